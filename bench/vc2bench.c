@@ -0,0 +1,1031 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* In-process benchmarks for rtpvc2pay and rtpvc2depay.
+ *
+ * The input pictures are made by vc2testsrc before any timing starts, then
+ * pushed through the elements with GstHarness, which calls the chain
+ * functions directly on this thread. Results are printed one JSON object per
+ * line on stdout so they can be collected and compared between runs. */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#include "vc2vlcparse.h"
+
+/* Counting every heap allocation is the only way to see the allocations made
+ * inside GLib and GStreamer as well as in the plugin. With glibc the
+ * allocator can be replaced from the executable and still reach the real
+ * one, elsewhere the counts are reported as null. The harness itself makes
+ * about one allocation per buffer it queues for us to pull. */
+#if defined(__GLIBC__)
+#define HAVE_ALLOC_COUNT 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static gint count_allocs = 0;
+static gint64 n_allocs = 0;
+
+#define COUNT_ALLOC() \
+  G_STMT_START { \
+    if (__atomic_load_n (&count_allocs, __ATOMIC_RELAXED)) \
+      __atomic_fetch_add (&n_allocs, 1, __ATOMIC_RELAXED); \
+  } G_STMT_END
+
+void *
+malloc (size_t size)
+{
+  COUNT_ALLOC ();
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  COUNT_ALLOC ();
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  COUNT_ALLOC ();
+  return __libc_realloc (ptr, size);
+}
+
+static void
+allocs_start (void)
+{
+  __atomic_store_n (&n_allocs, 0, __ATOMIC_RELAXED);
+  __atomic_store_n (&count_allocs, 1, __ATOMIC_RELAXED);
+}
+
+static gint64
+allocs_stop (void)
+{
+  __atomic_store_n (&count_allocs, 0, __ATOMIC_RELAXED);
+  return __atomic_load_n (&n_allocs, __ATOMIC_RELAXED);
+}
+#else
+static void
+allocs_start (void)
+{
+}
+
+static gint64
+allocs_stop (void)
+{
+  return -1;
+}
+#endif
+
+typedef struct {
+  guint    format;
+  guint32  width;
+  guint32  height;
+  gboolean interlaced;
+  guint    slices_x;
+  guint    slices_y;
+  guint    slice_bytes;
+
+  GPtrArray *pictures;
+  guint64    bytes;
+} BenchInput;
+
+static gint     opt_pictures       = 50;
+static gchar   *opt_formats        = NULL;
+static gchar   *opt_mtus           = NULL;
+static gchar   *opt_benches        = NULL;
+static gdouble  opt_bits_per_pixel = 1.0;
+static gchar   *opt_profiles       = NULL;
+static gint     opt_seed           = 1;
+static gint     opt_interleave     = 0;
+static gboolean opt_conceal        = FALSE;
+
+static GOptionEntry entries[] = {
+  {"pictures", 'n', 0, G_OPTION_ARG_INT, &opt_pictures,
+      "Number of pictures in each run (default 50)", "N"},
+  {"formats", 'f', 0, G_OPTION_ARG_STRING, &opt_formats,
+      "Comma separated VC-2 base video formats (default 11,17,19: 1080i, 2160p, 4320p)", "LIST"},
+  {"mtus", 'm', 0, G_OPTION_ARG_STRING, &opt_mtus,
+      "Comma separated MTUs (default 1500,9000)", "LIST"},
+  {"benches", 'b', 0, G_OPTION_ARG_STRING, &opt_benches,
+      "Comma separated benchmarks to run from pay, depay, e2e, impair, udp and udprecv (default all)", "LIST"},
+  {"bits-per-pixel", 0, 0, G_OPTION_ARG_DOUBLE, &opt_bits_per_pixel,
+      "Coded size of the test pictures (default 1.0)", "BPP"},
+  {"profiles", 'p', 0, G_OPTION_ARG_STRING, &opt_profiles,
+      "Comma separated impairment profiles for the impair benchmark (default all)", "LIST"},
+  {"seed", 's', 0, G_OPTION_ARG_INT, &opt_seed,
+      "Seed for rtpvc2impair (default 1)", "SEED"},
+  {"interleave", 0, 0, G_OPTION_ARG_INT, &opt_interleave,
+      "rtpvc2pay interleave for the impair benchmark (default 0)", "N"},
+  {"conceal", 0, 0, G_OPTION_ARG_NONE, &opt_conceal,
+      "Have rtpvc2depay conceal missing slices in the impair benchmark", NULL},
+  {NULL}
+};
+
+/* Network impairments for the impair benchmark, as rtpvc2impair properties */
+typedef struct {
+  const gchar *name;
+  const gchar *props;
+} ImpairProfile;
+
+static const ImpairProfile impair_profiles[] = {
+  { "clean",           "" },
+  { "bernoulli-0.1",   "loss-model=bernoulli loss-probability=0.001" },
+  { "bernoulli-1",     "loss-model=bernoulli loss-probability=0.01" },
+  { "gilbert-elliott", "loss-model=gilbert-elliott gilbert-p=0.001 gilbert-r=0.25 gilbert-bad-loss=0.5" },
+  { "reorder",         "reorder-probability=0.01 reorder-depth=3" },
+  { "duplicate",       "duplicate-probability=0.01" },
+  { "jitter",          "delay=1000000 jitter=500000" },
+};
+
+static gboolean
+list_contains (const gchar * list, const gchar * name)
+{
+  gchar **items;
+  gboolean r;
+
+  if (list == NULL)
+    return TRUE;
+
+  items = g_strsplit (list, ",", -1);
+  r = g_strv_contains ((const gchar * const *) items, name);
+  g_strfreev (items);
+
+  return r;
+}
+
+static gboolean
+bench_enabled (const gchar * name)
+{
+  return list_contains (opt_benches, name);
+}
+
+static gboolean
+is_picture (GstBuffer * buf)
+{
+  guint8 header[5];
+
+  if (gst_buffer_extract (buf, 0, header, 5) != 5)
+    return FALSE;
+
+  return (header[4] == 0xE8);
+}
+
+static gboolean
+bench_input_init (BenchInput * in, guint format)
+{
+  GstHarness *h;
+  gchar *desc;
+  guint32 picture_height;
+  gint i;
+
+  memset (in, 0, sizeof (BenchInput));
+  in->format = format;
+
+  if (!vc2_base_video_format_get (format, &in->width, &in->height,
+          &in->interlaced, NULL, NULL)) {
+    g_printerr ("unknown base video format %u\n", format);
+    return FALSE;
+  }
+
+  /* roughly 64x32 pixel slices */
+  picture_height  = (in->interlaced) ? in->height/2 : in->height;
+  in->slices_x    = MAX (1, in->width/64);
+  in->slices_y    = MAX (1, picture_height/32);
+  in->slice_bytes = MAX (8, (guint) (opt_bits_per_pixel*(in->width/in->slices_x)*(picture_height/in->slices_y)/8));
+
+  desc = g_strdup_printf ("vc2testsrc base-video-format=%u slices-x=%u slices-y=%u "
+      "slice-bytes=%u slice-sizes=uniform num-buffers=%d",
+      format, in->slices_x, in->slices_y, in->slice_bytes, opt_pictures);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_play (h);
+
+  in->pictures = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  for (i = 0; i < opt_pictures; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+
+    if (buf == NULL) {
+      g_printerr ("vc2testsrc stopped after %d pictures\n", i);
+      gst_harness_teardown (h);
+      return FALSE;
+    }
+    in->bytes += gst_buffer_get_size (buf);
+    g_ptr_array_add (in->pictures, buf);
+  }
+
+  gst_harness_teardown (h);
+  return TRUE;
+}
+
+static void
+bench_input_clear (BenchInput * in)
+{
+  if (in->pictures)
+    g_ptr_array_unref (in->pictures);
+  in->pictures = NULL;
+}
+
+static void
+print_header (const gchar * bench, BenchInput * in, guint mtu)
+{
+  g_print ("{\"bench\":\"%s\",\"gstreamer\":\"%s\",\"format\":%u,"
+      "\"width\":%u,\"height\":%u,\"interlaced\":%s,\"slices\":%u,"
+      "\"mtu\":%u,\"pictures\":%u,\"input_bytes\":%" G_GUINT64_FORMAT,
+      bench, gst_version_string (), in->format, in->width, in->height,
+      (in->interlaced) ? "true" : "false", in->slices_x*in->slices_y,
+      mtu, in->pictures->len, in->bytes);
+}
+
+static void
+print_allocs (gint64 allocs, guint pictures)
+{
+  if (allocs < 0 || pictures == 0)
+    g_print (",\"allocs_per_picture\":null");
+  else
+    g_print (",\"allocs_per_picture\":%.2f", (gdouble) allocs/pictures);
+}
+
+/* Pushes every picture through the payloader, keeping the packets in
+ * packets for the depayloader benchmark */
+static GstCaps *
+bench_pay (BenchInput * in, guint mtu, GPtrArray * packets, gboolean report)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstCaps *caps;
+  GstClockTime start, elapsed;
+  guint64 n_packets = 0, bytes = 0;
+  gint64 allocs;
+  gchar *desc;
+  guint i;
+
+  desc = g_strdup_printf ("rtpvc2pay mtu=%u", mtu);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_set_src_caps_str (h, "video/x-dirac");
+
+  allocs_start ();
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < in->pictures->len; i++) {
+    if (gst_harness_push (h, gst_buffer_ref (g_ptr_array_index (in->pictures, i))) != GST_FLOW_OK) {
+      g_printerr ("rtpvc2pay refused picture %u\n", i);
+      break;
+    }
+    while ((buf = gst_harness_try_pull (h)) != NULL) {
+      n_packets++;
+      bytes += gst_buffer_get_size (buf);
+      g_ptr_array_add (packets, buf);
+    }
+  }
+  elapsed = gst_util_get_timestamp () - start;
+  allocs = allocs_stop ();
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  gst_harness_teardown (h);
+
+  if (!report)
+    return caps;
+
+  print_header ("pay", in, mtu);
+  g_print (",\"packets\":%" G_GUINT64_FORMAT ",\"output_bytes\":%" G_GUINT64_FORMAT
+      ",\"seconds\":%.6f,\"packets_per_sec\":%.1f,\"ns_per_packet\":%.1f"
+      ",\"pictures_per_sec\":%.2f",
+      n_packets, bytes, (gdouble) elapsed/GST_SECOND,
+      (elapsed > 0) ? (gdouble) n_packets*GST_SECOND/elapsed : 0.0,
+      (n_packets > 0) ? (gdouble) elapsed/n_packets : 0.0,
+      (elapsed > 0) ? (gdouble) in->pictures->len*GST_SECOND/elapsed : 0.0);
+  print_allocs (allocs, in->pictures->len);
+  g_print ("}\n");
+
+  return caps;
+}
+
+static void
+bench_depay (BenchInput * in, guint mtu, GPtrArray * packets, GstCaps * caps)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstClockTime start, elapsed;
+  guint64 n_pictures = 0;
+  gint64 allocs;
+  guint i;
+
+  h = gst_harness_new ("rtpvc2depay");
+  gst_harness_set_src_caps (h, gst_caps_ref (caps));
+
+  allocs_start ();
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < packets->len; i++) {
+    if (gst_harness_push (h, gst_buffer_ref (g_ptr_array_index (packets, i))) != GST_FLOW_OK) {
+      g_printerr ("rtpvc2depay refused packet %u\n", i);
+      break;
+    }
+    while ((buf = gst_harness_try_pull (h)) != NULL) {
+      if (is_picture (buf))
+        n_pictures++;
+      gst_buffer_unref (buf);
+    }
+  }
+  elapsed = gst_util_get_timestamp () - start;
+  allocs = allocs_stop ();
+
+  gst_harness_teardown (h);
+
+  print_header ("depay", in, mtu);
+  g_print (",\"packets\":%u,\"output_pictures\":%" G_GUINT64_FORMAT
+      ",\"seconds\":%.6f,\"pictures_per_sec\":%.2f,\"ns_per_packet\":%.1f",
+      packets->len, n_pictures, (gdouble) elapsed/GST_SECOND,
+      (elapsed > 0) ? (gdouble) n_pictures*GST_SECOND/elapsed : 0.0,
+      (packets->len > 0) ? (gdouble) elapsed/packets->len : 0.0);
+  print_allocs (allocs, n_pictures);
+  g_print ("}\n");
+}
+
+static gint
+compare_clock_time (gconstpointer a, gconstpointer b)
+{
+  GstClockTime ta = *(const GstClockTime *) a;
+  GstClockTime tb = *(const GstClockTime *) b;
+
+  return (ta > tb) - (ta < tb);
+}
+
+/* The payloader only sends a picture once it sees the next parse info
+ * header, so pushing picture n sends picture n - 1 all the way through to
+ * the depayloader output. The time taken by each such push is the latency
+ * of one picture through the pair of elements. */
+static void
+bench_e2e (BenchInput * in, guint mtu)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstClockTime start, end, elapsed;
+  GArray *latencies;
+  guint64 n_pictures = 0, sum = 0;
+  gint64 allocs;
+  gchar *desc;
+  guint i, out;
+
+  desc = g_strdup_printf ("rtpvc2pay mtu=%u ! rtpvc2depay", mtu);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_set_src_caps_str (h, "video/x-dirac");
+
+  latencies = g_array_sized_new (FALSE, FALSE, sizeof (GstClockTime), in->pictures->len);
+
+  allocs_start ();
+  elapsed = 0;
+  for (i = 0; i < in->pictures->len; i++) {
+    start = gst_util_get_timestamp ();
+    if (gst_harness_push (h, gst_buffer_ref (g_ptr_array_index (in->pictures, i))) != GST_FLOW_OK) {
+      g_printerr ("rtpvc2pay ! rtpvc2depay refused picture %u\n", i);
+      break;
+    }
+    out = 0;
+    while ((buf = gst_harness_try_pull (h)) != NULL) {
+      if (is_picture (buf))
+        out++;
+      gst_buffer_unref (buf);
+    }
+    end = gst_util_get_timestamp ();
+
+    elapsed += end - start;
+    n_pictures += out;
+    if (out == 1) {
+      GstClockTime latency = end - start;
+      g_array_append_val (latencies, latency);
+    }
+  }
+  allocs = allocs_stop ();
+
+  gst_harness_teardown (h);
+
+  print_header ("e2e", in, mtu);
+  g_print (",\"output_pictures\":%" G_GUINT64_FORMAT ",\"seconds\":%.6f,\"pictures_per_sec\":%.2f",
+      n_pictures, (gdouble) elapsed/GST_SECOND,
+      (elapsed > 0) ? (gdouble) n_pictures*GST_SECOND/elapsed : 0.0);
+  if (latencies->len > 0) {
+    g_array_sort (latencies, compare_clock_time);
+    for (i = 0; i < latencies->len; i++)
+      sum += g_array_index (latencies, GstClockTime, i);
+    g_print (",\"latency_ns_min\":%" G_GUINT64_FORMAT ",\"latency_ns_mean\":%" G_GUINT64_FORMAT
+        ",\"latency_ns_p50\":%" G_GUINT64_FORMAT ",\"latency_ns_p99\":%" G_GUINT64_FORMAT
+        ",\"latency_ns_max\":%" G_GUINT64_FORMAT,
+        g_array_index (latencies, GstClockTime, 0),
+        sum/latencies->len,
+        g_array_index (latencies, GstClockTime, latencies->len/2),
+        g_array_index (latencies, GstClockTime, (latencies->len*99)/100),
+        g_array_index (latencies, GstClockTime, latencies->len - 1));
+  }
+  print_allocs (allocs, n_pictures);
+  g_print ("}\n");
+
+  g_array_unref (latencies);
+}
+
+/* Returns the picture number of the picture in buf, or FALSE if it does not
+ * contain one */
+static gboolean
+picture_number_get (GstBuffer * buf, guint32 * picture_number)
+{
+  GstMapInfo info;
+  vc2_parse_info pi;
+  gsize offset = 0;
+  gboolean found = FALSE;
+
+  gst_buffer_map (buf, &info, GST_MAP_READ);
+  while (vc2_parse_info_read (info.data + offset, info.size - offset, &pi)) {
+    if (pi.parse_code == 0xE8) {
+      if (offset + 17 <= info.size) {
+        *picture_number = GST_READ_UINT32_BE (info.data + offset + 13);
+        found = TRUE;
+      }
+      break;
+    }
+    if (pi.next_parse_offset == 0 || pi.next_parse_offset > info.size - offset)
+      break;
+    offset += pi.next_parse_offset;
+  }
+  gst_buffer_unmap (buf, &info);
+
+  return found;
+}
+
+/* Pushes every picture through rtpvc2pay ! rtpvc2impair ! rtpvc2depay and
+ * reports how many pictures got through, how many slices of them had to be
+ * concealed and how much later they came out than they went in, going by
+ * the picture numbers and timestamps. */
+static void
+bench_impair (BenchInput * in, guint mtu, const ImpairProfile * profile)
+{
+  GstHarness *h;
+  GstElement *impair, *depay;
+  GstStructure *stats = NULL;
+  GstBuffer *buf;
+  GHashTable *sent, *seen;
+  GstClockTime start, elapsed, added_sum = 0, added_max = 0;
+  guint64 n_pictures = 0, n_added = 0, lost = 0, duplicated = 0, reordered = 0;
+  guint64 concealed_pictures = 0, concealed_slices = 0;
+  guint32 picture_number;
+  gchar *desc;
+  guint i;
+
+  sent = g_hash_table_new (g_direct_hash, g_direct_equal);
+  seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (i = 0; i < in->pictures->len; i++) {
+    GstBuffer *picture = g_ptr_array_index (in->pictures, i);
+
+    if (picture_number_get (picture, &picture_number))
+      g_hash_table_insert (sent, GUINT_TO_POINTER (picture_number), picture);
+  }
+
+  desc = g_strdup_printf ("rtpvc2pay mtu=%u interleave=%d ! rtpvc2impair name=impair seed=%d %s ! "
+      "rtpvc2depay name=depay conceal=%s", mtu, opt_interleave, opt_seed, profile->props,
+      opt_conceal ? "true" : "false");
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_set_src_caps_str (h, "video/x-dirac");
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i <= in->pictures->len; i++) {
+    if (i < in->pictures->len) {
+      if (gst_harness_push (h, gst_buffer_ref (g_ptr_array_index (in->pictures, i))) != GST_FLOW_OK) {
+        g_printerr ("rtpvc2pay ! rtpvc2impair ! rtpvc2depay refused picture %u\n", i);
+        break;
+      }
+    } else {
+      /* send on the last picture and anything rtpvc2impair still holds */
+      gst_harness_push_event (h, gst_event_new_eos ());
+    }
+
+    while ((buf = gst_harness_try_pull (h)) != NULL) {
+      GstBuffer *picture;
+
+      if (picture_number_get (buf, &picture_number) &&
+          !g_hash_table_contains (seen, GUINT_TO_POINTER (picture_number))) {
+        g_hash_table_add (seen, GUINT_TO_POINTER (picture_number));
+        n_pictures++;
+
+        picture = g_hash_table_lookup (sent, GUINT_TO_POINTER (picture_number));
+        if (picture && GST_BUFFER_PTS_IS_VALID (picture) && GST_BUFFER_PTS_IS_VALID (buf) &&
+            GST_BUFFER_PTS (buf) >= GST_BUFFER_PTS (picture)) {
+          GstClockTime added = GST_BUFFER_PTS (buf) - GST_BUFFER_PTS (picture);
+
+          added_sum += added;
+          added_max  = MAX (added_max, added);
+          n_added++;
+        }
+      }
+      gst_buffer_unref (buf);
+    }
+  }
+  elapsed = gst_util_get_timestamp () - start;
+
+  impair = gst_bin_get_by_name (GST_BIN (h->element), "impair");
+  if (impair) {
+    g_object_get (impair, "stats", &stats, NULL);
+    gst_object_unref (impair);
+  }
+  if (stats) {
+    gst_structure_get_uint64 (stats, "lost", &lost);
+    gst_structure_get_uint64 (stats, "duplicated", &duplicated);
+    gst_structure_get_uint64 (stats, "reordered", &reordered);
+    gst_structure_free (stats);
+    stats = NULL;
+  }
+  depay = gst_bin_get_by_name (GST_BIN (h->element), "depay");
+  if (depay) {
+    g_object_get (depay, "stats", &stats, NULL);
+    gst_object_unref (depay);
+  }
+  if (stats) {
+    gst_structure_get_uint64 (stats, "concealed-pictures", &concealed_pictures);
+    gst_structure_get_uint64 (stats, "concealed-slices", &concealed_slices);
+    gst_structure_free (stats);
+  }
+  gst_harness_teardown (h);
+
+  print_header ("impair", in, mtu);
+  g_print (",\"profile\":\"%s\",\"seed\":%d,\"interleave\":%d,\"conceal\":%s"
+      ",\"packets_lost\":%" G_GUINT64_FORMAT
+      ",\"packets_duplicated\":%" G_GUINT64_FORMAT ",\"packets_reordered\":%" G_GUINT64_FORMAT
+      ",\"output_pictures\":%" G_GUINT64_FORMAT ",\"delivery_rate\":%.4f"
+      ",\"concealed_pictures\":%" G_GUINT64_FORMAT ",\"concealed_slices\":%" G_GUINT64_FORMAT
+      ",\"seconds\":%.6f",
+      profile->name, opt_seed, opt_interleave, opt_conceal ? "true" : "false",
+      lost, duplicated, reordered, n_pictures,
+      (in->pictures->len > 0) ? (gdouble) n_pictures/in->pictures->len : 0.0,
+      concealed_pictures, concealed_slices, (gdouble) elapsed/GST_SECOND);
+  if (n_added > 0)
+    g_print (",\"added_latency_ns_mean\":%" G_GUINT64_FORMAT ",\"added_latency_ns_max\":%" G_GUINT64_FORMAT,
+        added_sum/n_added, added_max);
+  else
+    g_print (",\"added_latency_ns_mean\":null,\"added_latency_ns_max\":null");
+  g_print ("}\n");
+
+  g_hash_table_unref (seen);
+  g_hash_table_unref (sent);
+}
+
+/* A loopback UDP socket drained by a thread of its own, counting what
+ * arrives, for the udp benchmark */
+typedef struct {
+  int      fd;
+  guint16  port;
+  gint     stop;
+  GThread *thread;
+
+  guint64  packets;
+  guint64  bytes;
+} UdpReceiver;
+
+static gpointer
+udp_receiver_run (gpointer data)
+{
+  UdpReceiver *rx = data;
+  static guint8 buf[65536];
+  struct pollfd pfd;
+  ssize_t n;
+
+  pfd.fd     = rx->fd;
+  pfd.events = POLLIN;
+
+  for (;;) {
+    while ((n = recv (rx->fd, buf, sizeof (buf), MSG_DONTWAIT)) >= 0) {
+      rx->packets++;
+      rx->bytes += n;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      break;
+    if (g_atomic_int_get (&rx->stop))
+      break;
+    poll (&pfd, 1, 10);
+  }
+
+  return NULL;
+}
+
+static gboolean
+udp_receiver_start (UdpReceiver * rx)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof (addr);
+  int rcvbuf = 64*1024*1024;
+
+  memset (rx, 0, sizeof (UdpReceiver));
+  rx->fd = socket (AF_INET, SOCK_DGRAM, 0);
+  if (rx->fd < 0)
+    return FALSE;
+  setsockopt (rx->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (bind (rx->fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+      getsockname (rx->fd, (struct sockaddr *) &addr, &addr_len) < 0) {
+    close (rx->fd);
+    return FALSE;
+  }
+  rx->port = ntohs (addr.sin_port);
+
+  rx->thread = g_thread_new ("udp-receiver", udp_receiver_run, rx);
+  return TRUE;
+}
+
+static void
+udp_receiver_stop (UdpReceiver * rx)
+{
+  g_atomic_int_set (&rx->stop, 1);
+  g_thread_join (rx->thread);
+  close (rx->fd);
+}
+
+/* Sends the payloaded packets to a loopback socket through sink, which is
+ * udpsink or vc2udpsink, and reports the send rate and system calls made */
+static void
+bench_udp (BenchInput * in, guint mtu, GPtrArray * packets, GstCaps * caps,
+    const gchar * sink)
+{
+  GstHarness *h;
+  GstElement *element;
+  GstStructure *stats = NULL;
+  GstClockTime start, elapsed;
+  UdpReceiver rx;
+  guint64 bytes = 0, syscalls = 0, gso_messages = 0;
+  gboolean have_stats = FALSE;
+  gint64 allocs;
+  gchar *desc;
+  guint i;
+
+  if (!udp_receiver_start (&rx)) {
+    g_printerr ("could not open a loopback socket: %s\n", g_strerror (errno));
+    return;
+  }
+
+  desc = g_strdup_printf ("%s name=sink host=127.0.0.1 port=%u sync=false async=false",
+      sink, rx.port);
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_set_src_caps (h, gst_caps_ref (caps));
+
+  for (i = 0; i < packets->len; i++)
+    bytes += gst_buffer_get_size (g_ptr_array_index (packets, i));
+
+  allocs_start ();
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < packets->len; i++) {
+    if (gst_harness_push (h, gst_buffer_ref (g_ptr_array_index (packets, i))) != GST_FLOW_OK) {
+      g_printerr ("%s refused packet %u\n", sink, i);
+      break;
+    }
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  elapsed = gst_util_get_timestamp () - start;
+  allocs = allocs_stop ();
+
+  element = gst_bin_get_by_name (GST_BIN (h->element), "sink");
+  if (element && g_object_class_find_property (G_OBJECT_GET_CLASS (element), "stats"))
+    g_object_get (element, "stats", &stats, NULL);
+  if (element)
+    gst_object_unref (element);
+  if (stats) {
+    have_stats = gst_structure_get_uint64 (stats, "syscalls", &syscalls) &&
+        gst_structure_get_uint64 (stats, "gso-messages", &gso_messages);
+    gst_structure_free (stats);
+  }
+  gst_harness_teardown (h);
+
+  /* let the receiver catch up before counting */
+  g_usleep (100000);
+  udp_receiver_stop (&rx);
+
+  print_header ("udp", in, mtu);
+  g_print (",\"sink\":\"%s\",\"packets\":%u,\"seconds\":%.6f,\"packets_per_sec\":%.1f"
+      ",\"gbit_per_sec\":%.3f,\"received_packets\":%" G_GUINT64_FORMAT,
+      sink, packets->len, (gdouble) elapsed/GST_SECOND,
+      (elapsed > 0) ? (gdouble) packets->len*GST_SECOND/elapsed : 0.0,
+      (elapsed > 0) ? (gdouble) bytes*8/elapsed : 0.0,
+      rx.packets);
+  if (have_stats)
+    g_print (",\"syscalls_per_picture\":%.2f,\"gso_messages\":%" G_GUINT64_FORMAT,
+        (gdouble) syscalls/in->pictures->len, gso_messages);
+  else
+    g_print (",\"syscalls_per_picture\":null,\"gso_messages\":null");
+  print_allocs (allocs, in->pictures->len);
+  g_print ("}\n");
+}
+
+/* Sends payloaded packets to a loopback port from a thread of its own, a
+ * picture at a time, keeping no more than a few pictures ahead of the
+ * receiver so that the kernel socket buffer does not overflow */
+#define UDP_SENDER_WINDOW 4
+
+typedef struct {
+  int        fd;
+  guint16    port;
+  GPtrArray *packets;
+  GThread   *thread;
+
+  gint       received;
+  gint       stop;
+} UdpSender;
+
+static gboolean
+is_marker (GstBuffer * buf)
+{
+  guint8 header[2];
+
+  if (gst_buffer_extract (buf, 0, header, 2) != 2)
+    return FALSE;
+
+  return ((header[1] & 0x80) != 0);
+}
+
+static gpointer
+udp_sender_run (gpointer data)
+{
+  UdpSender *tx = data;
+  struct sockaddr_in addr;
+  guint i, sent = 0;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port        = htons (tx->port);
+
+  for (i = 0; i < tx->packets->len && !g_atomic_int_get (&tx->stop); i++) {
+    GstBuffer *buf = g_ptr_array_index (tx->packets, i);
+    GstMapInfo info;
+
+    /* a lost picture is never received, so only wait a while for it */
+    if (i == 0 || is_marker (g_ptr_array_index (tx->packets, i - 1))) {
+      gint64 give_up = g_get_monotonic_time () + 50000;
+
+      while (sent >= g_atomic_int_get (&tx->received) + UDP_SENDER_WINDOW &&
+          g_get_monotonic_time () < give_up && !g_atomic_int_get (&tx->stop))
+        g_usleep (20);
+    }
+
+    gst_buffer_map (buf, &info, GST_MAP_READ);
+    sendto (tx->fd, info.data, info.size, 0, (struct sockaddr *) &addr, sizeof (addr));
+    gst_buffer_unmap (buf, &info);
+
+    if (is_marker (buf))
+      sent++;
+  }
+
+  return NULL;
+}
+
+/* Finds a free loopback port by binding to port 0 */
+static guint16
+udp_free_port (void)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof (addr);
+  guint16 port = 0;
+  int fd = socket (AF_INET, SOCK_DGRAM, 0);
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (fd >= 0 && bind (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0 &&
+      getsockname (fd, (struct sockaddr *) &addr, &addr_len) == 0)
+    port = ntohs (addr.sin_port);
+  if (fd >= 0)
+    close (fd);
+
+  return port;
+}
+
+/* Receives the payloaded packets over loopback through either
+ * udpsrc ! rtpvc2depay or vc2udpsrc and reports the picture rate */
+static void
+bench_udprecv (BenchInput * in, guint mtu, GPtrArray * packets, GstCaps * caps,
+    const gchar * source)
+{
+  GstHarness *h;
+  GstElement *element;
+  GstStructure *stats = NULL;
+  GstBuffer *buf;
+  GstClockTime start, elapsed;
+  UdpSender tx;
+  guint64 n_pictures = 0, expected = 0, syscalls = 0, gro_datagrams = 0;
+  gboolean have_stats = FALSE;
+  gint64 allocs, deadline;
+  gchar *desc, *caps_str;
+  guint i;
+
+  /* the payloader sets the marker bit on the last packet of each picture */
+  for (i = 0; i < packets->len; i++) {
+    if (is_marker (g_ptr_array_index (packets, i)))
+      expected++;
+  }
+
+  memset (&tx, 0, sizeof (UdpSender));
+  tx.port    = udp_free_port ();
+  tx.packets = packets;
+  tx.fd      = socket (AF_INET, SOCK_DGRAM, 0);
+  if (tx.port == 0 || tx.fd < 0) {
+    g_printerr ("could not open a loopback socket: %s\n", g_strerror (errno));
+    if (tx.fd >= 0)
+      close (tx.fd);
+    return;
+  }
+
+  if (g_str_equal (source, "vc2udpsrc")) {
+    desc = g_strdup_printf ("vc2udpsrc name=src address=127.0.0.1 port=%u buffer-size=67108864",
+        tx.port);
+  } else {
+    caps_str = gst_caps_to_string (caps);
+    desc = g_strdup_printf ("udpsrc name=src address=127.0.0.1 port=%u buffer-size=67108864 "
+        "caps=\"%s\" ! rtpvc2depay", tx.port, caps_str);
+    g_free (caps_str);
+  }
+  h = gst_harness_new_parse (desc);
+  g_free (desc);
+  gst_harness_play (h);
+
+  allocs_start ();
+  start = gst_util_get_timestamp ();
+  tx.thread = g_thread_new ("udp-sender", udp_sender_run, &tx);
+
+  deadline = g_get_monotonic_time () + 10*G_USEC_PER_SEC;
+  while (n_pictures < expected && g_get_monotonic_time () < deadline) {
+    buf = gst_harness_try_pull (h);
+    if (buf == NULL) {
+      g_usleep (20);
+      continue;
+    }
+    if (is_picture (buf)) {
+      n_pictures++;
+      g_atomic_int_inc (&tx.received);
+    }
+    gst_buffer_unref (buf);
+  }
+  elapsed = gst_util_get_timestamp () - start;
+  allocs = allocs_stop ();
+
+  g_atomic_int_set (&tx.stop, 1);
+  g_thread_join (tx.thread);
+  close (tx.fd);
+
+  element = gst_bin_get_by_name (GST_BIN (h->element), "src");
+  if (element && g_object_class_find_property (G_OBJECT_GET_CLASS (element), "stats"))
+    g_object_get (element, "stats", &stats, NULL);
+  if (element)
+    gst_object_unref (element);
+  if (stats) {
+    have_stats = gst_structure_get_uint64 (stats, "syscalls", &syscalls) &&
+        gst_structure_get_uint64 (stats, "gro-datagrams", &gro_datagrams);
+    gst_structure_free (stats);
+  }
+  gst_harness_teardown (h);
+
+  print_header ("udprecv", in, mtu);
+  g_print (",\"source\":\"%s\",\"packets\":%u,\"sent_pictures\":%" G_GUINT64_FORMAT
+      ",\"output_pictures\":%" G_GUINT64_FORMAT
+      ",\"seconds\":%.6f,\"pictures_per_sec\":%.2f,\"ns_per_packet\":%.1f",
+      source, packets->len, expected, n_pictures, (gdouble) elapsed/GST_SECOND,
+      (elapsed > 0) ? (gdouble) n_pictures*GST_SECOND/elapsed : 0.0,
+      (packets->len > 0) ? (gdouble) elapsed/packets->len : 0.0);
+  if (have_stats)
+    g_print (",\"syscalls_per_picture\":%.2f,\"gro_datagrams\":%" G_GUINT64_FORMAT,
+        (n_pictures > 0) ? (gdouble) syscalls/n_pictures : 0.0, gro_datagrams);
+  else
+    g_print (",\"syscalls_per_picture\":null,\"gro_datagrams\":null");
+  print_allocs (allocs, n_pictures);
+  g_print ("}\n");
+}
+
+static GArray *
+parse_list (const gchar * list)
+{
+  GArray *values = g_array_new (FALSE, FALSE, sizeof (guint));
+  gchar **items = g_strsplit (list, ",", -1);
+  gchar **item;
+
+  for (item = items; *item; item++) {
+    guint v = (guint) g_ascii_strtoull (*item, NULL, 10);
+    g_array_append_val (values, v);
+  }
+  g_strfreev (items);
+
+  return values;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GArray *formats, *mtus;
+  guint f, m;
+  int ret = 0;
+
+  ctx = g_option_context_new ("- benchmark rtpvc2pay and rtpvc2depay");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (opt_pictures < 3) {
+    g_printerr ("at least 3 pictures are needed\n");
+    return 1;
+  }
+
+  formats = parse_list ((opt_formats) ? opt_formats : "11,17,19");
+  mtus    = parse_list ((opt_mtus) ? opt_mtus : "1500,9000");
+
+  for (f = 0; f < formats->len && ret == 0; f++) {
+    BenchInput in;
+
+    if (!bench_input_init (&in, g_array_index (formats, guint, f))) {
+      bench_input_clear (&in);
+      ret = 1;
+      break;
+    }
+
+    for (m = 0; m < mtus->len; m++) {
+      guint mtu = g_array_index (mtus, guint, m);
+      GPtrArray *packets = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+      GstCaps *caps = NULL;
+
+      if (bench_enabled ("pay") || bench_enabled ("depay") || bench_enabled ("udp") ||
+          bench_enabled ("udprecv"))
+        caps = bench_pay (&in, mtu, packets, bench_enabled ("pay"));
+      if (bench_enabled ("depay") && caps != NULL)
+        bench_depay (&in, mtu, packets, caps);
+      if (bench_enabled ("udp") && caps != NULL) {
+        bench_udp (&in, mtu, packets, caps, "udpsink");
+        bench_udp (&in, mtu, packets, caps, "vc2udpsink");
+      }
+      if (bench_enabled ("udprecv") && caps != NULL) {
+        bench_udprecv (&in, mtu, packets, caps, "udpsrc");
+        bench_udprecv (&in, mtu, packets, caps, "vc2udpsrc");
+      }
+      if (caps)
+        gst_caps_unref (caps);
+      g_ptr_array_unref (packets);
+
+      if (bench_enabled ("e2e"))
+        bench_e2e (&in, mtu);
+
+      if (bench_enabled ("impair")) {
+        guint p;
+
+        for (p = 0; p < G_N_ELEMENTS (impair_profiles); p++) {
+          if (list_contains (opt_profiles, impair_profiles[p].name))
+            bench_impair (&in, mtu, &impair_profiles[p]);
+        }
+      }
+    }
+
+    bench_input_clear (&in);
+  }
+
+  g_array_unref (formats);
+  g_array_unref (mtus);
+
+  return ret;
+}
@@ -0,0 +1,806 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Timing and robustness checks for the parsers in src/vc2vlcparse.c.
+ *
+ * Each parser is run over a corpus of valid headers, every truncation of
+ * them and randomly mutated copies. Valid input has to parse to the values
+ * it was written with and truncated input has to be rejected; mutated input
+ * only has to be survived. Every input is held in an allocation of exactly
+ * its own size, so building with -fsanitize=address turns any read past the
+ * end into a failure. Results are printed one JSON object per line. */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+
+#include "vc2vlcparse.h"
+
+static gint    opt_passes    = 200;
+static gint    opt_mutations = 64;
+static gint    opt_seed      = 1;
+
+static GOptionEntry entries[] = {
+  {"passes", 'p', 0, G_OPTION_ARG_INT, &opt_passes,
+      "Number of times each corpus is parsed for timing (default 200)", "N"},
+  {"mutations", 'm', 0, G_OPTION_ARG_INT, &opt_mutations,
+      "Number of mutated copies of each valid input (default 64)", "N"},
+  {"seed", 's', 0, G_OPTION_ARG_INT, &opt_seed,
+      "Seed for the mutations (default 1)", "SEED"},
+  {NULL}
+};
+
+static gint failures = 0;
+
+#define CHECK(cond, ...) \
+  G_STMT_START { \
+    if (!(cond)) { \
+      g_printerr (__VA_ARGS__); \
+      g_printerr ("\n"); \
+      failures++; \
+    } \
+  } G_STMT_END
+
+/* What a valid input should parse to */
+typedef struct {
+  guint32 a;
+  guint32 b;
+  guint32 c;
+  guint32 d;
+} Expected;
+
+typedef struct {
+  GPtrArray *inputs;    /* GstBuffer, each wrapping exactly its own data */
+  GArray    *expected;  /* Expected, for the valid corpus only */
+} Corpus;
+
+static void
+corpus_init (Corpus * corpus)
+{
+  corpus->inputs   = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  corpus->expected = g_array_new (FALSE, TRUE, sizeof (Expected));
+}
+
+static void
+corpus_clear (Corpus * corpus)
+{
+  g_ptr_array_unref (corpus->inputs);
+  g_array_unref (corpus->expected);
+}
+
+static void
+corpus_add (Corpus * corpus, const guint8 * data, gsize size)
+{
+  gpointer copy = g_malloc (MAX (size, 1));
+
+  memcpy (copy, data, size);
+  g_ptr_array_add (corpus->inputs, gst_buffer_new_wrapped_full (0, copy,
+          MAX (size, 1), 0, size, copy, g_free));
+}
+
+static void
+corpus_add_valid (Corpus * corpus, const guint8 * data, gsize size,
+    guint32 a, guint32 b, guint32 c, guint32 d)
+{
+  Expected e = { a, b, c, d };
+
+  corpus_add (corpus, data, size);
+  g_array_append_val (corpus->expected, e);
+}
+
+/* Adds every truncation of each valid input */
+static void
+corpus_truncate (Corpus * truncated, Corpus * valid)
+{
+  GstMapInfo info;
+  gsize size;
+  guint i;
+
+  for (i = 0; i < valid->inputs->len; i++) {
+    GstBuffer *buf = g_ptr_array_index (valid->inputs, i);
+
+    gst_buffer_map (buf, &info, GST_MAP_READ);
+    for (size = 0; size < info.size; size++)
+      corpus_add (truncated, info.data, size);
+    gst_buffer_unmap (buf, &info);
+  }
+}
+
+/* Adds copies of each valid input with a few bits flipped, bytes replaced or
+ * the length changed */
+static void
+corpus_mutate (Corpus * mutated, Corpus * valid, GRand * rand)
+{
+  GstMapInfo info;
+  guint8 data[256];
+  gsize size;
+  guint i, j, k, n;
+
+  for (i = 0; i < valid->inputs->len; i++) {
+    GstBuffer *buf = g_ptr_array_index (valid->inputs, i);
+
+    gst_buffer_map (buf, &info, GST_MAP_READ);
+    for (j = 0; j < (guint) opt_mutations; j++) {
+      size = MIN (info.size, sizeof (data));
+      memcpy (data, info.data, size);
+
+      n = g_rand_int_range (rand, 1, 4);
+      for (k = 0; k < n && size > 0; k++) {
+        guint pos = g_rand_int_range (rand, 0, size);
+
+        switch (g_rand_int_range (rand, 0, 4)) {
+          case 0:
+            data[pos] ^= 1 << g_rand_int_range (rand, 0, 8);
+            break;
+          case 1:
+            data[pos] = g_rand_int_range (rand, 0, 256);
+            break;
+          case 2:
+            data[pos] = (g_rand_boolean (rand)) ? 0x00 : 0xFF;
+            break;
+          case 3:
+            size = g_rand_int_range (rand, 0, size + 1);
+            break;
+        }
+      }
+
+      corpus_add (mutated, data, size);
+    }
+    gst_buffer_unmap (buf, &info);
+  }
+}
+
+static void
+report (const gchar * parser, const gchar * corpus, guint inputs,
+    guint accepted, GstClockTime elapsed)
+{
+  g_print ("{\"parser\":\"%s\",\"corpus\":\"%s\",\"inputs\":%u,\"accepted\":%u,"
+      "\"rejected\":%u,\"passes\":%d,\"ns_per_parse\":%.1f}\n",
+      parser, corpus, inputs, accepted, inputs - accepted, opt_passes,
+      (inputs > 0) ? (gdouble) elapsed/((guint64) inputs*opt_passes) : 0.0);
+}
+
+/* Sequence headers */
+
+/* Variant 4 signals frame rate preset 8 (60/1) or 16 (120/1) explicitly */
+static gsize
+write_sequence_header (guint8 * data, gsize size, guint32 format,
+    guint32 picture_coding_mode, guint variant, guint32 * width, guint32 * height,
+    guint32 * frame_rate_numer, guint32 * frame_rate_denom)
+{
+  vc2_vlc_encoder *enc = vc2_vlc_encoder_new (data, size);
+  gsize length;
+
+  vc2_base_video_format_get (format, width, height, NULL, frame_rate_numer, frame_rate_denom);
+
+  vc2_vlc_encoder_write_uint (enc, 2);
+  vc2_vlc_encoder_write_uint (enc, 0);
+  vc2_vlc_encoder_write_uint (enc, 3);
+  vc2_vlc_encoder_write_uint (enc, 0);
+  vc2_vlc_encoder_write_uint (enc, format);
+
+  /* custom dimensions */
+  vc2_vlc_encoder_write_bool (enc, variant == 1);
+  if (variant == 1) {
+    *width  = 1000 + format;
+    *height = 500 + 2*format;
+    vc2_vlc_encoder_write_uint (enc, *width);
+    vc2_vlc_encoder_write_uint (enc, *height);
+  }
+
+  /* colour difference format and scan format */
+  vc2_vlc_encoder_write_bool (enc, variant == 2);
+  if (variant == 2)
+    vc2_vlc_encoder_write_uint (enc, 1);
+  vc2_vlc_encoder_write_bool (enc, variant == 2);
+  if (variant == 2)
+    vc2_vlc_encoder_write_uint (enc, 0);
+
+  /* frame rate and pixel aspect ratio, with custom values or a preset */
+  vc2_vlc_encoder_write_bool (enc, variant == 1 || variant == 4);
+  if (variant == 1) {
+    vc2_vlc_encoder_write_uint (enc, 0);
+    vc2_vlc_encoder_write_uint (enc, 30000);
+    vc2_vlc_encoder_write_uint (enc, 1001);
+    *frame_rate_numer = 30000;
+    *frame_rate_denom = 1001;
+  } else if (variant == 4) {
+    vc2_vlc_encoder_write_uint (enc, (format%2) ? 16 : 8);
+    *frame_rate_numer = (format%2) ? 120 : 60;
+    *frame_rate_denom = 1;
+  }
+  vc2_vlc_encoder_write_bool (enc, variant == 1);
+  if (variant == 1) {
+    vc2_vlc_encoder_write_uint (enc, 0);
+    vc2_vlc_encoder_write_uint (enc, 16);
+    vc2_vlc_encoder_write_uint (enc, 15);
+  }
+
+  /* clean area and signal range */
+  vc2_vlc_encoder_write_bool (enc, variant == 2);
+  if (variant == 2) {
+    vc2_vlc_encoder_write_uint (enc, 1900);
+    vc2_vlc_encoder_write_uint (enc, 1000);
+    vc2_vlc_encoder_write_uint (enc, 10);
+    vc2_vlc_encoder_write_uint (enc, 40);
+  }
+  vc2_vlc_encoder_write_bool (enc, variant == 2);
+  if (variant == 2) {
+    vc2_vlc_encoder_write_uint (enc, 0);
+    vc2_vlc_encoder_write_uint (enc, 64);
+    vc2_vlc_encoder_write_uint (enc, 876);
+    vc2_vlc_encoder_write_uint (enc, 512);
+    vc2_vlc_encoder_write_uint (enc, 896);
+  }
+
+  /* colour spec with custom primaries, matrix and transfer function */
+  vc2_vlc_encoder_write_bool (enc, variant == 3);
+  if (variant == 3) {
+    vc2_vlc_encoder_write_uint (enc, 0);
+    vc2_vlc_encoder_write_bool (enc, TRUE);
+    vc2_vlc_encoder_write_uint (enc, 1);
+    vc2_vlc_encoder_write_bool (enc, TRUE);
+    vc2_vlc_encoder_write_uint (enc, 2);
+    vc2_vlc_encoder_write_bool (enc, TRUE);
+    vc2_vlc_encoder_write_uint (enc, 3);
+  }
+
+  vc2_vlc_encoder_write_uint (enc, picture_coding_mode);
+
+  length = vc2_vlc_encoder_length (enc);
+  g_assert (!vc2_vlc_encoder_overrun (enc));
+  vc2_vlc_encoder_free (enc);
+
+  if (picture_coding_mode == 1)
+    *height /= 2;
+
+  return length;
+}
+
+static guint
+run_sequence_header (Corpus * corpus, gboolean check_valid, gboolean check_invalid,
+    GstClockTime * elapsed)
+{
+  GstClockTime start;
+  guint accepted = 0;
+  guint i;
+  gint pass;
+
+  start = gst_util_get_timestamp ();
+  for (pass = 0; pass < opt_passes; pass++) {
+    for (i = 0; i < corpus->inputs->len; i++) {
+      vc2_sequence_header *hdr = vc2_sequence_header_new (g_ptr_array_index (corpus->inputs, i));
+
+      if (pass == 0) {
+        if (hdr)
+          accepted++;
+
+        if (check_valid) {
+          Expected *e = &g_array_index (corpus->expected, Expected, i);
+
+          CHECK (hdr != NULL, "valid sequence header %u rejected", i);
+          CHECK (hdr == NULL || (hdr->picture_width == e->a && hdr->picture_height == e->b),
+              "valid sequence header %u parsed as %ux%u, expected %ux%u", i,
+              (hdr) ? hdr->picture_width : 0, (hdr) ? hdr->picture_height : 0, e->a, e->b);
+          CHECK (hdr == NULL || (hdr->frame_rate_numer == e->c && hdr->frame_rate_denom == e->d),
+              "valid sequence header %u parsed at %u/%u fps, expected %u/%u", i,
+              (hdr) ? hdr->frame_rate_numer : 0, (hdr) ? hdr->frame_rate_denom : 0, e->c, e->d);
+        }
+        if (check_invalid)
+          CHECK (hdr == NULL, "truncated sequence header %u accepted", i);
+      }
+
+      vc2_sequence_header_free (hdr);
+    }
+  }
+  *elapsed = gst_util_get_timestamp () - start;
+
+  return accepted;
+}
+
+static void
+bench_sequence_header (GRand * rand)
+{
+  Corpus valid, truncated, mutated;
+  GstClockTime elapsed;
+  guint8 data[128];
+  guint32 format, mode, variant, width, height, numer, denom;
+  guint accepted;
+  gsize size;
+
+  corpus_init (&valid);
+  corpus_init (&truncated);
+  corpus_init (&mutated);
+
+  for (format = 0; vc2_base_video_format_get (format, NULL, NULL, NULL, NULL, NULL); format++) {
+    for (mode = 0; mode < 2; mode++) {
+      for (variant = 0; variant < 5; variant++) {
+        size = write_sequence_header (data, sizeof (data), format, mode, variant, &width, &height,
+            &numer, &denom);
+        corpus_add_valid (&valid, data, size, width, height, numer, denom);
+      }
+    }
+  }
+  corpus_truncate (&truncated, &valid);
+  corpus_mutate (&mutated, &valid, rand);
+
+  accepted = run_sequence_header (&valid, TRUE, FALSE, &elapsed);
+  report ("sequence_header", "valid", valid.inputs->len, accepted, elapsed);
+  accepted = run_sequence_header (&truncated, FALSE, TRUE, &elapsed);
+  report ("sequence_header", "truncated", truncated.inputs->len, accepted, elapsed);
+  accepted = run_sequence_header (&mutated, FALSE, FALSE, &elapsed);
+  report ("sequence_header", "mutated", mutated.inputs->len, accepted, elapsed);
+
+  corpus_clear (&valid);
+  corpus_clear (&truncated);
+  corpus_clear (&mutated);
+}
+
+/* HQ transform parameters */
+
+static gsize
+write_transform_parameters (guint8 * data, gsize size, guint32 wavelet_index,
+    guint32 dwt_depth, guint32 slices_x, guint32 slices_y, guint32 prefix,
+    guint32 scalar, gboolean custom_quant_matrix)
+{
+  vc2_vlc_encoder *enc = vc2_vlc_encoder_new (data, size);
+  gsize length;
+  guint32 i;
+
+  vc2_vlc_encoder_write_uint (enc, wavelet_index);
+  vc2_vlc_encoder_write_uint (enc, dwt_depth);
+  vc2_vlc_encoder_write_uint (enc, slices_x);
+  vc2_vlc_encoder_write_uint (enc, slices_y);
+  vc2_vlc_encoder_write_uint (enc, prefix);
+  vc2_vlc_encoder_write_uint (enc, scalar);
+  vc2_vlc_encoder_write_bool (enc, custom_quant_matrix);
+  /* one value for the DC band and three for each level */
+  if (custom_quant_matrix) {
+    vc2_vlc_encoder_write_uint (enc, 4);
+    for (i = 0; i < dwt_depth; i++) {
+      vc2_vlc_encoder_write_uint (enc, 2 + i);
+      vc2_vlc_encoder_write_uint (enc, 2 + i);
+      vc2_vlc_encoder_write_uint (enc, 1 + i);
+    }
+  }
+
+  length = vc2_vlc_encoder_length (enc);
+  g_assert (!vc2_vlc_encoder_overrun (enc));
+  vc2_vlc_encoder_free (enc);
+
+  return length;
+}
+
+static guint
+run_transform_parameters (Corpus * corpus, gboolean check_valid, gboolean check_invalid,
+    GstClockTime * elapsed)
+{
+  GstClockTime start;
+  GstMapInfo *maps;
+  guint accepted = 0;
+  guint i;
+  gint pass;
+
+  /* map everything first so that only the parser is timed */
+  maps = g_new (GstMapInfo, corpus->inputs->len);
+  for (i = 0; i < corpus->inputs->len; i++)
+    gst_buffer_map (g_ptr_array_index (corpus->inputs, i), &maps[i], GST_MAP_READ);
+
+  start = gst_util_get_timestamp ();
+  for (pass = 0; pass < opt_passes; pass++) {
+    for (i = 0; i < corpus->inputs->len; i++) {
+      vc2_hq_transform_parameters *params =
+          vc2_hq_transform_parameters_new (maps[i].data, maps[i].size);
+
+      if (pass == 0) {
+        if (params)
+          accepted++;
+
+        if (check_valid) {
+          Expected *e = &g_array_index (corpus->expected, Expected, i);
+
+          CHECK (params != NULL, "valid transform parameters %u rejected", i);
+          CHECK (params == NULL || (params->slices_x == e->a && params->slices_y == e->b &&
+                  params->coded_size == maps[i].size),
+              "valid transform parameters %u parsed wrongly", i);
+        }
+        if (check_invalid)
+          CHECK (params == NULL, "truncated transform parameters %u accepted", i);
+      }
+
+      vc2_hq_transform_parameters_free (params);
+    }
+  }
+  *elapsed = gst_util_get_timestamp () - start;
+
+  for (i = 0; i < corpus->inputs->len; i++)
+    gst_buffer_unmap (g_ptr_array_index (corpus->inputs, i), &maps[i]);
+  g_free (maps);
+
+  return accepted;
+}
+
+static void
+bench_transform_parameters (GRand * rand)
+{
+  static const guint32 slices[][2] = { {1, 1}, {32, 18}, {120, 135}, {4096, 2160} };
+  Corpus valid, truncated, mutated;
+  GstClockTime elapsed;
+  guint8 data[128];
+  guint32 wavelet_index, dwt_depth, s, custom;
+  guint accepted;
+  gsize size;
+
+  corpus_init (&valid);
+  corpus_init (&truncated);
+  corpus_init (&mutated);
+
+  for (wavelet_index = 0; wavelet_index < 7; wavelet_index++) {
+    for (dwt_depth = 0; dwt_depth < 6; dwt_depth++) {
+      for (s = 0; s < G_N_ELEMENTS (slices); s++) {
+        for (custom = 0; custom < 2; custom++) {
+          size = write_transform_parameters (data, sizeof (data), wavelet_index,
+              dwt_depth, slices[s][0], slices[s][1], (s%2)*4, 1 + s*3, custom);
+          corpus_add_valid (&valid, data, size, slices[s][0], slices[s][1], 0, 0);
+        }
+      }
+    }
+  }
+  corpus_truncate (&truncated, &valid);
+  corpus_mutate (&mutated, &valid, rand);
+
+  accepted = run_transform_parameters (&valid, TRUE, FALSE, &elapsed);
+  report ("transform_parameters", "valid", valid.inputs->len, accepted, elapsed);
+  accepted = run_transform_parameters (&truncated, FALSE, TRUE, &elapsed);
+  report ("transform_parameters", "truncated", truncated.inputs->len, accepted, elapsed);
+  accepted = run_transform_parameters (&mutated, FALSE, FALSE, &elapsed);
+  report ("transform_parameters", "mutated", mutated.inputs->len, accepted, elapsed);
+
+  corpus_clear (&valid);
+  corpus_clear (&truncated);
+  corpus_clear (&mutated);
+}
+
+/* Parse info headers, both on their own and found in a stream held in an
+ * adapter the way the payloader does it */
+
+/* Units in the streams are at most 213 bytes, so anything longer than this
+ * is a corrupt next_parse_offset */
+#define STREAM_MAX_UNIT_SIZE 1024
+
+/* The unit data never contains 0x42, so the only parse info prefixes in the
+ * stream are the real ones */
+static gsize
+write_stream (guint8 * data, gsize size, GRand * rand, guint n_units)
+{
+  static const guint8 parse_codes[] = { 0x00, 0x20, 0x30, 0xE8 };
+  guint32 prev = 0, length;
+  gsize pos = 0;
+  guint i, j;
+
+  for (i = 0; i < n_units; i++) {
+    guint8 parse_code = parse_codes[g_rand_int_range (rand, 0, G_N_ELEMENTS (parse_codes))];
+
+    length = 13 + g_rand_int_range (rand, 0, 200);
+    if (pos + length + 13 > size)
+      break;
+
+    /* some padding units leave next_parse_offset as zero */
+    vc2_parse_info_write (data + pos, parse_code,
+        (parse_code == 0x30 && g_rand_boolean (rand)) ? 0 : length, prev);
+    for (j = 13; j < length; j++) {
+      data[pos + j] = g_rand_int_range (rand, 0, 256);
+      if (data[pos + j] == 0x42)
+        data[pos + j] = 0x41;
+    }
+
+    pos += length;
+    prev = length;
+  }
+
+  vc2_parse_info_write (data + pos, 0x10, 0, prev);
+
+  return pos + 13;
+}
+
+static guint
+run_parse_info_extract (Corpus * corpus, gboolean check_valid, gboolean check_truncated,
+    GstClockTime * elapsed, GstClockTime * find_elapsed, guint * found)
+{
+  GstAdapter **adapters;
+  GstClockTime start;
+  guint accepted = 0;
+  guint i;
+  gint pass;
+
+  adapters = g_new (GstAdapter *, corpus->inputs->len);
+  for (i = 0; i < corpus->inputs->len; i++) {
+    adapters[i] = gst_adapter_new ();
+    gst_adapter_push (adapters[i], gst_buffer_ref (g_ptr_array_index (corpus->inputs, i)));
+  }
+
+  /* extract at every parse info prefix found in the stream */
+  start = gst_util_get_timestamp ();
+  for (pass = 0; pass < opt_passes; pass++) {
+    for (i = 0; i < corpus->inputs->len; i++) {
+      gsize size = gst_adapter_available (adapters[i]);
+      gssize offset = 0;
+      gboolean ok = TRUE;
+      vc2_parse_info info;
+
+      while ((gsize) offset + 4 <= size &&
+          (offset = gst_adapter_masked_scan_uint32 (adapters[i], 0xFFFFFFFF,
+                  0x42424344, offset, size - offset)) >= 0) {
+        vc2_parse_info_result res = vc2_parse_info_extract (adapters[i], size, offset,
+            STREAM_MAX_UNIT_SIZE, &info);
+
+        if (res != VC2_PARSE_INFO_OK)
+          ok = FALSE;
+        if (pass == 0 && check_truncated)
+          CHECK (res != VC2_PARSE_INFO_INVALID,
+              "parse info at %" G_GSSIZE_FORMAT " of truncated stream %u rejected", offset, i);
+        offset++;
+      }
+
+      if (pass == 0) {
+        if (ok)
+          accepted++;
+        if (check_valid)
+          CHECK (ok, "valid stream %u rejected", i);
+      }
+    }
+  }
+  *elapsed = gst_util_get_timestamp () - start;
+
+  *found = 0;
+  start = gst_util_get_timestamp ();
+  for (pass = 0; pass < opt_passes; pass++) {
+    for (i = 0; i < corpus->inputs->len; i++) {
+      gssize offset = vc2_parse_info_find (adapters[i], gst_adapter_available (adapters[i]), 0,
+          STREAM_MAX_UNIT_SIZE);
+
+      if (pass == 0) {
+        if (offset >= 0)
+          (*found)++;
+        if (check_valid)
+          CHECK (offset == 0, "parse info not found at the start of valid stream %u", i);
+      }
+    }
+  }
+  *find_elapsed = gst_util_get_timestamp () - start;
+
+  for (i = 0; i < corpus->inputs->len; i++)
+    g_object_unref (adapters[i]);
+  g_free (adapters);
+
+  return accepted;
+}
+
+/* Streams whose first next_parse_offset has been made longer than any unit.
+ * The first header has to be rejected rather than waited on, and the search
+ * has to carry on to the second */
+static void
+bench_parse_info_corrupt_offset (GRand * rand)
+{
+  Corpus corrupt;
+  GstAdapter **adapters;
+  GstClockTime start, elapsed;
+  vc2_parse_info info;
+  guint8 data[4096];
+  guint accepted = 0, i;
+  gint pass;
+  gsize size;
+
+  corpus_init (&corrupt);
+  for (i = 0; i < 32; i++) {
+    guint32 length;
+
+    size = write_stream (data, sizeof (data), rand, 1 + i%8);
+    vc2_parse_info_read (data, size, &info);
+    length = info.next_parse_offset;
+    if (length == 0) {
+      vc2_parse_info next;
+
+      /* a padding unit which left it as zero, find the next header */
+      for (length = 13; length + 13 <= size; length++)
+        if (vc2_parse_info_read (data + length, size - length, &next) && next.prev_parse_offset == length)
+          break;
+    }
+
+    vc2_parse_info_write (data, data[4],
+        (i%2) ? G_MAXUINT32 : STREAM_MAX_UNIT_SIZE + 1 + g_rand_int_range (rand, 0, 1 << 20), 0);
+    corpus_add_valid (&corrupt, data, size, length, 0, 0, 0);
+  }
+
+  adapters = g_new (GstAdapter *, corrupt.inputs->len);
+  for (i = 0; i < corrupt.inputs->len; i++) {
+    adapters[i] = gst_adapter_new ();
+    gst_adapter_push (adapters[i], gst_buffer_ref (g_ptr_array_index (corrupt.inputs, i)));
+  }
+
+  start = gst_util_get_timestamp ();
+  for (pass = 0; pass < opt_passes; pass++) {
+    for (i = 0; i < corrupt.inputs->len; i++) {
+      gsize available = gst_adapter_available (adapters[i]);
+      vc2_parse_info_result res = vc2_parse_info_extract (adapters[i], available, 0,
+          STREAM_MAX_UNIT_SIZE, &info);
+      gssize offset = vc2_parse_info_find (adapters[i], available, 0, STREAM_MAX_UNIT_SIZE);
+
+      if (pass == 0) {
+        Expected *e = &g_array_index (corrupt.expected, Expected, i);
+
+        if (res == VC2_PARSE_INFO_OK)
+          accepted++;
+        CHECK (res == VC2_PARSE_INFO_INVALID,
+            "parse info with a corrupt next_parse_offset in stream %u not rejected", i);
+        CHECK (offset == (gssize) e->a,
+            "resynchronised at %" G_GSSIZE_FORMAT " in stream %u, expected %u", offset, i, e->a);
+      }
+    }
+  }
+  elapsed = gst_util_get_timestamp () - start;
+
+  report ("parse_info_extract", "corrupt_offset", corrupt.inputs->len, accepted, elapsed);
+
+  for (i = 0; i < corrupt.inputs->len; i++)
+    g_object_unref (adapters[i]);
+  g_free (adapters);
+  corpus_clear (&corrupt);
+}
+
+static void
+bench_parse_info (GRand * rand)
+{
+  Corpus valid, truncated, mutated;
+  GstClockTime elapsed, find_elapsed, start;
+  guint8 data[4096];
+  vc2_parse_info info;
+  guint accepted, found, i;
+  gint pass;
+  gsize size;
+
+  corpus_init (&valid);
+  corpus_init (&truncated);
+  corpus_init (&mutated);
+
+  /* single headers first */
+  for (i = 0; i < 256; i++) {
+    vc2_parse_info_write (data, i, g_rand_int (rand), g_rand_int (rand));
+    corpus_add_valid (&valid, data, 13, 0, 0, 0, 0);
+  }
+  corpus_truncate (&truncated, &valid);
+  corpus_mutate (&mutated, &valid, rand);
+
+  for (i = 0; i < 3; i++) {
+    Corpus *corpus = (i == 0) ? &valid : (i == 1) ? &truncated : &mutated;
+    GstMapInfo *maps = g_new (GstMapInfo, corpus->inputs->len);
+    guint j;
+
+    for (j = 0; j < corpus->inputs->len; j++)
+      gst_buffer_map (g_ptr_array_index (corpus->inputs, j), &maps[j], GST_MAP_READ);
+
+    accepted = 0;
+    start = gst_util_get_timestamp ();
+    for (pass = 0; pass < opt_passes; pass++) {
+      for (j = 0; j < corpus->inputs->len; j++) {
+        gboolean ok = vc2_parse_info_read (maps[j].data, maps[j].size, &info);
+
+        if (pass == 0) {
+          if (ok)
+            accepted++;
+          if (i == 0)
+            CHECK (ok && info.parse_code == j, "valid parse info %u rejected", j);
+          if (i == 1)
+            CHECK (!ok, "truncated parse info %u accepted", j);
+        }
+      }
+    }
+    elapsed = gst_util_get_timestamp () - start;
+
+    for (j = 0; j < corpus->inputs->len; j++)
+      gst_buffer_unmap (g_ptr_array_index (corpus->inputs, j), &maps[j]);
+    g_free (maps);
+
+    report ("parse_info_read", (i == 0) ? "valid" : (i == 1) ? "truncated" : "mutated",
+        corpus->inputs->len, accepted, elapsed);
+  }
+
+  corpus_clear (&valid);
+  corpus_clear (&truncated);
+  corpus_clear (&mutated);
+
+  /* then whole streams */
+  corpus_init (&valid);
+  corpus_init (&truncated);
+  corpus_init (&mutated);
+
+  for (i = 0; i < 32; i++) {
+    size = write_stream (data, sizeof (data), rand, 1 + i%8);
+    corpus_add_valid (&valid, data, size, 0, 0, 0, 0);
+  }
+  for (i = 0; i < valid.inputs->len; i++) {
+    GstBuffer *buf = g_ptr_array_index (valid.inputs, i);
+    guint j;
+
+    size = gst_buffer_extract (buf, 0, data, sizeof (data));
+    for (j = 0; j < 16; j++)
+      corpus_add (&truncated, data, g_rand_int_range (rand, 0, size));
+  }
+  corpus_mutate (&mutated, &valid, rand);
+
+  accepted = run_parse_info_extract (&valid, TRUE, FALSE, &elapsed, &find_elapsed, &found);
+  report ("parse_info_extract", "valid", valid.inputs->len, accepted, elapsed);
+  report ("parse_info_find", "valid", valid.inputs->len, found, find_elapsed);
+  accepted = run_parse_info_extract (&truncated, FALSE, TRUE, &elapsed, &find_elapsed, &found);
+  report ("parse_info_extract", "truncated", truncated.inputs->len, accepted, elapsed);
+  report ("parse_info_find", "truncated", truncated.inputs->len, found, find_elapsed);
+  accepted = run_parse_info_extract (&mutated, FALSE, FALSE, &elapsed, &find_elapsed, &found);
+  report ("parse_info_extract", "mutated", mutated.inputs->len, accepted, elapsed);
+  report ("parse_info_find", "mutated", mutated.inputs->len, found, find_elapsed);
+
+  corpus_clear (&valid);
+  corpus_clear (&truncated);
+  corpus_clear (&mutated);
+
+  bench_parse_info_corrupt_offset (rand);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GRand *rand;
+
+  ctx = g_option_context_new ("- time and check the VC-2 header parsers");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (opt_passes < 1)
+    opt_passes = 1;
+
+  rand = g_rand_new_with_seed (opt_seed);
+
+  bench_sequence_header (rand);
+  bench_transform_parameters (rand);
+  bench_parse_info (rand);
+
+  g_rand_free (rand);
+
+  if (failures > 0) {
+    g_printerr ("%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -26,6 +26,15 @@
 
 #include "gstrtpvc2depay.h"
 #include "gstrtpvc2pay.h"
+#include "gstrtpvc2repay.h"
+#include "gstrtpvc2analyzer.h"
+#include "gstvc2testsrc.h"
+#include "gstrtpvc2impair.h"
+#include "gstvc2udpsink.h"
+#include "gstvc2udpsrc.h"
+#include "gstvc2slicecrop.h"
+#include "gstvc2slicetile.h"
+#include "gstvc2filesrc.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -38,6 +47,33 @@ plugin_init (GstPlugin * plugin)
   if (!gst_rtp_vc2_pay_plugin_init (plugin))
     return FALSE;
 
+  if (!gst_rtp_vc2_repay_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_rtp_vc2_analyzer_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_test_src_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_rtp_vc2_impair_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_udp_sink_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_udp_src_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_slice_crop_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_slice_tile_plugin_init (plugin))
+    return FALSE;
+
+  if (!gst_vc2_file_src_plugin_init (plugin))
+    return FALSE;
+
 
   return TRUE;
 }
@@ -95,3 +95,46 @@ gst_rtp_drop_meta (GstElement * element, GstBuffer * buf, GQuark keep_tag)
 
   gst_buffer_foreach_meta (buf, foreach_metadata_drop, &data);
 }
+
+gboolean
+gst_rtp_vc2_capture_time_write (GstRTPBuffer * rtp, guint8 id, GstClockTime capture_time)
+{
+  guint8 data[8];
+
+  GST_WRITE_UINT64_BE (data, capture_time);
+
+  return gst_rtp_buffer_add_extension_onebyte_header (rtp, id, data, sizeof (data));
+}
+
+gboolean
+gst_rtp_vc2_capture_time_read (GstRTPBuffer * rtp, guint8 id, GstClockTime * capture_time)
+{
+  gpointer data;
+  guint size;
+
+  if (!gst_rtp_buffer_get_extension_onebyte_header (rtp, id, 0, &data, &size) || size != 8)
+    return FALSE;
+
+  *capture_time = GST_READ_UINT64_BE (data);
+
+  return GST_CLOCK_TIME_IS_VALID (*capture_time);
+}
+
+/* Looks for an extmap-<id> field naming the capture time extension, as
+ * produced from an SDP a=extmap line, and returns its id or 0 */
+guint8
+gst_rtp_vc2_capture_time_ext_id (const GstStructure * s)
+{
+  gchar field[16];
+  const gchar *uri;
+  guint id;
+
+  for (id = 1; id <= 14; id++) {
+    g_snprintf (field, sizeof (field), "extmap-%u", id);
+    uri = gst_structure_get_string (s, field);
+    if (uri != NULL && g_strcmp0 (uri, GST_RTP_VC2_CAPTURE_TIME_URI) == 0)
+      return id;
+  }
+
+  return 0;
+}
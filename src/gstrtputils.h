@@ -21,12 +21,22 @@
 #define __GST_RTP_UTILS_H__
 
 #include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
 
 G_BEGIN_DECLS
 
+/* RFC 8285 one-byte header extension carrying the clock time, in nanoseconds
+ * as a 64 bit big endian integer, at which a picture was captured */
+#define GST_RTP_VC2_CAPTURE_TIME_URI "urn:x-bbc:rtp-hdrext:vc2-capture-time"
+#define GST_RTP_VC2_CAPTURE_TIME_CAPS "timestamp/x-vc2-capture-time"
+
 void gst_rtp_copy_meta (GstElement * element, GstBuffer *outbuf, GstBuffer *inbuf, GQuark copy_tag);
 void gst_rtp_drop_meta (GstElement * element, GstBuffer *buf, GQuark keep_tag);
 
+gboolean gst_rtp_vc2_capture_time_write  (GstRTPBuffer * rtp, guint8 id, GstClockTime capture_time);
+gboolean gst_rtp_vc2_capture_time_read   (GstRTPBuffer * rtp, guint8 id, GstClockTime * capture_time);
+guint8   gst_rtp_vc2_capture_time_ext_id (const GstStructure * s);
+
 
 G_END_DECLS
 
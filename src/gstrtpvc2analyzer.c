@@ -0,0 +1,473 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "gstrtpvc2analyzer.h"
+#include "vc2vlcparse.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtpvc2analyzer_debug);
+#define GST_CAT_DEFAULT (rtpvc2analyzer_debug)
+
+/* A pass-through element which looks at the VC2 payload headers of the
+ * packets going through it and periodically posts element messages named
+ * "rtpvc2analyzer" describing the packet timing of the stream. The only
+ * per packet work is reading the headers and updating some counters, so it
+ * can be left in a pipeline running at full rate. */
+
+#define DEFAULT_INTERVAL GST_SECOND
+
+enum
+{
+  PROP_0,
+  PROP_INTERVAL
+};
+
+static GstStaticPadTemplate gst_rtp_vc2_analyzer_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+        "media = (string) \"video\", "
+        "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
+    );
+
+static GstStaticPadTemplate gst_rtp_vc2_analyzer_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+        "media = (string) \"video\", "
+        "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
+    );
+
+static void gst_rtp_vc2_analyzer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_rtp_vc2_analyzer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_rtp_vc2_analyzer_start (GstBaseTransform * trans);
+static GstFlowReturn gst_rtp_vc2_analyzer_transform_ip (GstBaseTransform *
+    trans, GstBuffer * buf);
+
+#define gst_rtp_vc2_analyzer_parent_class parent_class
+G_DEFINE_TYPE (GstRtpVC2Analyzer, gst_rtp_vc2_analyzer,
+    GST_TYPE_BASE_TRANSFORM);
+
+static void
+gst_rtp_vc2_analyzer_class_init (GstRtpVC2AnalyzerClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseTransformClass *gstbasetransform_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasetransform_class = (GstBaseTransformClass *) klass;
+
+  gobject_class->set_property = gst_rtp_vc2_analyzer_set_property;
+  gobject_class->get_property = gst_rtp_vc2_analyzer_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint64 ("interval", "Report Interval",
+          "Interval in nanoseconds between statistics messages (0 = never)",
+          0, G_MAXUINT64, DEFAULT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_analyzer_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_analyzer_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "RTP VC2 analyzer", "Filter/Analyzer/Network/RTP",
+      "Reports packet timing and burstiness of VC2 RTP streams",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstbasetransform_class->start = gst_rtp_vc2_analyzer_start;
+  gstbasetransform_class->transform_ip = gst_rtp_vc2_analyzer_transform_ip;
+  gstbasetransform_class->passthrough_on_same_caps = TRUE;
+  gstbasetransform_class->transform_ip_on_passthrough = TRUE;
+
+  GST_DEBUG_CATEGORY_INIT (rtpvc2analyzer_debug, "rtpvc2analyzer", 0,
+      "VC2 RTP Analyzer");
+}
+
+static void
+gst_rtp_vc2_analyzer_reset_stats (GstRtpVC2Analyzer * rtpvc2analyzer)
+{
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+
+  memset (stats, 0, sizeof (GstRtpVC2AnalyzerStats));
+  stats->picture_packets_min = G_MAXUINT;
+  stats->gap_min             = GST_CLOCK_TIME_NONE;
+  stats->spread_min          = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_rtp_vc2_analyzer_reset (GstRtpVC2Analyzer * rtpvc2analyzer)
+{
+  rtpvc2analyzer->last_report          = GST_CLOCK_TIME_NONE;
+  rtpvc2analyzer->have_seq             = FALSE;
+  rtpvc2analyzer->last_ext_seq         = 0;
+  rtpvc2analyzer->last_arrival         = GST_CLOCK_TIME_NONE;
+  rtpvc2analyzer->in_picture           = FALSE;
+  rtpvc2analyzer->have_rtptime         = FALSE;
+  rtpvc2analyzer->last_rtptime         = 0;
+  rtpvc2analyzer->picture_period       = GST_CLOCK_TIME_NONE;
+  rtpvc2analyzer->last_picture_packets = 0;
+
+  gst_rtp_vc2_analyzer_reset_stats (rtpvc2analyzer);
+}
+
+static void
+gst_rtp_vc2_analyzer_init (GstRtpVC2Analyzer * rtpvc2analyzer)
+{
+  rtpvc2analyzer->interval = DEFAULT_INTERVAL;
+
+  gst_rtp_vc2_analyzer_reset (rtpvc2analyzer);
+}
+
+static gboolean
+gst_rtp_vc2_analyzer_start (GstBaseTransform * trans)
+{
+  GstRtpVC2Analyzer *rtpvc2analyzer = GST_RTP_VC2_ANALYZER (trans);
+
+  GST_OBJECT_LOCK (rtpvc2analyzer);
+  gst_rtp_vc2_analyzer_reset (rtpvc2analyzer);
+  GST_OBJECT_UNLOCK (rtpvc2analyzer);
+
+  return TRUE;
+}
+
+static GstStructure *
+gst_rtp_vc2_analyzer_take_report (GstRtpVC2Analyzer * rtpvc2analyzer,
+    GstClockTime elapsed)
+{
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+  GstStructure *s;
+
+  s = gst_structure_new ("rtpvc2analyzer",
+      "interval",              G_TYPE_UINT64, elapsed,
+      "packets",               G_TYPE_UINT64, stats->packets,
+      "bytes",                 G_TYPE_UINT64, stats->bytes,
+      "lost",                  G_TYPE_UINT64, stats->lost,
+      "gaps",                  G_TYPE_UINT64, stats->gaps,
+      "reordered",             G_TYPE_UINT64, stats->reordered,
+      "duplicates",            G_TYPE_UINT64, stats->duplicates,
+      "pictures",              G_TYPE_UINT64, stats->pictures,
+      "incomplete-pictures",   G_TYPE_UINT64, stats->incomplete_pictures,
+      "progressive-pictures",  G_TYPE_UINT64, stats->progressive_pictures,
+      "first-fields",          G_TYPE_UINT64, stats->first_fields,
+      "second-fields",         G_TYPE_UINT64, stats->second_fields,
+      "slices",                G_TYPE_UINT64, stats->slices,
+      "picture-packets-min",   G_TYPE_UINT, (stats->pictures > 0) ? stats->picture_packets_min : 0,
+      "picture-packets-max",   G_TYPE_UINT, stats->picture_packets_max,
+      "picture-packets-mean",  G_TYPE_DOUBLE, (stats->pictures > 0) ?
+          (gdouble) stats->picture_packets_sum / stats->pictures : 0.0,
+      "gap-min",               G_TYPE_UINT64, (stats->gap_count > 0) ? stats->gap_min : 0,
+      "gap-max",               G_TYPE_UINT64, stats->gap_max,
+      "gap-mean",              G_TYPE_UINT64, (stats->gap_count > 0) ?
+          stats->gap_sum / stats->gap_count : 0,
+      "spread-min",            G_TYPE_UINT64, (stats->pictures > 0) ? stats->spread_min : 0,
+      "spread-max",            G_TYPE_UINT64, stats->spread_max,
+      "spread-mean",           G_TYPE_UINT64, (stats->pictures > 0) ?
+          stats->spread_sum / stats->pictures : 0,
+      "cinst-max",             G_TYPE_UINT, stats->cinst_max,
+      NULL);
+
+  gst_rtp_vc2_analyzer_reset_stats (rtpvc2analyzer);
+
+  return s;
+}
+
+static void
+gst_rtp_vc2_analyzer_start_picture (GstRtpVC2Analyzer * rtpvc2analyzer,
+    guint32 picture_number, guint32 rtptime, guint8 flags, GstClockTime arrival)
+{
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+  guint32 delta;
+
+  /* The picture period comes from the RTP timestamps, which only make sense
+   * if they moved on by less than a second */
+  if (rtpvc2analyzer->have_rtptime) {
+    delta = rtptime - rtpvc2analyzer->last_rtptime;
+    if (delta > 0 && delta < 90000)
+      rtpvc2analyzer->picture_period = gst_util_uint64_scale_int (delta, GST_SECOND, 90000);
+  }
+  rtpvc2analyzer->have_rtptime = TRUE;
+  rtpvc2analyzer->last_rtptime = rtptime;
+
+  rtpvc2analyzer->in_picture              = TRUE;
+  rtpvc2analyzer->picture_number          = picture_number;
+  rtpvc2analyzer->picture_rtptime         = rtptime;
+  rtpvc2analyzer->picture_packets         = 0;
+  rtpvc2analyzer->picture_slices          = 0;
+  rtpvc2analyzer->picture_expected_slices = 0;
+  rtpvc2analyzer->picture_first           = arrival;
+  rtpvc2analyzer->picture_last            = arrival;
+
+  if (!(flags & 0x2))
+    stats->progressive_pictures++;
+  else if (!(flags & 0x1))
+    stats->first_fields++;
+  else
+    stats->second_fields++;
+}
+
+static void
+gst_rtp_vc2_analyzer_end_picture (GstRtpVC2Analyzer * rtpvc2analyzer,
+    gboolean complete)
+{
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+  GstClockTime spread;
+
+  stats->pictures++;
+  if (!complete || (rtpvc2analyzer->picture_expected_slices != 0 &&
+          rtpvc2analyzer->picture_slices != rtpvc2analyzer->picture_expected_slices))
+    stats->incomplete_pictures++;
+
+  stats->picture_packets_sum += rtpvc2analyzer->picture_packets;
+  stats->picture_packets_min = MIN (stats->picture_packets_min, rtpvc2analyzer->picture_packets);
+  stats->picture_packets_max = MAX (stats->picture_packets_max, rtpvc2analyzer->picture_packets);
+
+  spread = rtpvc2analyzer->picture_last - rtpvc2analyzer->picture_first;
+  stats->spread_sum += spread;
+  if (!GST_CLOCK_TIME_IS_VALID (stats->spread_min) || spread < stats->spread_min)
+    stats->spread_min = spread;
+  stats->spread_max = MAX (stats->spread_max, spread);
+
+  rtpvc2analyzer->last_picture_packets = rtpvc2analyzer->picture_packets;
+  rtpvc2analyzer->in_picture           = FALSE;
+}
+
+/* An approximation of the network compatibility model of ST 2110-21: a
+ * bucket that is drained of one packet every picture period divided by the
+ * number of packets in the last picture. The peak fill shows how bursty the
+ * sender is. */
+static void
+gst_rtp_vc2_analyzer_update_cinst (GstRtpVC2Analyzer * rtpvc2analyzer,
+    GstClockTime arrival)
+{
+  GstClockTime trs;
+  guint64 drained;
+  guint cinst;
+
+  if (!GST_CLOCK_TIME_IS_VALID (rtpvc2analyzer->picture_period) ||
+      rtpvc2analyzer->last_picture_packets == 0)
+    return;
+
+  trs = rtpvc2analyzer->picture_period / rtpvc2analyzer->last_picture_packets;
+  if (trs == 0)
+    return;
+
+  drained = (arrival - rtpvc2analyzer->picture_first) / trs;
+  cinst = (rtpvc2analyzer->picture_packets > drained) ?
+      (guint) (rtpvc2analyzer->picture_packets - drained) : 0;
+
+  rtpvc2analyzer->stats.cinst_max = MAX (rtpvc2analyzer->stats.cinst_max, cinst);
+}
+
+static void
+gst_rtp_vc2_analyzer_track_seq (GstRtpVC2Analyzer * rtpvc2analyzer,
+    guint32 ext_seq)
+{
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+  gint32 diff;
+
+  if (!rtpvc2analyzer->have_seq) {
+    rtpvc2analyzer->have_seq     = TRUE;
+    rtpvc2analyzer->last_ext_seq = ext_seq;
+    return;
+  }
+
+  diff = (gint32) (ext_seq - (rtpvc2analyzer->last_ext_seq + 1));
+  if (diff == 0) {
+    rtpvc2analyzer->last_ext_seq = ext_seq;
+  } else if (diff > 0) {
+    /* a big jump is more likely a restarted sender than lost packets */
+    if (diff < 0x10000)
+      stats->lost += diff;
+    stats->gaps++;
+    rtpvc2analyzer->last_ext_seq = ext_seq;
+  } else if (ext_seq == rtpvc2analyzer->last_ext_seq) {
+    stats->duplicates++;
+  } else {
+    stats->reordered++;
+  }
+}
+
+static GstFlowReturn
+gst_rtp_vc2_analyzer_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstRtpVC2Analyzer *rtpvc2analyzer = GST_RTP_VC2_ANALYZER (trans);
+  GstRtpVC2AnalyzerStats *stats = &rtpvc2analyzer->stats;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstClockTime arrival, gap;
+  GstStructure *report = NULL;
+  guint8 *payload;
+  guint length;
+  guint32 rtptime;
+  gboolean M;
+
+  arrival = gst_util_get_timestamp ();
+
+  if (!gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp))
+    return GST_FLOW_OK;
+
+  GST_OBJECT_LOCK (rtpvc2analyzer);
+
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  length  = gst_rtp_buffer_get_payload_len (&rtp);
+  rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+  M       = gst_rtp_buffer_get_marker (&rtp);
+
+  stats->packets++;
+  stats->bytes += gst_buffer_get_size (buf);
+
+  if (GST_CLOCK_TIME_IS_VALID (rtpvc2analyzer->last_arrival)) {
+    gap = arrival - rtpvc2analyzer->last_arrival;
+    stats->gap_count++;
+    stats->gap_sum += gap;
+    if (!GST_CLOCK_TIME_IS_VALID (stats->gap_min) || gap < stats->gap_min)
+      stats->gap_min = gap;
+    stats->gap_max = MAX (stats->gap_max, gap);
+  }
+  rtpvc2analyzer->last_arrival = arrival;
+
+  if (length >= 4) {
+    gst_rtp_vc2_analyzer_track_seq (rtpvc2analyzer,
+        (payload[0] << 24) | (payload[1] << 16) | gst_rtp_buffer_get_seq (&rtp));
+
+    if (payload[3] == 0xEC && length >= 16) {
+      guint32 picture_number;
+      guint fragment_length, no_slices;
+
+      picture_number  = ((payload[4] << 24) |
+                         (payload[5] << 16) |
+                         (payload[6] <<  8) |
+                         (payload[7] <<  0));
+      fragment_length = ((payload[12] << 8) | (payload[13] << 0));
+      no_slices       = ((payload[14] << 8) | (payload[15] << 0));
+
+      if (no_slices == 0) {
+        vc2_hq_transform_parameters *params;
+
+        if (rtpvc2analyzer->in_picture)
+          gst_rtp_vc2_analyzer_end_picture (rtpvc2analyzer, FALSE);
+        gst_rtp_vc2_analyzer_start_picture (rtpvc2analyzer, picture_number,
+            rtptime, payload[2], arrival);
+
+        params = vc2_hq_transform_parameters_new (payload + 16,
+            MIN (fragment_length, length - 16));
+        if (params) {
+          rtpvc2analyzer->picture_expected_slices = params->slices_x*params->slices_y;
+          vc2_hq_transform_parameters_free (params);
+        }
+      } else {
+        if (!rtpvc2analyzer->in_picture || rtpvc2analyzer->picture_number != picture_number) {
+          if (rtpvc2analyzer->in_picture)
+            gst_rtp_vc2_analyzer_end_picture (rtpvc2analyzer, FALSE);
+          gst_rtp_vc2_analyzer_start_picture (rtpvc2analyzer, picture_number,
+              rtptime, payload[2], arrival);
+        }
+        rtpvc2analyzer->picture_slices += no_slices;
+        stats->slices += no_slices;
+      }
+
+      rtpvc2analyzer->picture_packets++;
+      rtpvc2analyzer->picture_last = arrival;
+      gst_rtp_vc2_analyzer_update_cinst (rtpvc2analyzer, arrival);
+
+      if (M)
+        gst_rtp_vc2_analyzer_end_picture (rtpvc2analyzer, TRUE);
+    }
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (rtpvc2analyzer->interval > 0) {
+    if (!GST_CLOCK_TIME_IS_VALID (rtpvc2analyzer->last_report)) {
+      rtpvc2analyzer->last_report = arrival;
+    } else if (arrival - rtpvc2analyzer->last_report >= rtpvc2analyzer->interval) {
+      report = gst_rtp_vc2_analyzer_take_report (rtpvc2analyzer,
+          arrival - rtpvc2analyzer->last_report);
+      rtpvc2analyzer->last_report = arrival;
+    }
+  }
+
+  GST_OBJECT_UNLOCK (rtpvc2analyzer);
+
+  if (report)
+    gst_element_post_message (GST_ELEMENT (rtpvc2analyzer),
+        gst_message_new_element (GST_OBJECT (rtpvc2analyzer), report));
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_rtp_vc2_analyzer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Analyzer *rtpvc2analyzer = GST_RTP_VC2_ANALYZER (object);
+
+  switch (prop_id) {
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (rtpvc2analyzer);
+      rtpvc2analyzer->interval = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (rtpvc2analyzer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_rtp_vc2_analyzer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Analyzer *rtpvc2analyzer = GST_RTP_VC2_ANALYZER (object);
+
+  switch (prop_id) {
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (rtpvc2analyzer);
+      g_value_set_uint64 (value, rtpvc2analyzer->interval);
+      GST_OBJECT_UNLOCK (rtpvc2analyzer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+gboolean
+gst_rtp_vc2_analyzer_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "rtpvc2analyzer",
+                               GST_RANK_NONE, GST_TYPE_RTP_VC2_ANALYZER);
+}
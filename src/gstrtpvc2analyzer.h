@@ -0,0 +1,117 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTP_VC2_ANALYZER_H__
+#define __GST_RTP_VC2_ANALYZER_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_RTP_VC2_ANALYZER \
+  (gst_rtp_vc2_analyzer_get_type())
+#define GST_RTP_VC2_ANALYZER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_RTP_VC2_ANALYZER,GstRtpVC2Analyzer))
+#define GST_RTP_VC2_ANALYZER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_RTP_VC2_ANALYZER,GstRtpVC2AnalyzerClass))
+#define GST_IS_RTP_VC2_ANALYZER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_RTP_VC2_ANALYZER))
+#define GST_IS_RTP_VC2_ANALYZER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_RTP_VC2_ANALYZER))
+
+typedef struct _GstRtpVC2Analyzer GstRtpVC2Analyzer;
+typedef struct _GstRtpVC2AnalyzerClass GstRtpVC2AnalyzerClass;
+
+typedef struct _GstRtpVC2AnalyzerStats GstRtpVC2AnalyzerStats;
+
+/* Everything here is reset after each report */
+struct _GstRtpVC2AnalyzerStats {
+  guint64 packets;
+  guint64 bytes;
+  guint64 lost;
+  guint64 gaps;
+  guint64 reordered;
+  guint64 duplicates;
+
+  guint64 pictures;
+  guint64 incomplete_pictures;
+  guint64 progressive_pictures;
+  guint64 first_fields;
+  guint64 second_fields;
+  guint64 slices;
+
+  guint64 picture_packets_sum;
+  guint   picture_packets_min;
+  guint   picture_packets_max;
+
+  guint64 gap_count;
+  GstClockTime gap_sum;
+  GstClockTime gap_min;
+  GstClockTime gap_max;
+
+  GstClockTime spread_sum;
+  GstClockTime spread_min;
+  GstClockTime spread_max;
+
+  guint   cinst_max;
+};
+
+struct _GstRtpVC2Analyzer
+{
+  GstBaseTransform base;
+
+  GstClockTime interval;
+  GstClockTime last_report;
+
+  gboolean have_seq;
+  guint32  last_ext_seq;
+  GstClockTime last_arrival;
+
+  /* the picture currently arriving */
+  gboolean in_picture;
+  guint32  picture_number;
+  guint32  picture_rtptime;
+  guint    picture_packets;
+  guint    picture_slices;
+  guint    picture_expected_slices;
+  GstClockTime picture_first;
+  GstClockTime picture_last;
+
+  /* for the network compatibility model */
+  gboolean have_rtptime;
+  guint32  last_rtptime;
+  GstClockTime picture_period;
+  guint    last_picture_packets;
+
+  GstRtpVC2AnalyzerStats stats;
+};
+
+struct _GstRtpVC2AnalyzerClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_rtp_vc2_analyzer_get_type (void);
+
+gboolean gst_rtp_vc2_analyzer_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_RTP_VC2_ANALYZER_H__ */
@@ -28,6 +28,9 @@
 #include <gst/base/gstbitreader.h>
 #include <gst/rtp/gstrtpbuffer.h>
 #include "gstrtpvc2depay.h"
+#include "gstrtputils.h"
+#include "gstvc2meta.h"
+#include "vc2probes.h"
 
 GST_DEBUG_CATEGORY_STATIC (rtpvc2depay_debug);
 #define GST_CAT_DEFAULT (rtpvc2depay_debug)
@@ -48,11 +51,61 @@ GST_STATIC_PAD_TEMPLATE ("sink",
         "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
     );
 
+#define DEFAULT_CAPTURE_TIME_EXT_ID          0
+#define DEFAULT_ADD_REFERENCE_TIMESTAMP_META FALSE
+#define DEFAULT_QOS                          TRUE
+#define DEFAULT_OUTPUT_QUEUE_DEPTH           0
+#define DEFAULT_OVERFLOW                     GST_RTP_VC2_DEPAY_OVERFLOW_DROP
+#define DEFAULT_CONCEAL                      FALSE
+
+/* The longest picture believed in, the same as the longest unit the
+ * payloader waits for. A picture is only concealed if it comes out no longer
+ * than this and what arrived outnumbers what is made up, and only indexed if
+ * it has no more slices than could fit in it, so that one forged transform
+ * parameters packet cannot have the depayloader take all memory. */
+#define MAX_PICTURE_SIZE                     VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE
+
+enum
+{
+  PROP_0,
+  PROP_CAPTURE_TIME_EXT_ID,
+  PROP_ADD_REFERENCE_TIMESTAMP_META,
+  PROP_QOS,
+  PROP_OUTPUT_QUEUE_DEPTH,
+  PROP_OVERFLOW,
+  PROP_CONCEAL,
+  PROP_STATS
+};
+
+#define GST_TYPE_RTP_VC2_DEPAY_OVERFLOW (gst_rtp_vc2_depay_overflow_get_type ())
+static GType
+gst_rtp_vc2_depay_overflow_get_type (void)
+{
+  static GType overflow_type = 0;
+  static const GEnumValue overflows[] = {
+    {GST_RTP_VC2_DEPAY_OVERFLOW_DROP,
+        "Drop the newly completed picture", "drop"},
+    {GST_RTP_VC2_DEPAY_OVERFLOW_BLOCK,
+        "Block packet intake until there is room", "block"},
+    {0, NULL, NULL},
+  };
+
+  if (!overflow_type) {
+    overflow_type =
+        g_enum_register_static ("GstRtpVC2DepayOverflow", overflows);
+  }
+  return overflow_type;
+}
+
 #define gst_rtp_vc2_depay_parent_class parent_class
 G_DEFINE_TYPE (GstRtpVC2Depay, gst_rtp_vc2_depay,
     GST_TYPE_RTP_BASE_DEPAYLOAD);
 
 static void gst_rtp_vc2_depay_finalize (GObject * object);
+static void gst_rtp_vc2_depay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_rtp_vc2_depay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static GstStateChangeReturn gst_rtp_vc2_depay_change_state (GstElement *
     element, GstStateChange transition);
@@ -63,6 +116,12 @@ static gboolean gst_rtp_vc2_depay_setcaps (GstRTPBaseDepayload * filter,
     GstCaps * caps);
 static gboolean gst_rtp_vc2_depay_handle_event (GstRTPBaseDepayload * depay,
     GstEvent * event);
+static gboolean gst_rtp_vc2_depay_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static GstFlowReturn gst_rtp_vc2_depay_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+static GstFlowReturn gst_rtp_vc2_depay_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list);
 
 static void
 gst_rtp_vc2_depay_class_init (GstRtpVC2DepayClass * klass)
@@ -76,6 +135,64 @@ gst_rtp_vc2_depay_class_init (GstRtpVC2DepayClass * klass)
   gstrtpbasedepayload_class = (GstRTPBaseDepayloadClass *) klass;
 
   gobject_class->finalize = gst_rtp_vc2_depay_finalize;
+  gobject_class->set_property = gst_rtp_vc2_depay_set_property;
+  gobject_class->get_property = gst_rtp_vc2_depay_get_property;
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CAPTURE_TIME_EXT_ID,
+      g_param_spec_uint ("capture-time-ext-id",
+          "Capture Time Extension ID",
+          "RFC 8285 one-byte header extension id of the picture capture time "
+          "(0 = take it from an extmap field in the caps)", 0, 14,
+          DEFAULT_CAPTURE_TIME_EXT_ID,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_ADD_REFERENCE_TIMESTAMP_META,
+      g_param_spec_boolean ("add-reference-timestamp-meta",
+          "Add Reference Timestamp Meta",
+          "Attach the capture time of each picture to it as a "
+          "GstReferenceTimestampMeta with " GST_RTP_VC2_CAPTURE_TIME_CAPS
+          " caps", DEFAULT_ADD_REFERENCE_TIMESTAMP_META,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_QOS,
+      g_param_spec_boolean ("qos", "QoS",
+          "Drop whole pictures that QoS events from downstream say will "
+          "arrive too late, without assembling them", DEFAULT_QOS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_OUTPUT_QUEUE_DEPTH,
+      g_param_spec_uint ("output-queue-depth", "Output Queue Depth",
+          "Push pictures from a separate thread through a queue of this many "
+          "pictures, so a slow downstream does not hold up packet intake "
+          "(0 = push from the streaming thread)", 0, 1024,
+          DEFAULT_OUTPUT_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_OVERFLOW,
+      g_param_spec_enum ("overflow", "Overflow",
+          "What to do with a completed picture when the output queue is full",
+          GST_TYPE_RTP_VC2_DEPAY_OVERFLOW, DEFAULT_OVERFLOW,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CONCEAL,
+      g_param_spec_boolean ("conceal", "Conceal",
+          "Output pictures with slices missing, putting empty slices in "
+          "their place, instead of dropping them", DEFAULT_CONCEAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of fragments, pictures, bytes, discontinuities and dropped "
+          "pictures by reason, per-picture assembly times and, when pictures "
+          "carry a capture time, network and reassembly latencies",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_rtp_vc2_depay_src_template));
@@ -93,6 +210,14 @@ gst_rtp_vc2_depay_class_init (GstRtpVC2DepayClass * klass)
   gstrtpbasedepayload_class->handle_event = gst_rtp_vc2_depay_handle_event;
 }
 
+static void
+gst_rtp_vc2_depay_fragment_clear (gpointer data)
+{
+  GstRtpVC2DepayFragment *fragment = data;
+
+  gst_buffer_unref (fragment->buf);
+}
+
 static void
 gst_rtp_vc2_depay_init (GstRtpVC2Depay * rtpvc2depay)
 {
@@ -102,17 +227,102 @@ gst_rtp_vc2_depay_init (GstRtpVC2Depay * rtpvc2depay)
   rtpvc2depay->last_parse_info_offset = 0;
   rtpvc2depay->in_picture             = FALSE;
   rtpvc2depay->picture_number         = 0;
+  rtpvc2depay->picture_parse_code     = 0xE8;
+  rtpvc2depay->picture_pts            = GST_CLOCK_TIME_NONE;
+
+  rtpvc2depay->fragments              = g_array_new (FALSE, FALSE, sizeof (GstRtpVC2DepayFragment));
+  g_array_set_clear_func (rtpvc2depay->fragments, gst_rtp_vc2_depay_fragment_clear);
+  rtpvc2depay->conceal                = DEFAULT_CONCEAL;
+
+  rtpvc2depay->caps_seq_hdr           = NULL;
+  rtpvc2depay->send_caps_seq_hdr      = FALSE;
+
+  rtpvc2depay->params                 = NULL;
+  rtpvc2depay->ld_params              = NULL;
+  rtpvc2depay->params_size            = 0;
+  rtpvc2depay->slice_offsets          = NULL;
+  rtpvc2depay->n_slice_offsets        = 0;
+  rtpvc2depay->slice_index_valid      = FALSE;
+
+  rtpvc2depay->capture_time_ext_id          = DEFAULT_CAPTURE_TIME_EXT_ID;
+  rtpvc2depay->caps_capture_time_ext_id     = 0;
+  rtpvc2depay->add_reference_timestamp_meta = DEFAULT_ADD_REFERENCE_TIMESTAMP_META;
+  rtpvc2depay->capture_time_caps            = gst_caps_new_empty_simple (GST_RTP_VC2_CAPTURE_TIME_CAPS);
+  rtpvc2depay->picture_capture_time         = GST_CLOCK_TIME_NONE;
+  rtpvc2depay->picture_arrival_time         = GST_CLOCK_TIME_NONE;
+
+  rtpvc2depay->picture_start          = GST_CLOCK_TIME_NONE;
+
+  /* The base class has no src_event vfunc, so QoS events are caught on the
+   * pad and then handed on to whatever the base class installed */
+  rtpvc2depay->qos            = DEFAULT_QOS;
+  rtpvc2depay->earliest_time  = GST_CLOCK_TIME_NONE;
+  rtpvc2depay->base_src_event = GST_PAD_EVENTFUNC (GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay));
+  gst_pad_set_event_function (GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay),
+                              gst_rtp_vc2_depay_src_event);
+
+  rtpvc2depay->output_queue_depth = DEFAULT_OUTPUT_QUEUE_DEPTH;
+  rtpvc2depay->overflow           = DEFAULT_OVERFLOW;
+  rtpvc2depay->output_ring        = NULL;
+  rtpvc2depay->base_sink_chain      = GST_PAD_CHAINFUNC (GST_RTP_BASE_DEPAYLOAD_SINKPAD (rtpvc2depay));
+  rtpvc2depay->base_sink_chain_list = GST_PAD_CHAINLISTFUNC (GST_RTP_BASE_DEPAYLOAD_SINKPAD (rtpvc2depay));
+  gst_pad_set_chain_function (GST_RTP_BASE_DEPAYLOAD_SINKPAD (rtpvc2depay),
+                              gst_rtp_vc2_depay_chain);
+  if (rtpvc2depay->base_sink_chain_list)
+    gst_pad_set_chain_list_function (GST_RTP_BASE_DEPAYLOAD_SINKPAD (rtpvc2depay),
+                                     gst_rtp_vc2_depay_chain_list);
+  g_mutex_init (&rtpvc2depay->output_lock);
+  g_cond_init (&rtpvc2depay->output_cond);
 }
 
 static void
-gst_rtp_vc2_depay_reset (GstRtpVC2Depay * rtpvc2depay)
+gst_rtp_vc2_depay_reset_stats (GstRtpVC2Depay * rtpvc2depay)
+{
+  VC2_STATS_SET (rtpvc2depay->stats_fragments,                  0);
+  VC2_STATS_SET (rtpvc2depay->stats_pictures,                   0);
+  VC2_STATS_SET (rtpvc2depay->stats_bytes,                      0);
+  VC2_STATS_SET (rtpvc2depay->stats_discontinuities,            0);
+  VC2_STATS_SET (rtpvc2depay->stats_malformed_fragments,        0);
+  VC2_STATS_SET (rtpvc2depay->stats_dropped_no_sequence_header, 0);
+  VC2_STATS_SET (rtpvc2depay->stats_dropped_discont,            0);
+  VC2_STATS_SET (rtpvc2depay->stats_dropped_incomplete,         0);
+  VC2_STATS_SET (rtpvc2depay->stats_dropped_qos,                0);
+  VC2_STATS_SET (rtpvc2depay->stats_dropped_overflow,           0);
+  VC2_STATS_SET (rtpvc2depay->stats_concealed_pictures,         0);
+  VC2_STATS_SET (rtpvc2depay->stats_concealed_slices,           0);
+  VC2_STATS_SET (rtpvc2depay->stats_output_queue_max,           0);
+  VC2_STATS_SET (rtpvc2depay->stats_clock_skew,                 0);
+  vc2_stats_histogram_reset (&rtpvc2depay->stats_assembly_time);
+  vc2_stats_histogram_reset (&rtpvc2depay->stats_network_latency);
+  vc2_stats_histogram_reset (&rtpvc2depay->stats_reassembly_latency);
+}
+
+/* Forgets the picture being assembled */
+static void
+gst_rtp_vc2_depay_clear_picture (GstRtpVC2Depay * rtpvc2depay)
 {
   gst_adapter_clear (rtpvc2depay->adapter);
+  g_array_set_size (rtpvc2depay->fragments, 0);
+  rtpvc2depay->picture_size = 0;
+  rtpvc2depay->in_picture   = FALSE;
+}
+
+static void
+gst_rtp_vc2_depay_reset (GstRtpVC2Depay * rtpvc2depay)
+{
+  gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
 
   rtpvc2depay->wait_start             = TRUE;
   rtpvc2depay->last_parse_info_offset = 0;
-  rtpvc2depay->in_picture             = FALSE;
   rtpvc2depay->picture_number         = 0;
+  rtpvc2depay->slice_index_valid      = FALSE;
+
+  GST_OBJECT_LOCK (rtpvc2depay);
+  rtpvc2depay->earliest_time          = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (rtpvc2depay);
+
+  /* A sequence header from the caps is still valid, so output it again */
+  rtpvc2depay->send_caps_seq_hdr      = (rtpvc2depay->caps_seq_hdr != NULL);
 }
 
 static void
@@ -123,10 +333,117 @@ gst_rtp_vc2_depay_finalize (GObject * object)
   rtpvc2depay = GST_RTP_VC2_DEPAY (object);
 
   g_object_unref (rtpvc2depay->adapter);
+  g_array_unref (rtpvc2depay->fragments);
+  gst_buffer_replace (&rtpvc2depay->caps_seq_hdr, NULL);
+  gst_caps_unref (rtpvc2depay->capture_time_caps);
+  vc2_hq_transform_parameters_free (rtpvc2depay->params);
+  vc2_ld_transform_parameters_free (rtpvc2depay->ld_params);
+  g_free (rtpvc2depay->slice_offsets);
+  vc2_ring_free (rtpvc2depay->output_ring, (GDestroyNotify) gst_buffer_unref);
+  g_mutex_clear (&rtpvc2depay->output_lock);
+  g_cond_clear (&rtpvc2depay->output_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static GstStructure *
+gst_rtp_vc2_depay_get_stats (GstRtpVC2Depay * rtpvc2depay)
+{
+  GstStructure *s;
+
+  s = gst_structure_new ("application/x-rtp-vc2-depay-stats",
+      "fragments",                          G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_fragments),
+      "pictures",                           G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_pictures),
+      "bytes",                              G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_bytes),
+      "discontinuities",                    G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_discontinuities),
+      "malformed-fragments",                G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_malformed_fragments),
+      "dropped-pictures-no-sequence-header", G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_dropped_no_sequence_header),
+      "dropped-pictures-discont",           G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_dropped_discont),
+      "dropped-pictures-incomplete",        G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_dropped_incomplete),
+      "dropped-pictures-qos",               G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_dropped_qos),
+      "dropped-pictures-overflow",          G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_dropped_overflow),
+      "concealed-pictures",                 G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_concealed_pictures),
+      "concealed-slices",                   G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_concealed_slices),
+      "output-queue-max",                   G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_output_queue_max),
+      "clock-skew",                         G_TYPE_UINT64, VC2_STATS_GET (rtpvc2depay->stats_clock_skew),
+      NULL);
+  vc2_stats_histogram_append (&rtpvc2depay->stats_assembly_time, s, "assembly-time");
+  vc2_stats_histogram_append (&rtpvc2depay->stats_network_latency, s, "network-latency");
+  vc2_stats_histogram_append (&rtpvc2depay->stats_reassembly_latency, s, "reassembly-latency");
+  vc2_stats_merge_parent (G_OBJECT (rtpvc2depay), parent_class, s);
+
+  return s;
+}
+
+static void
+gst_rtp_vc2_depay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Depay *rtpvc2depay;
+
+  rtpvc2depay = GST_RTP_VC2_DEPAY (object);
+
+  switch (prop_id) {
+    case PROP_CAPTURE_TIME_EXT_ID:
+      rtpvc2depay->capture_time_ext_id = g_value_get_uint (value);
+      break;
+    case PROP_ADD_REFERENCE_TIMESTAMP_META:
+      rtpvc2depay->add_reference_timestamp_meta = g_value_get_boolean (value);
+      break;
+    case PROP_QOS:
+      rtpvc2depay->qos = g_value_get_boolean (value);
+      break;
+    case PROP_OUTPUT_QUEUE_DEPTH:
+      rtpvc2depay->output_queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_OVERFLOW:
+      rtpvc2depay->overflow = g_value_get_enum (value);
+      break;
+    case PROP_CONCEAL:
+      rtpvc2depay->conceal = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_rtp_vc2_depay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Depay *rtpvc2depay;
+
+  rtpvc2depay = GST_RTP_VC2_DEPAY (object);
+
+  switch (prop_id) {
+    case PROP_CAPTURE_TIME_EXT_ID:
+      g_value_set_uint (value, rtpvc2depay->capture_time_ext_id);
+      break;
+    case PROP_ADD_REFERENCE_TIMESTAMP_META:
+      g_value_set_boolean (value, rtpvc2depay->add_reference_timestamp_meta);
+      break;
+    case PROP_QOS:
+      g_value_set_boolean (value, rtpvc2depay->qos);
+      break;
+    case PROP_OUTPUT_QUEUE_DEPTH:
+      g_value_set_uint (value, rtpvc2depay->output_queue_depth);
+      break;
+    case PROP_OVERFLOW:
+      g_value_set_enum (value, rtpvc2depay->overflow);
+      break;
+    case PROP_CONCEAL:
+      g_value_set_boolean (value, rtpvc2depay->conceal);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rtp_vc2_depay_get_stats (rtpvc2depay));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_rtp_vc2_set_src_caps (GstRtpVC2Depay * rtpvc2depay)
 {
@@ -149,6 +466,7 @@ gst_rtp_vc2_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
   gint clock_rate;
   GstStructure *structure = gst_caps_get_structure (caps, 0);
   GstRtpVC2Depay *rtpvc2depay;
+  const gchar *seqhdr;
 
   rtpvc2depay = GST_RTP_VC2_DEPAY (depayload);
 
@@ -156,6 +474,38 @@ gst_rtp_vc2_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
     clock_rate = 90000;
   depayload->clock_rate = clock_rate;
 
+  rtpvc2depay->caps_capture_time_ext_id = gst_rtp_vc2_capture_time_ext_id (structure);
+
+  /* A sequence header signalled out of band lets us start outputting pictures
+   * without waiting for one to arrive in-band */
+  seqhdr = gst_structure_get_string (structure, "sequence-header");
+  if (seqhdr != NULL) {
+    guchar *data;
+    gsize size;
+    GstBuffer *buf;
+    vc2_sequence_header *hdr;
+
+    data = g_base64_decode (seqhdr, &size);
+    buf = gst_buffer_new_wrapped (data, size);
+
+    hdr = (size > 0) ? vc2_sequence_header_new (buf) : NULL;
+    if (hdr == NULL) {
+      GST_WARNING_OBJECT (rtpvc2depay, "ignoring invalid sequence-header in caps");
+      gst_buffer_unref (buf);
+    } else if (rtpvc2depay->caps_seq_hdr != NULL
+        && vc2_sequence_header_cmp (hdr, rtpvc2depay->caps_seq_hdr,
+            gst_buffer_get_size (rtpvc2depay->caps_seq_hdr))) {
+      gst_buffer_unref (buf);
+    } else {
+      GST_DEBUG_OBJECT (rtpvc2depay, "got sequence header from caps");
+      gst_buffer_replace (&rtpvc2depay->caps_seq_hdr, buf);
+      gst_buffer_unref (buf);
+      rtpvc2depay->send_caps_seq_hdr = TRUE;
+      rtpvc2depay->wait_start        = FALSE;
+    }
+    vc2_sequence_header_free (hdr);
+  }
+
   return gst_rtp_vc2_set_src_caps (rtpvc2depay);
 }
 
@@ -163,11 +513,235 @@ static GstBuffer *
 gst_rtp_vc2_depay_process_sequence_header (GstRTPBaseDepayload * depayload, guint8 *payload, gint length);
 
 static GstBuffer *
-gst_rtp_vc2_depay_process_hq_fragment (GstRTPBaseDepayload * depayload, guint8 *payload, gint length, gboolean I, gboolean F, gboolean M);
+gst_rtp_vc2_depay_process_fragment (GstRTPBaseDepayload * depayload, guint8 *payload, gint length, gboolean low_delay,
+                                    gboolean I, gboolean F, gboolean M,
+                                    GstClockTime pts, GstClockTime capture_time);
+
+static GstBuffer *
+gst_rtp_vc2_depay_complete_picture (GstRtpVC2Depay * rtpvc2depay);
 
 static GstBuffer *
 gst_rtp_vc2_depay_process_end_of_sequence (GstRTPBaseDepayload * depayload);
 
+/* Output thread
+ *
+ * With output-queue-depth set, completed pictures are handed to a task on the
+ * src pad through a single-producer/single-consumer ring, so the streaming
+ * thread never waits for downstream. The lock and condition are only taken
+ * by a side that has to sleep, or that sees the other side asleep. The
+ * waiting flags and the ring indices are seq-cst ordered against each other
+ * so a wakeup cannot be missed.
+ *
+ * Serialized events drain the ring before they are forwarded, so they stay in
+ * order with the pictures around them. */
+
+static void
+gst_rtp_vc2_depay_output_wake (GstRtpVC2Depay * rtpvc2depay, gint * waiting)
+{
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  if (__atomic_load_n (waiting, __ATOMIC_SEQ_CST)) {
+    g_mutex_lock (&rtpvc2depay->output_lock);
+    g_cond_broadcast (&rtpvc2depay->output_cond);
+    g_mutex_unlock (&rtpvc2depay->output_lock);
+  }
+}
+
+static void
+gst_rtp_vc2_depay_output_loop (GstRtpVC2Depay * rtpvc2depay)
+{
+  GstPad *srcpad = GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay);
+  GstBuffer *buf;
+  GstFlowReturn ret;
+
+  buf = vc2_ring_pop (rtpvc2depay->output_ring);
+  if (buf == NULL) {
+    g_mutex_lock (&rtpvc2depay->output_lock);
+    __atomic_store_n (&rtpvc2depay->consumer_waiting, TRUE, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    while (!g_atomic_int_get (&rtpvc2depay->output_flushing) &&
+           (buf = vc2_ring_pop (rtpvc2depay->output_ring)) == NULL)
+      g_cond_wait (&rtpvc2depay->output_cond, &rtpvc2depay->output_lock);
+    __atomic_store_n (&rtpvc2depay->consumer_waiting, FALSE, __ATOMIC_SEQ_CST);
+    g_mutex_unlock (&rtpvc2depay->output_lock);
+
+    if (buf == NULL) {
+      gst_pad_pause_task (srcpad);
+      return;
+    }
+  }
+
+  ret = gst_pad_push (srcpad, buf);
+  if (ret != GST_FLOW_OK)
+    g_atomic_int_set (&rtpvc2depay->output_ret, ret);
+  __atomic_add_fetch (&rtpvc2depay->output_pushed, 1, __ATOMIC_SEQ_CST);
+  gst_rtp_vc2_depay_output_wake (rtpvc2depay, &rtpvc2depay->producer_waiting);
+
+  if (ret != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT (rtpvc2depay, "pausing output thread, reason %s", gst_flow_get_name (ret));
+    if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS)
+      GST_ELEMENT_FLOW_ERROR (rtpvc2depay, ret);
+    gst_pad_pause_task (srcpad);
+  }
+}
+
+static void
+gst_rtp_vc2_depay_output_drain (GstRtpVC2Depay * rtpvc2depay);
+
+/* Called in the streaming thread with a completed picture, sequence header or
+ * end of sequence. Returns the buffer for the base class to push when there
+ * is no output thread, otherwise queues it and returns NULL. */
+static GstBuffer *
+gst_rtp_vc2_depay_output (GstRtpVC2Depay * rtpvc2depay, GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  guint length;
+
+  if (outbuf == NULL || rtpvc2depay->output_ring == NULL)
+    return outbuf;
+
+  /* Once the output thread has stopped on an error the chain function hands
+   * it upstream, there is nothing left to push to */
+  if (g_atomic_int_get (&rtpvc2depay->output_ret) != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT (rtpvc2depay, "output thread stopped (%s), dropping picture",
+                      gst_flow_get_name (g_atomic_int_get (&rtpvc2depay->output_ret)));
+    gst_buffer_unref (outbuf);
+    return NULL;
+  }
+
+  /* A new segment has to go out ahead of this buffer and only the base class
+   * can send it, so let the queue empty and give the buffer to the base class
+   * to push from the streaming thread */
+  if (GST_RTP_BASE_DEPAYLOAD (rtpvc2depay)->need_newsegment) {
+    gst_rtp_vc2_depay_output_drain (rtpvc2depay);
+    rtpvc2depay->output_discont = FALSE;
+    return outbuf;
+  }
+
+  /* The output thread pushes on the pad directly, so fill in what the base
+   * class push would have taken from the packet being processed */
+  if (!GST_BUFFER_PTS_IS_VALID (outbuf))
+    GST_BUFFER_PTS (outbuf) = GST_BUFFER_PTS (inbuf);
+  if (!GST_BUFFER_DTS_IS_VALID (outbuf))
+    GST_BUFFER_DTS (outbuf) = GST_BUFFER_DTS (inbuf);
+  if (!GST_BUFFER_DURATION_IS_VALID (outbuf))
+    GST_BUFFER_DURATION (outbuf) = GST_BUFFER_DURATION (inbuf);
+  if (rtpvc2depay->output_discont) {
+    outbuf = gst_buffer_make_writable (outbuf);
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    rtpvc2depay->output_discont = FALSE;
+  }
+
+  while (!vc2_ring_push (rtpvc2depay->output_ring, outbuf)) {
+    if (rtpvc2depay->overflow == GST_RTP_VC2_DEPAY_OVERFLOW_DROP) {
+      GST_LOG_OBJECT (rtpvc2depay, "output queue full, dropping picture");
+      VC2_STATS_INC (rtpvc2depay->stats_dropped_overflow);
+      VC2_PROBE2 (depay_picture_dropped, rtpvc2depay->picture_number, "overflow");
+      gst_buffer_unref (outbuf);
+      return NULL;
+    }
+
+    g_mutex_lock (&rtpvc2depay->output_lock);
+    __atomic_store_n (&rtpvc2depay->producer_waiting, TRUE, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    while (!g_atomic_int_get (&rtpvc2depay->output_flushing) &&
+           g_atomic_int_get (&rtpvc2depay->output_ret) == GST_FLOW_OK &&
+           vc2_ring_length (rtpvc2depay->output_ring) >= vc2_ring_size (rtpvc2depay->output_ring))
+      g_cond_wait (&rtpvc2depay->output_cond, &rtpvc2depay->output_lock);
+    __atomic_store_n (&rtpvc2depay->producer_waiting, FALSE, __ATOMIC_SEQ_CST);
+    g_mutex_unlock (&rtpvc2depay->output_lock);
+
+    if (g_atomic_int_get (&rtpvc2depay->output_flushing) ||
+        g_atomic_int_get (&rtpvc2depay->output_ret) != GST_FLOW_OK) {
+      gst_buffer_unref (outbuf);
+      return NULL;
+    }
+  }
+
+  rtpvc2depay->output_queued++;
+  gst_rtp_vc2_depay_output_wake (rtpvc2depay, &rtpvc2depay->consumer_waiting);
+
+  length = vc2_ring_length (rtpvc2depay->output_ring);
+  VC2_STATS_MAX (rtpvc2depay->stats_output_queue_max, length);
+
+  return NULL;
+}
+
+/* Waits until the output thread has pushed everything queued so far */
+static void
+gst_rtp_vc2_depay_output_drain (GstRtpVC2Depay * rtpvc2depay)
+{
+  if (rtpvc2depay->output_ring == NULL)
+    return;
+
+  g_mutex_lock (&rtpvc2depay->output_lock);
+  __atomic_store_n (&rtpvc2depay->producer_waiting, TRUE, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  while (!g_atomic_int_get (&rtpvc2depay->output_flushing) &&
+         g_atomic_int_get (&rtpvc2depay->output_ret) == GST_FLOW_OK &&
+         __atomic_load_n (&rtpvc2depay->output_pushed, __ATOMIC_SEQ_CST) != rtpvc2depay->output_queued)
+    g_cond_wait (&rtpvc2depay->output_cond, &rtpvc2depay->output_lock);
+  __atomic_store_n (&rtpvc2depay->producer_waiting, FALSE, __ATOMIC_SEQ_CST);
+  g_mutex_unlock (&rtpvc2depay->output_lock);
+}
+
+static void
+gst_rtp_vc2_depay_output_set_flushing (GstRtpVC2Depay * rtpvc2depay, gboolean flushing)
+{
+  g_mutex_lock (&rtpvc2depay->output_lock);
+  g_atomic_int_set (&rtpvc2depay->output_flushing, flushing);
+  g_cond_broadcast (&rtpvc2depay->output_cond);
+  g_mutex_unlock (&rtpvc2depay->output_lock);
+}
+
+/* Only called while the output thread is stopped or paused, which makes it
+ * safe to pop from here */
+static void
+gst_rtp_vc2_depay_output_clear (GstRtpVC2Depay * rtpvc2depay)
+{
+  GstBuffer *buf;
+
+  while ((buf = vc2_ring_pop (rtpvc2depay->output_ring)) != NULL)
+    gst_buffer_unref (buf);
+
+  rtpvc2depay->output_queued = 0;
+  rtpvc2depay->output_discont = TRUE;
+  __atomic_store_n (&rtpvc2depay->output_pushed, 0, __ATOMIC_SEQ_CST);
+  g_atomic_int_set (&rtpvc2depay->output_ret, GST_FLOW_OK);
+}
+
+/* The base class returns the flow of its own pushes, the output thread's
+ * comes from output_ret */
+static GstFlowReturn
+gst_rtp_vc2_depay_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstRtpVC2Depay *rtpvc2depay = GST_RTP_VC2_DEPAY (parent);
+  GstFlowReturn ret;
+
+  ret = rtpvc2depay->base_sink_chain (pad, parent, buf);
+  if (ret == GST_FLOW_OK && rtpvc2depay->output_ring != NULL)
+    ret = g_atomic_int_get (&rtpvc2depay->output_ret);
+  return ret;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_depay_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstRtpVC2Depay *rtpvc2depay = GST_RTP_VC2_DEPAY (parent);
+  GstFlowReturn ret;
+
+  ret = rtpvc2depay->base_sink_chain_list (pad, parent, list);
+  if (ret == GST_FLOW_OK && rtpvc2depay->output_ring != NULL)
+    ret = g_atomic_int_get (&rtpvc2depay->output_ret);
+  return ret;
+}
+
+static void
+gst_rtp_vc2_depay_output_start (GstRtpVC2Depay * rtpvc2depay)
+{
+  gst_rtp_vc2_depay_output_set_flushing (rtpvc2depay, FALSE);
+  gst_pad_start_task (GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay),
+                      (GstTaskFunction) gst_rtp_vc2_depay_output_loop, rtpvc2depay, NULL);
+}
+
 static GstBuffer *
 gst_rtp_vc2_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
 {
@@ -177,13 +751,37 @@ gst_rtp_vc2_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
 
   rtpvc2depay = GST_RTP_VC2_DEPAY (depayload);
 
-  /* flush remaining data on discont */
+  /* flush remaining data on discont, a lost packet does not invalidate the
+   * sequence header we already have so keep wait_start as it is. When
+   * concealing, the fragments of the picture that did arrive are kept and
+   * the missing ones made up when it completes. */
   if (GST_BUFFER_IS_DISCONT (buf)) {
-    gst_adapter_clear (rtpvc2depay->adapter);
-    rtpvc2depay->wait_start             = TRUE;
-    rtpvc2depay->last_parse_info_offset = 0;
-    rtpvc2depay->in_picture             = FALSE;
-    rtpvc2depay->picture_number         = 0;
+    VC2_STATS_INC (rtpvc2depay->stats_discontinuities);
+    rtpvc2depay->output_discont = TRUE;
+    if (!rtpvc2depay->conceal) {
+      if (rtpvc2depay->in_picture) {
+        VC2_STATS_INC (rtpvc2depay->stats_dropped_discont);
+        VC2_PROBE2 (depay_picture_dropped, rtpvc2depay->picture_number, "discont");
+      }
+      gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+      rtpvc2depay->last_parse_info_offset = 0;
+      rtpvc2depay->picture_number         = 0;
+    }
+  }
+
+  /* Output the sequence header from the caps ahead of anything else */
+  if (rtpvc2depay->send_caps_seq_hdr) {
+    GstMapInfo info;
+
+    rtpvc2depay->send_caps_seq_hdr = FALSE;
+    if (gst_buffer_map (rtpvc2depay->caps_seq_hdr, &info, GST_MAP_READ)) {
+      outbuf = gst_rtp_vc2_depay_process_sequence_header (depayload, info.data, info.size);
+      gst_buffer_unmap (rtpvc2depay->caps_seq_hdr, &info);
+      outbuf = gst_rtp_vc2_depay_output (rtpvc2depay, buf, outbuf);
+      if (outbuf)
+        gst_rtp_base_depayload_push (depayload, outbuf);
+      outbuf = NULL;
+    }
   }
 
   {
@@ -195,6 +793,8 @@ gst_rtp_vc2_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
       gboolean M;
 
       gst_rtp_buffer_map(buf, GST_MAP_READ, &rtp);
+      VC2_STATS_INC (rtpvc2depay->stats_fragments);
+      VC2_STATS_ADD (rtpvc2depay->stats_bytes, gst_rtp_buffer_get_payload_len (&rtp));
 
       payload = gst_rtp_buffer_get_payload(&rtp);
       payload_length = gst_rtp_buffer_get_packet_len(&rtp) - gst_rtp_buffer_get_header_len(&rtp);
@@ -216,8 +816,37 @@ gst_rtp_vc2_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
         }
         break;
       case GSTRTPVC2DEPAYPARSECODE_HQ_FRAGMENT:
+      case GSTRTPVC2DEPAYPARSECODE_LD_FRAGMENT:
         {
-          outbuf = gst_rtp_vc2_depay_process_hq_fragment (depayload, payload + 4, payload_length - 4, I, F, M);
+          GstClockTime capture_time = GST_CLOCK_TIME_NONE;
+          guint ext_id;
+
+          ext_id = (rtpvc2depay->capture_time_ext_id != 0) ?
+              rtpvc2depay->capture_time_ext_id : rtpvc2depay->caps_capture_time_ext_id;
+          if (ext_id != 0 && gst_rtp_buffer_get_extension (&rtp))
+            gst_rtp_vc2_capture_time_read (&rtp, ext_id, &capture_time);
+
+          /* When concealing, a picture whose marker packet was lost is
+           * output once the next picture starts, rather than dropped */
+          if (rtpvc2depay->conceal && rtpvc2depay->in_picture && payload_length >= 16) {
+            guint32 picture_number = ((payload[4] << 24) | (payload[5] << 16) |
+                                      (payload[6] <<  8) | (payload[7] <<  0));
+            gboolean params = (payload[14] == 0 && payload[15] == 0);
+
+            if (params || picture_number != rtpvc2depay->picture_number) {
+              outbuf = gst_rtp_vc2_depay_complete_picture (rtpvc2depay);
+              if (outbuf)
+                GST_BUFFER_PTS (outbuf) = rtpvc2depay->picture_pts;
+              outbuf = gst_rtp_vc2_depay_output (rtpvc2depay, buf, outbuf);
+              if (outbuf)
+                gst_rtp_base_depayload_push (depayload, outbuf);
+              outbuf = NULL;
+            }
+          }
+
+          outbuf = gst_rtp_vc2_depay_process_fragment (depayload, payload + 4, payload_length - 4,
+                                                       PC == GSTRTPVC2DEPAYPARSECODE_LD_FRAGMENT, I, F, M,
+                                                       GST_BUFFER_PTS (buf), capture_time);
         }
         break;
       default:
@@ -227,7 +856,7 @@ gst_rtp_vc2_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
       gst_rtp_buffer_unmap(&rtp);
   }
 
-  return outbuf;
+  return gst_rtp_vc2_depay_output (rtpvc2depay, buf, outbuf);
 }
 
 static GstBuffer *
@@ -268,14 +897,417 @@ gst_rtp_vc2_depay_process_sequence_header (GstRTPBaseDepayload * depayload, guin
   memcpy(info.data + 13, payload, length);
 
   rtpvc2depay->last_parse_info_offset = next_parse_info_offset;
+  rtpvc2depay->wait_start             = FALSE;
+
+  gst_buffer_unmap(outbuf, &info);
+
+  return outbuf;
+}
+
+static void
+gst_rtp_vc2_depay_grow_slice_offsets (GstRtpVC2Depay * rtpvc2depay, guint n) {
+  if (rtpvc2depay->n_slice_offsets < n) {
+    rtpvc2depay->n_slice_offsets = MAX (2*rtpvc2depay->n_slice_offsets, n);
+    rtpvc2depay->slice_offsets   = g_renew (guint32, rtpvc2depay->slice_offsets, rtpvc2depay->n_slice_offsets);
+  }
+}
+
+/* The number of slices in the picture being assembled, and how many there
+ * are across it, or 0 when its transform parameters are not known */
+static guint64
+gst_rtp_vc2_depay_picture_slices (GstRtpVC2Depay * rtpvc2depay, guint *slices_x) {
+  if (rtpvc2depay->params != NULL) {
+    *slices_x = rtpvc2depay->params->slices_x;
+    return (guint64) rtpvc2depay->params->slices_x*rtpvc2depay->params->slices_y;
+  }
+  if (rtpvc2depay->ld_params != NULL) {
+    *slices_x = rtpvc2depay->ld_params->slices_x;
+    return (guint64) rtpvc2depay->ld_params->slices_x*rtpvc2depay->ld_params->slices_y;
+  }
+  *slices_x = 0;
+  return 0;
+}
+
+/* Records the offsets of the slices in a fragment, from the start of the
+ * fragment, while its data is still hot in the cache, so that the output
+ * picture can carry a slice index without anyone having to walk the slice
+ * headers again */
+static void
+gst_rtp_vc2_depay_index_slices (GstRtpVC2Depay * rtpvc2depay, guint8 *data, gint length, gint no_slices, guint first) {
+  vc2_hq_transform_parameters *params = rtpvc2depay->params;
+  guint i;
+  gsize offs, slice_length;
+
+  gst_rtp_vc2_depay_grow_slice_offsets (rtpvc2depay, first + no_slices + 1);
+
+  offs = 0;
+  for (i = 0; i < no_slices; i++) {
+    slice_length = vc2_hq_slice_length (data + offs, length - offs, params->slice_prefix_bytes, params->slice_size_scalar);
+    if (slice_length == 0) {
+      rtpvc2depay->slice_index_valid = FALSE;
+      return;
+    }
+    rtpvc2depay->slice_offsets[first + i] = offs;
+    offs += slice_length;
+  }
+
+  if (offs != length)
+    rtpvc2depay->slice_index_valid = FALSE;
+}
+
+/* Works out where in the picture a slice fragment goes from its slice_x and
+ * slice_y, so fragments can arrive in any order. An LD fragment also has to
+ * be exactly as long as the transform parameters make its slices, which is
+ * a little arithmetic and catches mangled packets that would otherwise put
+ * slices in the wrong places. Returns FALSE for a fragment that does not
+ * fit in the picture. */
+static gboolean
+gst_rtp_vc2_depay_place_fragment (GstRtpVC2Depay * rtpvc2depay, guint8 *data, gint length, gint no_slices,
+                                  gint slice_x, gint slice_y, guint *first) {
+  guint64 n_slices, position;
+  guint slices_x;
+
+  /* Without transform parameters there is no telling where a fragment goes,
+   * so the fragments are kept in the order they came in */
+  n_slices = gst_rtp_vc2_depay_picture_slices (rtpvc2depay, &slices_x);
+  if (n_slices == 0) {
+    *first = rtpvc2depay->fragments->len;
+    return TRUE;
+  }
+
+  position = (guint64) slice_y*slices_x + slice_x;
+  if (slice_x >= slices_x || position + no_slices > n_slices || position + no_slices >= G_MAXUINT)
+    return FALSE;
+  *first = position;
+
+  /* An HQ slice is at least four bytes */
+  if (n_slices > MAX_PICTURE_SIZE/4)
+    rtpvc2depay->slice_index_valid = FALSE;
+
+  if (rtpvc2depay->ld_params != NULL)
+    return (vc2_ld_slice_offset (rtpvc2depay->ld_params, position + no_slices) -
+            vc2_ld_slice_offset (rtpvc2depay->ld_params, position) == (guint64) length);
+
+  if (rtpvc2depay->slice_index_valid)
+    gst_rtp_vc2_depay_index_slices (rtpvc2depay, data, length, no_slices, position);
+  return TRUE;
+}
+
+static gint
+gst_rtp_vc2_depay_fragment_compare (gconstpointer a, gconstpointer b) {
+  const GstRtpVC2DepayFragment *fa = a;
+  const GstRtpVC2DepayFragment *fb = b;
+
+  return (fa->first > fb->first) - (fa->first < fb->first);
+}
+
+/* Stands in for slices first to last - 1 of the picture, which never
+ * arrived, with slices that decode to nothing: an HQ slice with every
+ * component length zero, an LD slice of all one bits, which are all zero
+ * coefficients. offset is where they go from the start of the slices. */
+static gboolean
+gst_rtp_vc2_depay_push_filler (GstRtpVC2Depay * rtpvc2depay, guint first, guint last, guint64 offset, gsize *size) {
+  GstBuffer *buf;
+  GstMapInfo info;
+  guint64 slice_size = 0;
+  guint i;
+
+  if (rtpvc2depay->ld_params != NULL) {
+    *size = vc2_ld_slice_offset (rtpvc2depay->ld_params, last) - vc2_ld_slice_offset (rtpvc2depay->ld_params, first);
+  } else {
+    slice_size = (guint64) rtpvc2depay->params->slice_prefix_bytes + 4;
+    *size      = slice_size*(last - first);
+  }
+
+  buf = gst_buffer_new_allocate (NULL, *size, NULL);
+  if (!buf)
+    return FALSE;
+
+  if (!gst_buffer_map (buf, &info, GST_MAP_WRITE)) {
+    gst_buffer_unref (buf);
+    return FALSE;
+  }
+  memset (info.data, (rtpvc2depay->ld_params != NULL) ? 0xFF : 0x00, *size);
+  gst_buffer_unmap (buf, &info);
+
+  gst_adapter_push (rtpvc2depay->adapter, buf);
+
+  if (rtpvc2depay->slice_index_valid) {
+    for (i = first; i < last; i++)
+      rtpvc2depay->slice_offsets[i] = offset + (i - first)*slice_size;
+  }
+
+  return TRUE;
+}
+
+/* Puts the slice fragments of the picture into the adapter after its
+ * transform parameters, in raster order whatever order they came in, and
+ * rebases the slice index to match. Duplicated slices are left out. Missing
+ * ones are made up when conceal is set, otherwise the picture can't be
+ * output and FALSE is returned. */
+static gboolean
+gst_rtp_vc2_depay_assemble_slices (GstRtpVC2Depay * rtpvc2depay) {
+  GArray *fragments = rtpvc2depay->fragments;
+  GstRtpVC2DepayFragment *fragment;
+  guint64 n_slices, received, received_size, filler_size;
+  guint slices_x, next, end, i, k;
+  guint concealed = 0;
+  guint64 offset = 0;
+  gsize size;
+
+  g_array_sort (fragments, gst_rtp_vc2_depay_fragment_compare);
+
+  n_slices = gst_rtp_vc2_depay_picture_slices (rtpvc2depay, &slices_x);
+  if (n_slices == 0) {
+    for (i = 0; i < fragments->len; i++) {
+      fragment = &g_array_index (fragments, GstRtpVC2DepayFragment, i);
+      rtpvc2depay->picture_size += gst_buffer_get_size (fragment->buf);
+      gst_adapter_push (rtpvc2depay->adapter, gst_buffer_ref (fragment->buf));
+    }
+    g_array_set_size (fragments, 0);
+    return TRUE;
+  }
+
+  /* Count what arrived, leaving out duplicates as the loop below does */
+  received      = 0;
+  received_size = 0;
+  next          = 0;
+  for (i = 0; i < fragments->len; i++) {
+    fragment = &g_array_index (fragments, GstRtpVC2DepayFragment, i);
+    if (fragment->first < next)
+      continue;
+    received      += fragment->n_slices;
+    received_size += gst_buffer_get_size (fragment->buf);
+    next           = fragment->first + fragment->n_slices;
+  }
+
+  filler_size = 0;
+  if (received < n_slices) {
+    if (!rtpvc2depay->conceal)
+      return FALSE;
+
+    if (rtpvc2depay->ld_params != NULL)
+      filler_size = vc2_ld_slice_offset (rtpvc2depay->ld_params, n_slices) - received_size;
+    else
+      filler_size = (n_slices - received)*((guint64) rtpvc2depay->params->slice_prefix_bytes + 4);
+
+    if (n_slices - received > received || received_size + filler_size > MAX_PICTURE_SIZE) {
+      GST_DEBUG_OBJECT (rtpvc2depay, "not concealing %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+                        " slices, %" G_GUINT64_FORMAT " bytes", n_slices - received, n_slices, filler_size);
+      return FALSE;
+    }
+  }
+
+  if (n_slices >= G_MAXUINT)
+    return FALSE;
+  if (received_size + filler_size > G_MAXUINT32)
+    rtpvc2depay->slice_index_valid = FALSE;
+  if (rtpvc2depay->slice_index_valid)
+    gst_rtp_vc2_depay_grow_slice_offsets (rtpvc2depay, n_slices + 1);
+
+  next = 0;
+  for (i = 0; i <= fragments->len; i++) {
+    fragment = (i < fragments->len) ? &g_array_index (fragments, GstRtpVC2DepayFragment, i) : NULL;
+    if (fragment != NULL && fragment->first < next)
+      continue;
+
+    end = (fragment != NULL) ? fragment->first : n_slices;
+    if (end > next) {
+      if (!gst_rtp_vc2_depay_push_filler (rtpvc2depay, next, end, offset, &size))
+        return FALSE;
+      concealed += end - next;
+      offset    += size;
+    }
+
+    if (fragment != NULL) {
+      if (rtpvc2depay->slice_index_valid) {
+        for (k = 0; k < fragment->n_slices; k++)
+          rtpvc2depay->slice_offsets[fragment->first + k] += offset;
+      }
+      gst_adapter_push (rtpvc2depay->adapter, gst_buffer_ref (fragment->buf));
+      offset += gst_buffer_get_size (fragment->buf);
+      next    = fragment->first + fragment->n_slices;
+    }
+  }
+  g_array_set_size (fragments, 0);
+
+  if (rtpvc2depay->slice_index_valid)
+    rtpvc2depay->slice_offsets[n_slices] = offset;
+  rtpvc2depay->picture_size += offset;
+
+  if (concealed > 0) {
+    VC2_STATS_INC (rtpvc2depay->stats_concealed_pictures);
+    VC2_STATS_ADD (rtpvc2depay->stats_concealed_slices, concealed);
+    VC2_PROBE2 (depay_picture_concealed, rtpvc2depay->picture_number, concealed);
+  }
+
+  return TRUE;
+}
+
+static GstClockTime
+gst_rtp_vc2_depay_clock_time (GstRtpVC2Depay * rtpvc2depay)
+{
+  GstClockTime now = GST_CLOCK_TIME_NONE;
+  GstClock *clock;
+
+  clock = gst_element_get_clock (GST_ELEMENT (rtpvc2depay));
+  if (clock != NULL) {
+    now = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+  }
+
+  return now;
+}
+
+/* The capture time is the sender's clock time, so these latencies are only
+ * meaningful when both pipelines are slaved to a common clock such as PTP */
+static void
+gst_rtp_vc2_depay_record_latency (GstRtpVC2Depay * rtpvc2depay, GstBuffer * outbuf)
+{
+  GstClockTime capture_time = rtpvc2depay->picture_capture_time;
+  GstClockTime arrival_time = rtpvc2depay->picture_arrival_time;
+  GstClockTime now;
+
+  if (!GST_CLOCK_TIME_IS_VALID (capture_time))
+    return;
+
+  if (rtpvc2depay->add_reference_timestamp_meta)
+    gst_buffer_add_reference_timestamp_meta (outbuf, rtpvc2depay->capture_time_caps,
+                                             capture_time, GST_CLOCK_TIME_NONE);
+
+  now = gst_rtp_vc2_depay_clock_time (rtpvc2depay);
+  if (!GST_CLOCK_TIME_IS_VALID (arrival_time) || !GST_CLOCK_TIME_IS_VALID (now))
+    return;
+
+  if (arrival_time < capture_time) {
+    VC2_STATS_INC (rtpvc2depay->stats_clock_skew);
+    return;
+  }
+
+  vc2_stats_histogram_add (&rtpvc2depay->stats_network_latency, arrival_time - capture_time);
+  vc2_stats_histogram_add (&rtpvc2depay->stats_reassembly_latency, now - arrival_time);
+}
+
+/* Returns TRUE when the last QoS event says a picture with this PTS will be
+ * too late downstream, and posts a QoS message about dropping it */
+static gboolean
+gst_rtp_vc2_depay_picture_is_late (GstRtpVC2Depay * rtpvc2depay, GstClockTime pts)
+{
+  GstSegment *segment = &GST_RTP_BASE_DEPAYLOAD (rtpvc2depay)->segment;
+  GstClockTime running_time, earliest_time;
+  GstMessage *msg;
+
+  if (!rtpvc2depay->qos || !GST_CLOCK_TIME_IS_VALID (pts) || segment->format != GST_FORMAT_TIME)
+    return FALSE;
+
+  GST_OBJECT_LOCK (rtpvc2depay);
+  earliest_time = rtpvc2depay->earliest_time;
+  GST_OBJECT_UNLOCK (rtpvc2depay);
+
+  if (!GST_CLOCK_TIME_IS_VALID (earliest_time))
+    return FALSE;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time) || running_time > earliest_time)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (rtpvc2depay, "picture at %" GST_TIME_FORMAT " is late, earliest time %" GST_TIME_FORMAT,
+                    GST_TIME_ARGS (running_time), GST_TIME_ARGS (earliest_time));
+
+  VC2_STATS_INC (rtpvc2depay->stats_dropped_qos);
+  msg = gst_message_new_qos (GST_OBJECT (rtpvc2depay), FALSE, running_time,
+      gst_segment_to_stream_time (segment, GST_FORMAT_TIME, pts), pts, GST_CLOCK_TIME_NONE);
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS,
+      VC2_STATS_GET (rtpvc2depay->stats_pictures), VC2_STATS_GET (rtpvc2depay->stats_dropped_qos));
+  gst_element_post_message (GST_ELEMENT (rtpvc2depay), msg);
+
+  return TRUE;
+}
+
+/* Outputs the picture being assembled, its slices put in order behind a
+ * picture parse info */
+static GstBuffer *
+gst_rtp_vc2_depay_complete_picture (GstRtpVC2Depay * rtpvc2depay) {
+  GstBuffer *outbuf;
+  GstBuffer *buf;
+  GstMapInfo info;
+  guint32 next_parse_info_offset;
+
+  if (!gst_rtp_vc2_depay_assemble_slices (rtpvc2depay)) {
+    VC2_STATS_INC (rtpvc2depay->stats_dropped_incomplete);
+    VC2_PROBE2 (depay_picture_dropped, rtpvc2depay->picture_number, "incomplete");
+    gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+    return NULL;
+  }
+
+  outbuf = gst_buffer_new_allocate(NULL,
+                                   17,
+                                   NULL);
+  if (!outbuf) {
+    gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+    return NULL;
+  }
+
+  if (!gst_buffer_map(outbuf,
+                      &info,
+                      GST_MAP_WRITE)) {
+    gst_buffer_unref(outbuf);
+    gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+    return NULL;
+  }
+
+  next_parse_info_offset = rtpvc2depay->picture_size + 17;
+
+  info.data[ 0] = 0x42;
+  info.data[ 1] = 0x42;
+  info.data[ 2] = 0x43;
+  info.data[ 3] = 0x44;
+  info.data[ 4] = rtpvc2depay->picture_parse_code;
+  info.data[ 5] = (next_parse_info_offset >> 24)&0xFF;
+  info.data[ 6] = (next_parse_info_offset >> 16)&0xFF;
+  info.data[ 7] = (next_parse_info_offset >>  8)&0xFF;
+  info.data[ 8] = (next_parse_info_offset >>  0)&0xFF;
+  info.data[ 9] = (rtpvc2depay->last_parse_info_offset >> 24)&0xFF;
+  info.data[10] = (rtpvc2depay->last_parse_info_offset >> 16)&0xFF;
+  info.data[11] = (rtpvc2depay->last_parse_info_offset >>  8)&0xFF;
+  info.data[12] = (rtpvc2depay->last_parse_info_offset >>  0)&0xFF;
+  info.data[13] = (rtpvc2depay->picture_number >> 24)&0xFF;
+  info.data[14] = (rtpvc2depay->picture_number >> 16)&0xFF;
+  info.data[15] = (rtpvc2depay->picture_number >>  8)&0xFF;
+  info.data[16] = (rtpvc2depay->picture_number >>  0)&0xFF;
 
   gst_buffer_unmap(outbuf, &info);
 
+  buf = gst_adapter_take_buffer(rtpvc2depay->adapter, rtpvc2depay->picture_size);
+  rtpvc2depay->picture_size = 0;
+  rtpvc2depay->in_picture   = FALSE;
+  rtpvc2depay->last_parse_info_offset = next_parse_info_offset;
+
+  outbuf = gst_buffer_append(outbuf, buf);
+
+  if (rtpvc2depay->slice_index_valid) {
+    GstVC2SliceIndexMeta *meta;
+
+    meta = gst_buffer_add_vc2_slice_index_meta (outbuf, rtpvc2depay->picture_number, rtpvc2depay->params,
+                                                17 + rtpvc2depay->params_size);
+    if (meta)
+      memcpy (meta->slice_offsets, rtpvc2depay->slice_offsets, (meta->n_slices + 1)*sizeof(guint32));
+  }
+  rtpvc2depay->slice_index_valid = FALSE;
+
+  VC2_STATS_INC (rtpvc2depay->stats_pictures);
+  VC2_PROBE2 (depay_picture, rtpvc2depay->picture_number, gst_buffer_get_size (outbuf));
+  vc2_stats_histogram_add (&rtpvc2depay->stats_assembly_time,
+                           gst_util_get_timestamp () - rtpvc2depay->picture_start);
+  gst_rtp_vc2_depay_record_latency (rtpvc2depay, outbuf);
+
   return outbuf;
 }
 
 static GstBuffer *
-gst_rtp_vc2_depay_process_hq_fragment (GstRTPBaseDepayload * depayload, guint8 *payload, gint length, gboolean I, gboolean F, gboolean M) {
+gst_rtp_vc2_depay_process_fragment (GstRTPBaseDepayload * depayload, guint8 *payload, gint length, gboolean low_delay,
+                                    gboolean I, gboolean F, gboolean M,
+                                    GstClockTime pts, GstClockTime capture_time) {
   GstBuffer *outbuf = NULL;
   GstBuffer *buf;
   GstMapInfo info;
@@ -286,8 +1318,21 @@ gst_rtp_vc2_depay_process_hq_fragment (GstRTPBaseDepayload * depayload, guint8 *
 
   rtpvc2depay = GST_RTP_VC2_DEPAY (depayload);
 
-  if (length < 12)
+  if (length < 12) {
+    VC2_STATS_INC (rtpvc2depay->stats_malformed_fragments);
+    return NULL;
+  }
+
+  /* Pictures can't be decoded without a sequence header, so don't output any
+   * until one has been received */
+  if (rtpvc2depay->wait_start) {
+    GST_LOG_OBJECT (rtpvc2depay, "waiting for sequence header, dropping fragment");
+    if (M) {
+      VC2_STATS_INC (rtpvc2depay->stats_dropped_no_sequence_header);
+      VC2_PROBE2 (depay_picture_dropped, -1, "no-sequence-header");
+    }
     return NULL;
+  }
 
   picture_number = ((payload[0] << 24) |
                     (payload[1] << 16) |
@@ -297,47 +1342,36 @@ gst_rtp_vc2_depay_process_hq_fragment (GstRTPBaseDepayload * depayload, guint8 *
                      (payload[9] << 0));
   no_slices = ((payload[10] << 8) |
                (payload[11] << 0));
+  VC2_PROBE4 (depay_fragment, picture_number, no_slices, fragment_length, M);
 
-  if (fragment_length > length - 12)
+  if (fragment_length > length - 12) {
+    VC2_STATS_INC (rtpvc2depay->stats_malformed_fragments);
     return NULL;
+  }
 
   if (no_slices == 0) {
     /* Picture Parameters */
-    gst_adapter_clear (rtpvc2depay->adapter);
-    rtpvc2depay->in_picture     = TRUE;
-    rtpvc2depay->picture_number = picture_number;
-    rtpvc2depay->picture_size   = 0;
-
-    buf = gst_buffer_new_allocate(NULL,
-                                  fragment_length,
-                                  NULL);
-    if (!buf) {
-      rtpvc2depay->in_picture     = FALSE;
-      return NULL;
+    if (rtpvc2depay->in_picture) {
+      VC2_STATS_INC (rtpvc2depay->stats_dropped_incomplete);
+      VC2_PROBE2 (depay_picture_dropped, rtpvc2depay->picture_number, "incomplete");
     }
+    gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
 
-    if (!gst_buffer_map(buf,
-                        &info,
-                        GST_MAP_WRITE)) {
-      gst_buffer_unref(buf);
-      rtpvc2depay->in_picture     = FALSE;
+    /* A late picture is skipped from its first fragment on: leaving
+     * in_picture unset makes the rest of its fragments drop straight away */
+    if (gst_rtp_vc2_depay_picture_is_late (rtpvc2depay, pts)) {
+      VC2_PROBE2 (depay_picture_dropped, picture_number, "qos");
       return NULL;
     }
 
-    memcpy(info.data, payload + 12, fragment_length);
-
-    gst_buffer_unmap(buf, &info);
-
-    gst_adapter_push(rtpvc2depay->adapter, buf);
-    rtpvc2depay->picture_size += fragment_length;
-
-    return NULL;
-  } else {
-    if (!rtpvc2depay->in_picture || (rtpvc2depay->picture_number != picture_number) || fragment_length > length - 16) {
-      gst_adapter_clear (rtpvc2depay->adapter);
-      rtpvc2depay->in_picture     = FALSE;
-      return NULL;
-    }
+    rtpvc2depay->picture_start  = gst_util_get_timestamp ();
+    rtpvc2depay->picture_capture_time = capture_time;
+    rtpvc2depay->picture_arrival_time = GST_CLOCK_TIME_IS_VALID (capture_time) ?
+        gst_rtp_vc2_depay_clock_time (rtpvc2depay) : GST_CLOCK_TIME_NONE;
+    rtpvc2depay->in_picture     = TRUE;
+    rtpvc2depay->picture_number = picture_number;
+    rtpvc2depay->picture_pts    = pts;
+    rtpvc2depay->picture_parse_code = (low_delay) ? 0xC8 : 0xE8;
 
     buf = gst_buffer_new_allocate(NULL,
                                   fragment_length,
@@ -355,63 +1389,75 @@ gst_rtp_vc2_depay_process_hq_fragment (GstRTPBaseDepayload * depayload, guint8 *
       return NULL;
     }
 
-    memcpy(info.data, payload + 16, fragment_length);
+    memcpy(info.data, payload + 12, fragment_length);
 
     gst_buffer_unmap(buf, &info);
 
     gst_adapter_push(rtpvc2depay->adapter, buf);
     rtpvc2depay->picture_size += fragment_length;
-  }
 
-  if (M) {
-    guint32 next_parse_info_offset;
+    vc2_hq_transform_parameters_free (rtpvc2depay->params);
+    vc2_ld_transform_parameters_free (rtpvc2depay->ld_params);
+    rtpvc2depay->params            = NULL;
+    rtpvc2depay->ld_params         = NULL;
+    if (low_delay)
+      rtpvc2depay->ld_params       = vc2_ld_transform_parameters_new (payload + 12, fragment_length);
+    else
+      rtpvc2depay->params          = vc2_hq_transform_parameters_new (payload + 12, fragment_length);
+    rtpvc2depay->params_size       = fragment_length;
+    rtpvc2depay->slice_index_valid = (rtpvc2depay->params != NULL);
 
-    outbuf = gst_buffer_new_allocate(NULL,
-                                     17,
-                                     NULL);
-    if (!outbuf) {
-      rtpvc2depay->in_picture     = FALSE;
-      return NULL;
-    }
+    return NULL;
+  } else {
+    GstRtpVC2DepayFragment fragment;
+    gint slice_x, slice_y;
 
-    if (!gst_buffer_map(outbuf,
-                        &info,
-                        GST_MAP_WRITE)) {
-      gst_buffer_unref(outbuf);
-      rtpvc2depay->in_picture     = FALSE;
+    if (!rtpvc2depay->in_picture || (rtpvc2depay->picture_number != picture_number) || fragment_length > length - 16) {
+      if (rtpvc2depay->in_picture) {
+        VC2_STATS_INC (rtpvc2depay->stats_dropped_incomplete);
+        VC2_PROBE2 (depay_picture_dropped, rtpvc2depay->picture_number, "incomplete");
+      }
+      gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
       return NULL;
     }
 
-    next_parse_info_offset = rtpvc2depay->picture_size + 17;
+    slice_x = ((payload[12] << 8) | (payload[13] << 0));
+    slice_y = ((payload[14] << 8) | (payload[15] << 0));
+    if (!gst_rtp_vc2_depay_place_fragment (rtpvc2depay, payload + 16, fragment_length, no_slices,
+                                           slice_x, slice_y, &fragment.first)) {
+      /* Leaves a hole, which the marker packet finds */
+      GST_LOG_OBJECT (rtpvc2depay, "fragment of picture %u does not fit, ignoring it", picture_number);
+      VC2_STATS_INC (rtpvc2depay->stats_malformed_fragments);
+    } else {
+      buf = gst_buffer_new_allocate(NULL,
+                                    fragment_length,
+                                    NULL);
+      if (!buf) {
+        gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+        return NULL;
+      }
 
-    info.data[ 0] = 0x42;
-    info.data[ 1] = 0x42;
-    info.data[ 2] = 0x43;
-    info.data[ 3] = 0x44;
-    info.data[ 4] = 0xE8; // HQ Picture
-    info.data[ 5] = (next_parse_info_offset >> 24)&0xFF;
-    info.data[ 6] = (next_parse_info_offset >> 16)&0xFF;
-    info.data[ 7] = (next_parse_info_offset >>  8)&0xFF;
-    info.data[ 8] = (next_parse_info_offset >>  0)&0xFF;
-    info.data[ 9] = (rtpvc2depay->last_parse_info_offset >> 24)&0xFF;
-    info.data[10] = (rtpvc2depay->last_parse_info_offset >> 16)&0xFF;
-    info.data[11] = (rtpvc2depay->last_parse_info_offset >>  8)&0xFF;
-    info.data[12] = (rtpvc2depay->last_parse_info_offset >>  0)&0xFF;
-    info.data[13] = (rtpvc2depay->picture_number >> 24)&0xFF;
-    info.data[14] = (rtpvc2depay->picture_number >> 16)&0xFF;
-    info.data[15] = (rtpvc2depay->picture_number >>  8)&0xFF;
-    info.data[16] = (rtpvc2depay->picture_number >>  0)&0xFF;
+      if (!gst_buffer_map(buf,
+                          &info,
+                          GST_MAP_WRITE)) {
+        gst_buffer_unref(buf);
+        gst_rtp_vc2_depay_clear_picture (rtpvc2depay);
+        return NULL;
+      }
 
-    gst_buffer_unmap(outbuf, &info);
+      memcpy(info.data, payload + 16, fragment_length);
 
-    buf = gst_adapter_take_buffer(rtpvc2depay->adapter, rtpvc2depay->picture_size);
-    rtpvc2depay->picture_size = 0;
-    rtpvc2depay->in_picture   = FALSE;
-    rtpvc2depay->last_parse_info_offset = next_parse_info_offset;
+      gst_buffer_unmap(buf, &info);
 
-    outbuf = gst_buffer_append(outbuf, buf);
+      fragment.n_slices = no_slices;
+      fragment.buf      = buf;
+      g_array_append_val (rtpvc2depay->fragments, fragment);
+    }
   }
 
+  if (M)
+    outbuf = gst_rtp_vc2_depay_complete_picture (rtpvc2depay);
+
   return outbuf;
 }
 
@@ -451,6 +1497,7 @@ gst_rtp_vc2_depay_process_end_of_sequence (GstRTPBaseDepayload * depayload) {
   info.data[12] = (rtpvc2depay->last_parse_info_offset >>  0)&0xFF;
 
   rtpvc2depay->last_parse_info_offset = next_parse_info_offset;
+  rtpvc2depay->wait_start             = TRUE;
 
   gst_buffer_unmap(outbuf, &info);
 
@@ -461,19 +1508,76 @@ static gboolean
 gst_rtp_vc2_depay_handle_event (GstRTPBaseDepayload * depay, GstEvent * event)
 {
   GstRtpVC2Depay *rtpvc2depay;
+  gboolean res;
 
   rtpvc2depay = GST_RTP_VC2_DEPAY (depay);
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      break;
     case GST_EVENT_FLUSH_STOP:
       gst_rtp_vc2_depay_reset (rtpvc2depay);
       break;
     default:
+      if (GST_EVENT_IS_SERIALIZED (event))
+        gst_rtp_vc2_depay_output_drain (rtpvc2depay);
       break;
   }
 
-  return
-      GST_RTP_BASE_DEPAYLOAD_CLASS (parent_class)->handle_event (depay, event);
+  res = GST_RTP_BASE_DEPAYLOAD_CLASS (parent_class)->handle_event (depay, event);
+
+  /* The flush events have gone downstream by now, so a push blocked there
+   * has returned and the output thread can be stopped and restarted */
+  if (rtpvc2depay->output_ring != NULL) {
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_FLUSH_START:
+        gst_rtp_vc2_depay_output_set_flushing (rtpvc2depay, TRUE);
+        gst_pad_pause_task (GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay));
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        gst_rtp_vc2_depay_output_clear (rtpvc2depay);
+        gst_rtp_vc2_depay_output_start (rtpvc2depay);
+        break;
+      default:
+        break;
+    }
+  }
+
+  return res;
+}
+
+static gboolean
+gst_rtp_vc2_depay_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstRtpVC2Depay *rtpvc2depay;
+
+  rtpvc2depay = GST_RTP_VC2_DEPAY (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_QOS:
+    {
+      GstQOSType type;
+      gdouble proportion;
+      GstClockTimeDiff diff;
+      GstClockTime timestamp;
+
+      gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+
+      GST_OBJECT_LOCK (rtpvc2depay);
+      if (GST_CLOCK_TIME_IS_VALID (timestamp))
+        rtpvc2depay->earliest_time = (diff < 0 && -diff > timestamp) ? 0 : timestamp + diff;
+      else
+        rtpvc2depay->earliest_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (rtpvc2depay);
+      break;
+    }
+    default:
+      break;
+  }
+
+  if (rtpvc2depay->base_src_event)
+    return rtpvc2depay->base_src_event (pad, parent, event);
+  return gst_pad_event_default (pad, parent, event);
 }
 
 static GstStateChangeReturn
@@ -490,6 +1594,21 @@ gst_rtp_vc2_depay_change_state (GstElement * element,
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       gst_rtp_vc2_depay_reset (rtpvc2depay);
+      gst_rtp_vc2_depay_reset_stats (rtpvc2depay);
+      vc2_ring_free (rtpvc2depay->output_ring, (GDestroyNotify) gst_buffer_unref);
+      rtpvc2depay->output_ring = NULL;
+      if (rtpvc2depay->output_queue_depth > 0) {
+        rtpvc2depay->output_ring = vc2_ring_new (rtpvc2depay->output_queue_depth);
+        gst_rtp_vc2_depay_output_clear (rtpvc2depay);
+      }
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* Downstream is already in READY, so a push in the output thread has
+       * returned and the task can be joined */
+      if (rtpvc2depay->output_ring != NULL) {
+        gst_rtp_vc2_depay_output_set_flushing (rtpvc2depay, TRUE);
+        gst_pad_stop_task (GST_RTP_BASE_DEPAYLOAD_SRCPAD (rtpvc2depay));
+      }
       break;
     default:
       break;
@@ -498,6 +1617,14 @@ gst_rtp_vc2_depay_change_state (GstElement * element,
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (rtpvc2depay->output_ring != NULL)
+        gst_rtp_vc2_depay_output_start (rtpvc2depay);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      vc2_ring_free (rtpvc2depay->output_ring, (GDestroyNotify) gst_buffer_unref);
+      rtpvc2depay->output_ring = NULL;
+      break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
     default:
@@ -25,6 +25,10 @@
 #include <gst/base/gstadapter.h>
 #include <gst/rtp/gstrtpbasedepayload.h>
 
+#include "vc2vlcparse.h"
+#include "vc2stats.h"
+#include "vc2ring.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_RTP_VC2_DEPAY \
@@ -41,6 +45,19 @@ G_BEGIN_DECLS
 typedef struct _GstRtpVC2Depay GstRtpVC2Depay;
 typedef struct _GstRtpVC2DepayClass GstRtpVC2DepayClass;
 
+/* A slice fragment of the picture being assembled, first being the raster
+ * position of its first slice */
+typedef struct {
+  guint      first;
+  guint      n_slices;
+  GstBuffer *buf;
+} GstRtpVC2DepayFragment;
+
+typedef enum {
+  GST_RTP_VC2_DEPAY_OVERFLOW_DROP,
+  GST_RTP_VC2_DEPAY_OVERFLOW_BLOCK,
+} GstRtpVC2DepayOverflow;
+
 struct _GstRtpVC2Depay
 {
   GstRTPBaseDepayload depayload;
@@ -52,6 +69,74 @@ struct _GstRtpVC2Depay
   gboolean  in_picture;
   guint32   picture_number;
   gint      picture_size;
+  guint8    picture_parse_code;
+  GstClockTime picture_pts;
+
+  /* slice fragments of the picture, put in order when it is complete */
+  GArray   *fragments;
+  gboolean  conceal;
+
+  GstBuffer *caps_seq_hdr;
+  gboolean   send_caps_seq_hdr;
+
+  vc2_hq_transform_parameters *params;
+  vc2_ld_transform_parameters *ld_params;
+  gint      params_size;
+  guint32  *slice_offsets;
+  guint     n_slice_offsets;
+  gboolean  slice_index_valid;
+
+  guint        capture_time_ext_id;
+  guint        caps_capture_time_ext_id;
+  gboolean     add_reference_timestamp_meta;
+  GstCaps     *capture_time_caps;
+  GstClockTime picture_capture_time;
+  GstClockTime picture_arrival_time;
+
+  /* QoS, earliest_time is protected by the object lock */
+  gboolean          qos;
+  GstClockTime      earliest_time;
+  GstPadEventFunction base_src_event;
+
+  /* Output thread. Pictures go from the streaming thread to a task on the
+   * src pad through output_ring; output_lock and output_cond are only used
+   * to sleep when the ring is empty, full or being drained. The task pushes
+   * on the pad itself, its flow return reaches upstream through the sink
+   * pad chain functions wrapped around the base class ones. */
+  guint                  output_queue_depth;
+  GstRtpVC2DepayOverflow overflow;
+  vc2_ring              *output_ring;
+  GMutex                 output_lock;
+  GCond                  output_cond;
+  gint                   output_flushing;
+  gint                   output_ret;
+  gint                   consumer_waiting;
+  gint                   producer_waiting;
+  guint64                output_queued;
+  guint64                output_pushed;
+  gboolean               output_discont;
+  GstPadChainFunction    base_sink_chain;
+  GstPadChainListFunction base_sink_chain_list;
+
+  /* statistics, updated with VC2_STATS_* */
+  GstClockTime picture_start;
+  guint64 stats_fragments;
+  guint64 stats_pictures;
+  guint64 stats_bytes;
+  guint64 stats_discontinuities;
+  guint64 stats_malformed_fragments;
+  guint64 stats_dropped_no_sequence_header;
+  guint64 stats_dropped_discont;
+  guint64 stats_dropped_incomplete;
+  guint64 stats_dropped_qos;
+  guint64 stats_dropped_overflow;
+  guint64 stats_concealed_pictures;
+  guint64 stats_concealed_slices;
+  guint64 stats_output_queue_max;
+  vc2_stats_histogram stats_assembly_time;
+  guint64 stats_clock_skew;
+  vc2_stats_histogram stats_network_latency;
+  vc2_stats_histogram stats_reassembly_latency;
 };
 
 struct _GstRtpVC2DepayClass
@@ -62,6 +147,9 @@ struct _GstRtpVC2DepayClass
 enum _GstRtpVC2DepayParseCode {
   GSTRTPVC2DEPAYPARSECODE_SEQUENCE_HEADER = 0x00,
   GSTRTPVC2DEPAYPARSECODE_END_OF_SEQUENCE = 0x10,
+  /* not in RFC 8450, which has no LD fragment: a private extension that
+   * only rtpvc2pay sends */
+  GSTRTPVC2DEPAYPARSECODE_LD_FRAGMENT     = 0xCC,
   GSTRTPVC2DEPAYPARSECODE_HQ_FRAGMENT     = 0xEC,
 };
 
@@ -0,0 +1,704 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstrtpvc2impair.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtpvc2impair_debug);
+#define GST_CAT_DEFAULT (rtpvc2impair_debug)
+
+/* A test element which damages an RTP stream in repeatable ways, to go
+ * between rtpvc2pay and rtpvc2depay. Each packet in turn may be
+ *
+ *   lost, with a fixed probability or from a two state Gilbert-Elliott
+ *   model for bursts of loss,
+ *   duplicated,
+ *   held back until reorder-depth later packets have gone past it, and
+ *   delayed by delay plus or minus up to jitter.
+ *
+ * The delay is virtual: a delayed packet has its PTS moved on by the delay
+ * and is sent once a packet with a later PTS arrives, so the order packets
+ * come out in matches their delays but nothing waits on a clock and the
+ * element can be run as fast as the data allows. All the randomness comes
+ * from one generator seeded with the seed property when the element starts,
+ * so a run can be repeated exactly. */
+
+#define DEFAULT_LOSS_MODEL            GST_RTP_VC2_IMPAIR_LOSS_NONE
+#define DEFAULT_LOSS_PROBABILITY      0.0
+#define DEFAULT_GILBERT_P             0.0
+#define DEFAULT_GILBERT_R             1.0
+#define DEFAULT_GILBERT_BAD_LOSS      1.0
+#define DEFAULT_GILBERT_GOOD_LOSS     0.0
+#define DEFAULT_DUPLICATE_PROBABILITY 0.0
+#define DEFAULT_REORDER_PROBABILITY   0.0
+#define DEFAULT_REORDER_DEPTH         1
+#define DEFAULT_DELAY                 0
+#define DEFAULT_JITTER                0
+#define DEFAULT_SEED                  0
+
+enum
+{
+  PROP_0,
+  PROP_LOSS_MODEL,
+  PROP_LOSS_PROBABILITY,
+  PROP_GILBERT_P,
+  PROP_GILBERT_R,
+  PROP_GILBERT_BAD_LOSS,
+  PROP_GILBERT_GOOD_LOSS,
+  PROP_DUPLICATE_PROBABILITY,
+  PROP_REORDER_PROBABILITY,
+  PROP_REORDER_DEPTH,
+  PROP_DELAY,
+  PROP_JITTER,
+  PROP_SEED,
+  PROP_STATS
+};
+
+typedef struct {
+  GstBuffer   *buffer;
+  guint        countdown;
+  GstClockTime departure;
+} GstRtpVC2ImpairHeld;
+
+static GstStaticPadTemplate gst_rtp_vc2_impair_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp")
+    );
+
+static GstStaticPadTemplate gst_rtp_vc2_impair_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp")
+    );
+
+#define GST_TYPE_RTP_VC2_IMPAIR_LOSS_MODEL (gst_rtp_vc2_impair_loss_model_get_type ())
+static GType
+gst_rtp_vc2_impair_loss_model_get_type (void)
+{
+  static GType loss_model_type = 0;
+  static const GEnumValue loss_models[] = {
+    {GST_RTP_VC2_IMPAIR_LOSS_NONE, "No loss", "none"},
+    {GST_RTP_VC2_IMPAIR_LOSS_BERNOULLI,
+        "Each packet is lost with loss-probability", "bernoulli"},
+    {GST_RTP_VC2_IMPAIR_LOSS_GILBERT_ELLIOTT,
+        "Two state Gilbert-Elliott model for burst loss", "gilbert-elliott"},
+    {0, NULL, NULL},
+  };
+
+  if (!loss_model_type) {
+    loss_model_type =
+        g_enum_register_static ("GstRtpVC2ImpairLossModel", loss_models);
+  }
+  return loss_model_type;
+}
+
+static void gst_rtp_vc2_impair_finalize (GObject * object);
+static void gst_rtp_vc2_impair_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_rtp_vc2_impair_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static GstStateChangeReturn gst_rtp_vc2_impair_change_state (GstElement *
+    element, GstStateChange transition);
+static GstFlowReturn gst_rtp_vc2_impair_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+static gboolean gst_rtp_vc2_impair_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+
+#define gst_rtp_vc2_impair_parent_class parent_class
+G_DEFINE_TYPE (GstRtpVC2Impair, gst_rtp_vc2_impair, GST_TYPE_ELEMENT);
+
+static void
+gst_rtp_vc2_impair_class_init (GstRtpVC2ImpairClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->finalize = gst_rtp_vc2_impair_finalize;
+  gobject_class->set_property = gst_rtp_vc2_impair_set_property;
+  gobject_class->get_property = gst_rtp_vc2_impair_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LOSS_MODEL,
+      g_param_spec_enum ("loss-model", "Loss Model",
+          "How packets are chosen to be lost",
+          GST_TYPE_RTP_VC2_IMPAIR_LOSS_MODEL, DEFAULT_LOSS_MODEL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LOSS_PROBABILITY,
+      g_param_spec_double ("loss-probability", "Loss Probability",
+          "Probability of losing each packet with the bernoulli loss model",
+          0.0, 1.0, DEFAULT_LOSS_PROBABILITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GILBERT_P,
+      g_param_spec_double ("gilbert-p", "Gilbert-Elliott p",
+          "Probability of moving from the good state to the bad state after each packet",
+          0.0, 1.0, DEFAULT_GILBERT_P,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GILBERT_R,
+      g_param_spec_double ("gilbert-r", "Gilbert-Elliott r",
+          "Probability of moving from the bad state to the good state after each packet",
+          0.0, 1.0, DEFAULT_GILBERT_R,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GILBERT_BAD_LOSS,
+      g_param_spec_double ("gilbert-bad-loss", "Gilbert-Elliott Bad Loss",
+          "Probability of losing a packet in the bad state",
+          0.0, 1.0, DEFAULT_GILBERT_BAD_LOSS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GILBERT_GOOD_LOSS,
+      g_param_spec_double ("gilbert-good-loss", "Gilbert-Elliott Good Loss",
+          "Probability of losing a packet in the good state",
+          0.0, 1.0, DEFAULT_GILBERT_GOOD_LOSS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DUPLICATE_PROBABILITY,
+      g_param_spec_double ("duplicate-probability", "Duplicate Probability",
+          "Probability of sending a packet twice",
+          0.0, 1.0, DEFAULT_DUPLICATE_PROBABILITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_REORDER_PROBABILITY,
+      g_param_spec_double ("reorder-probability", "Reorder Probability",
+          "Probability of holding a packet back until reorder-depth later packets have gone",
+          0.0, 1.0, DEFAULT_REORDER_PROBABILITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_REORDER_DEPTH,
+      g_param_spec_uint ("reorder-depth", "Reorder Depth",
+          "Number of later packets which overtake a reordered packet",
+          1, G_MAXUINT16, DEFAULT_REORDER_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DELAY,
+      g_param_spec_uint64 ("delay", "Delay",
+          "Delay in nanoseconds added to the timestamp of every packet",
+          0, G_MAXUINT64, DEFAULT_DELAY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_JITTER,
+      g_param_spec_uint64 ("jitter", "Jitter",
+          "Largest random change in nanoseconds to the delay of each packet",
+          0, G_MAXUINT64, DEFAULT_JITTER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint ("seed", "Seed",
+          "Seed for the random choices, applied when the element starts",
+          0, G_MAXUINT32, DEFAULT_SEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of packets in, out, lost, duplicated and reordered, and the delay added",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_impair_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_impair_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "RTP VC2 impairment", "Filter/Network/RTP",
+      "Loses, duplicates, reorders and delays RTP packets for testing",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstelement_class->change_state = gst_rtp_vc2_impair_change_state;
+
+  GST_DEBUG_CATEGORY_INIT (rtpvc2impair_debug, "rtpvc2impair", 0,
+      "VC2 RTP Impairment");
+}
+
+static void
+gst_rtp_vc2_impair_init (GstRtpVC2Impair * rtpvc2impair)
+{
+  rtpvc2impair->sinkpad =
+      gst_pad_new_from_static_template (&gst_rtp_vc2_impair_sink_template, "sink");
+  gst_pad_set_chain_function (rtpvc2impair->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_rtp_vc2_impair_chain));
+  gst_pad_set_event_function (rtpvc2impair->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_rtp_vc2_impair_sink_event));
+  GST_PAD_SET_PROXY_CAPS (rtpvc2impair->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (rtpvc2impair->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (rtpvc2impair), rtpvc2impair->sinkpad);
+
+  rtpvc2impair->srcpad =
+      gst_pad_new_from_static_template (&gst_rtp_vc2_impair_src_template, "src");
+  GST_PAD_SET_PROXY_CAPS (rtpvc2impair->srcpad);
+  GST_PAD_SET_PROXY_ALLOCATION (rtpvc2impair->srcpad);
+  gst_element_add_pad (GST_ELEMENT (rtpvc2impair), rtpvc2impair->srcpad);
+
+  rtpvc2impair->loss_model            = DEFAULT_LOSS_MODEL;
+  rtpvc2impair->loss_probability      = DEFAULT_LOSS_PROBABILITY;
+  rtpvc2impair->gilbert_p             = DEFAULT_GILBERT_P;
+  rtpvc2impair->gilbert_r             = DEFAULT_GILBERT_R;
+  rtpvc2impair->gilbert_bad_loss      = DEFAULT_GILBERT_BAD_LOSS;
+  rtpvc2impair->gilbert_good_loss     = DEFAULT_GILBERT_GOOD_LOSS;
+  rtpvc2impair->duplicate_probability = DEFAULT_DUPLICATE_PROBABILITY;
+  rtpvc2impair->reorder_probability   = DEFAULT_REORDER_PROBABILITY;
+  rtpvc2impair->reorder_depth         = DEFAULT_REORDER_DEPTH;
+  rtpvc2impair->delay                 = DEFAULT_DELAY;
+  rtpvc2impair->jitter                = DEFAULT_JITTER;
+  rtpvc2impair->seed                  = DEFAULT_SEED;
+
+  rtpvc2impair->rand = g_rand_new_with_seed (rtpvc2impair->seed);
+  g_queue_init (&rtpvc2impair->reordered);
+  g_queue_init (&rtpvc2impair->delayed);
+}
+
+static void
+gst_rtp_vc2_impair_held_free (GstRtpVC2ImpairHeld * held)
+{
+  gst_buffer_unref (held->buffer);
+  g_slice_free (GstRtpVC2ImpairHeld, held);
+}
+
+static void
+gst_rtp_vc2_impair_clear (GstRtpVC2Impair * rtpvc2impair)
+{
+  GstRtpVC2ImpairHeld *held;
+
+  while ((held = g_queue_pop_head (&rtpvc2impair->reordered)))
+    gst_rtp_vc2_impair_held_free (held);
+  while ((held = g_queue_pop_head (&rtpvc2impair->delayed)))
+    gst_rtp_vc2_impair_held_free (held);
+}
+
+static void
+gst_rtp_vc2_impair_reset (GstRtpVC2Impair * rtpvc2impair)
+{
+  gst_rtp_vc2_impair_clear (rtpvc2impair);
+
+  g_rand_set_seed (rtpvc2impair->rand, rtpvc2impair->seed);
+  rtpvc2impair->gilbert_bad = FALSE;
+
+  rtpvc2impair->packets_in  = 0;
+  rtpvc2impair->packets_out = 0;
+  rtpvc2impair->lost        = 0;
+  rtpvc2impair->duplicated  = 0;
+  rtpvc2impair->reorders    = 0;
+  rtpvc2impair->delay_sum   = 0;
+  rtpvc2impair->delay_max   = 0;
+}
+
+static void
+gst_rtp_vc2_impair_finalize (GObject * object)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (object);
+
+  gst_rtp_vc2_impair_clear (rtpvc2impair);
+  g_rand_free (rtpvc2impair->rand);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_rtp_vc2_impair_chance (GstRtpVC2Impair * rtpvc2impair, gdouble p)
+{
+  if (p <= 0.0)
+    return FALSE;
+  return g_rand_double (rtpvc2impair->rand) < p;
+}
+
+static gboolean
+gst_rtp_vc2_impair_lose (GstRtpVC2Impair * rtpvc2impair)
+{
+  gboolean lose;
+
+  switch (rtpvc2impair->loss_model) {
+    case GST_RTP_VC2_IMPAIR_LOSS_BERNOULLI:
+      return gst_rtp_vc2_impair_chance (rtpvc2impair, rtpvc2impair->loss_probability);
+    case GST_RTP_VC2_IMPAIR_LOSS_GILBERT_ELLIOTT:
+      lose = gst_rtp_vc2_impair_chance (rtpvc2impair, (rtpvc2impair->gilbert_bad) ?
+          rtpvc2impair->gilbert_bad_loss : rtpvc2impair->gilbert_good_loss);
+      if (rtpvc2impair->gilbert_bad)
+        rtpvc2impair->gilbert_bad = !gst_rtp_vc2_impair_chance (rtpvc2impair, rtpvc2impair->gilbert_r);
+      else
+        rtpvc2impair->gilbert_bad = gst_rtp_vc2_impair_chance (rtpvc2impair, rtpvc2impair->gilbert_p);
+      return lose;
+    case GST_RTP_VC2_IMPAIR_LOSS_NONE:
+    default:
+      return FALSE;
+  }
+}
+
+/* Gives a packet its delay and adds it to the delayed packets, which are kept
+ * in order of departure. Packets with the same departure keep their order. */
+static void
+gst_rtp_vc2_impair_delay (GstRtpVC2Impair * rtpvc2impair, GstBuffer * buf,
+    GQueue * out)
+{
+  GstRtpVC2ImpairHeld *held;
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+  GstClockTime departure;
+  GList *l;
+
+  if ((rtpvc2impair->delay == 0 && rtpvc2impair->jitter == 0) ||
+      !GST_CLOCK_TIME_IS_VALID (pts)) {
+    g_queue_push_tail (out, buf);
+    return;
+  }
+
+  departure = pts + rtpvc2impair->delay;
+  if (rtpvc2impair->jitter > 0) {
+    gdouble offset = g_rand_double_range (rtpvc2impair->rand,
+        -(gdouble) rtpvc2impair->jitter, (gdouble) rtpvc2impair->jitter);
+
+    if (offset < 0 && (GstClockTime) (-offset) > departure - pts)
+      departure = pts;
+    else
+      departure += (GstClockTimeDiff) offset;
+  }
+
+  held = g_slice_new (GstRtpVC2ImpairHeld);
+  held->buffer    = buf;
+  held->countdown = 0;
+  held->departure = departure;
+
+  for (l = rtpvc2impair->delayed.tail; l; l = l->prev) {
+    if (((GstRtpVC2ImpairHeld *) l->data)->departure <= departure)
+      break;
+  }
+  if (l)
+    g_queue_insert_after (&rtpvc2impair->delayed, l, held);
+  else
+    g_queue_push_head (&rtpvc2impair->delayed, held);
+}
+
+/* Sends every delayed packet due by now, or all of them if now is
+ * GST_CLOCK_TIME_NONE */
+static void
+gst_rtp_vc2_impair_release (GstRtpVC2Impair * rtpvc2impair, GstClockTime now,
+    GQueue * out)
+{
+  GstRtpVC2ImpairHeld *held;
+  GstClockTime added;
+  GstBuffer *buf;
+
+  while ((held = g_queue_peek_head (&rtpvc2impair->delayed))) {
+    if (GST_CLOCK_TIME_IS_VALID (now) && held->departure > now)
+      break;
+    g_queue_pop_head (&rtpvc2impair->delayed);
+
+    buf = gst_buffer_make_writable (held->buffer);
+    added = held->departure - GST_BUFFER_PTS (buf);
+    rtpvc2impair->delay_sum += added;
+    rtpvc2impair->delay_max  = MAX (rtpvc2impair->delay_max, added);
+    GST_BUFFER_PTS (buf) = held->departure;
+    g_queue_push_tail (out, buf);
+
+    g_slice_free (GstRtpVC2ImpairHeld, held);
+  }
+}
+
+/* Counts a packet past the packets held for reordering and moves on any which
+ * have now been overtaken by enough packets */
+static void
+gst_rtp_vc2_impair_age (GstRtpVC2Impair * rtpvc2impair, GQueue * overtaken)
+{
+  GList *l, *next;
+
+  for (l = rtpvc2impair->reordered.head; l; l = next) {
+    GstRtpVC2ImpairHeld *held = l->data;
+
+    next = l->next;
+    if (--held->countdown == 0) {
+      g_queue_delete_link (&rtpvc2impair->reordered, l);
+      g_queue_push_tail (overtaken, held->buffer);
+      g_slice_free (GstRtpVC2ImpairHeld, held);
+    }
+  }
+}
+
+static GstFlowReturn
+gst_rtp_vc2_impair_push (GstRtpVC2Impair * rtpvc2impair, GQueue * out)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buf;
+
+  while ((buf = g_queue_pop_head (out))) {
+    if (ret == GST_FLOW_OK)
+      ret = gst_pad_push (rtpvc2impair->srcpad, buf);
+    else
+      gst_buffer_unref (buf);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_impair_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (parent);
+  GQueue overtaken = G_QUEUE_INIT;
+  GQueue out = G_QUEUE_INIT;
+  GstClockTime now = GST_BUFFER_PTS (buf);
+  GstBuffer *copies[2];
+  guint n_copies, i;
+
+  GST_OBJECT_LOCK (rtpvc2impair);
+  rtpvc2impair->packets_in++;
+
+  gst_rtp_vc2_impair_age (rtpvc2impair, &overtaken);
+
+  n_copies = 0;
+  if (gst_rtp_vc2_impair_lose (rtpvc2impair)) {
+    rtpvc2impair->lost++;
+    gst_buffer_unref (buf);
+  } else {
+    copies[n_copies++] = buf;
+    if (gst_rtp_vc2_impair_chance (rtpvc2impair, rtpvc2impair->duplicate_probability)) {
+      rtpvc2impair->duplicated++;
+      copies[n_copies++] = gst_buffer_ref (buf);
+    }
+  }
+
+  for (i = 0; i < n_copies; i++) {
+    if (gst_rtp_vc2_impair_chance (rtpvc2impair, rtpvc2impair->reorder_probability)) {
+      GstRtpVC2ImpairHeld *held = g_slice_new (GstRtpVC2ImpairHeld);
+
+      held->buffer    = copies[i];
+      held->countdown = rtpvc2impair->reorder_depth;
+      held->departure = GST_CLOCK_TIME_NONE;
+      g_queue_push_tail (&rtpvc2impair->reordered, held);
+      rtpvc2impair->reorders++;
+    } else {
+      gst_rtp_vc2_impair_delay (rtpvc2impair, copies[i], &out);
+    }
+  }
+
+  /* packets held for reordering go after the packet which overtook them */
+  while ((buf = g_queue_pop_head (&overtaken)))
+    gst_rtp_vc2_impair_delay (rtpvc2impair, buf, &out);
+
+  if (GST_CLOCK_TIME_IS_VALID (now))
+    gst_rtp_vc2_impair_release (rtpvc2impair, now, &out);
+
+  rtpvc2impair->packets_out += out.length;
+  GST_OBJECT_UNLOCK (rtpvc2impair);
+
+  return gst_rtp_vc2_impair_push (rtpvc2impair, &out);
+}
+
+static gboolean
+gst_rtp_vc2_impair_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (parent);
+  GstRtpVC2ImpairHeld *held;
+  GQueue out = G_QUEUE_INIT;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      /* nothing else is coming to overtake or release what is held */
+      GST_OBJECT_LOCK (rtpvc2impair);
+      while ((held = g_queue_pop_head (&rtpvc2impair->reordered))) {
+        gst_rtp_vc2_impair_delay (rtpvc2impair, held->buffer, &out);
+        g_slice_free (GstRtpVC2ImpairHeld, held);
+      }
+      gst_rtp_vc2_impair_release (rtpvc2impair, GST_CLOCK_TIME_NONE, &out);
+      rtpvc2impair->packets_out += out.length;
+      GST_OBJECT_UNLOCK (rtpvc2impair);
+
+      gst_rtp_vc2_impair_push (rtpvc2impair, &out);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (rtpvc2impair);
+      gst_rtp_vc2_impair_clear (rtpvc2impair);
+      GST_OBJECT_UNLOCK (rtpvc2impair);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+gst_rtp_vc2_impair_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      GST_OBJECT_LOCK (rtpvc2impair);
+      gst_rtp_vc2_impair_reset (rtpvc2impair);
+      GST_OBJECT_UNLOCK (rtpvc2impair);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      GST_OBJECT_LOCK (rtpvc2impair);
+      gst_rtp_vc2_impair_clear (rtpvc2impair);
+      GST_OBJECT_UNLOCK (rtpvc2impair);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static GstStructure *
+gst_rtp_vc2_impair_get_stats (GstRtpVC2Impair * rtpvc2impair)
+{
+  guint64 out = rtpvc2impair->packets_out;
+
+  return gst_structure_new ("application/x-rtp-vc2-impair-stats",
+      "packets-in",  G_TYPE_UINT64, rtpvc2impair->packets_in,
+      "packets-out", G_TYPE_UINT64, rtpvc2impair->packets_out,
+      "lost",        G_TYPE_UINT64, rtpvc2impair->lost,
+      "duplicated",  G_TYPE_UINT64, rtpvc2impair->duplicated,
+      "reordered",   G_TYPE_UINT64, rtpvc2impair->reorders,
+      "delay-mean",  G_TYPE_UINT64, (out > 0) ? rtpvc2impair->delay_sum/out : 0,
+      "delay-max",   G_TYPE_UINT64, rtpvc2impair->delay_max,
+      NULL);
+}
+
+static void
+gst_rtp_vc2_impair_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (object);
+
+  GST_OBJECT_LOCK (rtpvc2impair);
+  switch (prop_id) {
+    case PROP_LOSS_MODEL:
+      rtpvc2impair->loss_model = g_value_get_enum (value);
+      break;
+    case PROP_LOSS_PROBABILITY:
+      rtpvc2impair->loss_probability = g_value_get_double (value);
+      break;
+    case PROP_GILBERT_P:
+      rtpvc2impair->gilbert_p = g_value_get_double (value);
+      break;
+    case PROP_GILBERT_R:
+      rtpvc2impair->gilbert_r = g_value_get_double (value);
+      break;
+    case PROP_GILBERT_BAD_LOSS:
+      rtpvc2impair->gilbert_bad_loss = g_value_get_double (value);
+      break;
+    case PROP_GILBERT_GOOD_LOSS:
+      rtpvc2impair->gilbert_good_loss = g_value_get_double (value);
+      break;
+    case PROP_DUPLICATE_PROBABILITY:
+      rtpvc2impair->duplicate_probability = g_value_get_double (value);
+      break;
+    case PROP_REORDER_PROBABILITY:
+      rtpvc2impair->reorder_probability = g_value_get_double (value);
+      break;
+    case PROP_REORDER_DEPTH:
+      rtpvc2impair->reorder_depth = g_value_get_uint (value);
+      break;
+    case PROP_DELAY:
+      rtpvc2impair->delay = g_value_get_uint64 (value);
+      break;
+    case PROP_JITTER:
+      rtpvc2impair->jitter = g_value_get_uint64 (value);
+      break;
+    case PROP_SEED:
+      rtpvc2impair->seed = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (rtpvc2impair);
+}
+
+static void
+gst_rtp_vc2_impair_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRtpVC2Impair *rtpvc2impair = GST_RTP_VC2_IMPAIR (object);
+
+  GST_OBJECT_LOCK (rtpvc2impair);
+  switch (prop_id) {
+    case PROP_LOSS_MODEL:
+      g_value_set_enum (value, rtpvc2impair->loss_model);
+      break;
+    case PROP_LOSS_PROBABILITY:
+      g_value_set_double (value, rtpvc2impair->loss_probability);
+      break;
+    case PROP_GILBERT_P:
+      g_value_set_double (value, rtpvc2impair->gilbert_p);
+      break;
+    case PROP_GILBERT_R:
+      g_value_set_double (value, rtpvc2impair->gilbert_r);
+      break;
+    case PROP_GILBERT_BAD_LOSS:
+      g_value_set_double (value, rtpvc2impair->gilbert_bad_loss);
+      break;
+    case PROP_GILBERT_GOOD_LOSS:
+      g_value_set_double (value, rtpvc2impair->gilbert_good_loss);
+      break;
+    case PROP_DUPLICATE_PROBABILITY:
+      g_value_set_double (value, rtpvc2impair->duplicate_probability);
+      break;
+    case PROP_REORDER_PROBABILITY:
+      g_value_set_double (value, rtpvc2impair->reorder_probability);
+      break;
+    case PROP_REORDER_DEPTH:
+      g_value_set_uint (value, rtpvc2impair->reorder_depth);
+      break;
+    case PROP_DELAY:
+      g_value_set_uint64 (value, rtpvc2impair->delay);
+      break;
+    case PROP_JITTER:
+      g_value_set_uint64 (value, rtpvc2impair->jitter);
+      break;
+    case PROP_SEED:
+      g_value_set_uint (value, rtpvc2impair->seed);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rtp_vc2_impair_get_stats (rtpvc2impair));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (rtpvc2impair);
+}
+
+gboolean
+gst_rtp_vc2_impair_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "rtpvc2impair",
+                               GST_RANK_NONE, GST_TYPE_RTP_VC2_IMPAIR);
+}
@@ -0,0 +1,95 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTP_VC2_IMPAIR_H__
+#define __GST_RTP_VC2_IMPAIR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_RTP_VC2_IMPAIR \
+  (gst_rtp_vc2_impair_get_type())
+#define GST_RTP_VC2_IMPAIR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_RTP_VC2_IMPAIR,GstRtpVC2Impair))
+#define GST_RTP_VC2_IMPAIR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_RTP_VC2_IMPAIR,GstRtpVC2ImpairClass))
+#define GST_IS_RTP_VC2_IMPAIR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_RTP_VC2_IMPAIR))
+#define GST_IS_RTP_VC2_IMPAIR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_RTP_VC2_IMPAIR))
+
+typedef struct _GstRtpVC2Impair GstRtpVC2Impair;
+typedef struct _GstRtpVC2ImpairClass GstRtpVC2ImpairClass;
+
+typedef enum {
+  GST_RTP_VC2_IMPAIR_LOSS_NONE,
+  GST_RTP_VC2_IMPAIR_LOSS_BERNOULLI,
+  GST_RTP_VC2_IMPAIR_LOSS_GILBERT_ELLIOTT,
+} GstRtpVC2ImpairLossModel;
+
+struct _GstRtpVC2Impair
+{
+  GstElement element;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* properties */
+  GstRtpVC2ImpairLossModel loss_model;
+  gdouble loss_probability;
+  gdouble gilbert_p;
+  gdouble gilbert_r;
+  gdouble gilbert_bad_loss;
+  gdouble gilbert_good_loss;
+  gdouble duplicate_probability;
+  gdouble reorder_probability;
+  guint   reorder_depth;
+  GstClockTime delay;
+  GstClockTime jitter;
+  guint32 seed;
+
+  GRand   *rand;
+  gboolean gilbert_bad;
+
+  /* packets held back, see gstrtpvc2impair.c */
+  GQueue reordered;
+  GQueue delayed;
+
+  guint64 packets_in;
+  guint64 packets_out;
+  guint64 lost;
+  guint64 duplicated;
+  guint64 reorders;
+  GstClockTime delay_sum;
+  GstClockTime delay_max;
+};
+
+struct _GstRtpVC2ImpairClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_rtp_vc2_impair_get_type (void);
+
+gboolean gst_rtp_vc2_impair_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_RTP_VC2_IMPAIR_H__ */
@@ -31,6 +31,9 @@
 
 
 #include "gstrtpvc2pay.h"
+#include "gstrtputils.h"
+#include "gstvc2meta.h"
+#include "vc2probes.h"
 
 GST_DEBUG_CATEGORY_STATIC (rtpvc2pay_debug);
 #define GST_CAT_DEFAULT (rtpvc2pay_debug)
@@ -58,6 +61,39 @@ GST_STATIC_PAD_TEMPLATE ("src",
         "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
     );
 
+#define DEFAULT_CONFIG_INTERVAL 0
+#define DEFAULT_CONFIG_INTERVAL_PICTURES 0
+#define DEFAULT_CAPTURE_TIME_EXT_ID 0
+#define DEFAULT_QOS TRUE
+#define DEFAULT_INCREMENTAL FALSE
+#define DEFAULT_DECIMATION 1
+#define DEFAULT_MAX_UNIT_SIZE VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE
+#define DEFAULT_INTERLEAVE 0
+#define DEFAULT_PACKETIZATION GST_RTP_VC2_PAY_PACKETIZATION_GREEDY
+#define DEFAULT_ROW_ALIGNED FALSE
+#define DEFAULT_FRAME_RATE_TIMESTAMPS FALSE
+
+/* Transform parameters longer than this are not believed in incremental
+ * mode, the picture is left to the whole-picture path instead */
+#define MAX_TRANSFORM_PARAMETERS_SIZE 1024
+
+enum
+{
+  PROP_0,
+  PROP_CONFIG_INTERVAL,
+  PROP_CONFIG_INTERVAL_PICTURES,
+  PROP_CAPTURE_TIME_EXT_ID,
+  PROP_QOS,
+  PROP_INCREMENTAL,
+  PROP_DECIMATION,
+  PROP_MAX_UNIT_SIZE,
+  PROP_INTERLEAVE,
+  PROP_PACKETIZATION,
+  PROP_ROW_ALIGNED,
+  PROP_FRAME_RATE_TIMESTAMPS,
+  PROP_STATS
+};
+
 static void gst_rtp_vc2_pay_finalize (GObject * object);
 
 static void gst_rtp_vc2_pay_set_property (GObject * object, guint prop_id,
@@ -73,9 +109,31 @@ static GstFlowReturn gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * pad,
     GstBuffer * buffer);
 static gboolean gst_rtp_vc2_pay_sink_event (GstRTPBasePayload * payload,
     GstEvent * event);
+static gboolean gst_rtp_vc2_pay_src_event (GstRTPBasePayload * payload,
+    GstEvent * event);
 static GstStateChangeReturn gst_rtp_vc2_pay_change_state (GstElement *
     element, GstStateChange transition);
 
+#define GST_TYPE_RTP_VC2_PAY_PACKETIZATION (gst_rtp_vc2_pay_packetization_get_type ())
+static GType
+gst_rtp_vc2_pay_packetization_get_type (void)
+{
+  static GType packetization_type = 0;
+  static const GEnumValue packetizations[] = {
+    {GST_RTP_VC2_PAY_PACKETIZATION_GREEDY,
+        "Fill each packet as far as the MTU allows", "greedy"},
+    {GST_RTP_VC2_PAY_PACKETIZATION_BALANCED,
+        "As few packets, but of even sizes", "balanced"},
+    {0, NULL, NULL},
+  };
+
+  if (!packetization_type) {
+    packetization_type =
+        g_enum_register_static ("GstRtpVC2PayPacketization", packetizations);
+  }
+  return packetization_type;
+}
+
 #define gst_rtp_vc2_pay_parent_class parent_class
 G_DEFINE_TYPE (GstRtpVC2Pay, gst_rtp_vc2_pay, GST_TYPE_RTP_BASE_PAYLOAD);
 
@@ -95,6 +153,108 @@ gst_rtp_vc2_pay_class_init (GstRtpVC2PayClass * klass)
 
   gobject_class->finalize = gst_rtp_vc2_pay_finalize;
 
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CONFIG_INTERVAL,
+      g_param_spec_int ("config-interval",
+          "Sequence Header Send Interval",
+          "Send the last sequence header ahead of the next picture after this "
+          "many seconds have passed without one (0 = disabled, -1 = before "
+          "every picture)", -1, 3600, DEFAULT_CONFIG_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CONFIG_INTERVAL_PICTURES,
+      g_param_spec_uint ("config-interval-pictures",
+          "Sequence Header Send Interval In Pictures",
+          "Send the last sequence header ahead of the next picture after this "
+          "many pictures have gone without one, as well as or instead of "
+          "config-interval (0 = disabled)", 0, G_MAXUINT,
+          DEFAULT_CONFIG_INTERVAL_PICTURES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_CAPTURE_TIME_EXT_ID,
+      g_param_spec_uint ("capture-time-ext-id",
+          "Capture Time Extension ID",
+          "RFC 8285 one-byte header extension id used to send the clock time "
+          "at which each picture was captured on its first packet "
+          "(0 = disabled)", 0, 14, DEFAULT_CAPTURE_TIME_EXT_ID,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_QOS,
+      g_param_spec_boolean ("qos", "QoS",
+          "Drop whole pictures that QoS events from downstream say will "
+          "arrive too late, before packetising them", DEFAULT_QOS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_INCREMENTAL,
+      g_param_spec_boolean ("incremental", "Incremental",
+          "Start sending an HQ picture as soon as its transform parameters "
+          "and first slices have arrived, instead of waiting for all of it, "
+          "for encoders which produce a slice row at a time",
+          DEFAULT_INCREMENTAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_DECIMATION,
+      g_param_spec_uint ("decimation", "Decimation",
+          "Only send every Nth frame, for low frame rate proxy and monitoring "
+          "streams (both fields of an interlaced frame are kept together)",
+          1, G_MAXUINT, DEFAULT_DECIMATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_MAX_UNIT_SIZE,
+      g_param_spec_uint ("max-unit-size", "Maximum Unit Size",
+          "Largest data unit in bytes, parse info header included, that is "
+          "waited for; a longer next_parse_offset is taken to be corrupt and "
+          "the payloader resynchronises (0 = no limit)",
+          0, G_MAXUINT, DEFAULT_MAX_UNIT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_INTERLEAVE,
+      g_param_spec_uint ("interleave", "Interleave",
+          "Send the slice packets of each picture in this many interleaved "
+          "passes, so a burst of lost packets leaves holes spread over the "
+          "picture instead of a band across it (0 = raster order, not used "
+          "in incremental mode)",
+          0, G_MAXUINT16, DEFAULT_INTERLEAVE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_PACKETIZATION,
+      g_param_spec_enum ("packetization", "Packetization",
+          "How the slices of a picture are shared out between packets, both "
+          "ways using as few packets as the MTU allows (not used in "
+          "incremental mode)",
+          GST_TYPE_RTP_VC2_PAY_PACKETIZATION, DEFAULT_PACKETIZATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_ROW_ALIGNED,
+      g_param_spec_boolean ("row-aligned", "Row Aligned",
+          "Never let a packet carry slices from two rows of slices",
+          DEFAULT_ROW_ALIGNED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_FRAME_RATE_TIMESTAMPS,
+      g_param_spec_boolean ("frame-rate-timestamps", "Frame Rate Timestamps",
+          "Give pictures RTP timestamps counted from the frame rate in the "
+          "sequence header and their picture numbers, going back to the "
+          "buffer timestamps only at discontinuities (needs perfect-rtptime)",
+          DEFAULT_FRAME_RATE_TIMESTAMPS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of pictures, packets, bytes, sequence headers, resyncs and "
+          "drops, packet fill and per-picture packetisation times",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_rtp_vc2_pay_src_template));
   gst_element_class_add_pad_template (gstelement_class,
@@ -112,6 +272,7 @@ gst_rtp_vc2_pay_class_init (GstRtpVC2PayClass * klass)
   gstrtpbasepayload_class->set_caps = gst_rtp_vc2_pay_setcaps;
   gstrtpbasepayload_class->handle_buffer = gst_rtp_vc2_pay_handle_buffer;
   gstrtpbasepayload_class->sink_event = gst_rtp_vc2_pay_sink_event;
+  gstrtpbasepayload_class->src_event = gst_rtp_vc2_pay_src_event;
 
   GST_DEBUG_CATEGORY_INIT (rtpvc2pay_debug, "rtpvc2pay", 0,
       "VC2 RTP Payloader");
@@ -127,11 +288,80 @@ gst_rtp_vc2_pay_init (GstRtpVC2Pay * rtpvc2pay)
 
   rtpvc2pay->seq_hdr = NULL;
   rtpvc2pay->next_ext_seq_num = 0;
+
+  rtpvc2pay->config_interval = DEFAULT_CONFIG_INTERVAL;
+  rtpvc2pay->last_config = GST_CLOCK_TIME_NONE;
+  rtpvc2pay->config_interval_pictures = DEFAULT_CONFIG_INTERVAL_PICTURES;
+  rtpvc2pay->pictures_since_config = G_MAXUINT;
+
+  rtpvc2pay->capture_time_ext_id = DEFAULT_CAPTURE_TIME_EXT_ID;
+
+  rtpvc2pay->qos = DEFAULT_QOS;
+  rtpvc2pay->earliest_time = GST_CLOCK_TIME_NONE;
+
+  rtpvc2pay->slice_offsets = NULL;
+  rtpvc2pay->n_slice_offsets = 0;
+
+  rtpvc2pay->decimation = DEFAULT_DECIMATION;
+  rtpvc2pay->max_unit_size = DEFAULT_MAX_UNIT_SIZE;
+
+  rtpvc2pay->frame_rate_timestamps = DEFAULT_FRAME_RATE_TIMESTAMPS;
+  rtpvc2pay->rtptime_anchored = FALSE;
+  rtpvc2pay->rtptime_discont = FALSE;
+  rtpvc2pay->rtptime_offset = GST_BUFFER_OFFSET_NONE;
+
+  rtpvc2pay->packetization = DEFAULT_PACKETIZATION;
+  rtpvc2pay->row_aligned = DEFAULT_ROW_ALIGNED;
+  rtpvc2pay->interleave = DEFAULT_INTERLEAVE;
+  rtpvc2pay->packets = NULL;
+  rtpvc2pay->n_packets_alloc = 0;
+  rtpvc2pay->plan = NULL;
+  rtpvc2pay->n_plan_alloc = 0;
+
+  rtpvc2pay->incremental = DEFAULT_INCREMENTAL;
+  rtpvc2pay->inc_active = FALSE;
+  rtpvc2pay->inc_params = NULL;
+}
+
+static void
+gst_rtp_vc2_pay_incremental_reset (GstRtpVC2Pay * rtpvc2pay)
+{
+  vc2_hq_transform_parameters_free (rtpvc2pay->inc_params);
+  rtpvc2pay->inc_params = NULL;
+  rtpvc2pay->inc_active = FALSE;
+}
+
+static void
+gst_rtp_vc2_pay_reset_stats (GstRtpVC2Pay * rtpvc2pay)
+{
+  VC2_STATS_SET (rtpvc2pay->stats_pictures,          0);
+  VC2_STATS_SET (rtpvc2pay->stats_packets,           0);
+  VC2_STATS_SET (rtpvc2pay->stats_bytes,             0);
+  VC2_STATS_SET (rtpvc2pay->stats_slice_packets,     0);
+  VC2_STATS_SET (rtpvc2pay->stats_slice_bytes,       0);
+  VC2_STATS_SET (rtpvc2pay->stats_slice_mtu,         0);
+  VC2_STATS_SET (rtpvc2pay->stats_max_fill_ppm,      0);
+  VC2_STATS_SET (rtpvc2pay->stats_sequence_headers,  0);
+  VC2_STATS_SET (rtpvc2pay->stats_resyncs,           0);
+  VC2_STATS_SET (rtpvc2pay->stats_dropped_pictures,  0);
+  VC2_STATS_SET (rtpvc2pay->stats_dropped_aux_bytes, 0);
+  VC2_STATS_SET (rtpvc2pay->stats_dropped_qos,       0);
+  VC2_STATS_SET (rtpvc2pay->stats_decimated,         0);
+  VC2_STATS_SET (rtpvc2pay->stats_oversized_slices,  0);
+  VC2_STATS_SET (rtpvc2pay->stats_rtptime_anchors,   0);
+  vc2_stats_histogram_reset (&rtpvc2pay->stats_picture_time);
 }
 
 static void
 gst_rtp_vc2_pay_finalize (GObject * object)
 {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (object);
+
+  g_free (rtpvc2pay->slice_offsets);
+  g_free (rtpvc2pay->packets);
+  g_free (rtpvc2pay->plan);
+  gst_rtp_vc2_pay_incremental_reset (rtpvc2pay);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -192,102 +422,191 @@ done:
   return caps;
 }
 
+/* Publishes the current sequence header base64 encoded in the src caps, so
+ * that it ends up in the SDP and receivers can start decoding without waiting
+ * for it to arrive in-band */
+static gboolean
+gst_rtp_vc2_pay_set_outcaps (GstRTPBasePayload * basepayload)
+{
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  GstMapInfo info;
+  gchar *seqhdr = NULL;
+  gchar *extmap = NULL;
+  gboolean res;
+
+  if (rtpvc2pay->seq_hdr != NULL) {
+    if (!gst_buffer_map (rtpvc2pay->seq_hdr->buf, &info, GST_MAP_READ))
+      return FALSE;
+    seqhdr = g_base64_encode (info.data, info.size);
+    gst_buffer_unmap (rtpvc2pay->seq_hdr->buf, &info);
+  }
+
+  /* The extension is announced the same way as an a=extmap line in the SDP */
+  if (rtpvc2pay->capture_time_ext_id != 0)
+    extmap = g_strdup_printf ("extmap-%u", rtpvc2pay->capture_time_ext_id);
+
+  if (seqhdr != NULL && extmap != NULL)
+    res = gst_rtp_base_payload_set_outcaps (basepayload,
+        "sequence-header", G_TYPE_STRING, seqhdr,
+        extmap, G_TYPE_STRING, GST_RTP_VC2_CAPTURE_TIME_URI, NULL);
+  else if (seqhdr != NULL)
+    res = gst_rtp_base_payload_set_outcaps (basepayload,
+        "sequence-header", G_TYPE_STRING, seqhdr, NULL);
+  else if (extmap != NULL)
+    res = gst_rtp_base_payload_set_outcaps (basepayload,
+        extmap, G_TYPE_STRING, GST_RTP_VC2_CAPTURE_TIME_URI, NULL);
+  else
+    res = gst_rtp_base_payload_set_outcaps (basepayload, NULL);
+  g_free (seqhdr);
+  g_free (extmap);
+
+  return res;
+}
+
 static gboolean
 gst_rtp_vc2_pay_setcaps (GstRTPBasePayload * basepayload, GstCaps * caps)
 {
   gst_rtp_base_payload_set_options (basepayload, "video", TRUE, "VC2", 90000);
-  gst_rtp_base_payload_set_outcaps (basepayload, NULL);
 
-  return TRUE;
+  return gst_rtp_vc2_pay_set_outcaps (basepayload);
 }
 
-static gboolean gst_rtp_vc2_pay_extract_parse_info(GstAdapter *adapter, int adaptersize, int offset, GstRtpVC2PayParseInfo *info) {
-  unsigned char buf[13];
-  GstRtpVC2PayParseInfo first, next;
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_seqhdr(GstRTPBasePayload * basepayload, GstClockTime dts, GstClockTime pts);
 
-  if (offset + 13 > adaptersize)
-    return FALSE;
-  
-  gst_adapter_copy(adapter, buf, offset, 13);
-  if (buf[0] != 0x42 || buf[1] != 0x42 || buf[2] != 0x43 || buf[3] != 0x44)
-    return FALSE;
-  first.parse_code        = ((unsigned char)buf[ 4]);
-  first.next_parse_offset = (((unsigned int)buf[ 5] << 24) |
-                             ((unsigned int)buf[ 6] << 16) |
-                             ((unsigned int)buf[ 7] <<  8) |
-                             ((unsigned int)buf[ 8] <<  0));
-  first.prev_parse_offset = (((unsigned int)buf[ 9] << 24) |
-                             ((unsigned int)buf[10] << 16) |
-                             ((unsigned int)buf[11] <<  8) |
-                             ((unsigned int)buf[12] <<  0));
-
-  if (first.parse_code == GSTRTPVC2PAYPARSECODE_END_OF_SEQUENCE) {
-    *info = first;
-    return TRUE;
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_hqpicture(GstRTPBasePayload * basepayload, GstBuffer *buffer);
+
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_ldpicture(GstRTPBasePayload * basepayload, GstBuffer *buffer);
+
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_eos(GstRTPBasePayload * basepayload, GstClockTime dts, GstClockTime pts);
+
+static gboolean
+gst_rtp_vc2_pay_picture_is_decimated(GstRtpVC2Pay *rtpvc2pay, guint32 picture_number);
+
+static gboolean
+gst_rtp_vc2_pay_picture_is_late(GstRtpVC2Pay *rtpvc2pay, GstClockTime pts);
+
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_incremental(GstRTPBasePayload * basepayload, GstRtpVC2PayIncrementalResult *result);
+
+/* Works out the RTP clock offset of a picture from its number and the frame
+ * rate in the sequence header, counting on from an anchor picture whose
+ * offset came from its timestamp, so that the jitter of a live source does
+ * not reach the RTP timestamps. A picture is a field in an interlaced
+ * stream, so the second field of a frame lands half a frame later. The
+ * anchor moves to the picture given at a discontinuity, when the rate
+ * changes, when picture numbers stop running on, or when the timestamps
+ * have wandered more than a picture away from the count. A pts of
+ * GST_CLOCK_TIME_NONE just counts on, for packets sent ahead of a picture.
+ * The offset goes on every packet sent, as GST_BUFFER_OFFSET. */
+static void
+gst_rtp_vc2_pay_update_rtptime (GstRtpVC2Pay * rtpvc2pay, guint32 picture_number, GstClockTime pts)
+{
+  GstRTPBasePayload *basepayload = GST_RTP_BASE_PAYLOAD (rtpvc2pay);
+  vc2_sequence_header *hdr = rtpvc2pay->seq_hdr;
+  guint64 period_numer, period_denom, offset, period, stamp = GST_BUFFER_OFFSET_NONE;
+  guint32 count;
+  gboolean anchor;
+
+  if (!rtpvc2pay->frame_rate_timestamps || hdr == NULL ||
+      hdr->frame_rate_numer == 0 || hdr->frame_rate_denom == 0) {
+    rtpvc2pay->rtptime_offset = GST_BUFFER_OFFSET_NONE;
+    return;
   }
 
-  gssize nextoffset = offset + first.next_parse_offset;
-  if (first.next_parse_offset == 0)
-    nextoffset = gst_adapter_masked_scan_uint32(adapter, 0xFFFFFFFF, 0x42424344, offset + 13, adaptersize - offset - 13);
+  if (GST_CLOCK_TIME_IS_VALID (pts) && basepayload->segment.format == GST_FORMAT_TIME) {
+    GstClockTime running_time = gst_segment_to_running_time (&basepayload->segment, GST_FORMAT_TIME, pts);
 
-  while (TRUE) {
-    if (nextoffset < 0) {
-      return FALSE;
-    }
+    if (GST_CLOCK_TIME_IS_VALID (running_time))
+      stamp = gst_util_uint64_scale_int (running_time, basepayload->clock_rate, GST_SECOND);
+  }
 
-    if (nextoffset + 13 > adaptersize) {
-      return FALSE;
+  /* pictures per second as period_numer/period_denom */
+  period_numer = (guint64) hdr->frame_rate_numer*((hdr->interlaced) ? 2 : 1);
+  period_denom = hdr->frame_rate_denom;
+  period       = gst_util_uint64_scale (1, basepayload->clock_rate*period_denom, period_numer);
+
+  count  = picture_number - rtpvc2pay->rtptime_anchor_picture;
+  anchor = !rtpvc2pay->rtptime_anchored ||
+           period_numer != rtpvc2pay->rtptime_period_numer ||
+           period_denom != rtpvc2pay->rtptime_period_denom ||
+           (guint32) (picture_number - rtpvc2pay->rtptime_last_picture) > G_MAXINT32;
+  if (stamp != GST_BUFFER_OFFSET_NONE)
+    anchor = anchor || rtpvc2pay->rtptime_discont;
+
+  offset = 0;
+  if (!anchor) {
+    offset = rtpvc2pay->rtptime_anchor_offset +
+        gst_util_uint64_scale (count, basepayload->clock_rate*period_denom, period_numer);
+    if (stamp != GST_BUFFER_OFFSET_NONE &&
+        ((stamp > offset) ? stamp - offset : offset - stamp) > period) {
+      GST_DEBUG_OBJECT (rtpvc2pay, "picture %u is %" G_GINT64_FORMAT " ticks off the frame rate, re-anchoring",
+                        picture_number, (gint64) (stamp - offset));
+      anchor = TRUE;
     }
+  }
 
-    gst_adapter_copy(adapter, buf, nextoffset, 13);
-    if (buf[0] != 0x42 || buf[1] != 0x42 || buf[2] != 0x43 || buf[3] != 0x44)
-      return FALSE;
-    next.parse_code        = ((unsigned char)buf[ 4]);
-    next.next_parse_offset = (((unsigned int)buf[ 5] << 24) |
-                              ((unsigned int)buf[ 6] << 16) |
-                              ((unsigned int)buf[ 7] <<  8) |
-                              ((unsigned int)buf[ 8] <<  0));
-    next.prev_parse_offset = (((unsigned int)buf[ 9] << 24) |
-                              ((unsigned int)buf[10] << 16) |
-                              ((unsigned int)buf[11] <<  8) |
-                              ((unsigned int)buf[12] <<  0));
-
-    if (nextoffset - offset == next.prev_parse_offset) {
-      first.next_parse_offset = nextoffset - offset;
-      *info = first;
-      return TRUE;
+  if (anchor) {
+    if (stamp == GST_BUFFER_OFFSET_NONE) {
+      /* Nothing to anchor to, leave it to the base class */
+      rtpvc2pay->rtptime_anchored = FALSE;
+      rtpvc2pay->rtptime_offset   = GST_BUFFER_OFFSET_NONE;
+      return;
     }
 
-    if (first.next_parse_offset != 0)
-      return FALSE;
-
-    nextoffset = gst_adapter_masked_scan_uint32(adapter, 0xFFFFFFFF, 0x42424344, nextoffset + 4, adaptersize - nextoffset - 4);
+    GST_LOG_OBJECT (rtpvc2pay, "anchoring RTP time at picture %u", picture_number);
+    VC2_STATS_INC (rtpvc2pay->stats_rtptime_anchors);
+    rtpvc2pay->rtptime_anchored       = TRUE;
+    rtpvc2pay->rtptime_discont        = FALSE;
+    rtpvc2pay->rtptime_anchor_picture = picture_number;
+    rtpvc2pay->rtptime_anchor_offset  = stamp;
+    rtpvc2pay->rtptime_period_numer   = period_numer;
+    rtpvc2pay->rtptime_period_denom   = period_denom;
+    offset = stamp;
   }
-  return FALSE;
+
+  if (stamp != GST_BUFFER_OFFSET_NONE)
+    rtpvc2pay->rtptime_last_picture = picture_number;
+  rtpvc2pay->rtptime_offset = offset;
 }
 
-static gssize gst_rtp_vc2_pay_find_parse_info(GstAdapter *adapter, int adaptersize, gssize offset) {
-  gssize parse_info_offset = offset;
-  while(TRUE) {
-    GstRtpVC2PayParseInfo info;
-    parse_info_offset = gst_adapter_masked_scan_uint32(adapter, 0xFFFFFFFF, 0x42424344, parse_info_offset, adaptersize - parse_info_offset);
-    if (parse_info_offset < 0)
-      break;
+/* Decides whether the cached sequence header should be repeated ahead of a
+ * picture with the given timestamp, so that receivers joining mid-stream do
+ * not have to wait for the encoder to send the next one. */
+static gboolean
+gst_rtp_vc2_pay_seqhdr_due (GstRtpVC2Pay * rtpvc2pay, GstClockTime pts)
+{
+  GstClockTime interval;
 
-    if (gst_rtp_vc2_pay_extract_parse_info(adapter, adaptersize, parse_info_offset, &info))
-      break;
-  }
-  return parse_info_offset;
-}
+  if (rtpvc2pay->seq_hdr == NULL)
+    return FALSE;
 
-static GstFlowReturn
-gst_rtp_vc2_pay_payload_seqhdr(GstRTPBasePayload * basepayload, GstClockTime dts, GstClockTime pts);
+  if (rtpvc2pay->config_interval_pictures > 0 &&
+      rtpvc2pay->pictures_since_config >= rtpvc2pay->config_interval_pictures)
+    return TRUE;
 
-static GstFlowReturn
-gst_rtp_vc2_pay_payload_hqpicture(GstRTPBasePayload * basepayload, GstBuffer *buffer);
+  if (rtpvc2pay->config_interval == 0)
+    return FALSE;
 
-static GstFlowReturn
-gst_rtp_vc2_pay_payload_eos(GstRTPBasePayload * basepayload, GstClockTime dts, GstClockTime pts);
+  if (rtpvc2pay->config_interval < 0)
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (rtpvc2pay->last_config))
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return FALSE;
+
+  /* timestamps went backwards, start counting again from here */
+  if (pts < rtpvc2pay->last_config)
+    return TRUE;
+
+  interval = rtpvc2pay->config_interval * GST_SECOND;
+  return (pts - rtpvc2pay->last_config >= interval);
+}
 
 static GstFlowReturn
 gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * basepayload,
@@ -299,16 +618,19 @@ gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * basepayload,
   rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
 
   if (buffer) {
+    if (GST_BUFFER_IS_DISCONT (buffer))
+      rtpvc2pay->rtptime_discont = TRUE;
     gst_adapter_push(rtpvc2pay->adapter, buffer);
     rtpvc2pay->storedsize += gst_buffer_get_size (buffer);
   }
 
   /* Data has been pushed into adapter, now process the data in the adapter */
   ret = GST_FLOW_OK;
-  while (ret == GST_FLOW_OK && rtpvc2pay->storedsize >= 13) {
+  while (ret == GST_FLOW_OK && (rtpvc2pay->storedsize >= 13 || rtpvc2pay->inc_active)) {
     if (rtpvc2pay->state == GSTRTPVC2PAYSTATE_UNSYNC) {
       /* We are not synchronised with a sequence */
-      gssize parse_info_offset = gst_rtp_vc2_pay_find_parse_info(rtpvc2pay->adapter, rtpvc2pay->storedsize, 0);
+      gssize parse_info_offset = vc2_parse_info_find(rtpvc2pay->adapter, rtpvc2pay->storedsize, 0,
+                                                          rtpvc2pay->max_unit_size);
       if (parse_info_offset < 0)
         break;
 
@@ -317,9 +639,28 @@ gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * basepayload,
       rtpvc2pay->state = GSTRTPVC2PAYSTATE_SYNC;
     }
 
-    GstRtpVC2PayParseInfo info;
-    if (!gst_rtp_vc2_pay_extract_parse_info(rtpvc2pay->adapter, rtpvc2pay->storedsize, 0, &info))
+    if (rtpvc2pay->incremental || rtpvc2pay->inc_active) {
+      GstRtpVC2PayIncrementalResult inc;
+
+      ret = gst_rtp_vc2_pay_payload_incremental(basepayload, &inc);
+      if (inc == GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA)
+        break;
+      if (inc == GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS)
+        continue;
+    }
+
+    vc2_parse_info info;
+    vc2_parse_info_result res = vc2_parse_info_extract(rtpvc2pay->adapter, rtpvc2pay->storedsize, 0,
+                                                          rtpvc2pay->max_unit_size, &info);
+    if (res == VC2_PARSE_INFO_NEED_DATA)
       break;
+    if (res == VC2_PARSE_INFO_INVALID) {
+      GST_WARNING_OBJECT (rtpvc2pay, "invalid parse info header, resynchronising");
+      VC2_STATS_INC (rtpvc2pay->stats_resyncs);
+      rtpvc2pay->state = GSTRTPVC2PAYSTATE_UNSYNC;
+      continue;
+    }
+    VC2_PROBE3 (pay_parse_info, info.parse_code, info.next_parse_offset, rtpvc2pay->storedsize);
 
     if (info.parse_code == GSTRTPVC2PAYPARSECODE_END_OF_SEQUENCE) {
     }
@@ -337,21 +678,37 @@ gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * basepayload,
         if (!vc2_sequence_header_cmp(rtpvc2pay->seq_hdr, outbuf, info.next_parse_offset - 13)) {
           vc2_sequence_header_free(rtpvc2pay->seq_hdr);
           rtpvc2pay->seq_hdr = vc2_sequence_header_new(outbuf);
+
+          if (rtpvc2pay->seq_hdr != NULL && !gst_rtp_vc2_pay_set_outcaps(basepayload)) {
+            gst_buffer_unref(outbuf);
+            ret = GST_FLOW_NOT_NEGOTIATED;
+            break;
+          }
         }
         gst_buffer_unref(outbuf);
 
+        if (rtpvc2pay->seq_hdr == NULL) {
+          GST_WARNING_OBJECT (rtpvc2pay, "invalid or unsupported sequence header");
+          break;
+        }
+
+        gst_rtp_vc2_pay_update_rtptime(rtpvc2pay, rtpvc2pay->rtptime_last_picture + 1, GST_CLOCK_TIME_NONE);
         ret = gst_rtp_vc2_pay_payload_seqhdr(basepayload, rtpvc2pay->dts, rtpvc2pay->pts);
       }
       break;
     case GSTRTPVC2PAYPARSECODE_AUXILIARY_DATA:
     case GSTRTPVC2PAYPARSECODE_PADDING_DATA:
       {
+        VC2_STATS_ADD (rtpvc2pay->stats_dropped_aux_bytes, info.next_parse_offset);
         gst_adapter_flush(rtpvc2pay->adapter, info.next_parse_offset);
         rtpvc2pay->storedsize -= info.next_parse_offset;
       }
       break;
     case GSTRTPVC2PAYPARSECODE_HQ_PICTURE:
+    case GSTRTPVC2PAYPARSECODE_LD_PICTURE:
       {
+        guint8 picture_number[4];
+
         gst_adapter_flush(rtpvc2pay->adapter, 13);
         GstBuffer *outbuf = gst_adapter_take_buffer_fast (rtpvc2pay->adapter, info.next_parse_offset - 13);
         rtpvc2pay->storedsize -= info.next_parse_offset;
@@ -359,7 +716,50 @@ gst_rtp_vc2_pay_handle_buffer (GstRTPBasePayload * basepayload,
         rtpvc2pay->pts = GST_BUFFER_PTS (outbuf);
         rtpvc2pay->dts = GST_BUFFER_DTS (outbuf);
 
-        ret = gst_rtp_vc2_pay_payload_hqpicture(basepayload, outbuf);
+        if (rtpvc2pay->seq_hdr == NULL) {
+          GST_DEBUG_OBJECT (rtpvc2pay, "no sequence header yet, dropping picture");
+          VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+          VC2_PROBE2 (pay_picture_dropped, -1, "no-sequence-header");
+          gst_buffer_unref(outbuf);
+          break;
+        }
+
+        if (gst_buffer_extract(outbuf, 0, picture_number, 4) == 4) {
+          guint32 number = GST_READ_UINT32_BE (picture_number);
+
+          VC2_PROBE3 (pay_picture, number, gst_buffer_get_size (outbuf), rtpvc2pay->pts);
+          gst_rtp_vc2_pay_update_rtptime(rtpvc2pay, number, rtpvc2pay->pts);
+
+          /* Pictures are dropped before a sequence header is sent or counted
+           * for them. Dropping the whole picture here costs nothing, whereas
+           * a picture missing some of its packets is broken for the
+           * receiver. */
+          if (gst_rtp_vc2_pay_picture_is_decimated(rtpvc2pay, number)) {
+            gst_buffer_unref(outbuf);
+            break;
+          }
+          if (gst_rtp_vc2_pay_picture_is_late(rtpvc2pay, rtpvc2pay->pts)) {
+            VC2_PROBE2 (pay_picture_dropped, number, "qos");
+            gst_buffer_unref(outbuf);
+            break;
+          }
+        }
+
+        if (gst_rtp_vc2_pay_seqhdr_due(rtpvc2pay, rtpvc2pay->pts)) {
+          GST_LOG_OBJECT (rtpvc2pay, "repeating sequence header");
+          ret = gst_rtp_vc2_pay_payload_seqhdr(basepayload, rtpvc2pay->dts, rtpvc2pay->pts);
+          if (ret != GST_FLOW_OK) {
+            gst_buffer_unref(outbuf);
+            break;
+          }
+        }
+        if (rtpvc2pay->pictures_since_config < G_MAXUINT)
+          rtpvc2pay->pictures_since_config++;
+
+        if (info.parse_code == GSTRTPVC2PAYPARSECODE_HQ_PICTURE)
+          ret = gst_rtp_vc2_pay_payload_hqpicture(basepayload, outbuf);
+        else
+          ret = gst_rtp_vc2_pay_payload_ldpicture(basepayload, outbuf);
       }
       break;
     case GSTRTPVC2PAYPARSECODE_END_OF_SEQUENCE:
@@ -420,16 +820,20 @@ gst_rtp_vc2_buffer_new_allocate (GstRTPBasePayload *payload,
   return outbuf;
 }
 
+/* Builds a picture fragment. The two 16 bit fields after the picture number
+ * are the slice prefix bytes and slice size scalar for HQ fragments and the
+ * slice bytes numerator and denominator for LD ones. */
 static GstBuffer *
-gst_rtp_vc2_hq_picture_buffer_new_with_data(GstRTPBasePayload *payload,
-                                            guint32 picture_number,
-                                            guint16 slice_prefix_bytes,
-                                            guint16 slice_size_scaler,
-                                            guint8 *data,
-                                            gsize size,
-                                            gint n_slices,
-                                            gint slice_x,
-                                            gint slice_y) {
+gst_rtp_vc2_picture_buffer_new_with_data(GstRTPBasePayload *payload,
+                                         guint8 fragment_code,
+                                         guint32 picture_number,
+                                         guint16 slice_param_a,
+                                         guint16 slice_param_b,
+                                         guint8 *data,
+                                         gsize size,
+                                         gint n_slices,
+                                         gint slice_x,
+                                         gint slice_y) {
   GstBuffer *outbuf;
   GstBuffer *hdrbuf;
   GstRtpVC2Pay *rtpvc2pay;
@@ -444,7 +848,7 @@ gst_rtp_vc2_hq_picture_buffer_new_with_data(GstRTPBasePayload *payload,
 
   hdr_length = (n_slices == 0)?(12):(16);
 
-  outbuf = gst_rtp_vc2_buffer_new_allocate(payload, 0xEC, interlace, second_field);
+  outbuf = gst_rtp_vc2_buffer_new_allocate(payload, fragment_code, interlace, second_field);
   hdrbuf = gst_buffer_new_allocate(NULL, hdr_length + size, NULL);
 
   if (!gst_buffer_map(hdrbuf, &info, GST_MAP_WRITE))
@@ -454,10 +858,10 @@ gst_rtp_vc2_hq_picture_buffer_new_with_data(GstRTPBasePayload *payload,
   info.data[ 1] = (picture_number >> 16)&0xFF;
   info.data[ 2] = (picture_number >>  8)&0xFF;
   info.data[ 3] = (picture_number >>  0)&0xFF;
-  info.data[ 4] = (slice_prefix_bytes >> 16)&0xFF;
-  info.data[ 5] = (slice_prefix_bytes >>  0)&0xFF;
-  info.data[ 6] = (slice_size_scaler >> 16)&0xFF;
-  info.data[ 7] = (slice_size_scaler >>  0)&0xFF;
+  info.data[ 4] = (slice_param_a >>  8)&0xFF;
+  info.data[ 5] = (slice_param_a >>  0)&0xFF;
+  info.data[ 6] = (slice_param_b >>  8)&0xFF;
+  info.data[ 7] = (slice_param_b >>  0)&0xFF;
   info.data[ 8] = (size >>  8)&0xFF;
   info.data[ 9] = (size >>  0)&0xFF;
   info.data[10] = (n_slices >>  8)&0xFF;
@@ -508,6 +912,7 @@ gst_rtp_vc2_payload_push (GstRTPBasePayload *payload,
   GstFlowReturn res;
   GstRTPBuffer rtp;
   guint8 *pld;
+  gsize size;
 
   memset(&rtp, 0, sizeof(GstRTPBuffer));
   rtpvc2pay = GST_RTP_VC2_PAY (payload);
@@ -523,7 +928,16 @@ gst_rtp_vc2_payload_push (GstRTPBasePayload *payload,
   pld[1] = (rtpvc2pay->next_ext_seq_num >> 0)&0xFF;
   gst_rtp_buffer_unmap(&rtp);
 
+  /* The base class makes the RTP timestamp from the offset when there is one */
+  if (rtpvc2pay->rtptime_offset != GST_BUFFER_OFFSET_NONE)
+    GST_BUFFER_OFFSET (buffer) = rtpvc2pay->rtptime_offset;
+
+  size = gst_buffer_get_size (buffer);
+  VC2_STATS_INC (rtpvc2pay->stats_packets);
+  VC2_STATS_ADD (rtpvc2pay->stats_bytes, size);
+
   res = gst_rtp_base_payload_push(payload, buffer);
+  VC2_PROBE3 (pay_packet_pushed, (rtpvc2pay->next_ext_seq_num << 16) | payload->seqnum, size, res);
   if (payload->priv->next_seqnum == 0) {
     rtpvc2pay->next_ext_seq_num++;
   }
@@ -546,6 +960,10 @@ gst_rtp_vc2_pay_payload_seqhdr(GstRTPBasePayload * basepayload, GstClockTime dts
 
   outbuf = gst_buffer_append (outbuf, gst_buffer_ref(rtpvc2pay->seq_hdr->buf));
 
+  rtpvc2pay->last_config = pts;
+  rtpvc2pay->pictures_since_config = 0;
+  VC2_STATS_INC (rtpvc2pay->stats_sequence_headers);
+
   return gst_rtp_vc2_payload_push(basepayload, outbuf);
 }
 
@@ -563,110 +981,687 @@ gst_rtp_vc2_pay_payload_eos(GstRTPBasePayload * basepayload, GstClockTime dts, G
   return gst_rtp_vc2_payload_push(basepayload, outbuf);
 }
 
+/* Fills rtpvc2pay->slice_offsets with the offset of every slice in the picture
+ * relative to the first one, followed by the offset of the end of the last
+ * slice. The index is taken from a GstVC2SliceIndexMeta on the buffer when
+ * there is a usable one, otherwise every slice header is walked. */
+static gboolean
+gst_rtp_vc2_pay_index_slices(GstRtpVC2Pay *rtpvc2pay, GstBuffer *buffer, vc2_hq_transform_parameters *params,
+                             guint8 *data, gsize size, gsize slice_data_offset) {
+  GstVC2SliceIndexMeta *meta;
+  guint n_slices, i;
+  gsize offs, slice_length;
+
+  /* Every slice takes at least its prefix, qindex and three length bytes, so
+   * this also stops absurd slice counts and prefixes from corrupt parameters */
+  if (params->slices_x == 0 || params->slices_y == 0 || params->slice_prefix_bytes >= size ||
+      (guint64)params->slices_x*params->slices_y > size/((guint64)params->slice_prefix_bytes + 4))
+    return FALSE;
+
+  n_slices = params->slices_x*params->slices_y;
+  if (rtpvc2pay->n_slice_offsets < n_slices + 1) {
+    rtpvc2pay->slice_offsets   = g_renew(guint32, rtpvc2pay->slice_offsets, n_slices + 1);
+    rtpvc2pay->n_slice_offsets = n_slices + 1;
+  }
+
+  meta = gst_buffer_get_vc2_slice_index_meta(buffer);
+  if (meta != NULL &&
+      meta->n_slices           == n_slices &&
+      meta->slices_x           == params->slices_x &&
+      meta->slice_prefix_bytes == params->slice_prefix_bytes &&
+      meta->slice_size_scalar  == params->slice_size_scalar &&
+      meta->slice_data_offset  == slice_data_offset &&
+      meta->slice_offsets[0]   == 0 &&
+      meta->slice_offsets[n_slices] <= size) {
+    for (i = 0; i < n_slices; i++) {
+      if (meta->slice_offsets[i] >= meta->slice_offsets[i + 1])
+        break;
+      rtpvc2pay->slice_offsets[i] = meta->slice_offsets[i];
+    }
+    if (i == n_slices) {
+      rtpvc2pay->slice_offsets[n_slices] = meta->slice_offsets[n_slices];
+      return TRUE;
+    }
+    GST_WARNING_OBJECT (rtpvc2pay, "ignoring inconsistent slice index meta");
+  }
+
+  offs = 0;
+  for (i = 0; i < n_slices; i++) {
+    slice_length = vc2_hq_slice_length(data + offs, size - offs, params->slice_prefix_bytes, params->slice_size_scalar);
+    if (slice_length == 0)
+      return FALSE;
+    rtpvc2pay->slice_offsets[i] = offs;
+    offs += slice_length;
+  }
+  rtpvc2pay->slice_offsets[n_slices] = offs;
+
+  return TRUE;
+}
+
+/* The capture time of a picture is the clock time its PTS corresponds to, or
+ * the current clock time when it has no PTS. It only means something to a
+ * receiver whose pipeline clock is slaved to the same reference as ours. */
+static void
+gst_rtp_vc2_pay_add_capture_time(GstRtpVC2Pay *rtpvc2pay, GstBuffer *outbuf, GstClockTime pts) {
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstClockTime capture_time, running_time;
+  GstSegment *segment;
+  GstClock *clock;
+
+  clock = gst_element_get_clock (GST_ELEMENT (rtpvc2pay));
+  if (clock == NULL)
+    return;
+
+  segment = &GST_RTP_BASE_PAYLOAD (rtpvc2pay)->segment;
+  running_time = GST_CLOCK_TIME_NONE;
+  if (segment->format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (pts))
+    running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+  if (GST_CLOCK_TIME_IS_VALID (running_time))
+    capture_time = running_time + gst_element_get_base_time (GST_ELEMENT (rtpvc2pay));
+  else
+    capture_time = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  if (!gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp))
+    return;
+  if (!gst_rtp_vc2_capture_time_write (&rtp, rtpvc2pay->capture_time_ext_id, capture_time))
+    GST_WARNING_OBJECT (rtpvc2pay, "could not add capture time extension");
+  gst_rtp_buffer_unmap (&rtp);
+}
+
+/* VC-2 HQ is intra only, so any picture can be left out. The choice goes by
+ * picture number so that the two fields of an interlaced frame, which have
+ * consecutive numbers starting from an even one, stay together. */
+static gboolean
+gst_rtp_vc2_pay_picture_is_decimated(GstRtpVC2Pay *rtpvc2pay, guint32 picture_number) {
+  guint32 frame_number;
+
+  if (rtpvc2pay->decimation <= 1)
+    return FALSE;
+
+  frame_number = rtpvc2pay->seq_hdr->interlaced ? picture_number/2 : picture_number;
+  if (frame_number % rtpvc2pay->decimation == 0)
+    return FALSE;
+
+  VC2_STATS_INC (rtpvc2pay->stats_decimated);
+  return TRUE;
+}
+
+/* Returns TRUE when the last QoS event says a picture with this PTS will be
+ * too late downstream, and posts a QoS message about dropping it */
+static gboolean
+gst_rtp_vc2_pay_picture_is_late(GstRtpVC2Pay *rtpvc2pay, GstClockTime pts) {
+  GstSegment *segment = &GST_RTP_BASE_PAYLOAD (rtpvc2pay)->segment;
+  GstClockTime running_time, earliest_time;
+  GstMessage *msg;
+
+  if (!rtpvc2pay->qos || !GST_CLOCK_TIME_IS_VALID (pts) || segment->format != GST_FORMAT_TIME)
+    return FALSE;
+
+  GST_OBJECT_LOCK (rtpvc2pay);
+  earliest_time = rtpvc2pay->earliest_time;
+  GST_OBJECT_UNLOCK (rtpvc2pay);
+
+  if (!GST_CLOCK_TIME_IS_VALID (earliest_time))
+    return FALSE;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time) || running_time > earliest_time)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (rtpvc2pay, "picture at %" GST_TIME_FORMAT " is late, earliest time %" GST_TIME_FORMAT,
+                    GST_TIME_ARGS (running_time), GST_TIME_ARGS (earliest_time));
+
+  VC2_STATS_INC (rtpvc2pay->stats_dropped_qos);
+  msg = gst_message_new_qos (GST_OBJECT (rtpvc2pay), FALSE, running_time,
+      gst_segment_to_stream_time (segment, GST_FORMAT_TIME, pts), pts, GST_CLOCK_TIME_NONE);
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS,
+      VC2_STATS_GET (rtpvc2pay->stats_pictures), VC2_STATS_GET (rtpvc2pay->stats_dropped_qos));
+  gst_element_post_message (GST_ELEMENT (rtpvc2pay), msg);
+
+  return TRUE;
+}
+
+/* Sends the transform parameters, the first packet of a picture */
+static GstFlowReturn
+gst_rtp_vc2_pay_push_params(GstRTPBasePayload * basepayload, guint8 fragment_code, guint32 picture_number,
+                            guint16 slice_param_a, guint16 slice_param_b,
+                            guint8 *data, gsize size, GstClockTime pts, GstClockTime dts) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  GstBuffer *outbuf;
+
+  outbuf = gst_rtp_vc2_picture_buffer_new_with_data(basepayload, fragment_code, picture_number, slice_param_a, slice_param_b,
+                                                    data, size, 0, 0, 0);
+  if (outbuf == NULL)
+    return GST_FLOW_ERROR;
+
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DTS (outbuf) = dts;
+  if (rtpvc2pay->capture_time_ext_id != 0)
+    gst_rtp_vc2_pay_add_capture_time(rtpvc2pay, outbuf, pts);
+  VC2_PROBE4 (pay_packet_built, picture_number, 0, 0, gst_buffer_get_size (outbuf));
+
+  return gst_rtp_vc2_payload_push(basepayload, outbuf);
+}
+
+/* Sends slices first to last - 1 of a picture slices_x slices wide, whose
+ * coded data is size bytes at data. The last packet sent for a picture gets
+ * the marker bit. */
+static GstFlowReturn
+gst_rtp_vc2_pay_push_slices(GstRTPBasePayload * basepayload, guint8 fragment_code, guint32 picture_number,
+                            guint16 slice_param_a, guint16 slice_param_b, guint slices_x,
+                            guint8 *data, gsize size, guint first, guint last, gboolean marker,
+                            GstClockTime pts, GstClockTime dts) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  GstBuffer *outbuf;
+  GstRTPBuffer rtp;
+  gsize packet_size;
+  uint mtu = basepayload->mtu;
+
+  outbuf = gst_rtp_vc2_picture_buffer_new_with_data(basepayload, fragment_code, picture_number,
+                                                    slice_param_a, slice_param_b,
+                                                    data, size,
+                                                    last - first,
+                                                    first % slices_x,
+                                                    first / slices_x);
+  if (outbuf == NULL)
+    return GST_FLOW_ERROR;
+
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DTS (outbuf) = dts;
+
+  packet_size = gst_buffer_get_size (outbuf);
+  VC2_STATS_INC (rtpvc2pay->stats_slice_packets);
+  VC2_STATS_ADD (rtpvc2pay->stats_slice_bytes, packet_size);
+  VC2_STATS_ADD (rtpvc2pay->stats_slice_mtu, mtu);
+  VC2_STATS_MAX (rtpvc2pay->stats_max_fill_ppm, (guint64) packet_size*1000000/mtu);
+  VC2_PROBE4 (pay_packet_built, picture_number, first, last - first, packet_size);
+
+  if (marker) {
+    memset(&rtp, 0, sizeof(rtp));
+    gst_rtp_buffer_map(outbuf, GST_MAP_WRITE, &rtp);
+    gst_rtp_buffer_set_marker(&rtp, TRUE);
+    gst_rtp_buffer_unmap(&rtp);
+  }
+
+  return gst_rtp_vc2_payload_push(basepayload, outbuf);
+}
+
+static void
+gst_rtp_vc2_pay_set_packet(GstRtpVC2Pay *rtpvc2pay, guint n, guint first_slice, gsize offset) {
+  if (rtpvc2pay->n_packets_alloc < n + 1) {
+    rtpvc2pay->n_packets_alloc = MAX (2*rtpvc2pay->n_packets_alloc, n + 1);
+    rtpvc2pay->packets         = g_renew(GstRtpVC2PayPacket, rtpvc2pay->packets, rtpvc2pay->n_packets_alloc);
+  }
+  rtpvc2pay->packets[n].first_slice = first_slice;
+  rtpvc2pay->packets[n].offset      = offset;
+}
+
+/* Plans the slice packets of a picture n_slices slices in all and slices_x
+ * across, the slices starting at offsets from the start of the slice data,
+ * into rtpvc2pay->packets. Returns the number of packets. A slice too big
+ * for a packet on its own still goes out, in an over-size packet, but is
+ * counted and warned about. */
+static guint
+gst_rtp_vc2_pay_plan_packets(GstRtpVC2Pay *rtpvc2pay, guint32 picture_number, const guint32 *offsets,
+                             guint n_slices, guint slices_x, gsize room) {
+  guint first, last, n, i, n_packets = 0;
+  guint oversized;
+
+  if (rtpvc2pay->n_plan_alloc < n_slices + 1) {
+    rtpvc2pay->plan         = g_renew(guint, rtpvc2pay->plan, n_slices + 1);
+    rtpvc2pay->n_plan_alloc = n_slices + 1;
+  }
+
+  for (first = 0; first < n_slices; first = last) {
+    last = (rtpvc2pay->row_aligned && slices_x > 0) ? MIN (first + slices_x, n_slices) : n_slices;
+    n    = vc2_packet_plan(offsets, first, last, room, (vc2_packet_plan_mode) rtpvc2pay->packetization,
+                           rtpvc2pay->plan);
+    for (i = 0; i < n; i++)
+      gst_rtp_vc2_pay_set_packet(rtpvc2pay, n_packets++, rtpvc2pay->plan[i], offsets[rtpvc2pay->plan[i]]);
+  }
+  gst_rtp_vc2_pay_set_packet(rtpvc2pay, n_packets, n_slices, offsets[n_slices]);
+
+  oversized = vc2_packet_plan_oversized(offsets, 0, n_slices, room);
+  if (oversized > 0) {
+    if (VC2_STATS_GET (rtpvc2pay->stats_oversized_slices) == 0)
+      GST_ELEMENT_WARNING (rtpvc2pay, STREAM, FORMAT, (NULL),
+          ("picture %u has %u slices too big for the MTU of %u, they are sent in over-size packets",
+           picture_number, oversized, GST_RTP_BASE_PAYLOAD_MTU (rtpvc2pay)));
+    GST_LOG_OBJECT (rtpvc2pay, "picture %u has %u over-size slices", picture_number, oversized);
+    VC2_STATS_ADD (rtpvc2pay->stats_oversized_slices, oversized);
+  }
+
+  return n_packets;
+}
+
+/* Sends the n_packets slice packets in rtpvc2pay->packets, the entry after
+ * the last marking the end of the slices. With interleave set to N they go
+ * out in N passes, pass r sending packets r, r + N, r + 2N and so on, so
+ * that neighbouring parts of the picture leave about a pass apart. Each
+ * fragment says which slice it starts at, so receivers can put them back. */
+static GstFlowReturn
+gst_rtp_vc2_pay_push_packets(GstRTPBasePayload * basepayload, guint8 fragment_code, guint32 picture_number,
+                             guint16 slice_param_a, guint16 slice_param_b, guint slices_x,
+                             guint8 *data, guint n_packets, GstClockTime pts, GstClockTime dts) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  GstRtpVC2PayPacket *packets = rtpvc2pay->packets;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint passes, pass, i, sent = 0;
+
+  passes = CLAMP (rtpvc2pay->interleave, 1, MAX (n_packets, 1));
+  for (pass = 0; pass < passes && ret == GST_FLOW_OK; pass++) {
+    for (i = pass; i < n_packets && ret == GST_FLOW_OK; i += passes) {
+      sent++;
+      ret = gst_rtp_vc2_pay_push_slices(basepayload, fragment_code, picture_number,
+                                        slice_param_a, slice_param_b, slices_x,
+                                        data + packets[i].offset,
+                                        packets[i + 1].offset - packets[i].offset,
+                                        packets[i].first_slice, packets[i + 1].first_slice,
+                                        sent == n_packets, pts, dts);
+    }
+  }
+
+  return ret;
+}
+
 static GstFlowReturn
 gst_rtp_vc2_pay_payload_hqpicture(GstRTPBasePayload * basepayload, GstBuffer *buffer) {
+  GstRtpVC2Pay *rtpvc2pay;
   GstClockTime dts, pts;
   guint32 picture_number;
   GstMapInfo info;
   vc2_hq_transform_parameters* params;
   gssize size;
   gint offset;
-  GstBuffer *outbuf;
   GstFlowReturn ret;
-  gint offset_x, offset_y, slice_x, slice_y, offs;
-  gint n_slices;
+  guint n_slices, n_packets;
+  guint32 *slice_offsets;
   uint mtu;
-  gint slice_length;
-  GstRTPBuffer rtp;
+  GstClockTime start;
 
+  rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
   mtu = basepayload->mtu;
+  start = gst_util_get_timestamp ();
 
   pts = GST_BUFFER_PTS (buffer);
   dts = GST_BUFFER_DTS (buffer);
   size = gst_buffer_get_size(buffer);
 
-  if (size < 5)
+  if (size < 5) {
+    gst_buffer_unref(buffer);
     return GST_FLOW_ERROR;
+  }
 
-  if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+  if (!gst_buffer_map(buffer, &info, GST_MAP_READ)) {
+    gst_buffer_unref(buffer);
     return GST_FLOW_ERROR;
+  }
 
   picture_number = ((info.data[0] << 24) |
                     (info.data[1] << 16) |
                     (info.data[2] <<  8) |
                     (info.data[3] <<  0));
 
-
   params = vc2_hq_transform_parameters_new (info.data + 4, size - 4);
   if (!params) {
+    VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+    VC2_PROBE2 (pay_picture_dropped, picture_number, "bad-transform-parameters");
     gst_buffer_unmap(buffer, &info);
     gst_buffer_unref(buffer);
     return GST_FLOW_ERROR;
   }
 
-  offset = 4;
-  outbuf = gst_rtp_vc2_hq_picture_buffer_new_with_data(basepayload, picture_number, params->slice_prefix_bytes, params->slice_size_scalar,
-                                                       info.data + offset, params->coded_size, 0, 0, 0);
-  GST_BUFFER_PTS (outbuf) = pts;
-  GST_BUFFER_DTS (outbuf) = dts;
-  ret = gst_rtp_vc2_payload_push(basepayload, outbuf);
-  offset += params->coded_size;
-
-  slice_x  = 0;
-  slice_y  = 0;
-  offset_x = 0;
-  offset_y = 0;
-  n_slices = 0;
-  offs = 0;
+  offset = 4 + params->coded_size;
+  if (!gst_rtp_vc2_pay_index_slices(rtpvc2pay, buffer, params, info.data + offset, size - offset, offset)) {
+    GST_WARNING_OBJECT (rtpvc2pay, "corrupt slice data in picture %u, dropping", picture_number);
+    VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+    VC2_PROBE2 (pay_picture_dropped, picture_number, "corrupt-slices");
+    vc2_hq_transform_parameters_free(params);
+    gst_buffer_unmap(buffer, &info);
+    gst_buffer_unref(buffer);
+    return GST_FLOW_OK;
+  }
+  slice_offsets = rtpvc2pay->slice_offsets;
+  n_slices      = params->slices_x*params->slices_y;
 
-  while (ret == GST_FLOW_OK && slice_y < params->slices_y) {
-    slice_length  = info.data[offset + offs + params->slice_prefix_bytes + 1]*params->slice_size_scalar + 2 + params->slice_prefix_bytes;
-    slice_length += info.data[offset + offs + slice_length ]*params->slice_size_scalar + 1;
-    slice_length += info.data[offset + offs + slice_length ]*params->slice_size_scalar + 1;
+  ret = gst_rtp_vc2_pay_push_params(basepayload, GSTRTPVC2PAYPARSECODE_HQ_FRAGMENT, picture_number,
+                                    params->slice_prefix_bytes, params->slice_size_scalar,
+                                    info.data + 4, params->coded_size, pts, dts);
 
-    if (n_slices > 0 && offs + slice_length + 16 > mtu) {
+  n_packets = gst_rtp_vc2_pay_plan_packets(rtpvc2pay, picture_number, slice_offsets, n_slices, params->slices_x,
+                                           (mtu > 16) ? mtu - 16 : 0);
 
-      outbuf = gst_rtp_vc2_hq_picture_buffer_new_with_data(basepayload, picture_number, params->slice_prefix_bytes, params->slice_size_scalar,
-                                                           info.data + offset, offs, n_slices, offset_x, offset_y);
-      GST_BUFFER_PTS (outbuf) = pts;
-      GST_BUFFER_DTS (outbuf) = dts;
-      ret = gst_rtp_vc2_payload_push(basepayload, outbuf);
+  if (ret == GST_FLOW_OK)
+    ret = gst_rtp_vc2_pay_push_packets(basepayload, GSTRTPVC2PAYPARSECODE_HQ_FRAGMENT, picture_number,
+                                       params->slice_prefix_bytes, params->slice_size_scalar,
+                                       params->slices_x, info.data + offset, n_packets, pts, dts);
 
-      offset += offs;
-      offs = 0;
-      n_slices = 0;
-      offset_x = slice_x;
-      offset_y = slice_y;
-    }
+  if (ret == GST_FLOW_OK) {
+    VC2_STATS_INC (rtpvc2pay->stats_pictures);
+    vc2_stats_histogram_add (&rtpvc2pay->stats_picture_time, gst_util_get_timestamp () - start);
+  }
 
-    offs += slice_length;
-    n_slices++;
-    slice_x++;
-    if (slice_x >= params->slices_x) {
-      slice_x = 0;
-      slice_y++;
-    }
+  vc2_hq_transform_parameters_free(params);
+  gst_buffer_unmap(buffer, &info);
+  gst_buffer_unref(buffer);
+  return ret;
+}
+
+/* The LD fragment header has 16 bits each for the slice bytes numerator and
+ * denominator, which often do not fit: encoders tend to give the numerator
+ * as the size of the whole picture. Those packets carry zeros instead, the
+ * values proper are in the transform parameters either way. */
+static void
+gst_rtp_vc2_pay_ld_slice_bytes_fields(vc2_ld_transform_parameters *params, guint16 *numerator, guint16 *denominator) {
+  guint32 n = params->slice_bytes_numerator;
+  guint32 d = params->slice_bytes_denominator;
+  guint32 a = n, b = d, t;
+
+  while (b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
   }
+  n /= a;
+  d /= a;
 
-  if (ret == GST_FLOW_OK && offs > 0) {
-    outbuf = gst_rtp_vc2_hq_picture_buffer_new_with_data(basepayload, picture_number,
-                                                         params->slice_prefix_bytes, params->slice_size_scalar,
-                                                         info.data + offset, offs, n_slices, offset_x, offset_y);
-    GST_BUFFER_PTS (outbuf) = pts;
-    GST_BUFFER_DTS (outbuf) = dts;
-    memset(&rtp, 0, sizeof(rtp));
-    gst_rtp_buffer_map(outbuf, GST_MAP_WRITE, &rtp);
-    gst_rtp_buffer_set_marker(&rtp, TRUE);
-    gst_rtp_buffer_unmap(&rtp);
-    ret = gst_rtp_vc2_payload_push(basepayload, outbuf);
+  *numerator   = (n <= G_MAXUINT16 && d <= G_MAXUINT16) ? n : 0;
+  *denominator = (n <= G_MAXUINT16 && d <= G_MAXUINT16) ? d : 0;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_ldpicture(GstRTPBasePayload * basepayload, GstBuffer *buffer) {
+  GstRtpVC2Pay *rtpvc2pay;
+  GstClockTime dts, pts;
+  guint32 picture_number;
+  GstMapInfo info;
+  vc2_ld_transform_parameters* params;
+  guint16 numerator, denominator;
+  gssize size;
+  gint offset;
+  GstFlowReturn ret;
+  guint n_slices, n_packets, i;
+  uint mtu;
+  GstClockTime start;
+
+  rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  mtu = basepayload->mtu;
+  start = gst_util_get_timestamp ();
+
+  pts = GST_BUFFER_PTS (buffer);
+  dts = GST_BUFFER_DTS (buffer);
+  size = gst_buffer_get_size(buffer);
+
+  if (size < 5) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
   }
 
-  vc2_hq_transform_parameters_free(params);
+  if (!gst_buffer_map(buffer, &info, GST_MAP_READ)) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  picture_number = GST_READ_UINT32_BE (info.data);
+
+  params = vc2_ld_transform_parameters_new (info.data + 4, size - 4);
+  if (!params) {
+    VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+    VC2_PROBE2 (pay_picture_dropped, picture_number, "bad-transform-parameters");
+    gst_buffer_unmap(buffer, &info);
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  offset   = 4 + params->coded_size;
+  n_slices = params->slices_x*params->slices_y;
+  if (vc2_ld_slice_offset(params, n_slices) > (guint64)(size - offset)) {
+    GST_WARNING_OBJECT (rtpvc2pay, "picture %u is shorter than its slices, dropping", picture_number);
+    VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+    VC2_PROBE2 (pay_picture_dropped, picture_number, "corrupt-slices");
+    vc2_ld_transform_parameters_free(params);
+    gst_buffer_unmap(buffer, &info);
+    gst_buffer_unref(buffer);
+    return GST_FLOW_OK;
+  }
+
+  gst_rtp_vc2_pay_ld_slice_bytes_fields(params, &numerator, &denominator);
+  ret = gst_rtp_vc2_pay_push_params(basepayload, GSTRTPVC2PAYPARSECODE_LD_FRAGMENT, picture_number,
+                                    numerator, denominator,
+                                    info.data + 4, params->coded_size, pts, dts);
+
+  /* LD slice sizes follow from the parameters, so the slice offsets are
+   * worked out rather than read from the slices */
+  if (rtpvc2pay->n_slice_offsets < n_slices + 1) {
+    rtpvc2pay->slice_offsets   = g_renew(guint32, rtpvc2pay->slice_offsets, n_slices + 1);
+    rtpvc2pay->n_slice_offsets = n_slices + 1;
+  }
+  for (i = 0; i <= n_slices; i++)
+    rtpvc2pay->slice_offsets[i] = vc2_ld_slice_offset(params, i);
+
+  n_packets = gst_rtp_vc2_pay_plan_packets(rtpvc2pay, picture_number, rtpvc2pay->slice_offsets, n_slices,
+                                           params->slices_x, (mtu > 16) ? mtu - 16 : 0);
+
+  if (ret == GST_FLOW_OK)
+    ret = gst_rtp_vc2_pay_push_packets(basepayload, GSTRTPVC2PAYPARSECODE_LD_FRAGMENT, picture_number,
+                                       numerator, denominator,
+                                       params->slices_x, info.data + offset, n_packets, pts, dts);
+
+  if (ret == GST_FLOW_OK) {
+    VC2_STATS_INC (rtpvc2pay->stats_pictures);
+    vc2_stats_histogram_add (&rtpvc2pay->stats_picture_time, gst_util_get_timestamp () - start);
+  }
+
+  vc2_ld_transform_parameters_free(params);
   gst_buffer_unmap(buffer, &info);
   gst_buffer_unref(buffer);
   return ret;
 }
 
+/* Starts an HQ picture in incremental mode once its parse info, picture
+ * number and transform parameters are in the adapter: sends the transform
+ * parameters and leaves the slices to gst_rtp_vc2_pay_incremental_slices */
+static GstFlowReturn
+gst_rtp_vc2_pay_incremental_start(GstRTPBasePayload * basepayload, GstRtpVC2PayIncrementalResult *result) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  vc2_hq_transform_parameters *params;
+  vc2_parse_info pi;
+  guint8 hdr[13];
+  const guint8 *data;
+  gsize size, header_size;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  *result = GST_RTP_VC2_PAY_INCREMENTAL_NOT_HQ;
+
+  /* Anything that is not an HQ picture we can start on goes the normal way,
+   * which also deals with invalid parse info */
+  gst_adapter_copy(rtpvc2pay->adapter, hdr, 0, 13);
+  if (!vc2_parse_info_read(hdr, 13, &pi) ||
+      pi.parse_code != GSTRTPVC2PAYPARSECODE_HQ_PICTURE ||
+      rtpvc2pay->seq_hdr == NULL ||
+      (pi.next_parse_offset != 0 && pi.next_parse_offset < 13 + 4) ||
+      (rtpvc2pay->max_unit_size != 0 && pi.next_parse_offset > rtpvc2pay->max_unit_size))
+    return GST_FLOW_OK;
+
+  size = MIN (rtpvc2pay->storedsize, 13 + 4 + MAX_TRANSFORM_PARAMETERS_SIZE);
+  if (pi.next_parse_offset != 0)
+    size = MIN (size, pi.next_parse_offset);
+  if (size < 13 + 4 + 1) {
+    *result = GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA;
+    return GST_FLOW_OK;
+  }
+
+  data = gst_adapter_map(rtpvc2pay->adapter, size);
+  params = vc2_hq_transform_parameters_new((guint8 *) data + 13 + 4, size - 13 - 4);
+  if (params == NULL) {
+    gst_adapter_unmap(rtpvc2pay->adapter);
+    if (size < 13 + 4 + MAX_TRANSFORM_PARAMETERS_SIZE && size != pi.next_parse_offset)
+      *result = GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA;
+    return GST_FLOW_OK;
+  }
+
+  *result = GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS;
+
+  rtpvc2pay->inc_picture_number = GST_READ_UINT32_BE (data + 13);
+  rtpvc2pay->pts = gst_adapter_prev_pts(rtpvc2pay->adapter, NULL);
+  rtpvc2pay->dts = gst_adapter_prev_dts(rtpvc2pay->adapter, NULL);
+  VC2_PROBE3 (pay_picture, rtpvc2pay->inc_picture_number, pi.next_parse_offset, rtpvc2pay->pts);
+  gst_rtp_vc2_pay_update_rtptime(rtpvc2pay, rtpvc2pay->inc_picture_number, rtpvc2pay->pts);
+
+  rtpvc2pay->inc_skip = gst_rtp_vc2_pay_picture_is_decimated(rtpvc2pay, rtpvc2pay->inc_picture_number);
+  if (!rtpvc2pay->inc_skip && gst_rtp_vc2_pay_picture_is_late(rtpvc2pay, rtpvc2pay->pts)) {
+    VC2_PROBE2 (pay_picture_dropped, rtpvc2pay->inc_picture_number, "qos");
+    rtpvc2pay->inc_skip = TRUE;
+  }
+  if (!rtpvc2pay->inc_skip) {
+    if (gst_rtp_vc2_pay_seqhdr_due(rtpvc2pay, rtpvc2pay->pts))
+      ret = gst_rtp_vc2_pay_payload_seqhdr(basepayload, rtpvc2pay->dts, rtpvc2pay->pts);
+    if (rtpvc2pay->pictures_since_config < G_MAXUINT)
+      rtpvc2pay->pictures_since_config++;
+    if (ret == GST_FLOW_OK)
+      ret = gst_rtp_vc2_pay_push_params(basepayload, GSTRTPVC2PAYPARSECODE_HQ_FRAGMENT, rtpvc2pay->inc_picture_number,
+                                        params->slice_prefix_bytes, params->slice_size_scalar,
+                                        (guint8 *) data + 13 + 4, params->coded_size,
+                                        rtpvc2pay->pts, rtpvc2pay->dts);
+  }
+  gst_adapter_unmap(rtpvc2pay->adapter);
+
+  header_size = 13 + 4 + params->coded_size;
+  gst_adapter_flush(rtpvc2pay->adapter, header_size);
+  rtpvc2pay->storedsize -= header_size;
+
+  rtpvc2pay->inc_active     = TRUE;
+  rtpvc2pay->inc_params     = params;
+  rtpvc2pay->inc_next_slice = 0;
+  rtpvc2pay->inc_remaining  = (pi.next_parse_offset != 0) ? pi.next_parse_offset - header_size : 0;
+
+  return ret;
+}
+
+/* Sends whatever complete slices of the current picture have arrived. A
+ * packet goes out once it is full or ends a slice row, so nothing waits for
+ * slices from the row below. */
+static GstFlowReturn
+gst_rtp_vc2_pay_incremental_slices(GstRTPBasePayload * basepayload, GstRtpVC2PayIncrementalResult *result) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  vc2_hq_transform_parameters *params = rtpvc2pay->inc_params;
+  guint32 *slice_offsets;
+  const guint8 *data;
+  gsize size, offs, slice_length;
+  guint n_slices, n_complete, first, last, i;
+  uint mtu = basepayload->mtu;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  n_slices = params->slices_x*params->slices_y;
+  size = rtpvc2pay->storedsize;
+  if (rtpvc2pay->inc_remaining != 0)
+    size = MIN (size, rtpvc2pay->inc_remaining);
+
+  data = gst_adapter_map(rtpvc2pay->adapter, size);
+
+  /* Find the slices which are complete, slice_offsets[i] being the offset of
+   * slice inc_next_slice + i */
+  n_complete = 0;
+  offs = 0;
+  for (i = rtpvc2pay->inc_next_slice; i < n_slices; i++) {
+    slice_length = vc2_hq_slice_length(data + offs, size - offs, params->slice_prefix_bytes, params->slice_size_scalar);
+    if (slice_length == 0)
+      break;
+    if (rtpvc2pay->n_slice_offsets < n_complete + 2) {
+      rtpvc2pay->n_slice_offsets = MAX (2*rtpvc2pay->n_slice_offsets, n_complete + 2);
+      rtpvc2pay->slice_offsets   = g_renew(guint32, rtpvc2pay->slice_offsets, rtpvc2pay->n_slice_offsets);
+    }
+    rtpvc2pay->slice_offsets[n_complete++] = offs;
+    offs += slice_length;
+  }
+  if (n_complete > 0)
+    rtpvc2pay->slice_offsets[n_complete] = offs;
+  slice_offsets = rtpvc2pay->slice_offsets;
+
+  /* All of the picture is here and the slices still do not fit in it */
+  if (rtpvc2pay->inc_next_slice + n_complete < n_slices &&
+      rtpvc2pay->inc_remaining != 0 && size == rtpvc2pay->inc_remaining) {
+    GST_WARNING_OBJECT (rtpvc2pay, "corrupt slice data in picture %u, dropping the rest of it", rtpvc2pay->inc_picture_number);
+    VC2_STATS_INC (rtpvc2pay->stats_dropped_pictures);
+    VC2_PROBE2 (pay_picture_dropped, rtpvc2pay->inc_picture_number, "corrupt-slices");
+    gst_adapter_unmap(rtpvc2pay->adapter);
+    gst_adapter_flush(rtpvc2pay->adapter, size);
+    rtpvc2pay->storedsize -= size;
+    gst_rtp_vc2_pay_incremental_reset(rtpvc2pay);
+    *result = GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS;
+    return GST_FLOW_OK;
+  }
+
+  first = 0;
+  while (ret == GST_FLOW_OK && first < n_complete) {
+    last = first + 1;
+    while (last < n_complete && slice_offsets[last + 1] - slice_offsets[first] + 16 <= mtu)
+      last++;
+
+    /* Ran out of slices before the packet was full: wait for more unless
+     * this is the end of a row */
+    if (last == n_complete && (rtpvc2pay->inc_next_slice + last) % params->slices_x != 0 &&
+        rtpvc2pay->inc_next_slice + last != n_slices)
+      break;
+
+    if (!rtpvc2pay->inc_skip)
+      ret = gst_rtp_vc2_pay_push_slices(basepayload, GSTRTPVC2PAYPARSECODE_HQ_FRAGMENT, rtpvc2pay->inc_picture_number,
+                                        params->slice_prefix_bytes, params->slice_size_scalar, params->slices_x,
+                                        (guint8 *) data + slice_offsets[first],
+                                        slice_offsets[last] - slice_offsets[first],
+                                        rtpvc2pay->inc_next_slice + first, rtpvc2pay->inc_next_slice + last,
+                                        rtpvc2pay->inc_next_slice + last == n_slices,
+                                        rtpvc2pay->pts, rtpvc2pay->dts);
+    first = last;
+  }
+  gst_adapter_unmap(rtpvc2pay->adapter);
+
+  if (first == 0) {
+    *result = GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA;
+    return ret;
+  }
+
+  *result = GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS;
+  offs = slice_offsets[first];
+  gst_adapter_flush(rtpvc2pay->adapter, offs);
+  rtpvc2pay->storedsize -= offs;
+  if (rtpvc2pay->inc_remaining != 0)
+    rtpvc2pay->inc_remaining -= offs;
+  rtpvc2pay->inc_next_slice += first;
+
+  return ret;
+}
+
+/* Incremental mode, see the incremental property. Returns NOT_HQ when the
+ * next data unit is to be handled by the normal path. */
+static GstFlowReturn
+gst_rtp_vc2_pay_payload_incremental(GstRTPBasePayload * basepayload, GstRtpVC2PayIncrementalResult *result) {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (basepayload);
+  vc2_hq_transform_parameters *params = rtpvc2pay->inc_params;
+
+  if (!rtpvc2pay->inc_active)
+    return gst_rtp_vc2_pay_incremental_start(basepayload, result);
+
+  if (rtpvc2pay->inc_next_slice < params->slices_x*params->slices_y)
+    return gst_rtp_vc2_pay_incremental_slices(basepayload, result);
+
+  /* Every slice is sent, skip anything left over before the next parse info */
+  if (rtpvc2pay->storedsize < rtpvc2pay->inc_remaining) {
+    *result = GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA;
+    return GST_FLOW_OK;
+  }
+  gst_adapter_flush(rtpvc2pay->adapter, rtpvc2pay->inc_remaining);
+  rtpvc2pay->storedsize -= rtpvc2pay->inc_remaining;
+
+  if (!rtpvc2pay->inc_skip)
+    VC2_STATS_INC (rtpvc2pay->stats_pictures);
+  gst_rtp_vc2_pay_incremental_reset(rtpvc2pay);
+  *result = GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS;
+
+  return GST_FLOW_OK;
+}
+
 
 static gboolean
 gst_rtp_vc2_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
@@ -678,10 +1673,17 @@ gst_rtp_vc2_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
     case GST_EVENT_FLUSH_STOP:
       gst_adapter_clear (rtpvc2pay->adapter);
       rtpvc2pay->storedsize = 0;
+      gst_rtp_vc2_pay_incremental_reset (rtpvc2pay);
+      rtpvc2pay->rtptime_anchored = FALSE;
+      rtpvc2pay->rtptime_offset = GST_BUFFER_OFFSET_NONE;
+      GST_OBJECT_LOCK (rtpvc2pay);
+      rtpvc2pay->earliest_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (rtpvc2pay);
       break;
     case GST_EVENT_EOS:
     {
       gst_rtp_vc2_pay_handle_buffer (payload, NULL);
+      gst_rtp_vc2_pay_incremental_reset (rtpvc2pay);
       break;
     }
     default:
@@ -693,6 +1695,36 @@ gst_rtp_vc2_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
   return res;
 }
 
+static gboolean
+gst_rtp_vc2_pay_src_event (GstRTPBasePayload * payload, GstEvent * event)
+{
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (payload);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_QOS:
+    {
+      GstQOSType type;
+      gdouble proportion;
+      GstClockTimeDiff diff;
+      GstClockTime timestamp;
+
+      gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+
+      GST_OBJECT_LOCK (rtpvc2pay);
+      if (GST_CLOCK_TIME_IS_VALID (timestamp))
+        rtpvc2pay->earliest_time = (diff < 0 && -diff > timestamp) ? 0 : timestamp + diff;
+      else
+        rtpvc2pay->earliest_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (rtpvc2pay);
+      break;
+    }
+    default:
+      break;
+  }
+
+  return GST_RTP_BASE_PAYLOAD_CLASS (parent_class)->src_event (payload, event);
+}
+
 static GstStateChangeReturn
 gst_rtp_vc2_pay_change_state (GstElement * element, GstStateChange transition)
 {
@@ -703,6 +1735,13 @@ gst_rtp_vc2_pay_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       gst_adapter_clear (rtpvc2pay->adapter);
       rtpvc2pay->storedsize = 0;
+      rtpvc2pay->last_config = GST_CLOCK_TIME_NONE;
+      rtpvc2pay->pictures_since_config = G_MAXUINT;
+      rtpvc2pay->earliest_time = GST_CLOCK_TIME_NONE;
+      rtpvc2pay->rtptime_anchored = FALSE;
+      rtpvc2pay->rtptime_offset = GST_BUFFER_OFFSET_NONE;
+      gst_rtp_vc2_pay_incremental_reset (rtpvc2pay);
+      gst_rtp_vc2_pay_reset_stats (rtpvc2pay);
       break;
     default:
       break;
@@ -713,11 +1752,75 @@ gst_rtp_vc2_pay_change_state (GstElement * element, GstStateChange transition)
   return ret;
 }
 
+static GstStructure *
+gst_rtp_vc2_pay_get_stats (GstRtpVC2Pay * rtpvc2pay)
+{
+  guint64 slice_mtu = VC2_STATS_GET (rtpvc2pay->stats_slice_mtu);
+  GstStructure *s;
+
+  s = gst_structure_new ("application/x-rtp-vc2-pay-stats",
+      "pictures",          G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_pictures),
+      "packets",           G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_packets),
+      "bytes",             G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_bytes),
+      "packet-fill-mean",  G_TYPE_DOUBLE, (slice_mtu > 0) ?
+          (gdouble) VC2_STATS_GET (rtpvc2pay->stats_slice_bytes)/slice_mtu : 0.0,
+      "packet-fill-max",   G_TYPE_DOUBLE,
+          (gdouble) VC2_STATS_GET (rtpvc2pay->stats_max_fill_ppm)/1000000,
+      "sequence-headers",  G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_sequence_headers),
+      "resyncs",           G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_resyncs),
+      "dropped-pictures",  G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_dropped_pictures),
+      "dropped-aux-bytes", G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_dropped_aux_bytes),
+      "dropped-qos",       G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_dropped_qos),
+      "decimated",         G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_decimated),
+      "oversized-slices",  G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_oversized_slices),
+      "rtptime-anchors",   G_TYPE_UINT64, VC2_STATS_GET (rtpvc2pay->stats_rtptime_anchors),
+      NULL);
+  vc2_stats_histogram_append (&rtpvc2pay->stats_picture_time, s, "picture-time");
+  vc2_stats_merge_parent (G_OBJECT (rtpvc2pay), parent_class, s);
+
+  return s;
+}
+
 static void
 gst_rtp_vc2_pay_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (object);
+
   switch (prop_id) {
+    case PROP_CONFIG_INTERVAL:
+      rtpvc2pay->config_interval = g_value_get_int (value);
+      break;
+    case PROP_CONFIG_INTERVAL_PICTURES:
+      rtpvc2pay->config_interval_pictures = g_value_get_uint (value);
+      break;
+    case PROP_CAPTURE_TIME_EXT_ID:
+      rtpvc2pay->capture_time_ext_id = g_value_get_uint (value);
+      break;
+    case PROP_QOS:
+      rtpvc2pay->qos = g_value_get_boolean (value);
+      break;
+    case PROP_INCREMENTAL:
+      rtpvc2pay->incremental = g_value_get_boolean (value);
+      break;
+    case PROP_DECIMATION:
+      rtpvc2pay->decimation = g_value_get_uint (value);
+      break;
+    case PROP_MAX_UNIT_SIZE:
+      rtpvc2pay->max_unit_size = g_value_get_uint (value);
+      break;
+    case PROP_INTERLEAVE:
+      rtpvc2pay->interleave = g_value_get_uint (value);
+      break;
+    case PROP_PACKETIZATION:
+      rtpvc2pay->packetization = g_value_get_enum (value);
+      break;
+    case PROP_ROW_ALIGNED:
+      rtpvc2pay->row_aligned = g_value_get_boolean (value);
+      break;
+    case PROP_FRAME_RATE_TIMESTAMPS:
+      rtpvc2pay->frame_rate_timestamps = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -728,7 +1831,45 @@ static void
 gst_rtp_vc2_pay_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstRtpVC2Pay *rtpvc2pay = GST_RTP_VC2_PAY (object);
+
   switch (prop_id) {
+    case PROP_CONFIG_INTERVAL:
+      g_value_set_int (value, rtpvc2pay->config_interval);
+      break;
+    case PROP_CONFIG_INTERVAL_PICTURES:
+      g_value_set_uint (value, rtpvc2pay->config_interval_pictures);
+      break;
+    case PROP_CAPTURE_TIME_EXT_ID:
+      g_value_set_uint (value, rtpvc2pay->capture_time_ext_id);
+      break;
+    case PROP_QOS:
+      g_value_set_boolean (value, rtpvc2pay->qos);
+      break;
+    case PROP_INCREMENTAL:
+      g_value_set_boolean (value, rtpvc2pay->incremental);
+      break;
+    case PROP_DECIMATION:
+      g_value_set_uint (value, rtpvc2pay->decimation);
+      break;
+    case PROP_MAX_UNIT_SIZE:
+      g_value_set_uint (value, rtpvc2pay->max_unit_size);
+      break;
+    case PROP_INTERLEAVE:
+      g_value_set_uint (value, rtpvc2pay->interleave);
+      break;
+    case PROP_PACKETIZATION:
+      g_value_set_enum (value, rtpvc2pay->packetization);
+      break;
+    case PROP_ROW_ALIGNED:
+      g_value_set_boolean (value, rtpvc2pay->row_aligned);
+      break;
+    case PROP_FRAME_RATE_TIMESTAMPS:
+      g_value_set_boolean (value, rtpvc2pay->frame_rate_timestamps);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rtp_vc2_pay_get_stats (rtpvc2pay));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
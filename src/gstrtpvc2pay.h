@@ -25,6 +25,8 @@
 #include <gst/rtp/gstrtpbasepayload.h>
 
 #include "vc2vlcparse.h"
+#include "vc2stats.h"
+#include "vc2packetplan.h"
 
 G_BEGIN_DECLS
 
@@ -42,8 +44,6 @@ G_BEGIN_DECLS
 typedef struct _GstRtpVC2Pay GstRtpVC2Pay;
 typedef struct _GstRtpVC2PayClass GstRtpVC2PayClass;
 
-typedef struct _GstRtpVC2PayParseInfo GstRtpVC2PayParseInfo;
-
 enum _GstRtpVC2PayState {
   GSTRTPVC2PAYSTATE_UNSYNC = 0,
   GSTRTPVC2PAYSTATE_SYNC   = 1,
@@ -51,6 +51,24 @@ enum _GstRtpVC2PayState {
 
 typedef enum _GstRtpVC2PayState GstRtpVC2PayState;
 
+/* Where one slice packet of a picture starts: its first slice and the offset
+ * of that slice from the first slice of the picture */
+typedef struct {
+  guint first_slice;
+  gsize offset;
+} GstRtpVC2PayPacket;
+
+typedef enum {
+  GST_RTP_VC2_PAY_PACKETIZATION_GREEDY   = VC2_PACKET_PLAN_GREEDY,
+  GST_RTP_VC2_PAY_PACKETIZATION_BALANCED = VC2_PACKET_PLAN_BALANCED,
+} GstRtpVC2PayPacketization;
+
+typedef enum {
+  GST_RTP_VC2_PAY_INCREMENTAL_NOT_HQ,
+  GST_RTP_VC2_PAY_INCREMENTAL_NEED_DATA,
+  GST_RTP_VC2_PAY_INCREMENTAL_PROGRESS,
+} GstRtpVC2PayIncrementalResult;
+
 struct _GstRtpVC2Pay
 {
   GstRTPBasePayload payload;
@@ -64,6 +82,74 @@ struct _GstRtpVC2Pay
   guint16 next_ext_seq_num;
   GstClockTime dts;
   GstClockTime pts;
+
+  gint config_interval;
+  GstClockTime last_config;
+  guint config_interval_pictures;
+  guint pictures_since_config;
+
+  guint capture_time_ext_id;
+  guint decimation;
+  guint max_unit_size;
+
+  /* RTP timestamps from the frame rate: pictures are counted on from the
+   * anchor picture, whose RTP clock offset came from its timestamp, and
+   * rtptime_offset is what goes on the packets being sent */
+  gboolean frame_rate_timestamps;
+  gboolean rtptime_anchored;
+  gboolean rtptime_discont;
+  guint32  rtptime_anchor_picture;
+  guint64  rtptime_anchor_offset;
+  guint32  rtptime_last_picture;
+  guint64  rtptime_period_numer;
+  guint64  rtptime_period_denom;
+  guint64  rtptime_offset;
+
+  /* QoS, earliest_time is protected by the object lock */
+  gboolean qos;
+  GstClockTime earliest_time;
+
+  guint32 *slice_offsets;
+  guint n_slice_offsets;
+
+  /* the slice packets of the picture being sent, in raster order, and the
+   * scratch space used to plan them */
+  GstRtpVC2PayPacketization packetization;
+  gboolean row_aligned;
+  guint interleave;
+  GstRtpVC2PayPacket *packets;
+  guint n_packets_alloc;
+  guint *plan;
+  guint n_plan_alloc;
+
+  /* Incremental mode: the HQ picture being sent as its slices arrive.
+   * inc_remaining is the number of bytes of it still to come, or 0 when its
+   * parse info did not say how long it is. */
+  gboolean incremental;
+  gboolean inc_active;
+  gboolean inc_skip;
+  guint32 inc_picture_number;
+  vc2_hq_transform_parameters *inc_params;
+  guint inc_next_slice;
+  gsize inc_remaining;
+
+  /* statistics, updated with VC2_STATS_* */
+  guint64 stats_pictures;
+  guint64 stats_packets;
+  guint64 stats_bytes;
+  guint64 stats_slice_packets;
+  guint64 stats_slice_bytes;
+  guint64 stats_slice_mtu;
+  guint64 stats_max_fill_ppm;
+  guint64 stats_sequence_headers;
+  guint64 stats_resyncs;
+  guint64 stats_dropped_pictures;
+  guint64 stats_dropped_aux_bytes;
+  guint64 stats_dropped_qos;
+  guint64 stats_decimated;
+  guint64 stats_oversized_slices;
+  guint64 stats_rtptime_anchors;
+  vc2_stats_histogram stats_picture_time;
 };
 
 struct _GstRtpVC2PayClass
@@ -76,13 +162,12 @@ enum _GstRtpVC2PayParseCode {
   GSTRTPVC2PAYPARSECODE_END_OF_SEQUENCE = 0x10,
   GSTRTPVC2PAYPARSECODE_AUXILIARY_DATA  = 0x20,
   GSTRTPVC2PAYPARSECODE_PADDING_DATA    = 0x30,
+  GSTRTPVC2PAYPARSECODE_LD_PICTURE      = 0xC8,
+  /* not in RFC 8450, which has no LD fragment: a private extension that
+   * only rtpvc2depay understands */
+  GSTRTPVC2PAYPARSECODE_LD_FRAGMENT     = 0xCC,
   GSTRTPVC2PAYPARSECODE_HQ_PICTURE      = 0xE8,
-};
-
-struct _GstRtpVC2PayParseInfo {
-  unsigned char parse_code;
-  unsigned int next_parse_offset;
-  unsigned int prev_parse_offset;
+  GSTRTPVC2PAYPARSECODE_HQ_FRAGMENT     = 0xEC,
 };
 
 GType gst_rtp_vc2_pay_get_type (void);
@@ -0,0 +1,483 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "gstrtpvc2repay.h"
+#include "vc2vlcparse.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtpvc2repay_debug);
+#define GST_CAT_DEFAULT (rtpvc2repay_debug)
+
+/* Re-fragments VC2 RTP packets for a different MTU without reassembling the
+ * pictures. Slices from the incoming HQ fragments are shared into the
+ * outgoing packets, so at most one picture's worth of input is held and no
+ * picture data is copied. */
+
+static GstStaticPadTemplate gst_rtp_vc2_repay_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+        "media = (string) \"video\", "
+        "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
+    );
+
+static GstStaticPadTemplate gst_rtp_vc2_repay_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+        "media = (string) \"video\", "
+        "payload = (int) " GST_RTP_PAYLOAD_DYNAMIC_STRING ", "
+        "clock-rate = (int) 90000, " "encoding-name = (string) \"VC2\"")
+    );
+
+static void gst_rtp_vc2_repay_finalize (GObject * object);
+
+static gboolean gst_rtp_vc2_repay_setcaps (GstRTPBasePayload * basepayload,
+    GstCaps * caps);
+static GstFlowReturn gst_rtp_vc2_repay_handle_buffer (GstRTPBasePayload *
+    basepayload, GstBuffer * buffer);
+static gboolean gst_rtp_vc2_repay_sink_event (GstRTPBasePayload * payload,
+    GstEvent * event);
+static GstStateChangeReturn gst_rtp_vc2_repay_change_state (GstElement *
+    element, GstStateChange transition);
+
+#define gst_rtp_vc2_repay_parent_class parent_class
+G_DEFINE_TYPE (GstRtpVC2Repay, gst_rtp_vc2_repay, GST_TYPE_RTP_BASE_PAYLOAD);
+
+static void
+gst_rtp_vc2_repay_class_init (GstRtpVC2RepayClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstRTPBasePayloadClass *gstrtpbasepayload_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstrtpbasepayload_class = (GstRTPBasePayloadClass *) klass;
+
+  gobject_class->finalize = gst_rtp_vc2_repay_finalize;
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_repay_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_rtp_vc2_repay_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "RTP VC2 repayloader", "Codec/Payloader/Network/RTP",
+      "Re-fragments VC2 RTP packets for a different MTU without depayloading",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_rtp_vc2_repay_change_state);
+
+  gstrtpbasepayload_class->set_caps = gst_rtp_vc2_repay_setcaps;
+  gstrtpbasepayload_class->handle_buffer = gst_rtp_vc2_repay_handle_buffer;
+  gstrtpbasepayload_class->sink_event = gst_rtp_vc2_repay_sink_event;
+
+  GST_DEBUG_CATEGORY_INIT (rtpvc2repay_debug, "rtpvc2repay", 0,
+      "VC2 RTP Repayloader");
+}
+
+static void
+gst_rtp_vc2_repay_reset (GstRtpVC2Repay * rtpvc2repay)
+{
+  gst_buffer_replace (&rtpvc2repay->pending, NULL);
+
+  rtpvc2repay->in_picture     = FALSE;
+  rtpvc2repay->picture_number = 0;
+  rtpvc2repay->slices_x       = 0;
+  rtpvc2repay->field_flags    = 0;
+  rtpvc2repay->pts            = GST_CLOCK_TIME_NONE;
+  rtpvc2repay->dts            = GST_CLOCK_TIME_NONE;
+
+  rtpvc2repay->pending_size         = 0;
+  rtpvc2repay->pending_slices       = 0;
+  rtpvc2repay->pending_first        = 0;
+  rtpvc2repay->pending_prefix_bytes = 0;
+  rtpvc2repay->pending_size_scalar  = 0;
+}
+
+static void
+gst_rtp_vc2_repay_init (GstRtpVC2Repay * rtpvc2repay)
+{
+  rtpvc2repay->next_ext_seq_num = 0;
+  rtpvc2repay->pending = NULL;
+
+  gst_rtp_vc2_repay_reset (rtpvc2repay);
+}
+
+static void
+gst_rtp_vc2_repay_finalize (GObject * object)
+{
+  GstRtpVC2Repay *rtpvc2repay = GST_RTP_VC2_REPAY (object);
+
+  gst_buffer_replace (&rtpvc2repay->pending, NULL);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_rtp_vc2_repay_setcaps (GstRTPBasePayload * basepayload, GstCaps * caps)
+{
+  GstStructure *structure = gst_caps_get_structure (caps, 0);
+  const gchar *seqhdr;
+
+  gst_rtp_base_payload_set_options (basepayload, "video", TRUE, "VC2", 90000);
+
+  /* Keep passing on an out of band sequence header */
+  seqhdr = gst_structure_get_string (structure, "sequence-header");
+  if (seqhdr != NULL)
+    return gst_rtp_base_payload_set_outcaps (basepayload,
+        "sequence-header", G_TYPE_STRING, seqhdr, NULL);
+
+  return gst_rtp_base_payload_set_outcaps (basepayload, NULL);
+}
+
+/* Sends a packet made of the given payload header followed by data. The
+ * header is written into the same memory as the RTP header so the data,
+ * which is shared with the input packets, never has to be mapped. */
+static GstFlowReturn
+gst_rtp_vc2_repay_push (GstRtpVC2Repay * rtpvc2repay, const guint8 * header,
+    guint header_len, GstBuffer * data, gboolean marker, GstClockTime pts,
+    GstClockTime dts)
+{
+  GstRTPBasePayload *basepayload = GST_RTP_BASE_PAYLOAD (rtpvc2repay);
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+  guint8 *pld;
+
+  outbuf = gst_rtp_buffer_new_allocate (header_len, 0, 0);
+  if (!gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp)) {
+    gst_buffer_unref (outbuf);
+    if (data)
+      gst_buffer_unref (data);
+    return GST_FLOW_ERROR;
+  }
+
+  pld = gst_rtp_buffer_get_payload (&rtp);
+  memcpy (pld, header, header_len);
+  pld[0] = (rtpvc2repay->next_ext_seq_num >> 8)&0xFF;
+  pld[1] = (rtpvc2repay->next_ext_seq_num >> 0)&0xFF;
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (data)
+    outbuf = gst_buffer_append (outbuf, data);
+
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DTS (outbuf) = dts;
+
+  ret = gst_rtp_base_payload_push (basepayload, outbuf);
+
+  /* seqnum is the last sequence number used, once it wraps the extended
+   * sequence number moves on */
+  if (basepayload->seqnum == 0xFFFF)
+    rtpvc2repay->next_ext_seq_num++;
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_repay_flush_pending (GstRtpVC2Repay * rtpvc2repay, gboolean marker)
+{
+  guint8 header[20];
+  guint slice_x, slice_y;
+  GstBuffer *data;
+
+  if (rtpvc2repay->pending == NULL)
+    return GST_FLOW_OK;
+
+  slice_x = rtpvc2repay->pending_first % rtpvc2repay->slices_x;
+  slice_y = rtpvc2repay->pending_first / rtpvc2repay->slices_x;
+
+  header[ 0] = 0x00;
+  header[ 1] = 0x00;
+  header[ 2] = rtpvc2repay->field_flags;
+  header[ 3] = 0xEC;
+  header[ 4] = (rtpvc2repay->picture_number >> 24)&0xFF;
+  header[ 5] = (rtpvc2repay->picture_number >> 16)&0xFF;
+  header[ 6] = (rtpvc2repay->picture_number >>  8)&0xFF;
+  header[ 7] = (rtpvc2repay->picture_number >>  0)&0xFF;
+  header[ 8] = (rtpvc2repay->pending_prefix_bytes >> 8)&0xFF;
+  header[ 9] = (rtpvc2repay->pending_prefix_bytes >> 0)&0xFF;
+  header[10] = (rtpvc2repay->pending_size_scalar >> 8)&0xFF;
+  header[11] = (rtpvc2repay->pending_size_scalar >> 0)&0xFF;
+  header[12] = (rtpvc2repay->pending_size >> 8)&0xFF;
+  header[13] = (rtpvc2repay->pending_size >> 0)&0xFF;
+  header[14] = (rtpvc2repay->pending_slices >> 8)&0xFF;
+  header[15] = (rtpvc2repay->pending_slices >> 0)&0xFF;
+  header[16] = (slice_x >> 8)&0xFF;
+  header[17] = (slice_x >> 0)&0xFF;
+  header[18] = (slice_y >> 8)&0xFF;
+  header[19] = (slice_y >> 0)&0xFF;
+
+  data = rtpvc2repay->pending;
+  rtpvc2repay->pending        = NULL;
+  rtpvc2repay->pending_size   = 0;
+  rtpvc2repay->pending_slices = 0;
+
+  return gst_rtp_vc2_repay_push (rtpvc2repay, header, 20, data, marker,
+      rtpvc2repay->pts, rtpvc2repay->dts);
+}
+
+static void
+gst_rtp_vc2_repay_append (GstRtpVC2Repay * rtpvc2repay, GstBuffer * buffer,
+    gsize offset, gsize size, guint n_slices, guint first)
+{
+  GstBuffer *region;
+
+  if (n_slices == 0)
+    return;
+
+  region = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, offset, size);
+  if (rtpvc2repay->pending == NULL) {
+    rtpvc2repay->pending       = region;
+    rtpvc2repay->pending_first = first;
+  } else {
+    rtpvc2repay->pending = gst_buffer_append (rtpvc2repay->pending, region);
+  }
+  rtpvc2repay->pending_size   += size;
+  rtpvc2repay->pending_slices += n_slices;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_repay_process_hq_fragment (GstRtpVC2Repay * rtpvc2repay,
+    GstBuffer * buffer, guint8 * payload, guint payload_offset, guint length,
+    gboolean M)
+{
+  GstRTPBasePayload *basepayload = GST_RTP_BASE_PAYLOAD (rtpvc2repay);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint32 picture_number;
+  guint16 prefix_bytes, size_scalar;
+  guint fragment_length, no_slices, slice_x, slice_y, first;
+  guint run_slices, i;
+  gsize offs, run, slice_length, max_size;
+
+  if (length < 16)
+    return GST_FLOW_OK;
+
+  picture_number  = ((payload[4] << 24) |
+                     (payload[5] << 16) |
+                     (payload[6] <<  8) |
+                     (payload[7] <<  0));
+  prefix_bytes    = ((payload[ 8] << 8) | (payload[ 9] << 0));
+  size_scalar     = ((payload[10] << 8) | (payload[11] << 0));
+  fragment_length = ((payload[12] << 8) | (payload[13] << 0));
+  no_slices       = ((payload[14] << 8) | (payload[15] << 0));
+
+  if (no_slices == 0) {
+    /* Transform parameters, the start of a new picture */
+    vc2_hq_transform_parameters *params;
+
+    if (fragment_length > length - 16)
+      return GST_FLOW_OK;
+
+    /* Whatever is left of a picture whose last packet was lost */
+    ret = gst_rtp_vc2_repay_flush_pending (rtpvc2repay, FALSE);
+
+    params = vc2_hq_transform_parameters_new (payload + 16, fragment_length);
+    rtpvc2repay->in_picture     = (params != NULL && params->slices_x > 0);
+    rtpvc2repay->slices_x       = (params != NULL) ? params->slices_x : 0;
+    rtpvc2repay->picture_number = picture_number;
+    rtpvc2repay->field_flags    = payload[2];
+    rtpvc2repay->pts            = GST_BUFFER_PTS (buffer);
+    rtpvc2repay->dts            = GST_BUFFER_DTS (buffer);
+    vc2_hq_transform_parameters_free (params);
+
+    if (ret == GST_FLOW_OK)
+      ret = gst_rtp_vc2_repay_push (rtpvc2repay, payload, 16,
+          (fragment_length > 0) ? gst_buffer_copy_region (buffer,
+              GST_BUFFER_COPY_MEMORY, payload_offset + 16,
+              fragment_length) : NULL, M, rtpvc2repay->pts, rtpvc2repay->dts);
+    return ret;
+  }
+
+  if (length < 20 || fragment_length > length - 20)
+    return GST_FLOW_OK;
+
+  slice_x = ((payload[16] << 8) | (payload[17] << 0));
+  slice_y = ((payload[18] << 8) | (payload[19] << 0));
+
+  if (!rtpvc2repay->in_picture || rtpvc2repay->picture_number != picture_number ||
+      slice_x >= rtpvc2repay->slices_x) {
+    GST_DEBUG_OBJECT (rtpvc2repay, "fragment of unknown picture %u, dropping", picture_number);
+    return GST_FLOW_OK;
+  }
+
+  first = slice_y*rtpvc2repay->slices_x + slice_x;
+
+  /* Slices can only share a packet with the ones pending if they follow
+   * straight on from them */
+  if (rtpvc2repay->pending != NULL &&
+      (first != rtpvc2repay->pending_first + rtpvc2repay->pending_slices ||
+       prefix_bytes != rtpvc2repay->pending_prefix_bytes ||
+       size_scalar  != rtpvc2repay->pending_size_scalar)) {
+    ret = gst_rtp_vc2_repay_flush_pending (rtpvc2repay, FALSE);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
+  rtpvc2repay->pending_prefix_bytes = prefix_bytes;
+  rtpvc2repay->pending_size_scalar  = size_scalar;
+
+  max_size = gst_rtp_buffer_calc_payload_len (basepayload->mtu, 0, 0);
+  max_size = (max_size > 20) ? (max_size - 20) : 1;
+
+  if (rtpvc2repay->pending_size + fragment_length <= max_size) {
+    gst_rtp_vc2_repay_append (rtpvc2repay, buffer, payload_offset + 20,
+        fragment_length, no_slices, first);
+  } else {
+    /* Only here do the slice headers have to be read, to find where the
+     * fragment can be split */
+    offs       = 0;
+    run        = 0;
+    run_slices = 0;
+    for (i = 0; i < no_slices && ret == GST_FLOW_OK; i++) {
+      slice_length = vc2_hq_slice_length (payload + 20 + offs, fragment_length - offs,
+                                          prefix_bytes, size_scalar);
+      if (slice_length == 0) {
+        GST_WARNING_OBJECT (rtpvc2repay, "corrupt slice in picture %u", picture_number);
+        break;
+      }
+
+      if (rtpvc2repay->pending_size + (offs - run) + slice_length > max_size &&
+          rtpvc2repay->pending_slices + run_slices > 0) {
+        gst_rtp_vc2_repay_append (rtpvc2repay, buffer, payload_offset + 20 + run,
+            offs - run, run_slices, first + i - run_slices);
+        ret = gst_rtp_vc2_repay_flush_pending (rtpvc2repay, FALSE);
+        run        = offs;
+        run_slices = 0;
+      }
+
+      offs += slice_length;
+      run_slices++;
+    }
+
+    if (ret == GST_FLOW_OK)
+      gst_rtp_vc2_repay_append (rtpvc2repay, buffer, payload_offset + 20 + run,
+          offs - run, run_slices, first + i - run_slices);
+  }
+
+  if (ret == GST_FLOW_OK && M) {
+    ret = gst_rtp_vc2_repay_flush_pending (rtpvc2repay, TRUE);
+    rtpvc2repay->in_picture = FALSE;
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_rtp_vc2_repay_handle_buffer (GstRTPBasePayload * basepayload,
+    GstBuffer * buffer)
+{
+  GstRtpVC2Repay *rtpvc2repay = GST_RTP_VC2_REPAY (basepayload);
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint8 *payload;
+  guint payload_offset, length;
+  gboolean M;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    GST_WARNING_OBJECT (rtpvc2repay, "dropping invalid RTP packet");
+    gst_buffer_unref (buffer);
+    return GST_FLOW_OK;
+  }
+
+  payload        = gst_rtp_buffer_get_payload (&rtp);
+  length         = gst_rtp_buffer_get_payload_len (&rtp);
+  payload_offset = gst_rtp_buffer_get_header_len (&rtp);
+  M              = gst_rtp_buffer_get_marker (&rtp);
+
+  if (length >= 4) {
+    switch (payload[3]) {
+    case 0xEC:
+      ret = gst_rtp_vc2_repay_process_hq_fragment (rtpvc2repay, buffer,
+          payload, payload_offset, length, M);
+      break;
+    default:
+      /* Sequence headers, end of sequence and anything else we don't know
+       * about go out as they are */
+      ret = gst_rtp_vc2_repay_flush_pending (rtpvc2repay, FALSE);
+      if (ret == GST_FLOW_OK)
+        ret = gst_rtp_vc2_repay_push (rtpvc2repay, payload, 4,
+            (length > 4) ? gst_buffer_copy_region (buffer,
+                GST_BUFFER_COPY_MEMORY, payload_offset + 4, length - 4) : NULL,
+            M, GST_BUFFER_PTS (buffer), GST_BUFFER_DTS (buffer));
+      break;
+    }
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gboolean
+gst_rtp_vc2_repay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
+{
+  GstRtpVC2Repay *rtpvc2repay = GST_RTP_VC2_REPAY (payload);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      gst_rtp_vc2_repay_reset (rtpvc2repay);
+      break;
+    case GST_EVENT_EOS:
+      gst_rtp_vc2_repay_flush_pending (rtpvc2repay, FALSE);
+      break;
+    default:
+      break;
+  }
+
+  return GST_RTP_BASE_PAYLOAD_CLASS (parent_class)->sink_event (payload, event);
+}
+
+static GstStateChangeReturn
+gst_rtp_vc2_repay_change_state (GstElement * element, GstStateChange transition)
+{
+  GstRtpVC2Repay *rtpvc2repay = GST_RTP_VC2_REPAY (element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_rtp_vc2_repay_reset (rtpvc2repay);
+      break;
+    default:
+      break;
+  }
+
+  return GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+}
+
+gboolean
+gst_rtp_vc2_repay_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "rtpvc2repay",
+                               GST_RANK_NONE, GST_TYPE_RTP_VC2_REPAY);
+}
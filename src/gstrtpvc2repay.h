@@ -0,0 +1,76 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTP_VC2_REPAY_H__
+#define __GST_RTP_VC2_REPAY_H__
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbasepayload.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_RTP_VC2_REPAY \
+  (gst_rtp_vc2_repay_get_type())
+#define GST_RTP_VC2_REPAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_RTP_VC2_REPAY,GstRtpVC2Repay))
+#define GST_RTP_VC2_REPAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_RTP_VC2_REPAY,GstRtpVC2RepayClass))
+#define GST_IS_RTP_VC2_REPAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_RTP_VC2_REPAY))
+#define GST_IS_RTP_VC2_REPAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_RTP_VC2_REPAY))
+
+typedef struct _GstRtpVC2Repay GstRtpVC2Repay;
+typedef struct _GstRtpVC2RepayClass GstRtpVC2RepayClass;
+
+struct _GstRtpVC2Repay
+{
+  GstRTPBasePayload payload;
+
+  guint16 next_ext_seq_num;
+
+  /* the picture currently being repacketized */
+  gboolean in_picture;
+  guint32  picture_number;
+  guint32  slices_x;
+  guint8   field_flags;
+  GstClockTime pts;
+  GstClockTime dts;
+
+  /* slices waiting to go out in the next packet */
+  GstBuffer *pending;
+  gsize      pending_size;
+  guint      pending_slices;
+  guint      pending_first;
+  guint16    pending_prefix_bytes;
+  guint16    pending_size_scalar;
+};
+
+struct _GstRtpVC2RepayClass
+{
+  GstRTPBasePayloadClass parent_class;
+};
+
+GType gst_rtp_vc2_repay_get_type (void);
+
+gboolean gst_rtp_vc2_repay_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_RTP_VC2_REPAY_H__ */
@@ -0,0 +1,724 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gstvc2filesrc.h"
+#include "vc2vlcparse.h"
+
+GST_DEBUG_CATEGORY_STATIC (vc2filesrc_debug);
+#define GST_CAT_DEFAULT (vc2filesrc_debug)
+
+/* A source for VC-2 elementary stream files, for playing out recordings
+ * without a parser in the pipeline. The file is mapped into memory rather
+ * than read, and every output buffer shares the one GstMemory wrapping the
+ * mapping, so a picture costs a few allocations however large it is.
+ *
+ * When the element starts it walks the file once by the next parse offsets
+ * in the parse info headers and keeps an index of where each picture starts
+ * and ends and which sequence header it follows. One picture is pushed per
+ * buffer, timestamped from the frame rate in the first sequence header, and
+ * the index makes seeking (in time or in pictures) and looping direct. The
+ * walk reads every header in the file, so for long recordings the index can
+ * be kept in a sidecar file and reused while the file is unchanged.
+ *
+ * After a seek, or when looping back to the start, the first buffer is made
+ * to stand alone: the sequence header is sent in front of the picture if it
+ * is not already there and the parse info headers are rewritten so the
+ * previous parse offsets still match what went before. Pictures coded as
+ * fragments are not told apart, they go out with the next whole picture. */
+
+#define DEFAULT_LOCATION       NULL
+#define DEFAULT_INDEX_LOCATION NULL
+#define DEFAULT_LOOP           FALSE
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_INDEX_LOCATION,
+  PROP_LOOP
+};
+
+/* at the start of a sidecar index, followed by the entries */
+typedef struct {
+  gchar   magic[8];
+  guint64 file_size;
+  gint64  file_mtime;
+  guint32 n_entries;
+  guint32 reserved;
+} GstVC2FileSrcIndexHeader;
+
+#define INDEX_MAGIC "VC2IDX1"
+
+static GstStaticPadTemplate gst_vc2_file_src_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-dirac")
+    );
+
+static void gst_vc2_file_src_finalize (GObject * object);
+static void gst_vc2_file_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_file_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_vc2_file_src_start (GstBaseSrc * basesrc);
+static gboolean gst_vc2_file_src_stop (GstBaseSrc * basesrc);
+static gboolean gst_vc2_file_src_is_seekable (GstBaseSrc * basesrc);
+static gboolean gst_vc2_file_src_prepare_seek_segment (GstBaseSrc * basesrc,
+    GstEvent * seek, GstSegment * segment);
+static gboolean gst_vc2_file_src_do_seek (GstBaseSrc * basesrc,
+    GstSegment * segment);
+static gboolean gst_vc2_file_src_query (GstBaseSrc * basesrc, GstQuery * query);
+static GstFlowReturn gst_vc2_file_src_create (GstPushSrc * pushsrc,
+    GstBuffer ** buffer);
+
+#define gst_vc2_file_src_parent_class parent_class
+G_DEFINE_TYPE (GstVC2FileSrc, gst_vc2_file_src, GST_TYPE_PUSH_SRC);
+
+static void
+gst_vc2_file_src_class_init (GstVC2FileSrcClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSrcClass *gstbasesrc_class;
+  GstPushSrcClass *gstpushsrc_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesrc_class = (GstBaseSrcClass *) klass;
+  gstpushsrc_class = (GstPushSrcClass *) klass;
+
+  gobject_class->finalize = gst_vc2_file_src_finalize;
+  gobject_class->set_property = gst_vc2_file_src_set_property;
+  gobject_class->get_property = gst_vc2_file_src_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the VC-2 elementary stream file to read",
+          DEFAULT_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index Location",
+          "Location of a sidecar file for the picture index, reused when it "
+          "matches the size and modification time of the file and written "
+          "otherwise (NULL = build the index every time)",
+          DEFAULT_INDEX_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP,
+      g_param_spec_boolean ("loop", "Loop",
+          "Start again from the first picture at the end of the file, with "
+          "timestamps carrying on",
+          DEFAULT_LOOP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_file_src_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 file source", "Source/File",
+      "Reads VC-2 elementary stream files a picture at a time, with seeking",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstbasesrc_class->start = gst_vc2_file_src_start;
+  gstbasesrc_class->stop = gst_vc2_file_src_stop;
+  gstbasesrc_class->is_seekable = gst_vc2_file_src_is_seekable;
+  gstbasesrc_class->prepare_seek_segment = gst_vc2_file_src_prepare_seek_segment;
+  gstbasesrc_class->do_seek = gst_vc2_file_src_do_seek;
+  gstbasesrc_class->query = gst_vc2_file_src_query;
+  gstpushsrc_class->create = gst_vc2_file_src_create;
+
+  GST_DEBUG_CATEGORY_INIT (vc2filesrc_debug, "vc2filesrc", 0,
+      "VC2 File Source");
+}
+
+static void
+gst_vc2_file_src_init (GstVC2FileSrc * vc2filesrc)
+{
+  vc2filesrc->location       = g_strdup (DEFAULT_LOCATION);
+  vc2filesrc->index_location = g_strdup (DEFAULT_INDEX_LOCATION);
+  vc2filesrc->loop           = DEFAULT_LOOP;
+
+  vc2filesrc->mapped = NULL;
+  vc2filesrc->memory = NULL;
+  vc2filesrc->index  = NULL;
+
+  gst_base_src_set_format (GST_BASE_SRC (vc2filesrc), GST_FORMAT_TIME);
+}
+
+static void
+gst_vc2_file_src_free_file (GstVC2FileSrc * vc2filesrc)
+{
+  if (vc2filesrc->memory) {
+    gst_memory_unref (vc2filesrc->memory);
+    vc2filesrc->memory = NULL;
+  }
+  if (vc2filesrc->mapped) {
+    g_mapped_file_unref (vc2filesrc->mapped);
+    vc2filesrc->mapped = NULL;
+  }
+  if (vc2filesrc->index) {
+    g_array_free (vc2filesrc->index, TRUE);
+    vc2filesrc->index = NULL;
+  }
+}
+
+static void
+gst_vc2_file_src_finalize (GObject * object)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (object);
+
+  gst_vc2_file_src_free_file (vc2filesrc);
+  g_free (vc2filesrc->location);
+  g_free (vc2filesrc->index_location);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* A unit with a next parse offset of zero (allowed for pictures) is as long
+ * as the distance to the next parse info header pointing back at it, or the
+ * rest of the file when there is none */
+static guint64
+gst_vc2_file_src_unit_size (const guint8 * data, gsize size, guint64 offset)
+{
+  vc2_parse_info info;
+  guint64 i;
+
+  for (i = offset + 13; i + 13 <= size; i++) {
+    if (data[i] == 'B' &&
+        vc2_parse_info_read (data + i, size - i, &info) &&
+        info.prev_parse_offset == i - offset)
+      return i - offset;
+  }
+
+  return size - offset;
+}
+
+static void
+gst_vc2_file_src_build_index (GstVC2FileSrc * vc2filesrc,
+    const guint8 * data, gsize size)
+{
+  GstVC2FileSrcIndexEntry entry;
+  vc2_parse_info info;
+  guint64 offset, start, seq_hdr = G_MAXUINT64;
+  guint32 seq_hdr_size = 0, unit_size = 0;
+
+  /* skip anything in front of the first parse info header */
+  for (offset = 0; offset + 13 <= size; offset++) {
+    if (data[offset] == 'B' && vc2_parse_info_read (data + offset, size - offset, &info))
+      break;
+  }
+  start = offset;
+
+  while (offset + 13 <= size && vc2_parse_info_read (data + offset, size - offset, &info)) {
+    guint64 next = info.next_parse_offset;
+
+    if (info.parse_code == 0x10)
+      next = 13;
+    else if (next == 0)
+      next = gst_vc2_file_src_unit_size (data, size, offset);
+
+    if (next < 13 || next > size - offset || next > G_MAXUINT32) {
+      GST_WARNING_OBJECT (vc2filesrc, "bad next parse offset %" G_GUINT64_FORMAT
+          " at byte %" G_GUINT64_FORMAT ", ignoring the rest of the file", next, offset);
+      break;
+    }
+    unit_size = next;
+
+    if (info.parse_code == 0x00) {
+      seq_hdr      = offset;
+      seq_hdr_size = next;
+    } else if ((info.parse_code & 0x0C) == 0x08) {
+      /* a whole picture, not a fragment */
+      entry.offset         = start;
+      entry.seq_hdr        = seq_hdr;
+      entry.seq_hdr_size   = seq_hdr_size;
+      entry.last_unit_size = next;
+      g_array_append_val (vc2filesrc->index, entry);
+      start = offset + next;
+    }
+
+    offset += next;
+  }
+
+  /* anything after the last picture, usually an end of sequence, goes out
+   * with it */
+  if (vc2filesrc->index->len > 0) {
+    g_array_index (vc2filesrc->index, GstVC2FileSrcIndexEntry,
+        vc2filesrc->index->len - 1).last_unit_size = unit_size;
+
+    entry.offset         = offset;
+    entry.seq_hdr        = G_MAXUINT64;
+    entry.seq_hdr_size   = 0;
+    entry.last_unit_size = 0;
+    g_array_append_val (vc2filesrc->index, entry);
+  }
+}
+
+static gboolean
+gst_vc2_file_src_load_index (GstVC2FileSrc * vc2filesrc, const gchar * location,
+    gsize size, gint64 mtime)
+{
+  GstVC2FileSrcIndexHeader hdr;
+  GstVC2FileSrcIndexEntry *entries;
+  gchar *contents;
+  gsize length;
+  guint32 i;
+
+  if (!g_file_get_contents (location, &contents, &length, NULL))
+    return FALSE;
+
+  if (length < sizeof (hdr))
+    goto invalid;
+  memcpy (&hdr, contents, sizeof (hdr));
+  if (memcmp (hdr.magic, INDEX_MAGIC, sizeof (hdr.magic)) != 0 ||
+      hdr.file_size != size || hdr.file_mtime != mtime || hdr.n_entries < 2 ||
+      length != sizeof (hdr) + (gsize) hdr.n_entries*sizeof (GstVC2FileSrcIndexEntry))
+    goto invalid;
+
+  /* the index is only ever used to cut up the mapping, but check it still
+   * stays inside it */
+  entries = (GstVC2FileSrcIndexEntry *) (contents + sizeof (hdr));
+  for (i = 0; i < hdr.n_entries; i++) {
+    if (entries[i].offset > size ||
+        (i > 0 && entries[i].offset < entries[i - 1].offset + 13) ||
+        (entries[i].seq_hdr != G_MAXUINT64 &&
+            (entries[i].seq_hdr_size < 13 || entries[i].seq_hdr > size - entries[i].seq_hdr_size)))
+      goto invalid;
+  }
+
+  g_array_append_vals (vc2filesrc->index, entries, hdr.n_entries);
+  g_free (contents);
+  GST_DEBUG_OBJECT (vc2filesrc, "loaded index of %u pictures from %s",
+      hdr.n_entries - 1, location);
+  return TRUE;
+
+invalid:
+  GST_INFO_OBJECT (vc2filesrc, "index in %s does not match, rebuilding it", location);
+  g_free (contents);
+  return FALSE;
+}
+
+static void
+gst_vc2_file_src_save_index (GstVC2FileSrc * vc2filesrc, const gchar * location,
+    gsize size, gint64 mtime)
+{
+  GstVC2FileSrcIndexHeader hdr;
+  GError *err = NULL;
+  gsize entries_size;
+  gchar *contents;
+
+  memset (&hdr, 0, sizeof (hdr));
+  memcpy (hdr.magic, INDEX_MAGIC, sizeof (hdr.magic));
+  hdr.file_size  = size;
+  hdr.file_mtime = mtime;
+  hdr.n_entries  = vc2filesrc->index->len;
+
+  entries_size = vc2filesrc->index->len*sizeof (GstVC2FileSrcIndexEntry);
+  contents = g_malloc (sizeof (hdr) + entries_size);
+  memcpy (contents, &hdr, sizeof (hdr));
+  memcpy (contents + sizeof (hdr), vc2filesrc->index->data, entries_size);
+
+  if (!g_file_set_contents (location, contents, sizeof (hdr) + entries_size, &err)) {
+    GST_WARNING_OBJECT (vc2filesrc, "could not write index to %s: %s",
+        location, err->message);
+    g_clear_error (&err);
+  }
+  g_free (contents);
+}
+
+static gboolean
+gst_vc2_file_src_start (GstBaseSrc * basesrc)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (basesrc);
+  GstVC2FileSrcIndexEntry *first = NULL;
+  vc2_sequence_header *hdr = NULL;
+  GError *err = NULL;
+  GStatBuf st;
+  const guint8 *data;
+  gsize size;
+  guint i;
+
+  gst_vc2_file_src_free_file (vc2filesrc);
+
+  if (vc2filesrc->location == NULL || vc2filesrc->location[0] == '\0') {
+    GST_ELEMENT_ERROR (vc2filesrc, RESOURCE, NOT_FOUND,
+        ("No file name specified for reading."), (NULL));
+    return FALSE;
+  }
+
+  vc2filesrc->mapped = g_mapped_file_new (vc2filesrc->location, FALSE, &err);
+  if (vc2filesrc->mapped == NULL) {
+    GST_ELEMENT_ERROR (vc2filesrc, RESOURCE, OPEN_READ, (NULL),
+        ("could not map %s: %s", vc2filesrc->location, err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+  data = (const guint8 *) g_mapped_file_get_contents (vc2filesrc->mapped);
+  size = g_mapped_file_get_length (vc2filesrc->mapped);
+
+  if (g_stat (vc2filesrc->location, &st) != 0)
+    st.st_mtime = 0;
+
+  vc2filesrc->index = g_array_new (FALSE, FALSE, sizeof (GstVC2FileSrcIndexEntry));
+  if (vc2filesrc->index_location == NULL ||
+      !gst_vc2_file_src_load_index (vc2filesrc, vc2filesrc->index_location, size, st.st_mtime)) {
+    gst_vc2_file_src_build_index (vc2filesrc, data, size);
+    if (vc2filesrc->index_location && vc2filesrc->index->len > 0)
+      gst_vc2_file_src_save_index (vc2filesrc, vc2filesrc->index_location, size, st.st_mtime);
+  }
+
+  if (vc2filesrc->index->len < 2) {
+    GST_ELEMENT_ERROR (vc2filesrc, STREAM, WRONG_TYPE, (NULL),
+        ("no VC-2 pictures found in %s", vc2filesrc->location));
+    gst_vc2_file_src_free_file (vc2filesrc);
+    return FALSE;
+  }
+  vc2filesrc->n_pictures = vc2filesrc->index->len - 1;
+
+  /* the timing all comes from the first sequence header */
+  for (i = 0; i < vc2filesrc->n_pictures && first == NULL; i++) {
+    GstVC2FileSrcIndexEntry *entry = &g_array_index (vc2filesrc->index, GstVC2FileSrcIndexEntry, i);
+    if (entry->seq_hdr != G_MAXUINT64)
+      first = entry;
+  }
+  if (first) {
+    GstBuffer *buf = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        (gpointer) (data + first->seq_hdr + 13), first->seq_hdr_size - 13,
+        0, first->seq_hdr_size - 13, NULL, NULL);
+    hdr = vc2_sequence_header_new (buf);
+    gst_buffer_unref (buf);
+  }
+  if (hdr == NULL) {
+    GST_ELEMENT_ERROR (vc2filesrc, STREAM, DECODE, (NULL),
+        ("no valid sequence header found in %s", vc2filesrc->location));
+    gst_vc2_file_src_free_file (vc2filesrc);
+    return FALSE;
+  }
+  vc2filesrc->interlaced = hdr->interlaced;
+  vc2filesrc->fps_n      = hdr->frame_rate_numer;
+  vc2filesrc->fps_d      = hdr->frame_rate_denom;
+  vc2_sequence_header_free (hdr);
+
+  /* the memory holds a reference to the mapping, so buffers still
+   * downstream keep it alive after the element stops */
+  vc2filesrc->memory = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      (gpointer) data, size, 0, size,
+      g_mapped_file_ref (vc2filesrc->mapped), (GDestroyNotify) g_mapped_file_unref);
+
+  GST_DEBUG_OBJECT (vc2filesrc, "%u pictures at %u/%u%s", vc2filesrc->n_pictures,
+      vc2filesrc->fps_n, vc2filesrc->fps_d, (vc2filesrc->interlaced) ? " (fields)" : "");
+
+  vc2filesrc->next_picture   = 0;
+  vc2filesrc->loops          = 0;
+  vc2filesrc->discont        = FALSE;
+  vc2filesrc->prev_unit_size = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_file_src_stop (GstBaseSrc * basesrc)
+{
+  gst_vc2_file_src_free_file (GST_VC2_FILE_SRC (basesrc));
+
+  return TRUE;
+}
+
+static GstClockTime
+gst_vc2_file_src_picture_time (GstVC2FileSrc * vc2filesrc, guint64 n)
+{
+  return gst_util_uint64_scale (n, vc2filesrc->fps_d*GST_SECOND,
+      (guint64) vc2filesrc->fps_n*((vc2filesrc->interlaced) ? 2 : 1));
+}
+
+/* Converts between time and frames (GST_FORMAT_DEFAULT), counting a frame
+ * as two pictures for interlaced streams */
+static gboolean
+gst_vc2_file_src_convert (GstVC2FileSrc * vc2filesrc, GstFormat src_format,
+    gint64 src_value, GstFormat dest_format, gint64 * dest_value)
+{
+  if (src_format == dest_format || src_value == -1) {
+    *dest_value = src_value;
+    return TRUE;
+  }
+  if (vc2filesrc->fps_n == 0)
+    return FALSE;
+
+  if (src_format == GST_FORMAT_DEFAULT && dest_format == GST_FORMAT_TIME) {
+    *dest_value = gst_util_uint64_scale (src_value, vc2filesrc->fps_d*GST_SECOND,
+        vc2filesrc->fps_n);
+    return TRUE;
+  }
+  if (src_format == GST_FORMAT_TIME && dest_format == GST_FORMAT_DEFAULT) {
+    *dest_value = gst_util_uint64_scale (src_value, vc2filesrc->fps_n,
+        vc2filesrc->fps_d*GST_SECOND);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+gst_vc2_file_src_is_seekable (GstBaseSrc * basesrc)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_file_src_prepare_seek_segment (GstBaseSrc * basesrc, GstEvent * seek,
+    GstSegment * segment)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (basesrc);
+  GstSeekType start_type, stop_type;
+  GstSeekFlags flags;
+  GstFormat format;
+  gint64 start, stop;
+  gdouble rate;
+
+  gst_event_parse_seek (seek, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  if (format == GST_FORMAT_DEFAULT) {
+    if (!gst_vc2_file_src_convert (vc2filesrc, format, start, GST_FORMAT_TIME, &start) ||
+        !gst_vc2_file_src_convert (vc2filesrc, format, stop, GST_FORMAT_TIME, &stop))
+      return FALSE;
+    format = GST_FORMAT_TIME;
+  }
+  if (format != GST_FORMAT_TIME) {
+    GST_DEBUG_OBJECT (vc2filesrc, "cannot seek in %s format", gst_format_get_name (format));
+    return FALSE;
+  }
+
+  gst_segment_init (segment, GST_FORMAT_TIME);
+  return gst_segment_do_seek (segment, rate, format, flags, start_type, start,
+      stop_type, stop, NULL);
+}
+
+static gboolean
+gst_vc2_file_src_do_seek (GstBaseSrc * basesrc, GstSegment * segment)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (basesrc);
+  guint64 n;
+
+  if (segment->rate < 0.0 || vc2filesrc->index == NULL) {
+    GST_DEBUG_OBJECT (vc2filesrc, "cannot play backwards");
+    return FALSE;
+  }
+
+  /* start at the first picture not before the segment, and on the first
+   * field of a frame */
+  n = gst_util_uint64_scale_ceil (segment->start,
+      (guint64) vc2filesrc->fps_n*((vc2filesrc->interlaced) ? 2 : 1),
+      vc2filesrc->fps_d*GST_SECOND);
+  if (vc2filesrc->interlaced)
+    n = (n + 1) & ~G_GUINT64_CONSTANT (1);
+
+  vc2filesrc->next_picture   = MIN (n, vc2filesrc->n_pictures);
+  vc2filesrc->loops          = 0;
+  vc2filesrc->discont        = TRUE;
+  vc2filesrc->prev_unit_size = 0;
+
+  segment->time     = segment->start;
+  segment->position = segment->start;
+  if (!vc2filesrc->loop)
+    segment->duration = gst_vc2_file_src_picture_time (vc2filesrc, vc2filesrc->n_pictures);
+
+  GST_DEBUG_OBJECT (vc2filesrc, "seek to picture %" G_GUINT64_FORMAT, n);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_file_src_query (GstBaseSrc * basesrc, GstQuery * query)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (basesrc);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONVERT) {
+    GstFormat src_format, dest_format;
+    gint64 src_value, dest_value;
+
+    gst_query_parse_convert (query, &src_format, &src_value, &dest_format, &dest_value);
+    if (gst_vc2_file_src_convert (vc2filesrc, src_format, src_value, dest_format, &dest_value)) {
+      gst_query_set_convert (query, src_format, src_value, dest_format, dest_value);
+      return TRUE;
+    }
+  }
+
+  return GST_BASE_SRC_CLASS (parent_class)->query (basesrc, query);
+}
+
+/* Rewrites the parse info header at the start of a picture's data so it
+ * follows on from prev_parse_offset, putting the sequence header in front
+ * of it if the data does not start with one */
+static GstBuffer *
+gst_vc2_file_src_make_head (GstVC2FileSrc * vc2filesrc,
+    GstVC2FileSrcIndexEntry * entry, const guint8 * data)
+{
+  GstBuffer *head;
+  GstMapInfo map;
+  vc2_parse_info info;
+  gboolean send_seq_hdr;
+  guint32 prev = vc2filesrc->prev_unit_size;
+  guint8 *p;
+
+  vc2_parse_info_read (data + entry->offset, 13, &info);
+  send_seq_hdr = (entry->seq_hdr != G_MAXUINT64 && entry->seq_hdr < entry->offset);
+
+  head = gst_buffer_new_allocate (NULL, (send_seq_hdr) ? entry->seq_hdr_size + 13 : 13, NULL);
+  gst_buffer_map (head, &map, GST_MAP_WRITE);
+  p = map.data;
+
+  if (send_seq_hdr) {
+    vc2_parse_info_write (p, 0x00, entry->seq_hdr_size, prev);
+    memcpy (p + 13, data + entry->seq_hdr + 13, entry->seq_hdr_size - 13);
+    p += entry->seq_hdr_size;
+    prev = entry->seq_hdr_size;
+  }
+  vc2_parse_info_write (p, info.parse_code, info.next_parse_offset, prev);
+
+  gst_buffer_unmap (head, &map);
+
+  return head;
+}
+
+static GstFlowReturn
+gst_vc2_file_src_create (GstPushSrc * pushsrc, GstBuffer ** buffer)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (pushsrc);
+  GstSegment *segment = &GST_BASE_SRC (pushsrc)->segment;
+  GstVC2FileSrcIndexEntry *entry;
+  GstBuffer *outbuf;
+  GstClockTime pts;
+  guint64 n, end;
+  gsize skip = 0;
+
+  if (vc2filesrc->next_picture >= vc2filesrc->n_pictures) {
+    if (!vc2filesrc->loop)
+      return GST_FLOW_EOS;
+    vc2filesrc->next_picture = 0;
+    vc2filesrc->loops++;
+    vc2filesrc->discont = TRUE;
+  }
+
+  n   = vc2filesrc->loops*vc2filesrc->n_pictures + vc2filesrc->next_picture;
+  pts = gst_vc2_file_src_picture_time (vc2filesrc, n);
+  if (GST_CLOCK_TIME_IS_VALID (segment->stop) && pts >= segment->stop)
+    return GST_FLOW_EOS;
+
+  entry = &g_array_index (vc2filesrc->index, GstVC2FileSrcIndexEntry, vc2filesrc->next_picture);
+  end   = entry[1].offset;
+
+  if (vc2filesrc->discont) {
+    outbuf = gst_vc2_file_src_make_head (vc2filesrc, entry,
+        (const guint8 *) g_mapped_file_get_contents (vc2filesrc->mapped));
+    skip = 13;
+
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    vc2filesrc->discont = FALSE;
+  } else {
+    outbuf = gst_buffer_new ();
+  }
+  gst_buffer_append_memory (outbuf, gst_memory_share (vc2filesrc->memory,
+          entry->offset + skip, end - entry->offset - skip));
+
+  GST_BUFFER_PTS (outbuf)        = pts;
+  GST_BUFFER_DTS (outbuf)        = pts;
+  GST_BUFFER_DURATION (outbuf)   = gst_vc2_file_src_picture_time (vc2filesrc, n + 1) - pts;
+  GST_BUFFER_OFFSET (outbuf)     = n;
+  GST_BUFFER_OFFSET_END (outbuf) = n + 1;
+
+  vc2filesrc->prev_unit_size = entry->last_unit_size;
+  vc2filesrc->next_picture++;
+
+  *buffer = outbuf;
+  return GST_FLOW_OK;
+}
+
+static void
+gst_vc2_file_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (vc2filesrc);
+      g_free (vc2filesrc->location);
+      vc2filesrc->location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (vc2filesrc);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (vc2filesrc);
+      g_free (vc2filesrc->index_location);
+      vc2filesrc->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (vc2filesrc);
+      break;
+    case PROP_LOOP:
+      vc2filesrc->loop = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vc2_file_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2FileSrc *vc2filesrc = GST_VC2_FILE_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (vc2filesrc);
+      g_value_set_string (value, vc2filesrc->location);
+      GST_OBJECT_UNLOCK (vc2filesrc);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (vc2filesrc);
+      g_value_set_string (value, vc2filesrc->index_location);
+      GST_OBJECT_UNLOCK (vc2filesrc);
+      break;
+    case PROP_LOOP:
+      g_value_set_boolean (value, vc2filesrc->loop);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+gboolean
+gst_vc2_file_src_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2filesrc",
+                               GST_RANK_NONE, GST_TYPE_VC2_FILE_SRC);
+}
@@ -0,0 +1,89 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VC2_FILE_SRC_H__
+#define __GST_VC2_FILE_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_FILE_SRC \
+  (gst_vc2_file_src_get_type())
+#define GST_VC2_FILE_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_FILE_SRC,GstVC2FileSrc))
+#define GST_VC2_FILE_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_FILE_SRC,GstVC2FileSrcClass))
+#define GST_IS_VC2_FILE_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_FILE_SRC))
+#define GST_IS_VC2_FILE_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_FILE_SRC))
+
+typedef struct _GstVC2FileSrc GstVC2FileSrc;
+typedef struct _GstVC2FileSrcClass GstVC2FileSrcClass;
+
+/* One per picture, and one more marking the end of the indexed data. A
+ * picture is pushed as everything from its entry's offset up to the next
+ * entry's, so any sequence header or other data units in front of it go
+ * with it. */
+typedef struct {
+  guint64 offset;
+  guint64 seq_hdr;          /* the sequence header in force, or G_MAXUINT64 */
+  guint32 seq_hdr_size;
+  guint32 last_unit_size;   /* of the last data unit pushed with the picture */
+} GstVC2FileSrcIndexEntry;
+
+struct _GstVC2FileSrc
+{
+  GstPushSrc pushsrc;
+
+  /* properties */
+  gchar   *location;
+  gchar   *index_location;
+  gboolean loop;
+
+  /* set up in start() */
+  GMappedFile *mapped;
+  GstMemory   *memory;
+  GArray      *index;
+  guint        n_pictures;
+  gboolean     interlaced;
+  guint32      fps_n;
+  guint32      fps_d;
+
+  guint    next_picture;
+  guint64  loops;
+  gboolean discont;
+  guint32  prev_unit_size;
+};
+
+struct _GstVC2FileSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType gst_vc2_file_src_get_type (void);
+
+gboolean gst_vc2_file_src_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_FILE_SRC_H__ */
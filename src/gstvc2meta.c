@@ -0,0 +1,178 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstvc2meta.h"
+
+GType
+gst_vc2_slice_index_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { "video", NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstVC2SliceIndexMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_vc2_slice_index_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstVC2SliceIndexMeta *smeta = (GstVC2SliceIndexMeta *) meta;
+
+  smeta->picture_number     = 0;
+  smeta->wavelet_index      = 0;
+  smeta->dwt_depth          = 0;
+  smeta->slices_x           = 0;
+  smeta->slices_y           = 0;
+  smeta->slice_prefix_bytes = 0;
+  smeta->slice_size_scalar  = 0;
+  smeta->slice_data_offset  = 0;
+  smeta->n_slices           = 0;
+  smeta->slice_offsets      = NULL;
+
+  return TRUE;
+}
+
+static void
+gst_vc2_slice_index_meta_free (GstMeta * meta, GstBuffer * buffer)
+{
+  GstVC2SliceIndexMeta *smeta = (GstVC2SliceIndexMeta *) meta;
+
+  g_free (smeta->slice_offsets);
+  smeta->slice_offsets = NULL;
+}
+
+static gboolean
+gst_vc2_slice_index_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstVC2SliceIndexMeta *smeta = (GstVC2SliceIndexMeta *) meta;
+  GstVC2SliceIndexMeta *dmeta;
+  gsize offset = 0;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  {
+    GstMetaTransformCopy *copy = data;
+
+    if (copy->region) {
+      /* The copy has to contain all of the slices for the index to still be
+       * of use, otherwise just leave the meta behind */
+      if (copy->offset > smeta->slice_data_offset)
+        return TRUE;
+      if (copy->size != (gsize) -1 &&
+          copy->offset + copy->size < smeta->slice_data_offset +
+          smeta->slice_offsets[smeta->n_slices])
+        return TRUE;
+      offset = copy->offset;
+    }
+  }
+
+  dmeta = (GstVC2SliceIndexMeta *) gst_buffer_add_meta (dest,
+      GST_VC2_SLICE_INDEX_META_INFO, NULL);
+  if (!dmeta)
+    return FALSE;
+
+  dmeta->picture_number     = smeta->picture_number;
+  dmeta->wavelet_index      = smeta->wavelet_index;
+  dmeta->dwt_depth          = smeta->dwt_depth;
+  dmeta->slices_x           = smeta->slices_x;
+  dmeta->slices_y           = smeta->slices_y;
+  dmeta->slice_prefix_bytes = smeta->slice_prefix_bytes;
+  dmeta->slice_size_scalar  = smeta->slice_size_scalar;
+  dmeta->slice_data_offset  = smeta->slice_data_offset - offset;
+  dmeta->n_slices           = smeta->n_slices;
+  dmeta->slice_offsets      = g_new (guint32, smeta->n_slices + 1);
+  memcpy (dmeta->slice_offsets, smeta->slice_offsets,
+      (smeta->n_slices + 1) * sizeof (guint32));
+
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_vc2_slice_index_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi =
+        gst_meta_register (GST_VC2_SLICE_INDEX_META_API_TYPE,
+        "GstVC2SliceIndexMeta",
+        sizeof (GstVC2SliceIndexMeta),
+        gst_vc2_slice_index_meta_init,
+        gst_vc2_slice_index_meta_free,
+        gst_vc2_slice_index_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+/**
+ * gst_buffer_add_vc2_slice_index_meta:
+ * @buffer: a #GstBuffer holding a single HQ picture
+ * @picture_number: the picture number
+ * @params: the transform parameters of the picture
+ * @slice_data_offset: offset in @buffer of the first slice
+ *
+ * Attaches a slice index to @buffer. The slice_offsets table is allocated
+ * with room for every slice plus the end offset and must be filled in by the
+ * caller.
+ *
+ * Returns: (transfer none): the #GstVC2SliceIndexMeta on @buffer.
+ */
+GstVC2SliceIndexMeta *
+gst_buffer_add_vc2_slice_index_meta (GstBuffer * buffer,
+    guint32 picture_number, const vc2_hq_transform_parameters * params,
+    gsize slice_data_offset)
+{
+  GstVC2SliceIndexMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (params != NULL, NULL);
+
+  meta = (GstVC2SliceIndexMeta *) gst_buffer_add_meta (buffer,
+      GST_VC2_SLICE_INDEX_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+
+  meta->picture_number     = picture_number;
+  meta->wavelet_index      = params->wavelet_index;
+  meta->dwt_depth          = params->dwt_depth;
+  meta->slices_x           = params->slices_x;
+  meta->slices_y           = params->slices_y;
+  meta->slice_prefix_bytes = params->slice_prefix_bytes;
+  meta->slice_size_scalar  = params->slice_size_scalar;
+  meta->slice_data_offset  = slice_data_offset;
+  meta->n_slices           = params->slices_x * params->slices_y;
+  meta->slice_offsets      = g_new0 (guint32, meta->n_slices + 1);
+
+  return meta;
+}
@@ -0,0 +1,83 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VC2_META_H__
+#define __GST_VC2_META_H__
+
+#include <gst/gst.h>
+
+#include "vc2vlcparse.h"
+
+G_BEGIN_DECLS
+
+#define GST_VC2_SLICE_INDEX_META_API_TYPE (gst_vc2_slice_index_meta_api_get_type())
+#define GST_VC2_SLICE_INDEX_META_INFO     (gst_vc2_slice_index_meta_get_info())
+
+typedef struct _GstVC2SliceIndexMeta GstVC2SliceIndexMeta;
+
+/**
+ * GstVC2SliceIndexMeta:
+ * @meta: parent #GstMeta
+ * @picture_number: the picture number of the picture
+ * @wavelet_index: transform parameters of the picture
+ * @dwt_depth: transform parameters of the picture
+ * @slices_x: number of slices horizontally
+ * @slices_y: number of slices vertically
+ * @slice_prefix_bytes: transform parameters of the picture
+ * @slice_size_scalar: transform parameters of the picture
+ * @slice_data_offset: offset in the buffer of the first slice
+ * @n_slices: number of slices in the picture, slices_x*slices_y
+ * @slice_offsets: offset of each slice in raster order relative to the first
+ *   slice, followed by the offset of the end of the last slice
+ *
+ * Carries the slice layout of a single HQ picture, so that elements which
+ * need to find slice boundaries don't have to walk every slice header.
+ */
+struct _GstVC2SliceIndexMeta {
+  GstMeta meta;
+
+  guint32 picture_number;
+
+  guint32 wavelet_index;
+  guint32 dwt_depth;
+  guint32 slices_x;
+  guint32 slices_y;
+  guint32 slice_prefix_bytes;
+  guint32 slice_size_scalar;
+
+  gsize    slice_data_offset;
+  guint    n_slices;
+  guint32 *slice_offsets;
+};
+
+GType gst_vc2_slice_index_meta_api_get_type (void);
+const GstMetaInfo *gst_vc2_slice_index_meta_get_info (void);
+
+#define gst_buffer_get_vc2_slice_index_meta(b) \
+  ((GstVC2SliceIndexMeta*)gst_buffer_get_meta((b),GST_VC2_SLICE_INDEX_META_API_TYPE))
+
+GstVC2SliceIndexMeta *gst_buffer_add_vc2_slice_index_meta (GstBuffer *buffer,
+                                                           guint32 picture_number,
+                                                           const vc2_hq_transform_parameters *params,
+                                                           gsize slice_data_offset);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_META_H__ */
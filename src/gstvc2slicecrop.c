@@ -0,0 +1,690 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstvc2slicecrop.h"
+#include "vc2stats.h"
+
+GST_DEBUG_CATEGORY_STATIC (vc2slicecrop_debug);
+#define GST_CAT_DEFAULT (vc2slicecrop_debug)
+
+/* Crops a VC-2 HQ stream to a rectangle of slices without decoding it.
+ *
+ * HQ slices are coded independently, so a picture holding only the slices
+ * in the rectangle is a valid picture in its own right once the transform
+ * parameters give the smaller slice grid and the sequence header gives the
+ * matching frame size. Each row of the rectangle is a contiguous run of
+ * the input, so the cost is one memcpy per row.
+ *
+ * This only works when every slice covers the same number of wavelet
+ * coefficients in every component, which is the case when the padded
+ * picture size at the coarsest level of the transform is a whole number of
+ * slices. The wavelet filters reach across slice boundaries, so a few
+ * pixels at the edges of the crop decode slightly differently from the
+ * same pixels in the full picture. */
+
+#define DEFAULT_LEFT   0
+#define DEFAULT_TOP    0
+#define DEFAULT_WIDTH  0
+#define DEFAULT_HEIGHT 0
+
+/* Transforms deeper than this cannot be described with 32 bit sizes */
+#define MAX_DWT_DEPTH 16
+
+/* The rewritten sequence header and transform parameters are at most a few
+ * bytes longer than the originals */
+#define MAX_HEADER_GROWTH 32
+
+enum
+{
+  PROP_0,
+  PROP_LEFT,
+  PROP_TOP,
+  PROP_WIDTH,
+  PROP_HEIGHT,
+  PROP_STATS
+};
+
+static GstStaticPadTemplate gst_vc2_slice_crop_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vc2;"
+                     "video/x-dirac")
+    );
+
+static GstStaticPadTemplate gst_vc2_slice_crop_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vc2;"
+                     "video/x-dirac")
+    );
+
+static void gst_vc2_slice_crop_finalize (GObject * object);
+static void gst_vc2_slice_crop_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_slice_crop_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static GstStateChangeReturn gst_vc2_slice_crop_change_state (GstElement *
+    element, GstStateChange transition);
+static GstFlowReturn gst_vc2_slice_crop_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+static gboolean gst_vc2_slice_crop_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+
+#define gst_vc2_slice_crop_parent_class parent_class
+G_DEFINE_TYPE (GstVC2SliceCrop, gst_vc2_slice_crop, GST_TYPE_ELEMENT);
+
+static void
+gst_vc2_slice_crop_class_init (GstVC2SliceCropClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->finalize = gst_vc2_slice_crop_finalize;
+  gobject_class->set_property = gst_vc2_slice_crop_set_property;
+  gobject_class->get_property = gst_vc2_slice_crop_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LEFT,
+      g_param_spec_uint ("left", "Left",
+          "First column of slices to keep",
+          0, G_MAXUINT32, DEFAULT_LEFT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TOP,
+      g_param_spec_uint ("top", "Top",
+          "First row of slices to keep",
+          0, G_MAXUINT32, DEFAULT_TOP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_WIDTH,
+      g_param_spec_uint ("width", "Width",
+          "Number of columns of slices to keep (0 = up to the right edge)",
+          0, G_MAXUINT32, DEFAULT_WIDTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_HEIGHT,
+      g_param_spec_uint ("height", "Height",
+          "Number of rows of slices to keep (0 = down to the bottom edge)",
+          0, G_MAXUINT32, DEFAULT_HEIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of pictures cropped and dropped, and bytes in and out",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_slice_crop_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_slice_crop_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 slice crop", "Filter/Editor/Video",
+      "Crops a VC-2 HQ stream to a rectangle of slices without decoding it",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstelement_class->change_state = gst_vc2_slice_crop_change_state;
+
+  GST_DEBUG_CATEGORY_INIT (vc2slicecrop_debug, "vc2slicecrop", 0,
+      "VC2 Slice Crop");
+}
+
+static void
+gst_vc2_slice_crop_init (GstVC2SliceCrop * vc2slicecrop)
+{
+  vc2slicecrop->sinkpad =
+      gst_pad_new_from_static_template (&gst_vc2_slice_crop_sink_template, "sink");
+  gst_pad_set_chain_function (vc2slicecrop->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vc2_slice_crop_chain));
+  gst_pad_set_event_function (vc2slicecrop->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vc2_slice_crop_sink_event));
+  GST_PAD_SET_PROXY_CAPS (vc2slicecrop->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (vc2slicecrop), vc2slicecrop->sinkpad);
+
+  vc2slicecrop->srcpad =
+      gst_pad_new_from_static_template (&gst_vc2_slice_crop_src_template, "src");
+  GST_PAD_SET_PROXY_CAPS (vc2slicecrop->srcpad);
+  gst_element_add_pad (GST_ELEMENT (vc2slicecrop), vc2slicecrop->srcpad);
+
+  vc2slicecrop->left   = DEFAULT_LEFT;
+  vc2slicecrop->top    = DEFAULT_TOP;
+  vc2slicecrop->width  = DEFAULT_WIDTH;
+  vc2slicecrop->height = DEFAULT_HEIGHT;
+
+  vc2slicecrop->adapter = gst_adapter_new ();
+  vc2slicecrop->seq_hdr = NULL;
+}
+
+static void
+gst_vc2_slice_crop_reset (GstVC2SliceCrop * vc2slicecrop)
+{
+  gst_adapter_clear (vc2slicecrop->adapter);
+  vc2slicecrop->sync = FALSE;
+
+  vc2_sequence_header_free (vc2slicecrop->seq_hdr);
+  vc2slicecrop->seq_hdr = NULL;
+  vc2slicecrop->seq_hdr_pending  = FALSE;
+  vc2slicecrop->out_frame_width  = 0;
+  vc2slicecrop->out_frame_height = 0;
+  vc2slicecrop->prev_parse_offset = 0;
+}
+
+static void
+gst_vc2_slice_crop_reset_stats (GstVC2SliceCrop * vc2slicecrop)
+{
+  VC2_STATS_SET (vc2slicecrop->stats_pictures,         0);
+  VC2_STATS_SET (vc2slicecrop->stats_dropped_pictures, 0);
+  VC2_STATS_SET (vc2slicecrop->stats_sequence_headers, 0);
+  VC2_STATS_SET (vc2slicecrop->stats_resyncs,          0);
+  VC2_STATS_SET (vc2slicecrop->stats_bytes_in,         0);
+  VC2_STATS_SET (vc2slicecrop->stats_bytes_out,        0);
+}
+
+static void
+gst_vc2_slice_crop_finalize (GObject * object)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (object);
+
+  vc2_sequence_header_free (vc2slicecrop->seq_hdr);
+  g_object_unref (vc2slicecrop->adapter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static guint32
+gst_vc2_slice_crop_pad (guint32 size, guint32 dwt_depth)
+{
+  guint32 scale = 1 << dwt_depth;
+
+  return (size + scale - 1)/scale;
+}
+
+/* Works out the size along one axis of the cropped picture for the luma
+ * and a colour difference component subsampled by sub. size is the luma
+ * size of the full picture and the crop keeps count of its slices from
+ * first. Fails unless each slice covers the same number of coefficients at
+ * the coarsest level of the transform in both components, and the crop
+ * keeps that true. */
+static gboolean
+gst_vc2_slice_crop_axis (guint32 size, guint32 sub, guint32 dwt_depth,
+    guint32 slices, guint32 first, guint32 count, guint32 * new_size)
+{
+  guint32 luma, chroma, start, end;
+
+  luma   = gst_vc2_slice_crop_pad (size, dwt_depth);
+  chroma = gst_vc2_slice_crop_pad (size/sub, dwt_depth);
+  if (luma % slices != 0 || chroma % slices != 0 ||
+      (luma/slices) != (chroma/slices)*sub)
+    return FALSE;
+
+  start = (first*(luma/slices)) << dwt_depth;
+  end   = MIN (size, ((first + count)*(luma/slices)) << dwt_depth);
+  if (end <= start)
+    return FALSE;
+
+  *new_size = end - start;
+  return (gst_vc2_slice_crop_pad (*new_size, dwt_depth) == count*(luma/slices) &&
+          gst_vc2_slice_crop_pad (*new_size/sub, dwt_depth) == count*(chroma/slices));
+}
+
+static void
+gst_vc2_slice_crop_set_timestamps (GstBuffer * outbuf, GstBuffer * inbuf)
+{
+  GST_BUFFER_PTS (outbuf)      = GST_BUFFER_PTS (inbuf);
+  GST_BUFFER_DTS (outbuf)      = GST_BUFFER_DTS (inbuf);
+  GST_BUFFER_DURATION (outbuf) = GST_BUFFER_DURATION (inbuf);
+}
+
+static GstFlowReturn
+gst_vc2_slice_crop_push (GstVC2SliceCrop * vc2slicecrop, GstBuffer * outbuf)
+{
+  VC2_STATS_ADD (vc2slicecrop->stats_bytes_out, gst_buffer_get_size (outbuf));
+  return gst_pad_push (vc2slicecrop->srcpad, outbuf);
+}
+
+/* buf is an HQ picture without its parse info header. The output is the
+ * cropped picture with a new parse info header, preceded by a rewritten
+ * sequence header when one has arrived since the last picture or the size
+ * of the crop has changed. */
+static GstFlowReturn
+gst_vc2_slice_crop_picture (GstVC2SliceCrop * vc2slicecrop, GstBuffer * buf)
+{
+  vc2_sequence_header *seq_hdr = vc2slicecrop->seq_hdr;
+  vc2_hq_transform_parameters *params;
+  guint left, top, width, height;
+  guint32 frame_width, frame_height, picture_height, sub_x, sub_y;
+  guint8 *seq_hdr_data = NULL, *params_data = NULL, *p;
+  gsize seq_hdr_size = 0, params_size = 0, picture_size;
+  gsize offset, length, *rows;
+  guint32 x, y, n_rows;
+  GstBuffer *outbuf;
+  GstMapInfo info, outinfo;
+
+  if (seq_hdr == NULL) {
+    GST_DEBUG_OBJECT (vc2slicecrop, "no sequence header yet, dropping picture");
+    goto drop;
+  }
+
+  if (!gst_buffer_map (buf, &info, GST_MAP_READ))
+    goto drop;
+
+  params = (info.size > 4) ? vc2_hq_transform_parameters_new (info.data + 4, info.size - 4) : NULL;
+  if (params == NULL || params->dwt_depth > MAX_DWT_DEPTH) {
+    GST_WARNING_OBJECT (vc2slicecrop, "invalid transform parameters, dropping picture");
+    vc2_hq_transform_parameters_free (params);
+    gst_buffer_unmap (buf, &info);
+    goto drop;
+  }
+
+  GST_OBJECT_LOCK (vc2slicecrop);
+  left   = MIN (vc2slicecrop->left, params->slices_x);
+  top    = MIN (vc2slicecrop->top,  params->slices_y);
+  width  = params->slices_x - left;
+  height = params->slices_y - top;
+  if (vc2slicecrop->width > 0)
+    width  = MIN (width,  vc2slicecrop->width);
+  if (vc2slicecrop->height > 0)
+    height = MIN (height, vc2slicecrop->height);
+  GST_OBJECT_UNLOCK (vc2slicecrop);
+
+  if (width == 0 || height == 0) {
+    GST_ELEMENT_ERROR (vc2slicecrop, RESOURCE, SETTINGS, (NULL),
+        ("the crop lies outside the %ux%u slice grid", params->slices_x, params->slices_y));
+    vc2_hq_transform_parameters_free (params);
+    gst_buffer_unmap (buf, &info);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  sub_x = (seq_hdr->color_diff_format == VC2_COLOR_DIFF_444) ? 1 : 2;
+  sub_y = (seq_hdr->color_diff_format == VC2_COLOR_DIFF_420) ? 2 : 1;
+  if (!gst_vc2_slice_crop_axis (seq_hdr->picture_width, sub_x, params->dwt_depth,
+          params->slices_x, left, width, &frame_width) ||
+      !gst_vc2_slice_crop_axis (seq_hdr->picture_height, sub_y, params->dwt_depth,
+          params->slices_y, top, height, &picture_height)) {
+    GST_ELEMENT_ERROR (vc2slicecrop, STREAM, FORMAT, (NULL),
+        ("a %ux%u picture with %ux%u slices and a depth %u transform cannot be "
+         "cropped on slice boundaries", seq_hdr->picture_width, seq_hdr->picture_height,
+         params->slices_x, params->slices_y, params->dwt_depth));
+    vc2_hq_transform_parameters_free (params);
+    gst_buffer_unmap (buf, &info);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+  frame_height = (seq_hdr->interlaced) ? picture_height*2 : picture_height;
+
+  /* Find the run of bytes holding each row of the crop, joining runs which
+   * follow on from each other */
+  rows = g_new (gsize, 2*height);
+  n_rows = 0;
+  offset = 4 + params->coded_size;
+  for (y = 0; y < top + height; y++) {
+    for (x = 0; x < params->slices_x; x++) {
+      if (y >= top && x == left) {
+        if (n_rows > 0 && rows[2*n_rows - 1] == offset) {
+          n_rows--;
+        } else {
+          rows[2*n_rows] = offset;
+        }
+      }
+
+      length = (offset < info.size) ?
+          vc2_hq_slice_length (info.data + offset, info.size - offset,
+              params->slice_prefix_bytes, params->slice_size_scalar) : 0;
+      if (length == 0) {
+        GST_WARNING_OBJECT (vc2slicecrop, "picture is truncated, dropping it");
+        g_free (rows);
+        vc2_hq_transform_parameters_free (params);
+        gst_buffer_unmap (buf, &info);
+        goto drop;
+      }
+      offset += length;
+
+      if (y >= top && x == left + width - 1)
+        rows[2*n_rows++ + 1] = offset;
+    }
+  }
+
+  params_data = g_malloc (params->coded_size + MAX_HEADER_GROWTH);
+  params_size = vc2_hq_transform_parameters_write_slices (info.data + 4, params->coded_size,
+      width, height, params_data, params->coded_size + MAX_HEADER_GROWTH);
+  vc2_hq_transform_parameters_free (params);
+
+  if (params_size == 0) {
+    GST_WARNING_OBJECT (vc2slicecrop, "could not rewrite the transform parameters, dropping picture");
+    g_free (params_data);
+    g_free (rows);
+    gst_buffer_unmap (buf, &info);
+    goto drop;
+  }
+
+  if (vc2slicecrop->seq_hdr_pending ||
+      frame_width  != vc2slicecrop->out_frame_width ||
+      frame_height != vc2slicecrop->out_frame_height) {
+    seq_hdr_data = g_malloc (seq_hdr->length + MAX_HEADER_GROWTH);
+    seq_hdr_size = vc2_sequence_header_write_dimensions (seq_hdr, frame_width, frame_height,
+        seq_hdr_data, seq_hdr->length + MAX_HEADER_GROWTH);
+    if (seq_hdr_size == 0) {
+      GST_WARNING_OBJECT (vc2slicecrop, "could not rewrite the sequence header, dropping picture");
+      g_free (seq_hdr_data);
+      g_free (params_data);
+      g_free (rows);
+      gst_buffer_unmap (buf, &info);
+      goto drop;
+    }
+
+    GST_DEBUG_OBJECT (vc2slicecrop, "cropping to %ux%u slices at %u,%u, a %ux%u frame",
+        width, height, left, top, frame_width, frame_height);
+    vc2slicecrop->seq_hdr_pending  = FALSE;
+    vc2slicecrop->out_frame_width  = frame_width;
+    vc2slicecrop->out_frame_height = frame_height;
+  }
+
+  picture_size = 13 + 4 + params_size;
+  for (y = 0; y < n_rows; y++)
+    picture_size += rows[2*y + 1] - rows[2*y];
+
+  outbuf = gst_buffer_new_allocate (NULL, ((seq_hdr_data) ? 13 + seq_hdr_size : 0) + picture_size, NULL);
+  gst_buffer_map (outbuf, &outinfo, GST_MAP_WRITE);
+  p = outinfo.data;
+
+  if (seq_hdr_data) {
+    vc2_parse_info_write (p, 0x00, 13 + seq_hdr_size, vc2slicecrop->prev_parse_offset);
+    memcpy (p + 13, seq_hdr_data, seq_hdr_size);
+    p += 13 + seq_hdr_size;
+    vc2slicecrop->prev_parse_offset = 13 + seq_hdr_size;
+    g_free (seq_hdr_data);
+  }
+
+  vc2_parse_info_write (p, 0xE8, picture_size, vc2slicecrop->prev_parse_offset);
+  memcpy (p + 13, info.data, 4);
+  memcpy (p + 17, params_data, params_size);
+  p += 17 + params_size;
+  vc2slicecrop->prev_parse_offset = picture_size;
+  g_free (params_data);
+
+  for (y = 0; y < n_rows; y++) {
+    memcpy (p, info.data + rows[2*y], rows[2*y + 1] - rows[2*y]);
+    p += rows[2*y + 1] - rows[2*y];
+  }
+  g_free (rows);
+
+  gst_buffer_unmap (outbuf, &outinfo);
+  gst_buffer_unmap (buf, &info);
+
+  gst_vc2_slice_crop_set_timestamps (outbuf, buf);
+  gst_buffer_unref (buf);
+
+  VC2_STATS_INC (vc2slicecrop->stats_pictures);
+  return gst_vc2_slice_crop_push (vc2slicecrop, outbuf);
+
+drop:
+  VC2_STATS_INC (vc2slicecrop->stats_dropped_pictures);
+  gst_buffer_unref (buf);
+  return GST_FLOW_OK;
+}
+
+/* Passes a data unit which is not changed by the crop, with its parse info
+ * header rewritten to point back to the last unit sent */
+static GstFlowReturn
+gst_vc2_slice_crop_pass (GstVC2SliceCrop * vc2slicecrop, GstBuffer * buf,
+    vc2_parse_info * info)
+{
+  guint8 head[13];
+
+  buf = gst_buffer_make_writable (buf);
+  vc2_parse_info_write (head, info->parse_code, info->next_parse_offset, vc2slicecrop->prev_parse_offset);
+  gst_buffer_fill (buf, 0, head, 13);
+  vc2slicecrop->prev_parse_offset = info->next_parse_offset;
+
+  return gst_vc2_slice_crop_push (vc2slicecrop, buf);
+}
+
+static GstFlowReturn
+gst_vc2_slice_crop_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (parent);
+  GstFlowReturn ret = GST_FLOW_OK;
+  vc2_parse_info info;
+  vc2_parse_info_result res;
+  GstBuffer *unit;
+  gsize size;
+
+  VC2_STATS_ADD (vc2slicecrop->stats_bytes_in, gst_buffer_get_size (buf));
+  gst_adapter_push (vc2slicecrop->adapter, buf);
+
+  while (ret == GST_FLOW_OK) {
+    size = gst_adapter_available (vc2slicecrop->adapter);
+    if (size < 13)
+      break;
+
+    if (!vc2slicecrop->sync) {
+      gssize parse_info_offset = vc2_parse_info_find (vc2slicecrop->adapter, size, 0, VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE);
+      if (parse_info_offset < 0)
+        break;
+
+      gst_adapter_flush (vc2slicecrop->adapter, parse_info_offset);
+      size -= parse_info_offset;
+      vc2slicecrop->sync = TRUE;
+    }
+
+    res = vc2_parse_info_extract (vc2slicecrop->adapter, size, 0, VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE, &info);
+    if (res == VC2_PARSE_INFO_NEED_DATA)
+      break;
+    if (res == VC2_PARSE_INFO_INVALID) {
+      GST_WARNING_OBJECT (vc2slicecrop, "invalid parse info header, resynchronising");
+      VC2_STATS_INC (vc2slicecrop->stats_resyncs);
+      vc2slicecrop->sync = FALSE;
+      continue;
+    }
+
+    if ((info.parse_code == 0x00 && info.next_parse_offset <= 13) ||
+        (info.parse_code == 0xE8 && info.next_parse_offset <= 13 + 4)) {
+      GST_WARNING_OBJECT (vc2slicecrop, "empty data unit, parse code 0x%02x", info.parse_code);
+      gst_adapter_flush (vc2slicecrop->adapter, info.next_parse_offset);
+      continue;
+    }
+
+    switch (info.parse_code) {
+      case 0x00:  /* sequence header */
+        gst_adapter_flush (vc2slicecrop->adapter, 13);
+        unit = gst_adapter_take_buffer_fast (vc2slicecrop->adapter, info.next_parse_offset - 13);
+        VC2_STATS_INC (vc2slicecrop->stats_sequence_headers);
+
+        if (!vc2_sequence_header_cmp (vc2slicecrop->seq_hdr, unit, info.next_parse_offset - 13)) {
+          vc2_sequence_header_free (vc2slicecrop->seq_hdr);
+          vc2slicecrop->seq_hdr = vc2_sequence_header_new (unit);
+          if (vc2slicecrop->seq_hdr == NULL)
+            GST_WARNING_OBJECT (vc2slicecrop, "invalid or unsupported sequence header");
+        }
+        gst_buffer_unref (unit);
+
+        /* sent in front of the next picture, once the size of the crop is
+         * known */
+        vc2slicecrop->seq_hdr_pending = TRUE;
+        break;
+      case 0xE8:  /* HQ picture */
+        gst_adapter_flush (vc2slicecrop->adapter, 13);
+        unit = gst_adapter_take_buffer_fast (vc2slicecrop->adapter, info.next_parse_offset - 13);
+        ret = gst_vc2_slice_crop_picture (vc2slicecrop, unit);
+        break;
+      case 0x10:  /* end of sequence */
+        unit = gst_adapter_take_buffer_fast (vc2slicecrop->adapter, 13);
+        info.next_parse_offset = 0;
+        ret = gst_vc2_slice_crop_pass (vc2slicecrop, unit, &info);
+        vc2slicecrop->prev_parse_offset = 0;
+        vc2slicecrop->sync = FALSE;
+        break;
+      case 0x20:  /* auxiliary data */
+      case 0x30:  /* padding data */
+        unit = gst_adapter_take_buffer_fast (vc2slicecrop->adapter, info.next_parse_offset);
+        ret = gst_vc2_slice_crop_pass (vc2slicecrop, unit, &info);
+        break;
+      default:
+        /* low delay pictures and HQ fragments are not cropped */
+        if (info.parse_code & 0x08) {
+          GST_DEBUG_OBJECT (vc2slicecrop, "dropping unsupported picture, parse code 0x%02x", info.parse_code);
+          VC2_STATS_INC (vc2slicecrop->stats_dropped_pictures);
+        }
+        gst_adapter_flush (vc2slicecrop->adapter, info.next_parse_offset);
+        break;
+    }
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_vc2_slice_crop_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      gst_adapter_clear (vc2slicecrop->adapter);
+      vc2slicecrop->sync = FALSE;
+      vc2slicecrop->seq_hdr_pending = TRUE;
+      vc2slicecrop->prev_parse_offset = 0;
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+gst_vc2_slice_crop_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_vc2_slice_crop_reset (vc2slicecrop);
+      gst_vc2_slice_crop_reset_stats (vc2slicecrop);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_vc2_slice_crop_reset (vc2slicecrop);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static GstStructure *
+gst_vc2_slice_crop_get_stats (GstVC2SliceCrop * vc2slicecrop)
+{
+  return gst_structure_new ("application/x-vc2-slice-crop-stats",
+      "pictures",         G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_pictures),
+      "dropped-pictures", G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_dropped_pictures),
+      "sequence-headers", G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_sequence_headers),
+      "resyncs",          G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_resyncs),
+      "bytes-in",         G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_bytes_in),
+      "bytes-out",        G_TYPE_UINT64, VC2_STATS_GET (vc2slicecrop->stats_bytes_out),
+      NULL);
+}
+
+static void
+gst_vc2_slice_crop_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (object);
+
+  GST_OBJECT_LOCK (vc2slicecrop);
+  switch (prop_id) {
+    case PROP_LEFT:
+      vc2slicecrop->left = g_value_get_uint (value);
+      break;
+    case PROP_TOP:
+      vc2slicecrop->top = g_value_get_uint (value);
+      break;
+    case PROP_WIDTH:
+      vc2slicecrop->width = g_value_get_uint (value);
+      break;
+    case PROP_HEIGHT:
+      vc2slicecrop->height = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2slicecrop);
+}
+
+static void
+gst_vc2_slice_crop_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2SliceCrop *vc2slicecrop = GST_VC2_SLICE_CROP (object);
+
+  GST_OBJECT_LOCK (vc2slicecrop);
+  switch (prop_id) {
+    case PROP_LEFT:
+      g_value_set_uint (value, vc2slicecrop->left);
+      break;
+    case PROP_TOP:
+      g_value_set_uint (value, vc2slicecrop->top);
+      break;
+    case PROP_WIDTH:
+      g_value_set_uint (value, vc2slicecrop->width);
+      break;
+    case PROP_HEIGHT:
+      g_value_set_uint (value, vc2slicecrop->height);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vc2_slice_crop_get_stats (vc2slicecrop));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2slicecrop);
+}
+
+gboolean
+gst_vc2_slice_crop_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2slicecrop",
+                               GST_RANK_NONE, GST_TYPE_VC2_SLICE_CROP);
+}
@@ -0,0 +1,86 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VC2_SLICE_CROP_H__
+#define __GST_VC2_SLICE_CROP_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+
+#include "vc2vlcparse.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_SLICE_CROP \
+  (gst_vc2_slice_crop_get_type())
+#define GST_VC2_SLICE_CROP(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_SLICE_CROP,GstVC2SliceCrop))
+#define GST_VC2_SLICE_CROP_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_SLICE_CROP,GstVC2SliceCropClass))
+#define GST_IS_VC2_SLICE_CROP(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_SLICE_CROP))
+#define GST_IS_VC2_SLICE_CROP_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_SLICE_CROP))
+
+typedef struct _GstVC2SliceCrop GstVC2SliceCrop;
+typedef struct _GstVC2SliceCropClass GstVC2SliceCropClass;
+
+struct _GstVC2SliceCrop
+{
+  GstElement element;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* properties, in slices */
+  guint left;
+  guint top;
+  guint width;
+  guint height;
+
+  GstAdapter *adapter;
+  gboolean sync;
+
+  vc2_sequence_header *seq_hdr;
+  gboolean seq_hdr_pending;
+  guint32 out_frame_width;
+  guint32 out_frame_height;
+  guint32 prev_parse_offset;
+
+  guint64 stats_pictures;
+  guint64 stats_dropped_pictures;
+  guint64 stats_sequence_headers;
+  guint64 stats_resyncs;
+  guint64 stats_bytes_in;
+  guint64 stats_bytes_out;
+};
+
+struct _GstVC2SliceCropClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_vc2_slice_crop_get_type (void);
+
+gboolean gst_vc2_slice_crop_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_SLICE_CROP_H__ */
@@ -0,0 +1,668 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gstvc2slicetile.h"
+#include "vc2stats.h"
+
+GST_DEBUG_CATEGORY_STATIC (vc2slicetile_debug);
+#define GST_CAT_DEFAULT (vc2slicetile_debug)
+
+/* Tiles several VC-2 HQ streams into one picture without decoding them.
+ *
+ * Input sink_N goes in column N % columns and row N / columns of the
+ * mosaic. When every input has the same picture size, colour difference
+ * format and scan, and identical transform parameters (wavelet, depth,
+ * slice grid, slice prefix and scalar, quantisation matrix), the slices of
+ * the inputs can be laid side by side in one larger slice grid: each row of
+ * the output grid is made of the matching slice row of each input in turn.
+ * Only the sequence header and transform parameters are rewritten; the
+ * slices are copied unchanged, one memcpy per input slice row.
+ *
+ * The slices of each input must cover equal areas of the picture, so that
+ * the slice boundaries of the mosaic line up with those of the inputs; see
+ * gst_vc2_slice_tile_axis. One picture is taken from each input in turn, so
+ * the inputs must run at the same rate, and for interlaced streams start on
+ * the same field. The output picture number and timestamps come from input
+ * 0. As in vc2slicecrop, the wavelet filters reach across slice boundaries,
+ * so pixels next to the joins decode slightly differently. */
+
+#define DEFAULT_COLUMNS 2
+
+/* Transforms deeper than this cannot be described with 32 bit sizes */
+#define MAX_DWT_DEPTH 16
+
+/* The rewritten sequence header and transform parameters are at most a few
+ * bytes longer than the originals */
+#define MAX_HEADER_GROWTH 32
+
+enum
+{
+  PROP_0,
+  PROP_COLUMNS,
+  PROP_STATS
+};
+
+static GstStaticPadTemplate gst_vc2_slice_tile_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("video/x-vc2;"
+                     "video/x-dirac")
+    );
+
+static GstStaticPadTemplate gst_vc2_slice_tile_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-dirac")
+    );
+
+#define gst_vc2_slice_tile_pad_parent_class pad_parent_class
+G_DEFINE_TYPE (GstVC2SliceTilePad, gst_vc2_slice_tile_pad, GST_TYPE_AGGREGATOR_PAD);
+
+static void
+gst_vc2_slice_tile_pad_reset (GstVC2SliceTilePad * pad)
+{
+  gst_adapter_clear (pad->adapter);
+  pad->sync = FALSE;
+  gst_buffer_replace (&pad->picture, NULL);
+}
+
+static void
+gst_vc2_slice_tile_pad_constructed (GObject * object)
+{
+  GstVC2SliceTilePad *pad = GST_VC2_SLICE_TILE_PAD (object);
+
+  G_OBJECT_CLASS (pad_parent_class)->constructed (object);
+
+  if (sscanf (GST_PAD_NAME (pad), "sink_%u", &pad->index) != 1)
+    pad->index = G_MAXUINT;
+}
+
+static void
+gst_vc2_slice_tile_pad_finalize (GObject * object)
+{
+  GstVC2SliceTilePad *pad = GST_VC2_SLICE_TILE_PAD (object);
+
+  gst_vc2_slice_tile_pad_reset (pad);
+  vc2_sequence_header_free (pad->seq_hdr);
+  g_object_unref (pad->adapter);
+
+  G_OBJECT_CLASS (pad_parent_class)->finalize (object);
+}
+
+static GstFlowReturn
+gst_vc2_slice_tile_pad_flush (GstAggregatorPad * aggpad, GstAggregator * agg)
+{
+  GstVC2SliceTilePad *pad = GST_VC2_SLICE_TILE_PAD (aggpad);
+
+  gst_vc2_slice_tile_pad_reset (pad);
+
+  /* send the sequence header again with the first picture after the flush */
+  pad->seq_hdr_seen = (pad->seq_hdr != NULL);
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_vc2_slice_tile_pad_class_init (GstVC2SliceTilePadClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstAggregatorPadClass *aggpad_class = (GstAggregatorPadClass *) klass;
+
+  gobject_class->constructed = gst_vc2_slice_tile_pad_constructed;
+  gobject_class->finalize = gst_vc2_slice_tile_pad_finalize;
+
+  aggpad_class->flush = GST_DEBUG_FUNCPTR (gst_vc2_slice_tile_pad_flush);
+}
+
+static void
+gst_vc2_slice_tile_pad_init (GstVC2SliceTilePad * pad)
+{
+  pad->index        = G_MAXUINT;
+  pad->adapter      = gst_adapter_new ();
+  pad->sync         = FALSE;
+  pad->seq_hdr      = NULL;
+  pad->seq_hdr_seen = FALSE;
+  pad->picture      = NULL;
+}
+
+static void gst_vc2_slice_tile_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_slice_tile_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_vc2_slice_tile_start (GstAggregator * agg);
+static gboolean gst_vc2_slice_tile_stop (GstAggregator * agg);
+static GstFlowReturn gst_vc2_slice_tile_flush (GstAggregator * agg);
+static GstFlowReturn gst_vc2_slice_tile_aggregate (GstAggregator * agg,
+    gboolean timeout);
+
+#define gst_vc2_slice_tile_parent_class parent_class
+G_DEFINE_TYPE (GstVC2SliceTile, gst_vc2_slice_tile, GST_TYPE_AGGREGATOR);
+
+static void
+gst_vc2_slice_tile_class_init (GstVC2SliceTileClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstAggregatorClass *gstaggregator_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstaggregator_class = (GstAggregatorClass *) klass;
+
+  gobject_class->set_property = gst_vc2_slice_tile_set_property;
+  gobject_class->get_property = gst_vc2_slice_tile_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_COLUMNS,
+      g_param_spec_uint ("columns", "Columns",
+          "Number of inputs across the mosaic; input N goes in column N % columns",
+          1, G_MAXUINT16, DEFAULT_COLUMNS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of pictures made and input pictures dropped",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_slice_tile_src_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_slice_tile_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 slice tile", "Filter/Editor/Video",
+      "Tiles VC-2 HQ streams into one picture without decoding them",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstaggregator_class->sinkpads_type = GST_TYPE_VC2_SLICE_TILE_PAD;
+  gstaggregator_class->start = GST_DEBUG_FUNCPTR (gst_vc2_slice_tile_start);
+  gstaggregator_class->stop = GST_DEBUG_FUNCPTR (gst_vc2_slice_tile_stop);
+  gstaggregator_class->flush = GST_DEBUG_FUNCPTR (gst_vc2_slice_tile_flush);
+  gstaggregator_class->aggregate = GST_DEBUG_FUNCPTR (gst_vc2_slice_tile_aggregate);
+
+  GST_DEBUG_CATEGORY_INIT (vc2slicetile_debug, "vc2slicetile", 0,
+      "VC2 Slice Tile");
+}
+
+static void
+gst_vc2_slice_tile_init (GstVC2SliceTile * vc2slicetile)
+{
+  vc2slicetile->columns = DEFAULT_COLUMNS;
+}
+
+static void
+gst_vc2_slice_tile_reset (GstVC2SliceTile * vc2slicetile)
+{
+  GList *l;
+
+  GST_OBJECT_LOCK (vc2slicetile);
+  for (l = GST_ELEMENT (vc2slicetile)->sinkpads; l; l = l->next) {
+    GstVC2SliceTilePad *pad = GST_VC2_SLICE_TILE_PAD (l->data);
+
+    gst_vc2_slice_tile_pad_reset (pad);
+    vc2_sequence_header_free (pad->seq_hdr);
+    pad->seq_hdr      = NULL;
+    pad->seq_hdr_seen = FALSE;
+  }
+  GST_OBJECT_UNLOCK (vc2slicetile);
+
+  vc2slicetile->out_frame_width   = 0;
+  vc2slicetile->out_frame_height  = 0;
+  vc2slicetile->prev_parse_offset = 0;
+}
+
+static gboolean
+gst_vc2_slice_tile_start (GstAggregator * agg)
+{
+  GstVC2SliceTile *vc2slicetile = GST_VC2_SLICE_TILE (agg);
+
+  gst_vc2_slice_tile_reset (vc2slicetile);
+
+  VC2_STATS_SET (vc2slicetile->stats_pictures,         0);
+  VC2_STATS_SET (vc2slicetile->stats_dropped_pictures, 0);
+  VC2_STATS_SET (vc2slicetile->stats_bytes_out,        0);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_slice_tile_stop (GstAggregator * agg)
+{
+  gst_vc2_slice_tile_reset (GST_VC2_SLICE_TILE (agg));
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_vc2_slice_tile_flush (GstAggregator * agg)
+{
+  GST_VC2_SLICE_TILE (agg)->prev_parse_offset = 0;
+
+  return GST_FLOW_OK;
+}
+
+/* Parses the data queued on pad until it holds a whole HQ picture. The
+ * latest sequence header is kept, and anything else is dropped. */
+static void
+gst_vc2_slice_tile_pad_parse (GstVC2SliceTile * vc2slicetile,
+    GstVC2SliceTilePad * pad)
+{
+  vc2_parse_info info;
+  vc2_parse_info_result res;
+  GstBuffer *unit;
+  gsize size;
+
+  while (pad->picture == NULL) {
+    size = gst_adapter_available (pad->adapter);
+    if (size < 13)
+      break;
+
+    if (!pad->sync) {
+      gssize parse_info_offset = vc2_parse_info_find (pad->adapter, size, 0, VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE);
+      if (parse_info_offset < 0)
+        break;
+
+      gst_adapter_flush (pad->adapter, parse_info_offset);
+      size -= parse_info_offset;
+      pad->sync = TRUE;
+    }
+
+    res = vc2_parse_info_extract (pad->adapter, size, 0, VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE, &info);
+    if (res == VC2_PARSE_INFO_NEED_DATA)
+      break;
+    if (res == VC2_PARSE_INFO_INVALID) {
+      GST_WARNING_OBJECT (pad, "invalid parse info header, resynchronising");
+      pad->sync = FALSE;
+      continue;
+    }
+
+    if ((info.parse_code == 0x00 && info.next_parse_offset <= 13) ||
+        (info.parse_code == 0xE8 && info.next_parse_offset <= 13 + 4)) {
+      GST_WARNING_OBJECT (pad, "empty data unit, parse code 0x%02x", info.parse_code);
+      gst_adapter_flush (pad->adapter, info.next_parse_offset);
+      continue;
+    }
+
+    switch (info.parse_code) {
+      case 0x00:  /* sequence header */
+        gst_adapter_flush (pad->adapter, 13);
+        unit = gst_adapter_take_buffer_fast (pad->adapter, info.next_parse_offset - 13);
+
+        if (!vc2_sequence_header_cmp (pad->seq_hdr, unit, info.next_parse_offset - 13)) {
+          vc2_sequence_header_free (pad->seq_hdr);
+          pad->seq_hdr = vc2_sequence_header_new (unit);
+          if (pad->seq_hdr == NULL)
+            GST_WARNING_OBJECT (pad, "invalid or unsupported sequence header");
+        }
+        gst_buffer_unref (unit);
+        pad->seq_hdr_seen = (pad->seq_hdr != NULL);
+        break;
+      case 0xE8:  /* HQ picture */
+        if (pad->seq_hdr == NULL) {
+          GST_DEBUG_OBJECT (pad, "no sequence header yet, dropping picture");
+          VC2_STATS_INC (vc2slicetile->stats_dropped_pictures);
+          gst_adapter_flush (pad->adapter, info.next_parse_offset);
+          break;
+        }
+        gst_adapter_flush (pad->adapter, 13);
+        pad->picture = gst_adapter_take_buffer_fast (pad->adapter, info.next_parse_offset - 13);
+        break;
+      case 0x10:  /* end of sequence */
+        gst_adapter_flush (pad->adapter, 13);
+        pad->sync = FALSE;
+        break;
+      default:
+        /* low delay pictures and HQ fragments cannot be tiled */
+        if (info.parse_code & 0x08) {
+          GST_DEBUG_OBJECT (pad, "dropping unsupported picture, parse code 0x%02x", info.parse_code);
+          VC2_STATS_INC (vc2slicetile->stats_dropped_pictures);
+        }
+        gst_adapter_flush (pad->adapter, info.next_parse_offset);
+        break;
+    }
+  }
+}
+
+/* The slices of a picture line up with those of its neighbours in the
+ * mosaic only if each covers the same area, with no padding, in the luma
+ * and in a colour difference component subsampled by sub */
+static gboolean
+gst_vc2_slice_tile_axis (guint32 size, guint32 sub, guint32 dwt_depth,
+    guint32 slices)
+{
+  return (size % (((guint64) sub << dwt_depth)*slices) == 0);
+}
+
+static gint
+gst_vc2_slice_tile_compare_pads (gconstpointer a, gconstpointer b)
+{
+  const GstVC2SliceTilePad *pad_a = *(GstVC2SliceTilePad * const *) a;
+  const GstVC2SliceTilePad *pad_b = *(GstVC2SliceTilePad * const *) b;
+
+  if (pad_a->index < pad_b->index)
+    return -1;
+  return (pad_a->index > pad_b->index) ? 1 : 0;
+}
+
+/* Builds one picture from the picture held on each of the n_pads pads,
+ * which are in mosaic order */
+static GstFlowReturn
+gst_vc2_slice_tile_compose (GstVC2SliceTile * vc2slicetile,
+    GstVC2SliceTilePad ** pads, guint n_pads, guint columns)
+{
+  vc2_sequence_header *seq_hdr = pads[0]->seq_hdr;
+  vc2_hq_transform_parameters *params = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo *info, outinfo;
+  guint8 *seq_hdr_data = NULL, *params_data = NULL, *p;
+  gsize seq_hdr_size = 0, params_size = 0, picture_size, length, *rows = NULL;
+  guint32 frame_width, frame_height, sub_x, sub_y, n_rows, x, y;
+  guint i, n_mapped, tile_rows;
+  GstBuffer *outbuf;
+
+  info = g_new0 (GstMapInfo, n_pads);
+  for (n_mapped = 0; n_mapped < n_pads; n_mapped++) {
+    if (!gst_buffer_map (pads[n_mapped]->picture, &info[n_mapped], GST_MAP_READ))
+      goto drop;
+  }
+
+  if (n_pads % columns != 0) {
+    GST_ELEMENT_ERROR (vc2slicetile, RESOURCE, SETTINGS, (NULL),
+        ("%u inputs do not make whole rows of %u", n_pads, columns));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+  tile_rows = n_pads/columns;
+
+  params = vc2_hq_transform_parameters_new (info[0].data + 4, info[0].size - 4);
+  if (params == NULL || params->dwt_depth > MAX_DWT_DEPTH) {
+    GST_WARNING_OBJECT (vc2slicetile, "invalid transform parameters on input 0, dropping pictures");
+    goto drop;
+  }
+
+  for (i = 1; i < n_pads; i++) {
+    vc2_sequence_header *other = pads[i]->seq_hdr;
+
+    if (other->picture_width     != seq_hdr->picture_width  ||
+        other->picture_height    != seq_hdr->picture_height ||
+        other->interlaced        != seq_hdr->interlaced     ||
+        other->color_diff_format != seq_hdr->color_diff_format ||
+        info[i].size < 4 + params->coded_size ||
+        memcmp (info[i].data + 4, info[0].data + 4, params->coded_size) != 0) {
+      GST_ELEMENT_ERROR (vc2slicetile, STREAM, FORMAT, (NULL),
+          ("input %u does not match input 0: the picture size, colour difference "
+           "format, scan and transform parameters must all be the same", pads[i]->index));
+      ret = GST_FLOW_ERROR;
+      goto done;
+    }
+  }
+
+  sub_x = (seq_hdr->color_diff_format == VC2_COLOR_DIFF_444) ? 1 : 2;
+  sub_y = (seq_hdr->color_diff_format == VC2_COLOR_DIFF_420) ? 2 : 1;
+  if (!gst_vc2_slice_tile_axis (seq_hdr->picture_width,  sub_x, params->dwt_depth, params->slices_x) ||
+      !gst_vc2_slice_tile_axis (seq_hdr->picture_height, sub_y, params->dwt_depth, params->slices_y)) {
+    GST_ELEMENT_ERROR (vc2slicetile, STREAM, FORMAT, (NULL),
+        ("a %ux%u picture with %ux%u slices and a depth %u transform cannot be "
+         "tiled on slice boundaries", seq_hdr->picture_width, seq_hdr->picture_height,
+         params->slices_x, params->slices_y, params->dwt_depth));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+
+  /* The start of each slice row of each input, and the end of the last */
+  n_rows = params->slices_y;
+  rows = g_new (gsize, n_pads*(n_rows + 1));
+  for (i = 0; i < n_pads; i++) {
+    gsize offset = 4 + params->coded_size;
+
+    for (y = 0; y < n_rows; y++) {
+      rows[i*(n_rows + 1) + y] = offset;
+      for (x = 0; x < params->slices_x; x++) {
+        length = (offset < info[i].size) ?
+            vc2_hq_slice_length (info[i].data + offset, info[i].size - offset,
+                params->slice_prefix_bytes, params->slice_size_scalar) : 0;
+        if (length == 0) {
+          GST_WARNING_OBJECT (vc2slicetile, "picture on input %u is truncated, dropping pictures", pads[i]->index);
+          goto drop;
+        }
+        offset += length;
+      }
+    }
+    rows[i*(n_rows + 1) + n_rows] = offset;
+  }
+
+  params_data = g_malloc (params->coded_size + MAX_HEADER_GROWTH);
+  params_size = vc2_hq_transform_parameters_write_slices (info[0].data + 4, params->coded_size,
+      columns*params->slices_x, tile_rows*params->slices_y,
+      params_data, params->coded_size + MAX_HEADER_GROWTH);
+  if (params_size == 0) {
+    GST_WARNING_OBJECT (vc2slicetile, "could not rewrite the transform parameters, dropping pictures");
+    goto drop;
+  }
+
+  frame_width  = columns*seq_hdr->picture_width;
+  frame_height = tile_rows*seq_hdr->picture_height*((seq_hdr->interlaced) ? 2 : 1);
+  if (pads[0]->seq_hdr_seen ||
+      frame_width  != vc2slicetile->out_frame_width ||
+      frame_height != vc2slicetile->out_frame_height) {
+    seq_hdr_data = g_malloc (seq_hdr->length + MAX_HEADER_GROWTH);
+    seq_hdr_size = vc2_sequence_header_write_dimensions (seq_hdr, frame_width, frame_height,
+        seq_hdr_data, seq_hdr->length + MAX_HEADER_GROWTH);
+    if (seq_hdr_size == 0) {
+      GST_WARNING_OBJECT (vc2slicetile, "could not rewrite the sequence header, dropping pictures");
+      goto drop;
+    }
+
+    GST_DEBUG_OBJECT (vc2slicetile, "tiling %ux%u inputs into a %ux%u frame",
+        columns, tile_rows, frame_width, frame_height);
+    pads[0]->seq_hdr_seen = FALSE;
+    vc2slicetile->out_frame_width  = frame_width;
+    vc2slicetile->out_frame_height = frame_height;
+  }
+
+  picture_size = 13 + 4 + params_size;
+  for (i = 0; i < n_pads; i++)
+    picture_size += rows[i*(n_rows + 1) + n_rows] - rows[i*(n_rows + 1)];
+
+  outbuf = gst_buffer_new_allocate (NULL, ((seq_hdr_data) ? 13 + seq_hdr_size : 0) + picture_size, NULL);
+  gst_buffer_map (outbuf, &outinfo, GST_MAP_WRITE);
+  p = outinfo.data;
+
+  if (seq_hdr_data) {
+    vc2_parse_info_write (p, 0x00, 13 + seq_hdr_size, vc2slicetile->prev_parse_offset);
+    memcpy (p + 13, seq_hdr_data, seq_hdr_size);
+    p += 13 + seq_hdr_size;
+    vc2slicetile->prev_parse_offset = 13 + seq_hdr_size;
+  }
+
+  vc2_parse_info_write (p, 0xE8, picture_size, vc2slicetile->prev_parse_offset);
+  memcpy (p + 13, info[0].data, 4);
+  memcpy (p + 17, params_data, params_size);
+  p += 17 + params_size;
+  vc2slicetile->prev_parse_offset = picture_size;
+
+  /* each row of the output slice grid is the same slice row of each input
+   * across one row of the mosaic */
+  for (i = 0; i < n_pads; i += columns) {
+    for (y = 0; y < n_rows; y++) {
+      for (x = i; x < i + columns; x++) {
+        gsize start = rows[x*(n_rows + 1) + y];
+        gsize end   = rows[x*(n_rows + 1) + y + 1];
+
+        memcpy (p, info[x].data + start, end - start);
+        p += end - start;
+      }
+    }
+  }
+
+  gst_buffer_unmap (outbuf, &outinfo);
+
+  GST_BUFFER_PTS (outbuf)      = GST_BUFFER_PTS (pads[0]->picture);
+  GST_BUFFER_DTS (outbuf)      = GST_BUFFER_DTS (pads[0]->picture);
+  GST_BUFFER_DURATION (outbuf) = GST_BUFFER_DURATION (pads[0]->picture);
+
+  VC2_STATS_INC (vc2slicetile->stats_pictures);
+  VC2_STATS_ADD (vc2slicetile->stats_bytes_out, gst_buffer_get_size (outbuf));
+
+  for (i = 0; i < n_mapped; i++)
+    gst_buffer_unmap (pads[i]->picture, &info[i]);
+  n_mapped = 0;
+
+  ret = gst_aggregator_finish_buffer (GST_AGGREGATOR (vc2slicetile), outbuf);
+  goto done;
+
+drop:
+  VC2_STATS_ADD (vc2slicetile->stats_dropped_pictures, n_pads);
+
+done:
+  for (i = 0; i < n_mapped; i++)
+    gst_buffer_unmap (pads[i]->picture, &info[i]);
+  for (i = 0; i < n_pads; i++)
+    gst_buffer_replace (&pads[i]->picture, NULL);
+
+  g_free (seq_hdr_data);
+  g_free (params_data);
+  g_free (rows);
+  vc2_hq_transform_parameters_free (params);
+  g_free (info);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_vc2_slice_tile_aggregate (GstAggregator * agg, gboolean timeout)
+{
+  GstVC2SliceTile *vc2slicetile = GST_VC2_SLICE_TILE (agg);
+  GstVC2SliceTilePad **pads;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean eos = FALSE, waiting = FALSE;
+  guint n_pads, columns, i;
+  GstBuffer *buf;
+  GList *l;
+
+  GST_OBJECT_LOCK (vc2slicetile);
+  n_pads = GST_ELEMENT (vc2slicetile)->numsinkpads;
+  pads = g_new (GstVC2SliceTilePad *, MAX (n_pads, 1));
+  for (l = GST_ELEMENT (vc2slicetile)->sinkpads, i = 0; l; l = l->next, i++)
+    pads[i] = gst_object_ref (l->data);
+  columns = vc2slicetile->columns;
+  GST_OBJECT_UNLOCK (vc2slicetile);
+
+  qsort (pads, n_pads, sizeof (GstVC2SliceTilePad *), gst_vc2_slice_tile_compare_pads);
+
+  /* Take data from each input until it has a picture ready. An input which
+   * is still short of one is waited for, unless it has ended, which ends
+   * the mosaic. */
+  for (i = 0; i < n_pads; i++) {
+    GstVC2SliceTilePad *pad = pads[i];
+
+    gst_vc2_slice_tile_pad_parse (vc2slicetile, pad);
+    while (pad->picture == NULL &&
+        (buf = gst_aggregator_pad_pop_buffer (GST_AGGREGATOR_PAD (pad)))) {
+      gst_adapter_push (pad->adapter, buf);
+      gst_vc2_slice_tile_pad_parse (vc2slicetile, pad);
+    }
+
+    if (pad->picture == NULL) {
+      if (gst_aggregator_pad_is_eos (GST_AGGREGATOR_PAD (pad)))
+        eos = TRUE;
+      else
+        waiting = TRUE;
+    }
+  }
+
+  if (n_pads == 0 || eos)
+    ret = (eos) ? GST_FLOW_EOS : GST_FLOW_OK;
+  else if (!waiting)
+    ret = gst_vc2_slice_tile_compose (vc2slicetile, pads, n_pads, columns);
+
+  for (i = 0; i < n_pads; i++)
+    gst_object_unref (pads[i]);
+  g_free (pads);
+
+  return ret;
+}
+
+static GstStructure *
+gst_vc2_slice_tile_get_stats (GstVC2SliceTile * vc2slicetile)
+{
+  return gst_structure_new ("application/x-vc2-slice-tile-stats",
+      "pictures",         G_TYPE_UINT64, VC2_STATS_GET (vc2slicetile->stats_pictures),
+      "dropped-pictures", G_TYPE_UINT64, VC2_STATS_GET (vc2slicetile->stats_dropped_pictures),
+      "bytes-out",        G_TYPE_UINT64, VC2_STATS_GET (vc2slicetile->stats_bytes_out),
+      NULL);
+}
+
+static void
+gst_vc2_slice_tile_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2SliceTile *vc2slicetile = GST_VC2_SLICE_TILE (object);
+
+  GST_OBJECT_LOCK (vc2slicetile);
+  switch (prop_id) {
+    case PROP_COLUMNS:
+      vc2slicetile->columns = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2slicetile);
+}
+
+static void
+gst_vc2_slice_tile_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2SliceTile *vc2slicetile = GST_VC2_SLICE_TILE (object);
+
+  GST_OBJECT_LOCK (vc2slicetile);
+  switch (prop_id) {
+    case PROP_COLUMNS:
+      g_value_set_uint (value, vc2slicetile->columns);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vc2_slice_tile_get_stats (vc2slicetile));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2slicetile);
+}
+
+gboolean
+gst_vc2_slice_tile_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2slicetile",
+                               GST_RANK_NONE, GST_TYPE_VC2_SLICE_TILE);
+}
@@ -0,0 +1,110 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VC2_SLICE_TILE_H__
+#define __GST_VC2_SLICE_TILE_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+#include <gst/base/gstaggregator.h>
+
+#include "vc2vlcparse.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_SLICE_TILE_PAD \
+  (gst_vc2_slice_tile_pad_get_type())
+#define GST_VC2_SLICE_TILE_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_SLICE_TILE_PAD,GstVC2SliceTilePad))
+#define GST_VC2_SLICE_TILE_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_SLICE_TILE_PAD,GstVC2SliceTilePadClass))
+#define GST_IS_VC2_SLICE_TILE_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_SLICE_TILE_PAD))
+#define GST_IS_VC2_SLICE_TILE_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_SLICE_TILE_PAD))
+
+typedef struct _GstVC2SliceTilePad GstVC2SliceTilePad;
+typedef struct _GstVC2SliceTilePadClass GstVC2SliceTilePadClass;
+
+struct _GstVC2SliceTilePad
+{
+  GstAggregatorPad parent;
+
+  /* position in the mosaic, from the pad name */
+  guint index;
+
+  GstAdapter *adapter;
+  gboolean sync;
+  vc2_sequence_header *seq_hdr;
+  gboolean seq_hdr_seen;
+
+  /* the next HQ picture, without its parse info header */
+  GstBuffer *picture;
+};
+
+struct _GstVC2SliceTilePadClass
+{
+  GstAggregatorPadClass parent_class;
+};
+
+GType gst_vc2_slice_tile_pad_get_type (void);
+
+#define GST_TYPE_VC2_SLICE_TILE \
+  (gst_vc2_slice_tile_get_type())
+#define GST_VC2_SLICE_TILE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_SLICE_TILE,GstVC2SliceTile))
+#define GST_VC2_SLICE_TILE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_SLICE_TILE,GstVC2SliceTileClass))
+#define GST_IS_VC2_SLICE_TILE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_SLICE_TILE))
+#define GST_IS_VC2_SLICE_TILE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_SLICE_TILE))
+
+typedef struct _GstVC2SliceTile GstVC2SliceTile;
+typedef struct _GstVC2SliceTileClass GstVC2SliceTileClass;
+
+struct _GstVC2SliceTile
+{
+  GstAggregator parent;
+
+  /* properties */
+  guint columns;
+
+  guint32 out_frame_width;
+  guint32 out_frame_height;
+  guint32 prev_parse_offset;
+
+  guint64 stats_pictures;
+  guint64 stats_dropped_pictures;
+  guint64 stats_bytes_out;
+};
+
+struct _GstVC2SliceTileClass
+{
+  GstAggregatorClass parent_class;
+};
+
+GType gst_vc2_slice_tile_get_type (void);
+
+gboolean gst_vc2_slice_tile_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_SLICE_TILE_H__ */
@@ -0,0 +1,691 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstvc2testsrc.h"
+#include "vc2vlcparse.h"
+
+GST_DEBUG_CATEGORY_STATIC (vc2testsrc_debug);
+#define GST_CAT_DEFAULT (vc2testsrc_debug)
+
+/* A source of synthetic HQ profile VC-2 streams, for driving the payloader
+ * and depayloader without an encoder in the pipeline. The transform
+ * parameters and slices of a few pictures are built when the element starts
+ * and each output picture just adds a parse info header and picture number
+ * in front of one of them, so the element costs almost nothing per picture.
+ *
+ * Every slice has a quantisation index of zero and component data made up
+ * of 0xFF bytes, which decodes as all zero coefficients (a mid grey picture)
+ * however large the slice is. */
+
+#define DEFAULT_BASE_VIDEO_FORMAT        14
+#define DEFAULT_WAVELET_INDEX            1
+#define DEFAULT_DWT_DEPTH                3
+#define DEFAULT_SLICES_X                 32
+#define DEFAULT_SLICES_Y                 16
+#define DEFAULT_SLICE_PREFIX_BYTES       0
+#define DEFAULT_SLICE_SIZE_SCALAR        1
+#define DEFAULT_SLICE_BYTES              512
+#define DEFAULT_SLICE_SIZES              GST_VC2_TEST_SRC_SLICE_SIZES_CONSTANT
+#define DEFAULT_SLICE_BYTES_VARIATION    50
+#define DEFAULT_TEMPLATES                8
+#define DEFAULT_SEQUENCE_HEADER_INTERVAL 0
+#define DEFAULT_SEED                     0
+
+enum
+{
+  PROP_0,
+  PROP_BASE_VIDEO_FORMAT,
+  PROP_WAVELET_INDEX,
+  PROP_DWT_DEPTH,
+  PROP_SLICES_X,
+  PROP_SLICES_Y,
+  PROP_SLICE_PREFIX_BYTES,
+  PROP_SLICE_SIZE_SCALAR,
+  PROP_SLICE_BYTES,
+  PROP_SLICE_SIZES,
+  PROP_SLICE_BYTES_VARIATION,
+  PROP_TEMPLATES,
+  PROP_SEQUENCE_HEADER_INTERVAL,
+  PROP_SEED
+};
+
+static GstStaticPadTemplate gst_vc2_test_src_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-dirac")
+    );
+
+#define GST_TYPE_VC2_TEST_SRC_SLICE_SIZES (gst_vc2_test_src_slice_sizes_get_type ())
+static GType
+gst_vc2_test_src_slice_sizes_get_type (void)
+{
+  static GType slice_sizes_type = 0;
+  static const GEnumValue slice_sizes[] = {
+    {GST_VC2_TEST_SRC_SLICE_SIZES_CONSTANT,
+        "Every slice is slice-bytes long", "constant"},
+    {GST_VC2_TEST_SRC_SLICE_SIZES_UNIFORM,
+        "Slice sizes are picked at random within slice-bytes-variation percent of slice-bytes",
+        "uniform"},
+    {GST_VC2_TEST_SRC_SLICE_SIZES_RAMP,
+        "Slice sizes grow across each picture within slice-bytes-variation percent of slice-bytes",
+        "ramp"},
+    {0, NULL, NULL},
+  };
+
+  if (!slice_sizes_type) {
+    slice_sizes_type =
+        g_enum_register_static ("GstVC2TestSrcSliceSizes", slice_sizes);
+  }
+  return slice_sizes_type;
+}
+
+static void gst_vc2_test_src_finalize (GObject * object);
+static void gst_vc2_test_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_test_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_vc2_test_src_start (GstBaseSrc * basesrc);
+static gboolean gst_vc2_test_src_stop (GstBaseSrc * basesrc);
+static void gst_vc2_test_src_get_times (GstBaseSrc * basesrc,
+    GstBuffer * buffer, GstClockTime * start, GstClockTime * end);
+static GstFlowReturn gst_vc2_test_src_create (GstPushSrc * pushsrc,
+    GstBuffer ** buffer);
+
+#define gst_vc2_test_src_parent_class parent_class
+G_DEFINE_TYPE (GstVC2TestSrc, gst_vc2_test_src, GST_TYPE_PUSH_SRC);
+
+static void
+gst_vc2_test_src_class_init (GstVC2TestSrcClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSrcClass *gstbasesrc_class;
+  GstPushSrcClass *gstpushsrc_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesrc_class = (GstBaseSrcClass *) klass;
+  gstpushsrc_class = (GstPushSrcClass *) klass;
+
+  gobject_class->finalize = gst_vc2_test_src_finalize;
+  gobject_class->set_property = gst_vc2_test_src_set_property;
+  gobject_class->get_property = gst_vc2_test_src_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_BASE_VIDEO_FORMAT,
+      g_param_spec_uint ("base-video-format", "Base Video Format",
+          "VC-2 base video format index, which sets the picture size, scan and frame rate",
+          0, 22, DEFAULT_BASE_VIDEO_FORMAT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_WAVELET_INDEX,
+      g_param_spec_uint ("wavelet-index", "Wavelet Index",
+          "Wavelet index written in the transform parameters",
+          0, 6, DEFAULT_WAVELET_INDEX,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DWT_DEPTH,
+      g_param_spec_uint ("dwt-depth", "DWT Depth",
+          "Transform depth written in the transform parameters",
+          0, 8, DEFAULT_DWT_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICES_X,
+      g_param_spec_uint ("slices-x", "Slices X",
+          "Number of slices across each picture",
+          1, 4096, DEFAULT_SLICES_X,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICES_Y,
+      g_param_spec_uint ("slices-y", "Slices Y",
+          "Number of slices down each picture",
+          1, 4096, DEFAULT_SLICES_Y,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_PREFIX_BYTES,
+      g_param_spec_uint ("slice-prefix-bytes", "Slice Prefix Bytes",
+          "Number of prefix bytes at the start of each slice",
+          0, 1024, DEFAULT_SLICE_PREFIX_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_SIZE_SCALAR,
+      g_param_spec_uint ("slice-size-scalar", "Slice Size Scalar",
+          "Multiplier applied to the component lengths in each slice",
+          1, 1024, DEFAULT_SLICE_SIZE_SCALAR,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_BYTES,
+      g_param_spec_uint ("slice-bytes", "Slice Bytes",
+          "Mean coded size of a slice in bytes, limited to what slice-prefix-bytes "
+          "and slice-size-scalar can express",
+          0, G_MAXUINT, DEFAULT_SLICE_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_SIZES,
+      g_param_spec_enum ("slice-sizes", "Slice Sizes",
+          "How the slice sizes are distributed around slice-bytes",
+          GST_TYPE_VC2_TEST_SRC_SLICE_SIZES, DEFAULT_SLICE_SIZES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_BYTES_VARIATION,
+      g_param_spec_uint ("slice-bytes-variation", "Slice Bytes Variation",
+          "Largest difference from slice-bytes, in percent, for the uniform and ramp slice sizes",
+          0, 100, DEFAULT_SLICE_BYTES_VARIATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_TEMPLATES,
+      g_param_spec_uint ("templates", "Templates",
+          "Number of different pictures built at start and output in turn",
+          1, 1024, DEFAULT_TEMPLATES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SEQUENCE_HEADER_INTERVAL,
+      g_param_spec_uint ("sequence-header-interval", "Sequence Header Interval",
+          "Repeat the sequence header every this many pictures (0 = only at the start)",
+          0, G_MAXUINT, DEFAULT_SEQUENCE_HEADER_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint ("seed", "Seed",
+          "Seed for the random slice sizes",
+          0, G_MAXUINT32, DEFAULT_SEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_test_src_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 test source", "Source/Video",
+      "Generates synthetic HQ profile VC-2 streams",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstbasesrc_class->start = gst_vc2_test_src_start;
+  gstbasesrc_class->stop = gst_vc2_test_src_stop;
+  gstbasesrc_class->get_times = gst_vc2_test_src_get_times;
+  gstpushsrc_class->create = gst_vc2_test_src_create;
+
+  GST_DEBUG_CATEGORY_INIT (vc2testsrc_debug, "vc2testsrc", 0,
+      "VC2 Test Source");
+}
+
+static void
+gst_vc2_test_src_init (GstVC2TestSrc * vc2testsrc)
+{
+  vc2testsrc->base_video_format        = DEFAULT_BASE_VIDEO_FORMAT;
+  vc2testsrc->wavelet_index            = DEFAULT_WAVELET_INDEX;
+  vc2testsrc->dwt_depth                = DEFAULT_DWT_DEPTH;
+  vc2testsrc->slices_x                 = DEFAULT_SLICES_X;
+  vc2testsrc->slices_y                 = DEFAULT_SLICES_Y;
+  vc2testsrc->slice_prefix_bytes       = DEFAULT_SLICE_PREFIX_BYTES;
+  vc2testsrc->slice_size_scalar        = DEFAULT_SLICE_SIZE_SCALAR;
+  vc2testsrc->slice_bytes              = DEFAULT_SLICE_BYTES;
+  vc2testsrc->slice_sizes              = DEFAULT_SLICE_SIZES;
+  vc2testsrc->slice_bytes_variation    = DEFAULT_SLICE_BYTES_VARIATION;
+  vc2testsrc->n_templates              = DEFAULT_TEMPLATES;
+  vc2testsrc->sequence_header_interval = DEFAULT_SEQUENCE_HEADER_INTERVAL;
+  vc2testsrc->seed                     = DEFAULT_SEED;
+
+  vc2testsrc->seq_hdr   = NULL;
+  vc2testsrc->templates = NULL;
+
+  gst_base_src_set_format (GST_BASE_SRC (vc2testsrc), GST_FORMAT_TIME);
+}
+
+static void
+gst_vc2_test_src_free_templates (GstVC2TestSrc * vc2testsrc)
+{
+  guint i;
+
+  if (vc2testsrc->templates) {
+    for (i = 0; i < vc2testsrc->n_templates; i++)
+      gst_buffer_replace (&vc2testsrc->templates[i], NULL);
+    g_free (vc2testsrc->templates);
+    vc2testsrc->templates = NULL;
+  }
+
+  g_free (vc2testsrc->seq_hdr);
+  vc2testsrc->seq_hdr = NULL;
+}
+
+static void
+gst_vc2_test_src_finalize (GObject * object)
+{
+  gst_vc2_test_src_free_templates (GST_VC2_TEST_SRC (object));
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Writes a sequence header using the base video format defaults for
+ * everything except the picture coding mode, which codes interlaced formats
+ * as fields */
+static gsize
+gst_vc2_test_src_write_sequence_header (GstVC2TestSrc * vc2testsrc,
+    guint8 * data, gsize size)
+{
+  vc2_vlc_encoder *enc = vc2_vlc_encoder_new (data, size);
+  gsize length;
+  int i;
+
+  vc2_vlc_encoder_write_uint (enc, 2);  /* major version */
+  vc2_vlc_encoder_write_uint (enc, 0);  /* minor version */
+  vc2_vlc_encoder_write_uint (enc, 3);  /* profile: HQ */
+  vc2_vlc_encoder_write_uint (enc, 0);  /* level */
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->base_video_format);
+
+  /* no custom dimensions, colour difference format, scan format, frame
+   * rate, pixel aspect ratio, clean area, signal range or colour spec */
+  for (i = 0; i < 8; i++)
+    vc2_vlc_encoder_write_bool (enc, FALSE);
+
+  vc2_vlc_encoder_write_uint (enc, (vc2testsrc->interlaced) ? 1 : 0);
+
+  length = vc2_vlc_encoder_length (enc);
+  if (vc2_vlc_encoder_overrun (enc))
+    length = 0;
+  vc2_vlc_encoder_free (enc);
+
+  return length;
+}
+
+static gsize
+gst_vc2_test_src_write_transform_parameters (GstVC2TestSrc * vc2testsrc,
+    guint8 * data, gsize size)
+{
+  vc2_vlc_encoder *enc = vc2_vlc_encoder_new (data, size);
+  gsize length;
+
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->wavelet_index);
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->dwt_depth);
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->slices_x);
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->slices_y);
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->slice_prefix_bytes);
+  vc2_vlc_encoder_write_uint (enc, vc2testsrc->slice_size_scalar);
+  vc2_vlc_encoder_write_bool (enc, FALSE);  /* default quantisation matrix */
+
+  length = vc2_vlc_encoder_length (enc);
+  if (vc2_vlc_encoder_overrun (enc))
+    length = 0;
+  vc2_vlc_encoder_free (enc);
+
+  return length;
+}
+
+/* The slice sizes are worked out in units of slice_size_scalar bytes of
+ * component data, which is all that can vary between slices */
+static guint
+gst_vc2_test_src_slice_units (GstVC2TestSrc * vc2testsrc, GRand * rand,
+    guint slice, guint n_slices)
+{
+  guint header = vc2testsrc->slice_prefix_bytes + 4;
+  guint target, low, high;
+
+  target = (vc2testsrc->slice_bytes > header) ?
+      (vc2testsrc->slice_bytes - header)/vc2testsrc->slice_size_scalar : 0;
+  target = MIN (target, 3*255);
+
+  low  = target - (target*vc2testsrc->slice_bytes_variation)/100;
+  high = MIN (target + (target*vc2testsrc->slice_bytes_variation)/100, 3*255);
+
+  switch (vc2testsrc->slice_sizes) {
+    case GST_VC2_TEST_SRC_SLICE_SIZES_UNIFORM:
+      return g_rand_int_range (rand, low, high + 1);
+    case GST_VC2_TEST_SRC_SLICE_SIZES_RAMP:
+      if (n_slices < 2)
+        return target;
+      return low + ((guint64) (high - low)*slice)/(n_slices - 1);
+    case GST_VC2_TEST_SRC_SLICE_SIZES_CONSTANT:
+    default:
+      return target;
+  }
+}
+
+/* Builds the part of a picture after the picture number: the transform
+ * parameters followed by the slices */
+static GstBuffer *
+gst_vc2_test_src_make_template (GstVC2TestSrc * vc2testsrc, GRand * rand)
+{
+  guint n_slices = vc2testsrc->slices_x*vc2testsrc->slices_y;
+  guint32 prefix = vc2testsrc->slice_prefix_bytes;
+  guint32 scalar = vc2testsrc->slice_size_scalar;
+  guint8 params[64];
+  gsize params_size, size;
+  guint *units;
+  guint8 *data, *p;
+  guint i, j;
+
+  params_size = gst_vc2_test_src_write_transform_parameters (vc2testsrc, params, sizeof (params));
+  if (params_size == 0)
+    return NULL;
+
+  units = g_new (guint, n_slices);
+  size = params_size;
+  for (i = 0; i < n_slices; i++) {
+    units[i] = gst_vc2_test_src_slice_units (vc2testsrc, rand, i, n_slices);
+    size += prefix + 4 + units[i]*scalar;
+  }
+
+  data = g_malloc (size);
+  memcpy (data, params, params_size);
+  p = data + params_size;
+
+  for (i = 0; i < n_slices; i++) {
+    guint length[3];
+
+    /* Split the slice as a 4:2:2 encoder would, half luma and a quarter for
+     * each colour difference component, each at most 255 units */
+    length[1] = MIN (units[i]/4, 255);
+    length[2] = length[1];
+    length[0] = units[i] - length[1] - length[2];
+    if (length[0] > 255) {
+      guint extra = length[0] - 255;
+      length[0]  = 255;
+      length[1] += (extra + 1)/2;
+      length[2] += extra/2;
+    }
+
+    memset (p, 0, prefix);
+    p += prefix;
+    *p++ = 0;  /* qindex */
+    for (j = 0; j < 3; j++) {
+      *p++ = length[j];
+      memset (p, 0xFF, length[j]*scalar);
+      p += length[j]*scalar;
+    }
+  }
+
+  g_free (units);
+
+  return gst_buffer_new_wrapped (data, size);
+}
+
+static gboolean
+gst_vc2_test_src_start (GstBaseSrc * basesrc)
+{
+  GstVC2TestSrc *vc2testsrc = GST_VC2_TEST_SRC (basesrc);
+  guint8 seq_hdr[64];
+  GRand *rand;
+  guint i;
+
+  gst_vc2_test_src_free_templates (vc2testsrc);
+
+  if (!vc2_base_video_format_get (vc2testsrc->base_video_format, NULL, NULL,
+          &vc2testsrc->interlaced, &vc2testsrc->fps_n, &vc2testsrc->fps_d)) {
+    GST_ELEMENT_ERROR (vc2testsrc, RESOURCE, SETTINGS, (NULL),
+        ("unknown base video format %u", vc2testsrc->base_video_format));
+    return FALSE;
+  }
+
+  vc2testsrc->seq_hdr_size = gst_vc2_test_src_write_sequence_header (vc2testsrc, seq_hdr, sizeof (seq_hdr));
+  vc2testsrc->seq_hdr = g_malloc (vc2testsrc->seq_hdr_size);
+  memcpy (vc2testsrc->seq_hdr, seq_hdr, vc2testsrc->seq_hdr_size);
+
+  rand = g_rand_new_with_seed (vc2testsrc->seed);
+  vc2testsrc->templates = g_new0 (GstBuffer *, vc2testsrc->n_templates);
+  for (i = 0; i < vc2testsrc->n_templates; i++) {
+    vc2testsrc->templates[i] = gst_vc2_test_src_make_template (vc2testsrc, rand);
+    if (vc2testsrc->templates[i] == NULL) {
+      g_rand_free (rand);
+      gst_vc2_test_src_free_templates (vc2testsrc);
+      GST_ELEMENT_ERROR (vc2testsrc, RESOURCE, SETTINGS, (NULL),
+          ("could not build the transform parameters"));
+      return FALSE;
+    }
+  }
+  g_rand_free (rand);
+
+  GST_DEBUG_OBJECT (vc2testsrc, "built %u pictures of %" G_GSIZE_FORMAT " bytes",
+      vc2testsrc->n_templates, gst_buffer_get_size (vc2testsrc->templates[0]));
+
+  vc2testsrc->n_pictures        = 0;
+  vc2testsrc->prev_parse_offset = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_test_src_stop (GstBaseSrc * basesrc)
+{
+  gst_vc2_test_src_free_templates (GST_VC2_TEST_SRC (basesrc));
+
+  return TRUE;
+}
+
+static void
+gst_vc2_test_src_get_times (GstBaseSrc * basesrc, GstBuffer * buffer,
+    GstClockTime * start, GstClockTime * end)
+{
+  /* only sync to the clock when live, otherwise run as fast as possible */
+  if (gst_base_src_is_live (basesrc)) {
+    GstClockTime timestamp = GST_BUFFER_PTS (buffer);
+
+    if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+      GstClockTime duration = GST_BUFFER_DURATION (buffer);
+
+      if (GST_CLOCK_TIME_IS_VALID (duration))
+        *end = timestamp + duration;
+      *start = timestamp;
+    }
+  } else {
+    *start = -1;
+    *end = -1;
+  }
+}
+
+static GstClockTime
+gst_vc2_test_src_picture_time (GstVC2TestSrc * vc2testsrc, guint64 n)
+{
+  return gst_util_uint64_scale (n, vc2testsrc->fps_d*GST_SECOND,
+      (guint64) vc2testsrc->fps_n*((vc2testsrc->interlaced) ? 2 : 1));
+}
+
+static GstFlowReturn
+gst_vc2_test_src_create (GstPushSrc * pushsrc, GstBuffer ** buffer)
+{
+  GstVC2TestSrc *vc2testsrc = GST_VC2_TEST_SRC (pushsrc);
+  GstBuffer *template, *outbuf;
+  GstMapInfo info;
+  gboolean send_seq_hdr, last;
+  gsize head_size, template_size;
+  guint64 n = vc2testsrc->n_pictures;
+  guint8 *p;
+
+  template = vc2testsrc->templates[n % vc2testsrc->n_templates];
+  template_size = gst_buffer_get_size (template);
+
+  send_seq_hdr = (n == 0 ||
+      (vc2testsrc->sequence_header_interval > 0 &&
+          n % vc2testsrc->sequence_header_interval == 0));
+
+  /* basesrc has already counted this buffer, so this is the last one when
+   * none are left. The end of sequence lets the payloader send the picture
+   * without waiting for the next parse info header */
+  last = (GST_BASE_SRC (pushsrc)->num_buffers_left == 0);
+
+  head_size = 17;
+  if (send_seq_hdr)
+    head_size += 13 + vc2testsrc->seq_hdr_size;
+  if (last)
+    head_size += 13;
+
+  /* Only the parse info headers and picture number are written for each
+   * picture, the template is shared */
+  outbuf = gst_buffer_new_allocate (NULL, head_size, NULL);
+  gst_buffer_map (outbuf, &info, GST_MAP_WRITE);
+  p = info.data;
+
+  if (send_seq_hdr) {
+    vc2_parse_info_write (p, 0x00, 13 + vc2testsrc->seq_hdr_size, vc2testsrc->prev_parse_offset);
+    memcpy (p + 13, vc2testsrc->seq_hdr, vc2testsrc->seq_hdr_size);
+    p += 13 + vc2testsrc->seq_hdr_size;
+    vc2testsrc->prev_parse_offset = 13 + vc2testsrc->seq_hdr_size;
+  }
+
+  vc2_parse_info_write (p, 0xE8, 17 + template_size, vc2testsrc->prev_parse_offset);
+  p[13] = (n >> 24)&0xFF;
+  p[14] = (n >> 16)&0xFF;
+  p[15] = (n >>  8)&0xFF;
+  p[16] = (n >>  0)&0xFF;
+  vc2testsrc->prev_parse_offset = 17 + template_size;
+
+  gst_buffer_unmap (outbuf, &info);
+
+  outbuf = gst_buffer_append (outbuf, gst_buffer_ref (template));
+
+  if (last) {
+    GstBuffer *eos = gst_buffer_new_allocate (NULL, 13, NULL);
+
+    gst_buffer_map (eos, &info, GST_MAP_WRITE);
+    vc2_parse_info_write (info.data, 0x10, 0, vc2testsrc->prev_parse_offset);
+    gst_buffer_unmap (eos, &info);
+    outbuf = gst_buffer_append (outbuf, eos);
+  }
+
+  GST_BUFFER_PTS (outbuf)      = gst_vc2_test_src_picture_time (vc2testsrc, n);
+  GST_BUFFER_DTS (outbuf)      = GST_BUFFER_PTS (outbuf);
+  GST_BUFFER_DURATION (outbuf) = gst_vc2_test_src_picture_time (vc2testsrc, n + 1) - GST_BUFFER_PTS (outbuf);
+  GST_BUFFER_OFFSET (outbuf)   = n;
+  GST_BUFFER_OFFSET_END (outbuf) = n + 1;
+
+  vc2testsrc->n_pictures++;
+
+  *buffer = outbuf;
+  return GST_FLOW_OK;
+}
+
+static void
+gst_vc2_test_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2TestSrc *vc2testsrc = GST_VC2_TEST_SRC (object);
+
+  switch (prop_id) {
+    case PROP_BASE_VIDEO_FORMAT:
+      vc2testsrc->base_video_format = g_value_get_uint (value);
+      break;
+    case PROP_WAVELET_INDEX:
+      vc2testsrc->wavelet_index = g_value_get_uint (value);
+      break;
+    case PROP_DWT_DEPTH:
+      vc2testsrc->dwt_depth = g_value_get_uint (value);
+      break;
+    case PROP_SLICES_X:
+      vc2testsrc->slices_x = g_value_get_uint (value);
+      break;
+    case PROP_SLICES_Y:
+      vc2testsrc->slices_y = g_value_get_uint (value);
+      break;
+    case PROP_SLICE_PREFIX_BYTES:
+      vc2testsrc->slice_prefix_bytes = g_value_get_uint (value);
+      break;
+    case PROP_SLICE_SIZE_SCALAR:
+      vc2testsrc->slice_size_scalar = g_value_get_uint (value);
+      break;
+    case PROP_SLICE_BYTES:
+      vc2testsrc->slice_bytes = g_value_get_uint (value);
+      break;
+    case PROP_SLICE_SIZES:
+      vc2testsrc->slice_sizes = g_value_get_enum (value);
+      break;
+    case PROP_SLICE_BYTES_VARIATION:
+      vc2testsrc->slice_bytes_variation = g_value_get_uint (value);
+      break;
+    case PROP_TEMPLATES:
+      /* the templates are freed using the old count */
+      if (vc2testsrc->templates == NULL)
+        vc2testsrc->n_templates = g_value_get_uint (value);
+      break;
+    case PROP_SEQUENCE_HEADER_INTERVAL:
+      vc2testsrc->sequence_header_interval = g_value_get_uint (value);
+      break;
+    case PROP_SEED:
+      vc2testsrc->seed = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vc2_test_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2TestSrc *vc2testsrc = GST_VC2_TEST_SRC (object);
+
+  switch (prop_id) {
+    case PROP_BASE_VIDEO_FORMAT:
+      g_value_set_uint (value, vc2testsrc->base_video_format);
+      break;
+    case PROP_WAVELET_INDEX:
+      g_value_set_uint (value, vc2testsrc->wavelet_index);
+      break;
+    case PROP_DWT_DEPTH:
+      g_value_set_uint (value, vc2testsrc->dwt_depth);
+      break;
+    case PROP_SLICES_X:
+      g_value_set_uint (value, vc2testsrc->slices_x);
+      break;
+    case PROP_SLICES_Y:
+      g_value_set_uint (value, vc2testsrc->slices_y);
+      break;
+    case PROP_SLICE_PREFIX_BYTES:
+      g_value_set_uint (value, vc2testsrc->slice_prefix_bytes);
+      break;
+    case PROP_SLICE_SIZE_SCALAR:
+      g_value_set_uint (value, vc2testsrc->slice_size_scalar);
+      break;
+    case PROP_SLICE_BYTES:
+      g_value_set_uint (value, vc2testsrc->slice_bytes);
+      break;
+    case PROP_SLICE_SIZES:
+      g_value_set_enum (value, vc2testsrc->slice_sizes);
+      break;
+    case PROP_SLICE_BYTES_VARIATION:
+      g_value_set_uint (value, vc2testsrc->slice_bytes_variation);
+      break;
+    case PROP_TEMPLATES:
+      g_value_set_uint (value, vc2testsrc->n_templates);
+      break;
+    case PROP_SEQUENCE_HEADER_INTERVAL:
+      g_value_set_uint (value, vc2testsrc->sequence_header_interval);
+      break;
+    case PROP_SEED:
+      g_value_set_uint (value, vc2testsrc->seed);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+gboolean
+gst_vc2_test_src_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2testsrc",
+                               GST_RANK_NONE, GST_TYPE_VC2_TEST_SRC);
+}
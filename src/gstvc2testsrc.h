@@ -0,0 +1,90 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VC2_TEST_SRC_H__
+#define __GST_VC2_TEST_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_TEST_SRC \
+  (gst_vc2_test_src_get_type())
+#define GST_VC2_TEST_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_TEST_SRC,GstVC2TestSrc))
+#define GST_VC2_TEST_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_TEST_SRC,GstVC2TestSrcClass))
+#define GST_IS_VC2_TEST_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_TEST_SRC))
+#define GST_IS_VC2_TEST_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_TEST_SRC))
+
+typedef struct _GstVC2TestSrc GstVC2TestSrc;
+typedef struct _GstVC2TestSrcClass GstVC2TestSrcClass;
+
+typedef enum {
+  GST_VC2_TEST_SRC_SLICE_SIZES_CONSTANT,
+  GST_VC2_TEST_SRC_SLICE_SIZES_UNIFORM,
+  GST_VC2_TEST_SRC_SLICE_SIZES_RAMP,
+} GstVC2TestSrcSliceSizes;
+
+struct _GstVC2TestSrc
+{
+  GstPushSrc pushsrc;
+
+  /* properties */
+  guint32 base_video_format;
+  guint32 wavelet_index;
+  guint32 dwt_depth;
+  guint32 slices_x;
+  guint32 slices_y;
+  guint32 slice_prefix_bytes;
+  guint32 slice_size_scalar;
+  guint   slice_bytes;
+  GstVC2TestSrcSliceSizes slice_sizes;
+  guint   slice_bytes_variation;
+  guint   n_templates;
+  guint   sequence_header_interval;
+  guint32 seed;
+
+  /* set up in start() */
+  guint8     *seq_hdr;
+  gsize       seq_hdr_size;
+  GstBuffer **templates;
+  gboolean    interlaced;
+  guint32     fps_n;
+  guint32     fps_d;
+
+  guint64 n_pictures;
+  guint32 prev_parse_offset;
+};
+
+struct _GstVC2TestSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType gst_vc2_test_src_get_type (void);
+
+gboolean gst_vc2_test_src_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_TEST_SRC_H__ */
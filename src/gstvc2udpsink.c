@@ -0,0 +1,665 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* sendmmsg and struct mmsghdr */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
+
+#include "gstvc2udpsink.h"
+
+#if defined(HAVE_DECL_UDP_SEGMENT) && HAVE_DECL_UDP_SEGMENT
+#  define VC2_UDP_HAVE_GSO 1
+#endif
+
+#if defined(HAVE_DECL_SO_TXTIME) && HAVE_DECL_SO_TXTIME && HAVE_DECL_SCM_TXTIME && \
+    defined(HAVE_LINUX_NET_TSTAMP_H) && defined(CLOCK_TAI)
+#  include <linux/net_tstamp.h>
+#  define VC2_UDP_HAVE_TXTIME 1
+#endif
+
+#ifndef HAVE_SENDMMSG
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;
+};
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (vc2udpsink_debug);
+#define GST_CAT_DEFAULT (vc2udpsink_debug)
+
+/* A UDP sink for the output of rtpvc2pay which sends a whole picture's
+ * packets with as few system calls as possible. Packets are mapped and held
+ * until one with the RTP marker bit set (the end of a picture) arrives, or
+ * max-batch are held, then go to the kernel in one sendmmsg call pointing
+ * straight at the buffer memory.
+ *
+ * Where the kernel has UDP_SEGMENT, each run of packets of the same size
+ * (plus one shorter packet at the end) goes as a single GSO message which
+ * the kernel, or the network card, splits back into packets, so a picture
+ * of equal sized packets costs a handful of trips down the stack instead
+ * of one per packet. With txtime set, each message carries an SCM_TXTIME
+ * departure time worked out from the buffer timestamp, for the fq or etf
+ * qdiscs to pace by.
+ *
+ * Without sendmmsg the messages are sent one sendmsg at a time, and without
+ * UDP_SEGMENT or SO_TXTIME (or if the socket refuses them) the options are
+ * just not used. */
+
+#define DEFAULT_HOST        "127.0.0.1"
+#define DEFAULT_PORT        5004
+#define DEFAULT_BUFFER_SIZE 0
+#define DEFAULT_MAX_BATCH   1024
+#define DEFAULT_GSO         TRUE
+#define DEFAULT_TXTIME      FALSE
+
+/* kernel limits on one GSO message */
+#define VC2_UDP_MAX_SEGMENTS  64
+#define VC2_UDP_MAX_GSO_BYTES 65507
+
+#define VC2_UDP_CONTROL_SPACE (CMSG_SPACE (sizeof (guint16)) + CMSG_SPACE (sizeof (guint64)))
+
+enum
+{
+  PROP_0,
+  PROP_HOST,
+  PROP_PORT,
+  PROP_BUFFER_SIZE,
+  PROP_MAX_BATCH,
+  PROP_GSO,
+  PROP_TXTIME,
+  PROP_STATS
+};
+
+static GstStaticPadTemplate gst_vc2_udp_sink_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp")
+    );
+
+static void gst_vc2_udp_sink_finalize (GObject * object);
+static void gst_vc2_udp_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_udp_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_vc2_udp_sink_start (GstBaseSink * basesink);
+static gboolean gst_vc2_udp_sink_stop (GstBaseSink * basesink);
+static gboolean gst_vc2_udp_sink_event (GstBaseSink * basesink,
+    GstEvent * event);
+static GstFlowReturn gst_vc2_udp_sink_render (GstBaseSink * basesink,
+    GstBuffer * buffer);
+static GstFlowReturn gst_vc2_udp_sink_render_list (GstBaseSink * basesink,
+    GstBufferList * list);
+
+#define gst_vc2_udp_sink_parent_class parent_class
+G_DEFINE_TYPE (GstVC2UdpSink, gst_vc2_udp_sink, GST_TYPE_BASE_SINK);
+
+static void
+gst_vc2_udp_sink_class_init (GstVC2UdpSinkClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSinkClass *gstbasesink_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesink_class = (GstBaseSinkClass *) klass;
+
+  gobject_class->finalize = gst_vc2_udp_sink_finalize;
+  gobject_class->set_property = gst_vc2_udp_sink_set_property;
+  gobject_class->get_property = gst_vc2_udp_sink_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_HOST,
+      g_param_spec_string ("host", "Host",
+          "Address to send packets to",
+          DEFAULT_HOST,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_PORT,
+      g_param_spec_int ("port", "Port",
+          "Port to send packets to",
+          0, 65535, DEFAULT_PORT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_int ("buffer-size", "Buffer Size",
+          "Size of the kernel send buffer in bytes (0 = default)",
+          0, G_MAXINT, DEFAULT_BUFFER_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH,
+      g_param_spec_uint ("max-batch", "Max Batch",
+          "Most packets held back waiting for the end of a picture",
+          1, 65536, DEFAULT_MAX_BATCH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_GSO,
+      g_param_spec_boolean ("gso", "GSO",
+          "Send runs of equal sized packets as UDP GSO messages where the kernel supports it",
+          DEFAULT_GSO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_TXTIME,
+      g_param_spec_boolean ("txtime", "Transmit Time",
+          "Give each message an SO_TXTIME departure time from its timestamp "
+          "(usually with sync=false, for the fq or etf qdiscs)",
+          DEFAULT_TXTIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of packets, bytes, messages, GSO messages, system calls and send errors",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_udp_sink_sink_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 RTP UDP sink", "Sink/Network",
+      "Sends the RTP packets of each VC2 picture over UDP in batches",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstbasesink_class->start = gst_vc2_udp_sink_start;
+  gstbasesink_class->stop = gst_vc2_udp_sink_stop;
+  gstbasesink_class->event = gst_vc2_udp_sink_event;
+  gstbasesink_class->render = gst_vc2_udp_sink_render;
+  gstbasesink_class->render_list = gst_vc2_udp_sink_render_list;
+
+  GST_DEBUG_CATEGORY_INIT (vc2udpsink_debug, "vc2udpsink", 0,
+      "VC2 RTP UDP Sink");
+}
+
+static void
+gst_vc2_udp_sink_init (GstVC2UdpSink * vc2udpsink)
+{
+  vc2udpsink->host        = g_strdup (DEFAULT_HOST);
+  vc2udpsink->port        = DEFAULT_PORT;
+  vc2udpsink->buffer_size = DEFAULT_BUFFER_SIZE;
+  vc2udpsink->max_batch   = DEFAULT_MAX_BATCH;
+  vc2udpsink->gso         = DEFAULT_GSO;
+  vc2udpsink->txtime      = DEFAULT_TXTIME;
+
+  vc2udpsink->fd = -1;
+}
+
+static void
+gst_vc2_udp_sink_finalize (GObject * object)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (object);
+
+  g_free (vc2udpsink->host);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_vc2_udp_sink_clear (GstVC2UdpSink * vc2udpsink)
+{
+  guint i;
+
+  for (i = 0; i < vc2udpsink->n_pending; i++) {
+    gst_buffer_unmap (vc2udpsink->pending[i], &vc2udpsink->maps[i]);
+    gst_buffer_unref (vc2udpsink->pending[i]);
+  }
+  vc2udpsink->n_pending = 0;
+}
+
+static gboolean
+gst_vc2_udp_sink_start (GstBaseSink * basesink)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (basesink);
+  struct addrinfo hints, *res;
+  gchar port[8];
+  int err;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags    = AI_NUMERICSERV;
+  g_snprintf (port, sizeof (port), "%d", vc2udpsink->port);
+
+  err = getaddrinfo (vc2udpsink->host, port, &hints, &res);
+  if (err != 0) {
+    GST_ELEMENT_ERROR (vc2udpsink, RESOURCE, NOT_FOUND, (NULL),
+        ("Could not resolve %s: %s", vc2udpsink->host, gai_strerror (err)));
+    return FALSE;
+  }
+
+  vc2udpsink->fd = socket (res->ai_family, SOCK_DGRAM, 0);
+  if (vc2udpsink->fd < 0) {
+    GST_ELEMENT_ERROR (vc2udpsink, RESOURCE, OPEN_WRITE, (NULL),
+        ("Could not create socket: %s", g_strerror (errno)));
+    freeaddrinfo (res);
+    return FALSE;
+  }
+  memcpy (&vc2udpsink->addr, res->ai_addr, res->ai_addrlen);
+  vc2udpsink->addr_len = res->ai_addrlen;
+  freeaddrinfo (res);
+
+  if (vc2udpsink->buffer_size > 0 &&
+      setsockopt (vc2udpsink->fd, SOL_SOCKET, SO_SNDBUF,
+          &vc2udpsink->buffer_size, sizeof (vc2udpsink->buffer_size)) < 0)
+    GST_WARNING_OBJECT (vc2udpsink, "could not set send buffer size: %s", g_strerror (errno));
+
+  vc2udpsink->gso_active = FALSE;
+#ifdef VC2_UDP_HAVE_GSO
+  if (vc2udpsink->gso) {
+    int gso_size = 0;
+
+    /* a zero segment size is accepted by any kernel which knows the option */
+    vc2udpsink->gso_active = (setsockopt (vc2udpsink->fd, IPPROTO_UDP, UDP_SEGMENT,
+            &gso_size, sizeof (gso_size)) == 0);
+  }
+#endif
+  if (vc2udpsink->gso && !vc2udpsink->gso_active)
+    GST_INFO_OBJECT (vc2udpsink, "UDP GSO not available, sending packets one by one");
+
+  vc2udpsink->txtime_active = FALSE;
+#ifdef VC2_UDP_HAVE_TXTIME
+  if (vc2udpsink->txtime) {
+    struct sock_txtime config;
+
+    memset (&config, 0, sizeof (config));
+    config.clockid = CLOCK_TAI;
+    vc2udpsink->txtime_active = (setsockopt (vc2udpsink->fd, SOL_SOCKET, SO_TXTIME,
+            &config, sizeof (config)) == 0);
+  }
+#endif
+  if (vc2udpsink->txtime && !vc2udpsink->txtime_active)
+    GST_WARNING_OBJECT (vc2udpsink, "SO_TXTIME not available, packets will not be paced");
+
+  vc2udpsink->pending = g_new0 (GstBuffer *, vc2udpsink->max_batch);
+  vc2udpsink->maps    = g_new0 (GstMapInfo, vc2udpsink->max_batch);
+  vc2udpsink->txtimes = g_new0 (guint64, vc2udpsink->max_batch);
+  vc2udpsink->iov     = g_new0 (struct iovec, vc2udpsink->max_batch);
+  vc2udpsink->msgs    = g_new0 (struct mmsghdr, vc2udpsink->max_batch);
+  vc2udpsink->control = g_malloc0 (VC2_UDP_CONTROL_SPACE*vc2udpsink->max_batch);
+  vc2udpsink->n_pending = 0;
+
+  vc2udpsink->packets      = 0;
+  vc2udpsink->bytes        = 0;
+  vc2udpsink->messages     = 0;
+  vc2udpsink->gso_messages = 0;
+  vc2udpsink->syscalls     = 0;
+  vc2udpsink->send_errors  = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_udp_sink_stop (GstBaseSink * basesink)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (basesink);
+
+  gst_vc2_udp_sink_clear (vc2udpsink);
+
+  g_free (vc2udpsink->pending);
+  g_free (vc2udpsink->maps);
+  g_free (vc2udpsink->txtimes);
+  g_free (vc2udpsink->iov);
+  g_free (vc2udpsink->msgs);
+  g_free (vc2udpsink->control);
+  vc2udpsink->pending = NULL;
+  vc2udpsink->maps    = NULL;
+  vc2udpsink->txtimes = NULL;
+  vc2udpsink->iov     = NULL;
+  vc2udpsink->msgs    = NULL;
+  vc2udpsink->control = NULL;
+
+  if (vc2udpsink->fd >= 0)
+    close (vc2udpsink->fd);
+  vc2udpsink->fd = -1;
+
+  return TRUE;
+}
+
+#ifdef VC2_UDP_HAVE_TXTIME
+/* The CLOCK_TAI time at which the pipeline clock will reach the buffer's
+ * render time, or 0 if it has none */
+static guint64
+gst_vc2_udp_sink_txtime (GstVC2UdpSink * vc2udpsink, GstBuffer * buffer)
+{
+  GstBaseSink *basesink = GST_BASE_SINK (vc2udpsink);
+  GstClockTime running_time, render_time, now;
+  GstClock *clock;
+  struct timespec ts;
+  guint64 tai;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer))
+    return 0;
+
+  running_time = gst_segment_to_running_time (&basesink->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return 0;
+
+  clock = gst_element_get_clock (GST_ELEMENT (vc2udpsink));
+  if (clock == NULL)
+    return 0;
+
+  render_time = running_time + gst_element_get_base_time (GST_ELEMENT (vc2udpsink)) +
+      gst_base_sink_get_latency (basesink);
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  if (clock_gettime (CLOCK_TAI, &ts) < 0)
+    return 0;
+  tai = GST_TIMESPEC_TO_TIME (ts);
+
+  return (render_time > now) ? tai + (render_time - now) : tai;
+}
+#endif
+
+/* Fills in msgs for the held packets from first on and returns how many
+ * messages there are. Each message's msg_iovlen is the number of packets it
+ * carries. */
+static guint
+gst_vc2_udp_sink_build (GstVC2UdpSink * vc2udpsink, guint first)
+{
+  guint8 *control = vc2udpsink->control;
+  guint n_msgs = 0, i, j;
+
+  for (i = first; i < vc2udpsink->n_pending; i = j) {
+    struct msghdr *hdr = &vc2udpsink->msgs[n_msgs].msg_hdr;
+    gsize segment = vc2udpsink->maps[i].size;
+    gsize total = segment;
+    gsize controllen = 0;
+
+    vc2udpsink->iov[i].iov_base = vc2udpsink->maps[i].data;
+    vc2udpsink->iov[i].iov_len  = segment;
+    j = i + 1;
+
+    /* the kernel cuts a GSO message into segment sized packets, so all but
+     * the last packet must be exactly that size */
+    if (vc2udpsink->gso_active) {
+      while (j < vc2udpsink->n_pending && j - i < VC2_UDP_MAX_SEGMENTS &&
+          vc2udpsink->maps[j].size <= segment &&
+          total + vc2udpsink->maps[j].size <= VC2_UDP_MAX_GSO_BYTES &&
+          vc2udpsink->txtimes[j] == vc2udpsink->txtimes[i]) {
+        vc2udpsink->iov[j].iov_base = vc2udpsink->maps[j].data;
+        vc2udpsink->iov[j].iov_len  = vc2udpsink->maps[j].size;
+        total += vc2udpsink->maps[j].size;
+        if (vc2udpsink->maps[j++].size < segment)
+          break;
+      }
+    }
+
+    memset (hdr, 0, sizeof (struct msghdr));
+    hdr->msg_name    = &vc2udpsink->addr;
+    hdr->msg_namelen = vc2udpsink->addr_len;
+    hdr->msg_iov     = &vc2udpsink->iov[i];
+    hdr->msg_iovlen  = j - i;
+    hdr->msg_control    = control;
+
+#ifdef VC2_UDP_HAVE_GSO
+    if (j - i > 1) {
+      struct cmsghdr *cmsg = (struct cmsghdr *) (control + controllen);
+      guint16 gso_size = segment;
+
+      cmsg->cmsg_level = IPPROTO_UDP;
+      cmsg->cmsg_type  = UDP_SEGMENT;
+      cmsg->cmsg_len   = CMSG_LEN (sizeof (guint16));
+      memcpy (CMSG_DATA (cmsg), &gso_size, sizeof (guint16));
+      controllen += CMSG_SPACE (sizeof (guint16));
+    }
+#endif
+#ifdef VC2_UDP_HAVE_TXTIME
+    if (vc2udpsink->txtimes[i] != 0) {
+      struct cmsghdr *cmsg = (struct cmsghdr *) (control + controllen);
+
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type  = SCM_TXTIME;
+      cmsg->cmsg_len   = CMSG_LEN (sizeof (guint64));
+      memcpy (CMSG_DATA (cmsg), &vc2udpsink->txtimes[i], sizeof (guint64));
+      controllen += CMSG_SPACE (sizeof (guint64));
+    }
+#endif
+    hdr->msg_controllen = controllen;
+    if (controllen == 0)
+      hdr->msg_control = NULL;
+
+    control += VC2_UDP_CONTROL_SPACE;
+    n_msgs++;
+  }
+
+  return n_msgs;
+}
+
+/* Sends all the held packets and releases them */
+static GstFlowReturn
+gst_vc2_udp_sink_flush (GstVC2UdpSink * vc2udpsink)
+{
+  guint first = 0, n_msgs, k;
+  int sent;
+
+  while (first < vc2udpsink->n_pending) {
+    n_msgs = gst_vc2_udp_sink_build (vc2udpsink, first);
+
+#ifdef HAVE_SENDMMSG
+    sent = sendmmsg (vc2udpsink->fd, vc2udpsink->msgs, n_msgs, 0);
+#else
+    sent = (sendmsg (vc2udpsink->fd, &vc2udpsink->msgs[0].msg_hdr, 0) < 0) ? -1 : 1;
+#endif
+    vc2udpsink->syscalls++;
+
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+
+      if ((errno == EIO || errno == EINVAL) && vc2udpsink->msgs[0].msg_hdr.msg_iovlen > 1) {
+        /* the route cannot segment (no checksum offload, or packets larger
+         * than its MTU), so go back to sending every packet on its own */
+        GST_WARNING_OBJECT (vc2udpsink, "UDP GSO send failed (%s), turning GSO off",
+            g_strerror (errno));
+        vc2udpsink->gso_active = FALSE;
+        continue;
+      }
+
+      /* drop the message that failed, as udpsink would */
+      GST_WARNING_OBJECT (vc2udpsink, "send failed: %s", g_strerror (errno));
+      vc2udpsink->send_errors++;
+      first += vc2udpsink->msgs[0].msg_hdr.msg_iovlen;
+      continue;
+    }
+
+    for (k = 0; k < (guint) sent; k++) {
+      struct msghdr *hdr = &vc2udpsink->msgs[k].msg_hdr;
+      gsize i;
+
+      for (i = 0; i < hdr->msg_iovlen; i++)
+        vc2udpsink->bytes += hdr->msg_iov[i].iov_len;
+      if (hdr->msg_iovlen > 1)
+        vc2udpsink->gso_messages++;
+      vc2udpsink->packets += hdr->msg_iovlen;
+      first += hdr->msg_iovlen;
+    }
+    vc2udpsink->messages += sent;
+  }
+
+  gst_vc2_udp_sink_clear (vc2udpsink);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_vc2_udp_sink_render (GstBaseSink * basesink, GstBuffer * buffer)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (basesink);
+  GstMapInfo *map = &vc2udpsink->maps[vc2udpsink->n_pending];
+  gboolean marker;
+
+  if (!gst_buffer_map (buffer, map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vc2udpsink, RESOURCE, READ, (NULL), ("Could not map buffer"));
+    return GST_FLOW_ERROR;
+  }
+  vc2udpsink->pending[vc2udpsink->n_pending] = gst_buffer_ref (buffer);
+  vc2udpsink->txtimes[vc2udpsink->n_pending] = 0;
+#ifdef VC2_UDP_HAVE_TXTIME
+  if (vc2udpsink->txtime_active)
+    vc2udpsink->txtimes[vc2udpsink->n_pending] = gst_vc2_udp_sink_txtime (vc2udpsink, buffer);
+#endif
+  vc2udpsink->n_pending++;
+
+  /* rtpvc2pay sets the marker on the last packet of each picture */
+  marker = (map->size >= 12 && (map->data[1] & 0x80));
+
+  if (marker || vc2udpsink->n_pending == vc2udpsink->max_batch)
+    return gst_vc2_udp_sink_flush (vc2udpsink);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_vc2_udp_sink_render_list (GstBaseSink * basesink, GstBufferList * list)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i, n = gst_buffer_list_length (list);
+
+  for (i = 0; i < n && ret == GST_FLOW_OK; i++)
+    ret = gst_vc2_udp_sink_render (basesink, gst_buffer_list_get (list, i));
+
+  return ret;
+}
+
+static gboolean
+gst_vc2_udp_sink_event (GstBaseSink * basesink, GstEvent * event)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (basesink);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      gst_vc2_udp_sink_flush (vc2udpsink);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_vc2_udp_sink_clear (vc2udpsink);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (basesink, event);
+}
+
+static GstStructure *
+gst_vc2_udp_sink_get_stats (GstVC2UdpSink * vc2udpsink)
+{
+  return gst_structure_new ("application/x-vc2-udp-sink-stats",
+      "packets",      G_TYPE_UINT64,  vc2udpsink->packets,
+      "bytes",        G_TYPE_UINT64,  vc2udpsink->bytes,
+      "messages",     G_TYPE_UINT64,  vc2udpsink->messages,
+      "gso-messages", G_TYPE_UINT64,  vc2udpsink->gso_messages,
+      "syscalls",     G_TYPE_UINT64,  vc2udpsink->syscalls,
+      "send-errors",  G_TYPE_UINT64,  vc2udpsink->send_errors,
+      "gso",          G_TYPE_BOOLEAN, vc2udpsink->gso_active,
+      "txtime",       G_TYPE_BOOLEAN, vc2udpsink->txtime_active,
+      NULL);
+}
+
+static void
+gst_vc2_udp_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (object);
+
+  GST_OBJECT_LOCK (vc2udpsink);
+  switch (prop_id) {
+    case PROP_HOST:
+      g_free (vc2udpsink->host);
+      vc2udpsink->host = g_value_dup_string (value);
+      break;
+    case PROP_PORT:
+      vc2udpsink->port = g_value_get_int (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      vc2udpsink->buffer_size = g_value_get_int (value);
+      break;
+    case PROP_MAX_BATCH:
+      vc2udpsink->max_batch = g_value_get_uint (value);
+      break;
+    case PROP_GSO:
+      vc2udpsink->gso = g_value_get_boolean (value);
+      break;
+    case PROP_TXTIME:
+      vc2udpsink->txtime = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2udpsink);
+}
+
+static void
+gst_vc2_udp_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2UdpSink *vc2udpsink = GST_VC2_UDP_SINK (object);
+
+  GST_OBJECT_LOCK (vc2udpsink);
+  switch (prop_id) {
+    case PROP_HOST:
+      g_value_set_string (value, vc2udpsink->host);
+      break;
+    case PROP_PORT:
+      g_value_set_int (value, vc2udpsink->port);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_int (value, vc2udpsink->buffer_size);
+      break;
+    case PROP_MAX_BATCH:
+      g_value_set_uint (value, vc2udpsink->max_batch);
+      break;
+    case PROP_GSO:
+      g_value_set_boolean (value, vc2udpsink->gso);
+      break;
+    case PROP_TXTIME:
+      g_value_set_boolean (value, vc2udpsink->txtime);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vc2_udp_sink_get_stats (vc2udpsink));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2udpsink);
+}
+
+gboolean
+gst_vc2_udp_sink_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2udpsink",
+                               GST_RANK_NONE, GST_TYPE_VC2_UDP_SINK);
+}
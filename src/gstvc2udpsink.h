@@ -0,0 +1,94 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_VC2_UDP_SINK_H__
+#define __GST_VC2_UDP_SINK_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_UDP_SINK \
+  (gst_vc2_udp_sink_get_type())
+#define GST_VC2_UDP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_UDP_SINK,GstVC2UdpSink))
+#define GST_VC2_UDP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_UDP_SINK,GstVC2UdpSinkClass))
+#define GST_IS_VC2_UDP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_UDP_SINK))
+#define GST_IS_VC2_UDP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_UDP_SINK))
+
+typedef struct _GstVC2UdpSink GstVC2UdpSink;
+typedef struct _GstVC2UdpSinkClass GstVC2UdpSinkClass;
+
+struct _GstVC2UdpSink
+{
+  GstBaseSink basesink;
+
+  /* properties */
+  gchar   *host;
+  gint     port;
+  gint     buffer_size;
+  guint    max_batch;
+  gboolean gso;
+  gboolean txtime;
+
+  int fd;
+  struct sockaddr_storage addr;
+  socklen_t               addr_len;
+  gboolean gso_active;
+  gboolean txtime_active;
+
+  /* packets of the current picture, mapped, waiting for the marker bit */
+  GstBuffer  **pending;
+  GstMapInfo  *maps;
+  guint64     *txtimes;
+  guint        n_pending;
+
+  /* sendmmsg vectors, sized for max_batch packets */
+  struct iovec   *iov;
+  struct mmsghdr *msgs;
+  guint8         *control;
+
+  guint64 packets;
+  guint64 bytes;
+  guint64 messages;
+  guint64 gso_messages;
+  guint64 syscalls;
+  guint64 send_errors;
+};
+
+struct _GstVC2UdpSinkClass
+{
+  GstBaseSinkClass parent_class;
+};
+
+GType gst_vc2_udp_sink_get_type (void);
+
+gboolean gst_vc2_udp_sink_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_UDP_SINK_H__ */
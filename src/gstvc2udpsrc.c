@@ -0,0 +1,757 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* recvmmsg and struct mmsghdr */
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "gstvc2udpsrc.h"
+#include "vc2stats.h"
+#include "vc2vlcparse.h"
+
+#if defined(HAVE_DECL_UDP_GRO) && HAVE_DECL_UDP_GRO
+#  define VC2_UDP_HAVE_GRO 1
+#endif
+
+#ifndef HAVE_RECVMMSG
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;
+};
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (vc2udpsrc_debug);
+#define GST_CAT_DEFAULT (vc2udpsrc_debug)
+
+/* A UDP source which receives VC2 RTP packets and outputs the VC-2 stream
+ * they carry, doing the work of udpsrc ! rtpvc2depay without a GstBuffer
+ * for every packet. Datagrams are read in batches with recvmmsg into one
+ * slab of fixed size slots which is reused for every batch, and the RTP and
+ * VC2 payload headers are parsed where they lie. Picture data is copied
+ * once, from the slab to the end of the picture being assembled, and the
+ * finished picture becomes the output buffer.
+ *
+ * Where the kernel has UDP_GRO, runs of packets from the same sender can
+ * arrive as a single datagram with the segment size in a control message,
+ * which is cut back into packets here, so a batch can hold far more
+ * packets than it has slots.
+ *
+ * The output is the same as rtpvc2depay's, except that pictures do not
+ * carry a GstVC2SliceIndexMeta and no sequence header can be given in caps.
+ * Packets arriving late or twice are dropped, and a gap in the sequence
+ * numbers drops the picture being assembled. */
+
+#define DEFAULT_ADDRESS     "0.0.0.0"
+#define DEFAULT_PORT        5004
+#define DEFAULT_BUFFER_SIZE 0
+#define DEFAULT_BATCH       64
+#define DEFAULT_GRO         TRUE
+
+/* a slot holds one packet up to jumbo frame size, or a GRO datagram */
+#define VC2_UDP_SLOT_SIZE     16384
+#define VC2_UDP_GRO_SLOT_SIZE 65536
+
+#define VC2_UDP_CONTROL_SPACE CMSG_SPACE (sizeof (int))
+
+/* sequence numbers this far behind the last are a late packet, not a restart */
+#define VC2_UDP_MAX_MISORDER  100
+
+enum
+{
+  PROP_0,
+  PROP_ADDRESS,
+  PROP_PORT,
+  PROP_BUFFER_SIZE,
+  PROP_BATCH,
+  PROP_GRO,
+  PROP_STATS
+};
+
+enum
+{
+  VC2_UDP_PARSE_CODE_SEQUENCE_HEADER = 0x00,
+  VC2_UDP_PARSE_CODE_END_OF_SEQUENCE = 0x10,
+  VC2_UDP_PARSE_CODE_HQ_FRAGMENT     = 0xEC,
+};
+
+static GstStaticPadTemplate gst_vc2_udp_src_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-dirac")
+    );
+
+static void gst_vc2_udp_src_finalize (GObject * object);
+static void gst_vc2_udp_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc2_udp_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_vc2_udp_src_start (GstBaseSrc * basesrc);
+static gboolean gst_vc2_udp_src_stop (GstBaseSrc * basesrc);
+static gboolean gst_vc2_udp_src_unlock (GstBaseSrc * basesrc);
+static gboolean gst_vc2_udp_src_unlock_stop (GstBaseSrc * basesrc);
+static GstFlowReturn gst_vc2_udp_src_create (GstPushSrc * pushsrc,
+    GstBuffer ** buffer);
+
+#define gst_vc2_udp_src_parent_class parent_class
+G_DEFINE_TYPE (GstVC2UdpSrc, gst_vc2_udp_src, GST_TYPE_PUSH_SRC);
+
+static void
+gst_vc2_udp_src_class_init (GstVC2UdpSrcClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSrcClass *gstbasesrc_class;
+  GstPushSrcClass *gstpushsrc_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesrc_class = (GstBaseSrcClass *) klass;
+  gstpushsrc_class = (GstPushSrcClass *) klass;
+
+  gobject_class->finalize = gst_vc2_udp_src_finalize;
+  gobject_class->set_property = gst_vc2_udp_src_set_property;
+  gobject_class->get_property = gst_vc2_udp_src_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_ADDRESS,
+      g_param_spec_string ("address", "Address",
+          "Address to receive packets on, which may be an IPv4 multicast group",
+          DEFAULT_ADDRESS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_PORT,
+      g_param_spec_int ("port", "Port",
+          "Port to receive packets on",
+          0, 65535, DEFAULT_PORT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_int ("buffer-size", "Buffer Size",
+          "Size of the kernel receive buffer in bytes (0 = default)",
+          0, G_MAXINT, DEFAULT_BUFFER_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BATCH,
+      g_param_spec_uint ("batch", "Batch",
+          "Most datagrams read by one system call",
+          1, 1024, DEFAULT_BATCH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_GRO,
+      g_param_spec_boolean ("gro", "GRO",
+          "Let the kernel join packets into UDP GRO datagrams where it supports it",
+          DEFAULT_GRO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counts of packets, bytes, system calls, GRO datagrams, pictures and losses",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vc2_udp_src_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "VC2 RTP UDP source", "Source/Network",
+      "Receives VC2 RTP packets over UDP in batches and outputs VC2 video",
+      "James Weaver <james.barrett@bbc.co.uk>");
+
+  gstbasesrc_class->start = gst_vc2_udp_src_start;
+  gstbasesrc_class->stop = gst_vc2_udp_src_stop;
+  gstbasesrc_class->unlock = gst_vc2_udp_src_unlock;
+  gstbasesrc_class->unlock_stop = gst_vc2_udp_src_unlock_stop;
+
+  gstpushsrc_class->create = gst_vc2_udp_src_create;
+
+  GST_DEBUG_CATEGORY_INIT (vc2udpsrc_debug, "vc2udpsrc", 0,
+      "VC2 RTP UDP Source");
+}
+
+static void
+gst_vc2_udp_src_init (GstVC2UdpSrc * vc2udpsrc)
+{
+  vc2udpsrc->address     = g_strdup (DEFAULT_ADDRESS);
+  vc2udpsrc->port        = DEFAULT_PORT;
+  vc2udpsrc->buffer_size = DEFAULT_BUFFER_SIZE;
+  vc2udpsrc->batch       = DEFAULT_BATCH;
+  vc2udpsrc->gro         = DEFAULT_GRO;
+
+  vc2udpsrc->fd = -1;
+  g_queue_init (&vc2udpsrc->output);
+
+  gst_base_src_set_live (GST_BASE_SRC (vc2udpsrc), TRUE);
+  gst_base_src_set_format (GST_BASE_SRC (vc2udpsrc), GST_FORMAT_TIME);
+  gst_base_src_set_do_timestamp (GST_BASE_SRC (vc2udpsrc), TRUE);
+}
+
+static void
+gst_vc2_udp_src_finalize (GObject * object)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (object);
+
+  g_free (vc2udpsrc->address);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_vc2_udp_src_reset (GstVC2UdpSrc * vc2udpsrc)
+{
+  g_queue_foreach (&vc2udpsrc->output, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&vc2udpsrc->output);
+
+  g_free (vc2udpsrc->picture);
+  vc2udpsrc->picture           = NULL;
+  vc2udpsrc->picture_size      = 0;
+  vc2udpsrc->picture_alloc     = 0;
+  vc2udpsrc->last_picture_size = 0;
+
+  vc2udpsrc->have_seqnum            = FALSE;
+  vc2udpsrc->wait_start             = TRUE;
+  vc2udpsrc->last_parse_info_offset = 0;
+  vc2udpsrc->in_picture             = FALSE;
+  vc2udpsrc->picture_number         = 0;
+
+  VC2_STATS_SET (vc2udpsrc->stats_packets,          0);
+  VC2_STATS_SET (vc2udpsrc->stats_bytes,            0);
+  VC2_STATS_SET (vc2udpsrc->stats_syscalls,         0);
+  VC2_STATS_SET (vc2udpsrc->stats_gro_datagrams,    0);
+  VC2_STATS_SET (vc2udpsrc->stats_pictures,         0);
+  VC2_STATS_SET (vc2udpsrc->stats_dropped_pictures, 0);
+  VC2_STATS_SET (vc2udpsrc->stats_lost_packets,     0);
+  VC2_STATS_SET (vc2udpsrc->stats_truncated,        0);
+}
+
+static gboolean
+gst_vc2_udp_src_start (GstBaseSrc * basesrc)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (basesrc);
+  struct addrinfo hints, *res;
+  gchar port[8];
+  int err, on = 1;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags    = AI_NUMERICSERV | AI_PASSIVE;
+  g_snprintf (port, sizeof (port), "%d", vc2udpsrc->port);
+
+  err = getaddrinfo (vc2udpsrc->address, port, &hints, &res);
+  if (err != 0) {
+    GST_ELEMENT_ERROR (vc2udpsrc, RESOURCE, NOT_FOUND, (NULL),
+        ("Could not resolve %s: %s", vc2udpsrc->address, gai_strerror (err)));
+    return FALSE;
+  }
+
+  vc2udpsrc->fd = socket (res->ai_family, SOCK_DGRAM, 0);
+  if (vc2udpsrc->fd < 0) {
+    GST_ELEMENT_ERROR (vc2udpsrc, RESOURCE, OPEN_READ, (NULL),
+        ("Could not create socket: %s", g_strerror (errno)));
+    freeaddrinfo (res);
+    return FALSE;
+  }
+  setsockopt (vc2udpsrc->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+
+  if (bind (vc2udpsrc->fd, res->ai_addr, res->ai_addrlen) < 0) {
+    GST_ELEMENT_ERROR (vc2udpsrc, RESOURCE, OPEN_READ, (NULL),
+        ("Could not bind to %s:%d: %s", vc2udpsrc->address, vc2udpsrc->port, g_strerror (errno)));
+    freeaddrinfo (res);
+    close (vc2udpsrc->fd);
+    vc2udpsrc->fd = -1;
+    return FALSE;
+  }
+
+  if (res->ai_family == AF_INET &&
+      IN_MULTICAST (ntohl (((struct sockaddr_in *) res->ai_addr)->sin_addr.s_addr))) {
+    struct ip_mreq mreq;
+
+    memset (&mreq, 0, sizeof (mreq));
+    mreq.imr_multiaddr = ((struct sockaddr_in *) res->ai_addr)->sin_addr;
+    mreq.imr_interface.s_addr = htonl (INADDR_ANY);
+    if (setsockopt (vc2udpsrc->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) < 0)
+      GST_WARNING_OBJECT (vc2udpsrc, "could not join multicast group %s: %s",
+          vc2udpsrc->address, g_strerror (errno));
+  }
+  freeaddrinfo (res);
+
+  if (vc2udpsrc->buffer_size > 0 &&
+      setsockopt (vc2udpsrc->fd, SOL_SOCKET, SO_RCVBUF,
+          &vc2udpsrc->buffer_size, sizeof (vc2udpsrc->buffer_size)) < 0)
+    GST_WARNING_OBJECT (vc2udpsrc, "could not set receive buffer size: %s", g_strerror (errno));
+
+  vc2udpsrc->gro_active = FALSE;
+#ifdef VC2_UDP_HAVE_GRO
+  if (vc2udpsrc->gro)
+    vc2udpsrc->gro_active = (setsockopt (vc2udpsrc->fd, IPPROTO_UDP, UDP_GRO,
+            &on, sizeof (on)) == 0);
+#endif
+  if (vc2udpsrc->gro && !vc2udpsrc->gro_active)
+    GST_INFO_OBJECT (vc2udpsrc, "UDP GRO not available, receiving packets one by one");
+
+  vc2udpsrc->poll = gst_poll_new (TRUE);
+  gst_poll_fd_init (&vc2udpsrc->pollfd);
+  vc2udpsrc->pollfd.fd = vc2udpsrc->fd;
+  gst_poll_add_fd (vc2udpsrc->poll, &vc2udpsrc->pollfd);
+  gst_poll_fd_ctl_read (vc2udpsrc->poll, &vc2udpsrc->pollfd, TRUE);
+
+  vc2udpsrc->slot_size = (vc2udpsrc->gro_active) ? VC2_UDP_GRO_SLOT_SIZE : VC2_UDP_SLOT_SIZE;
+  vc2udpsrc->slab      = g_malloc (vc2udpsrc->slot_size*vc2udpsrc->batch);
+  vc2udpsrc->iov       = g_new0 (struct iovec, vc2udpsrc->batch);
+  vc2udpsrc->msgs      = g_new0 (struct mmsghdr, vc2udpsrc->batch);
+  vc2udpsrc->control   = g_malloc0 (VC2_UDP_CONTROL_SPACE*vc2udpsrc->batch);
+
+  gst_vc2_udp_src_reset (vc2udpsrc);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_udp_src_stop (GstBaseSrc * basesrc)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (basesrc);
+
+  gst_vc2_udp_src_reset (vc2udpsrc);
+
+  if (vc2udpsrc->poll)
+    gst_poll_free (vc2udpsrc->poll);
+  vc2udpsrc->poll = NULL;
+
+  g_free (vc2udpsrc->slab);
+  g_free (vc2udpsrc->iov);
+  g_free (vc2udpsrc->msgs);
+  g_free (vc2udpsrc->control);
+  vc2udpsrc->slab    = NULL;
+  vc2udpsrc->iov     = NULL;
+  vc2udpsrc->msgs    = NULL;
+  vc2udpsrc->control = NULL;
+
+  if (vc2udpsrc->fd >= 0)
+    close (vc2udpsrc->fd);
+  vc2udpsrc->fd = -1;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_udp_src_unlock (GstBaseSrc * basesrc)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (basesrc);
+
+  gst_poll_set_flushing (vc2udpsrc->poll, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vc2_udp_src_unlock_stop (GstBaseSrc * basesrc)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (basesrc);
+
+  gst_poll_set_flushing (vc2udpsrc->poll, FALSE);
+
+  return TRUE;
+}
+
+/* Returns a buffer holding a parse info header for parse_code followed by
+ * size bytes of data, linked to the previous unit output */
+static GstBuffer *
+gst_vc2_udp_src_unit (GstVC2UdpSrc * vc2udpsrc, guint8 parse_code,
+    const guint8 * data, gsize size)
+{
+  guint32 next_parse_info_offset = (parse_code == VC2_UDP_PARSE_CODE_END_OF_SEQUENCE) ? 0 : 13 + size;
+  guint8 *unit = g_malloc (13 + size);
+
+  vc2_parse_info_write (unit, parse_code, next_parse_info_offset, vc2udpsrc->last_parse_info_offset);
+  if (size > 0)
+    memcpy (unit + 13, data, size);
+  vc2udpsrc->last_parse_info_offset = next_parse_info_offset;
+
+  return gst_buffer_new_wrapped (unit, 13 + size);
+}
+
+static void
+gst_vc2_udp_src_drop_picture (GstVC2UdpSrc * vc2udpsrc)
+{
+  if (vc2udpsrc->in_picture)
+    VC2_STATS_INC (vc2udpsrc->stats_dropped_pictures);
+  vc2udpsrc->in_picture   = FALSE;
+  vc2udpsrc->picture_size = 0;
+}
+
+static void
+gst_vc2_udp_src_append (GstVC2UdpSrc * vc2udpsrc, const guint8 * data, gsize size)
+{
+  if (vc2udpsrc->picture_size + size > vc2udpsrc->picture_alloc) {
+    vc2udpsrc->picture_alloc = MAX (2*vc2udpsrc->picture_alloc, vc2udpsrc->picture_size + size);
+    vc2udpsrc->picture       = g_realloc (vc2udpsrc->picture, vc2udpsrc->picture_alloc);
+  }
+  memcpy (vc2udpsrc->picture + vc2udpsrc->picture_size, data, size);
+  vc2udpsrc->picture_size += size;
+}
+
+/* The picture handling of rtpvc2depay, appending straight to the output
+ * picture instead of going through an adapter */
+static void
+gst_vc2_udp_src_process_hq_fragment (GstVC2UdpSrc * vc2udpsrc,
+    const guint8 * payload, gsize length, gboolean M)
+{
+  guint32 picture_number;
+  gsize fragment_length;
+  guint no_slices;
+
+  if (length < 12 || vc2udpsrc->wait_start)
+    return;
+
+  picture_number  = GST_READ_UINT32_BE (payload);
+  fragment_length = GST_READ_UINT16_BE (payload + 8);
+  no_slices       = GST_READ_UINT16_BE (payload + 10);
+
+  if (no_slices == 0) {
+    /* Picture Parameters */
+    if (fragment_length > length - 12)
+      return;
+
+    gst_vc2_udp_src_drop_picture (vc2udpsrc);
+    if (vc2udpsrc->picture == NULL) {
+      vc2udpsrc->picture_alloc = MAX (vc2udpsrc->last_picture_size, 17 + fragment_length);
+      vc2udpsrc->picture       = g_malloc (vc2udpsrc->picture_alloc);
+    }
+    vc2udpsrc->in_picture     = TRUE;
+    vc2udpsrc->picture_number = picture_number;
+    vc2udpsrc->picture_size   = 17;
+    gst_vc2_udp_src_append (vc2udpsrc, payload + 12, fragment_length);
+    return;
+  }
+
+  if (!vc2udpsrc->in_picture || vc2udpsrc->picture_number != picture_number ||
+      length < 16 || fragment_length > length - 16) {
+    gst_vc2_udp_src_drop_picture (vc2udpsrc);
+    return;
+  }
+  gst_vc2_udp_src_append (vc2udpsrc, payload + 16, fragment_length);
+
+  if (M) {
+    guint32 next_parse_info_offset = vc2udpsrc->picture_size;
+
+    vc2_parse_info_write (vc2udpsrc->picture, 0xE8, next_parse_info_offset,
+        vc2udpsrc->last_parse_info_offset);
+    GST_WRITE_UINT32_BE (vc2udpsrc->picture + 13, vc2udpsrc->picture_number);
+    vc2udpsrc->last_parse_info_offset = next_parse_info_offset;
+
+    g_queue_push_tail (&vc2udpsrc->output,
+        gst_buffer_new_wrapped (vc2udpsrc->picture, vc2udpsrc->picture_size));
+    VC2_STATS_INC (vc2udpsrc->stats_pictures);
+
+    vc2udpsrc->last_picture_size = vc2udpsrc->picture_size;
+    vc2udpsrc->picture       = NULL;
+    vc2udpsrc->picture_size  = 0;
+    vc2udpsrc->picture_alloc = 0;
+    vc2udpsrc->in_picture    = FALSE;
+  }
+}
+
+static void
+gst_vc2_udp_src_process_packet (GstVC2UdpSrc * vc2udpsrc, const guint8 * data, gsize size)
+{
+  const guint8 *payload;
+  gsize header_len, length;
+  guint16 seqnum;
+  gboolean M;
+
+  if (size < 12 || (data[0] >> 6) != 2)
+    return;
+
+  VC2_STATS_INC (vc2udpsrc->stats_packets);
+  VC2_STATS_ADD (vc2udpsrc->stats_bytes, size);
+
+  header_len = 12 + 4*(data[0] & 0x0F);
+  if (data[0] & 0x20) {
+    /* padding */
+    if (data[size - 1] > size - header_len)
+      return;
+    size -= data[size - 1];
+  }
+  if (data[0] & 0x10) {
+    /* header extension */
+    if (header_len + 4 > size)
+      return;
+    header_len += 4 + 4*GST_READ_UINT16_BE (data + header_len + 2);
+  }
+  if (header_len + 4 > size)
+    return;
+
+  M      = ((data[1] & 0x80) != 0);
+  seqnum = GST_READ_UINT16_BE (data + 2);
+
+  if (vc2udpsrc->have_seqnum) {
+    gint16 gap = (gint16) (seqnum - vc2udpsrc->next_seqnum);
+
+    if (gap < 0 && gap > -VC2_UDP_MAX_MISORDER) {
+      GST_LOG_OBJECT (vc2udpsrc, "dropping late or repeated packet %u", seqnum);
+      return;
+    }
+    if (gap != 0) {
+      GST_DEBUG_OBJECT (vc2udpsrc, "sequence gap of %d before packet %u", gap, seqnum);
+      if (gap > 0)
+        VC2_STATS_ADD (vc2udpsrc->stats_lost_packets, gap);
+      gst_vc2_udp_src_drop_picture (vc2udpsrc);
+      vc2udpsrc->last_parse_info_offset = 0;
+    }
+  }
+  vc2udpsrc->have_seqnum = TRUE;
+  vc2udpsrc->next_seqnum = seqnum + 1;
+
+  payload = data + header_len;
+  length  = size - header_len;
+
+  switch (payload[3]) {
+    case VC2_UDP_PARSE_CODE_SEQUENCE_HEADER:
+      g_queue_push_tail (&vc2udpsrc->output,
+          gst_vc2_udp_src_unit (vc2udpsrc, 0x00, payload + 4, length - 4));
+      vc2udpsrc->wait_start = FALSE;
+      break;
+    case VC2_UDP_PARSE_CODE_END_OF_SEQUENCE:
+      g_queue_push_tail (&vc2udpsrc->output,
+          gst_vc2_udp_src_unit (vc2udpsrc, 0x10, NULL, 0));
+      vc2udpsrc->wait_start = TRUE;
+      break;
+    case VC2_UDP_PARSE_CODE_HQ_FRAGMENT:
+      gst_vc2_udp_src_process_hq_fragment (vc2udpsrc, payload + 4, length - 4, M);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Cuts a received datagram back into packets and processes them */
+static void
+gst_vc2_udp_src_process_datagram (GstVC2UdpSrc * vc2udpsrc, struct msghdr *hdr, gsize size)
+{
+  const guint8 *data = hdr->msg_iov[0].iov_base;
+  gsize segment = size, offset;
+
+  if (hdr->msg_flags & MSG_TRUNC) {
+    VC2_STATS_INC (vc2udpsrc->stats_truncated);
+    return;
+  }
+
+#ifdef VC2_UDP_HAVE_GRO
+  if (vc2udpsrc->gro_active) {
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR (hdr); cmsg; cmsg = CMSG_NXTHDR (hdr, cmsg)) {
+      if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+        int gso_size;
+
+        memcpy (&gso_size, CMSG_DATA (cmsg), sizeof (int));
+        if (gso_size > 0 && (gsize) gso_size < size) {
+          segment = gso_size;
+          VC2_STATS_INC (vc2udpsrc->stats_gro_datagrams);
+        }
+      }
+    }
+  }
+#endif
+
+  for (offset = 0; offset < size; offset += segment)
+    gst_vc2_udp_src_process_packet (vc2udpsrc, data + offset, MIN (segment, size - offset));
+}
+
+/* Waits for datagrams and processes one batch of them */
+static GstFlowReturn
+gst_vc2_udp_src_receive (GstVC2UdpSrc * vc2udpsrc)
+{
+  guint k;
+  int n;
+
+  if (gst_poll_wait (vc2udpsrc->poll, GST_CLOCK_TIME_NONE) < 0) {
+    if (errno == EBUSY)
+      return GST_FLOW_FLUSHING;
+    if (errno == EINTR || errno == EAGAIN)
+      return GST_FLOW_OK;
+    GST_ELEMENT_ERROR (vc2udpsrc, RESOURCE, READ, (NULL),
+        ("poll failed: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+
+  for (k = 0; k < vc2udpsrc->batch; k++) {
+    struct msghdr *hdr = &vc2udpsrc->msgs[k].msg_hdr;
+
+    vc2udpsrc->iov[k].iov_base = vc2udpsrc->slab + k*vc2udpsrc->slot_size;
+    vc2udpsrc->iov[k].iov_len  = vc2udpsrc->slot_size;
+
+    memset (hdr, 0, sizeof (struct msghdr));
+    hdr->msg_iov        = &vc2udpsrc->iov[k];
+    hdr->msg_iovlen     = 1;
+    hdr->msg_control    = vc2udpsrc->control + k*VC2_UDP_CONTROL_SPACE;
+    hdr->msg_controllen = VC2_UDP_CONTROL_SPACE;
+  }
+
+#ifdef HAVE_RECVMMSG
+  n = recvmmsg (vc2udpsrc->fd, vc2udpsrc->msgs, vc2udpsrc->batch, MSG_DONTWAIT, NULL);
+  VC2_STATS_INC (vc2udpsrc->stats_syscalls);
+#else
+  for (n = 0; n < (int) vc2udpsrc->batch; n++) {
+    ssize_t r = recvmsg (vc2udpsrc->fd, &vc2udpsrc->msgs[n].msg_hdr, MSG_DONTWAIT);
+
+    VC2_STATS_INC (vc2udpsrc->stats_syscalls);
+    if (r < 0)
+      break;
+    vc2udpsrc->msgs[n].msg_len = r;
+  }
+  if (n == 0)
+    n = -1;
+#endif
+
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNREFUSED)
+      return GST_FLOW_OK;
+    GST_ELEMENT_ERROR (vc2udpsrc, RESOURCE, READ, (NULL),
+        ("receive failed: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+
+  for (k = 0; k < (guint) n; k++)
+    gst_vc2_udp_src_process_datagram (vc2udpsrc, &vc2udpsrc->msgs[k].msg_hdr,
+        vc2udpsrc->msgs[k].msg_len);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_vc2_udp_src_create (GstPushSrc * pushsrc, GstBuffer ** buffer)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (pushsrc);
+  GstFlowReturn ret;
+
+  while (g_queue_is_empty (&vc2udpsrc->output)) {
+    ret = gst_vc2_udp_src_receive (vc2udpsrc);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
+
+  *buffer = g_queue_pop_head (&vc2udpsrc->output);
+  return GST_FLOW_OK;
+}
+
+static GstStructure *
+gst_vc2_udp_src_get_stats (GstVC2UdpSrc * vc2udpsrc)
+{
+  return gst_structure_new ("application/x-vc2-udp-src-stats",
+      "packets",          G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_packets),
+      "bytes",            G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_bytes),
+      "syscalls",         G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_syscalls),
+      "gro-datagrams",    G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_gro_datagrams),
+      "pictures",         G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_pictures),
+      "dropped-pictures", G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_dropped_pictures),
+      "lost-packets",     G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_lost_packets),
+      "truncated",        G_TYPE_UINT64,  VC2_STATS_GET (vc2udpsrc->stats_truncated),
+      "gro",              G_TYPE_BOOLEAN, VC2_STATS_GET (vc2udpsrc->gro_active),
+      NULL);
+}
+
+static void
+gst_vc2_udp_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (object);
+
+  GST_OBJECT_LOCK (vc2udpsrc);
+  switch (prop_id) {
+    case PROP_ADDRESS:
+      g_free (vc2udpsrc->address);
+      vc2udpsrc->address = g_value_dup_string (value);
+      break;
+    case PROP_PORT:
+      vc2udpsrc->port = g_value_get_int (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      vc2udpsrc->buffer_size = g_value_get_int (value);
+      break;
+    case PROP_BATCH:
+      vc2udpsrc->batch = g_value_get_uint (value);
+      break;
+    case PROP_GRO:
+      vc2udpsrc->gro = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2udpsrc);
+}
+
+static void
+gst_vc2_udp_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVC2UdpSrc *vc2udpsrc = GST_VC2_UDP_SRC (object);
+
+  /* The counters are atomic, reading them needs no lock */
+  if (prop_id == PROP_STATS) {
+    g_value_take_boxed (value, gst_vc2_udp_src_get_stats (vc2udpsrc));
+    return;
+  }
+
+  GST_OBJECT_LOCK (vc2udpsrc);
+  switch (prop_id) {
+    case PROP_ADDRESS:
+      g_value_set_string (value, vc2udpsrc->address);
+      break;
+    case PROP_PORT:
+      g_value_set_int (value, vc2udpsrc->port);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_int (value, vc2udpsrc->buffer_size);
+      break;
+    case PROP_BATCH:
+      g_value_set_uint (value, vc2udpsrc->batch);
+      break;
+    case PROP_GRO:
+      g_value_set_boolean (value, vc2udpsrc->gro);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vc2udpsrc);
+}
+
+gboolean
+gst_vc2_udp_src_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vc2udpsrc",
+                               GST_RANK_NONE, GST_TYPE_VC2_UDP_SRC);
+}
@@ -0,0 +1,106 @@
+/* GStreamer
+ * Copyright (C) <2015> James Weaver <james.barrett@bbc.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_VC2_UDP_SRC_H__
+#define __GST_VC2_UDP_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VC2_UDP_SRC \
+  (gst_vc2_udp_src_get_type())
+#define GST_VC2_UDP_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VC2_UDP_SRC,GstVC2UdpSrc))
+#define GST_VC2_UDP_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VC2_UDP_SRC,GstVC2UdpSrcClass))
+#define GST_IS_VC2_UDP_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VC2_UDP_SRC))
+#define GST_IS_VC2_UDP_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VC2_UDP_SRC))
+
+typedef struct _GstVC2UdpSrc GstVC2UdpSrc;
+typedef struct _GstVC2UdpSrcClass GstVC2UdpSrcClass;
+
+struct _GstVC2UdpSrc
+{
+  GstPushSrc pushsrc;
+
+  /* properties */
+  gchar   *address;
+  gint     port;
+  gint     buffer_size;
+  guint    batch;
+  gboolean gro;
+
+  int      fd;
+  GstPoll *poll;
+  GstPollFD pollfd;
+  gboolean gro_active;
+
+  /* one slot per message in a recvmmsg batch */
+  guint8         *slab;
+  gsize           slot_size;
+  struct iovec   *iov;
+  struct mmsghdr *msgs;
+  guint8         *control;
+
+  /* complete units waiting to be output */
+  GQueue   output;
+
+  gboolean have_seqnum;
+  guint16  next_seqnum;
+
+  /* the same parsing state as rtpvc2depay */
+  gboolean wait_start;
+  guint32  last_parse_info_offset;
+  gboolean in_picture;
+  guint32  picture_number;
+
+  /* the picture being assembled, with room for its 17 byte header */
+  guint8  *picture;
+  gsize    picture_size;
+  gsize    picture_alloc;
+  gsize    last_picture_size;
+
+  /* statistics, updated with VC2_STATS_* */
+  guint64 stats_packets;
+  guint64 stats_bytes;
+  guint64 stats_syscalls;
+  guint64 stats_gro_datagrams;
+  guint64 stats_pictures;
+  guint64 stats_dropped_pictures;
+  guint64 stats_lost_packets;
+  guint64 stats_truncated;
+};
+
+struct _GstVC2UdpSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType gst_vc2_udp_src_get_type (void);
+
+gboolean gst_vc2_udp_src_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+
+#endif /* __GST_VC2_UDP_SRC_H__ */
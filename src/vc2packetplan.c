@@ -0,0 +1,156 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "vc2packetplan.h"
+
+/* How many packets of at most limit bytes slices first to last - 1 take
+ * when each packet is filled as far as it will go. Filling greedily takes
+ * the fewest packets there can be. */
+static guint
+vc2_packet_plan_greedy (const guint32 *offsets, guint first, guint last, gsize limit, guint *bounds)
+{
+  guint n = 0;
+  guint end;
+
+  while (first < last) {
+    if (bounds != NULL)
+      bounds[n] = first;
+    n++;
+
+    end = first + 1;
+    while (end < last && offsets[end + 1] - offsets[first] <= limit)
+      end++;
+    first = end;
+  }
+  if (bounds != NULL)
+    bounds[n] = last;
+
+  return n;
+}
+
+guint
+vc2_packet_plan_count (const guint32 *offsets, guint first, guint last, gsize room)
+{
+  return vc2_packet_plan_greedy (offsets, first, last, room, NULL);
+}
+
+/* The number of slices that do not fit in a packet on their own */
+guint
+vc2_packet_plan_oversized (const guint32 *offsets, guint first, guint last, gsize room)
+{
+  guint n = 0;
+  guint i;
+
+  for (i = first; i < last; i++) {
+    if (offsets[i + 1] - offsets[i] > room)
+      n++;
+  }
+
+  return n;
+}
+
+/* Balancing keeps the fewest packets greedy filling gives, n, but brings
+ * down the size of the biggest: a binary search finds the smallest limit
+ * that still only needs n packets. Filling up to that limit would still
+ * leave a short last packet, so instead each bound goes as near as it can
+ * to an even share of what is left, no earlier than the latest point from
+ * which the remaining packets can still hold the rest under the limit.
+ * Those latest points come from filling backwards from the end, and are
+ * kept in bounds until the forward pass overwrites them. */
+static guint
+vc2_packet_plan_balanced (const guint32 *offsets, guint first, guint last, gsize room, guint *bounds)
+{
+  guint n, j, start, end, max_end;
+  gsize low, high, limit, target;
+
+  n = vc2_packet_plan_greedy (offsets, first, last, room, NULL);
+  if (n <= 1)
+    return vc2_packet_plan_greedy (offsets, first, last, room, bounds);
+
+  /* The limit can be no lower than the biggest slice that fits at all */
+  low = 0;
+  for (j = first; j < last; j++) {
+    if (offsets[j + 1] - offsets[j] <= room)
+      low = MAX (low, offsets[j + 1] - offsets[j]);
+  }
+  high = room;
+  while (low < high) {
+    limit = low + (high - low)/2;
+    if (vc2_packet_plan_greedy (offsets, first, last, limit, NULL) <= n)
+      high = limit;
+    else
+      low = limit + 1;
+  }
+  limit = low;
+
+  bounds[n] = last;
+  for (j = n; j > 0; j--) {
+    end = bounds[j];
+    if (end <= first) {
+      bounds[j - 1] = first;
+      continue;
+    }
+    start = end - 1;
+    while (start > first && offsets[end] - offsets[start - 1] <= limit)
+      start--;
+    bounds[j - 1] = start;
+  }
+
+  bounds[0] = first;
+  for (j = 0; j + 1 < n; j++) {
+    start = bounds[j];
+
+    max_end = start + 1;
+    while (max_end < last && offsets[max_end + 1] - offsets[start] <= limit)
+      max_end++;
+    max_end = MIN (max_end, last - (n - j - 1));
+
+    target = offsets[start] + (offsets[last] - offsets[start])/(n - j);
+    end = MAX (bounds[j + 1], start + 1);
+    while (end < max_end && offsets[end] < target)
+      end++;
+    if (end > MAX (bounds[j + 1], start + 1) &&
+        target - offsets[end - 1] < offsets[end] - target)
+      end--;
+
+    bounds[j + 1] = MIN (end, max_end);
+  }
+
+  return n;
+}
+
+/* Splits slices first to last - 1 into packets of at most room bytes, each
+ * but over-size slices, writing the first slice of each packet and then
+ * last to bounds, which needs room for last - first + 1 entries. Returns
+ * the number of packets. */
+guint
+vc2_packet_plan (const guint32 *offsets, guint first, guint last, gsize room,
+                 vc2_packet_plan_mode mode, guint *bounds)
+{
+  if (mode == VC2_PACKET_PLAN_BALANCED)
+    return vc2_packet_plan_balanced (offsets, first, last, room, bounds);
+
+  return vc2_packet_plan_greedy (offsets, first, last, room, bounds);
+}
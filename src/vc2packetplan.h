@@ -0,0 +1,45 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __VC2_PACKET_PLAN_H__
+#define __VC2_PACKET_PLAN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Splitting a run of slices into packets. offsets[i] is where slice i starts
+ * and offsets[i + 1] where it ends, so each packet holds the slices from one
+ * bound up to the next. Every packet gets at least one slice, so a slice
+ * bigger than room on its own goes in a packet by itself and the packet is
+ * over size. */
+typedef enum {
+  VC2_PACKET_PLAN_GREEDY,
+  VC2_PACKET_PLAN_BALANCED,
+} vc2_packet_plan_mode;
+
+guint vc2_packet_plan_count     (const guint32 *offsets, guint first, guint last, gsize room);
+guint vc2_packet_plan_oversized (const guint32 *offsets, guint first, guint last, gsize room);
+guint vc2_packet_plan           (const guint32 *offsets, guint first, guint last, gsize room,
+                                 vc2_packet_plan_mode mode, guint *bounds);
+
+G_END_DECLS
+
+#endif /* __VC2_PACKET_PLAN_H__ */
@@ -0,0 +1,62 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __VC2_PROBES_H__
+#define __VC2_PROBES_H__
+
+#include <glib.h>
+
+/* Static tracepoints for the packetisation hot paths, compiled in with
+ * ./configure --enable-sdt-probes. They show up as USDT probes under the
+ * gstrtpvc2 provider, e.g. for bpftrace:
+ *
+ *   usdt:libgstrtpvc2.so:gstrtpvc2:depay_picture { ... }
+ *
+ * A disabled probe site is a single nop, and without --enable-sdt-probes the
+ * macros expand to nothing and their arguments are never evaluated.
+ *
+ * Probes and their arguments:
+ *
+ *   pay_parse_info        (parse_code, next_parse_offset, bytes_buffered)
+ *   pay_picture           (picture_number, size, pts)
+ *   pay_packet_built      (picture_number, first_slice, n_slices, size)
+ *   pay_packet_pushed     (extended_seqnum, size, flow_return)
+ *   pay_picture_dropped   (picture_number or -1, reason)
+ *   depay_fragment        (picture_number, n_slices, fragment_length, marker)
+ *   depay_picture         (picture_number, size)
+ *   depay_picture_dropped (picture_number or -1, reason)
+ *   depay_picture_concealed (picture_number, n_slices)
+ *
+ * reason is a string, read it with str(arg1) in bpftrace. */
+#ifdef ENABLE_SDT_PROBES
+#include <sys/sdt.h>
+
+#define VC2_PROBE1(name, a)             DTRACE_PROBE1 (gstrtpvc2, name, a)
+#define VC2_PROBE2(name, a, b)          DTRACE_PROBE2 (gstrtpvc2, name, a, b)
+#define VC2_PROBE3(name, a, b, c)       DTRACE_PROBE3 (gstrtpvc2, name, a, b, c)
+#define VC2_PROBE4(name, a, b, c, d)    DTRACE_PROBE4 (gstrtpvc2, name, a, b, c, d)
+#else
+#define VC2_PROBE1(name, a)             G_STMT_START { } G_STMT_END
+#define VC2_PROBE2(name, a, b)          G_STMT_START { } G_STMT_END
+#define VC2_PROBE3(name, a, b, c)       G_STMT_START { } G_STMT_END
+#define VC2_PROBE4(name, a, b, c, d)    G_STMT_START { } G_STMT_END
+#endif
+
+#endif /* __VC2_PROBES_H__ */
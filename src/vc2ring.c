@@ -0,0 +1,120 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "vc2ring.h"
+
+/* The indices run freely and wrap at 2^32, so head - tail is always the
+ * number of items held. The producer publishes a slot by storing head with
+ * release ordering after writing it, and the consumer frees one by storing
+ * tail with release ordering after reading it. */
+
+vc2_ring*
+vc2_ring_new (guint capacity)
+{
+  vc2_ring *ring;
+  guint size;
+
+  g_return_val_if_fail (capacity > 0 && capacity <= G_MAXUINT/2, NULL);
+
+  size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  ring = g_new0 (vc2_ring, 1);
+  ring->slots    = g_new0 (gpointer, size);
+  ring->capacity = capacity;
+  ring->mask     = size - 1;
+  ring->head     = 0;
+  ring->tail     = 0;
+
+  return ring;
+}
+
+void
+vc2_ring_free (vc2_ring *ring, GDestroyNotify free_func)
+{
+  gpointer item;
+
+  if (ring == NULL)
+    return;
+
+  while ((item = vc2_ring_pop (ring)) != NULL) {
+    if (free_func)
+      free_func (item);
+  }
+
+  g_free (ring->slots);
+  g_free (ring);
+}
+
+/* Producer only. Returns FALSE, without taking the item, when the ring is
+ * full. */
+gboolean
+vc2_ring_push (vc2_ring *ring, gpointer item)
+{
+  guint head = ring->head;
+  guint tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+
+  g_return_val_if_fail (item != NULL, FALSE);
+
+  if (head - tail >= ring->capacity)
+    return FALSE;
+
+  ring->slots[head & ring->mask] = item;
+  __atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  return TRUE;
+}
+
+/* Consumer only. Returns NULL when the ring is empty. */
+gpointer
+vc2_ring_pop (vc2_ring *ring)
+{
+  guint tail = ring->tail;
+  guint head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+  gpointer item;
+
+  if (head == tail)
+    return NULL;
+
+  item = ring->slots[tail & ring->mask];
+  __atomic_store_n (&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return item;
+}
+
+/* Either side may call this, the answer may be out of date by the time it
+ * is used */
+guint
+vc2_ring_length (vc2_ring *ring)
+{
+  return __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+guint
+vc2_ring_size (vc2_ring *ring)
+{
+  return ring->capacity;
+}
@@ -0,0 +1,50 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __VC2_RING_H__
+#define __VC2_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Bounded single-producer/single-consumer ring of pointers. Only one thread
+ * may push and only one other thread may pop; neither ever takes a lock.
+ * head is written only by the producer and tail only by the consumer. */
+typedef struct _vc2_ring vc2_ring;
+
+struct _vc2_ring {
+  gpointer *slots;
+  guint     capacity;
+  guint     mask;
+  guint     head;
+  guint     tail;
+};
+
+vc2_ring* vc2_ring_new    (guint capacity);
+void      vc2_ring_free   (vc2_ring *ring, GDestroyNotify free_func);
+gboolean  vc2_ring_push   (vc2_ring *ring, gpointer item);
+gpointer  vc2_ring_pop    (vc2_ring *ring);
+guint     vc2_ring_length (vc2_ring *ring);
+guint     vc2_ring_size   (vc2_ring *ring);
+
+G_END_DECLS
+
+#endif /* __VC2_RING_H__ */
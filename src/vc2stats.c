@@ -0,0 +1,113 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab: */
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "vc2stats.h"
+
+void vc2_stats_histogram_reset (vc2_stats_histogram *histogram) {
+  guint i;
+
+  VC2_STATS_SET (histogram->count, 0);
+  VC2_STATS_SET (histogram->sum,   0);
+  VC2_STATS_SET (histogram->max,   0);
+  for (i = 0; i < VC2_STATS_HISTOGRAM_BUCKETS; i++)
+    VC2_STATS_SET (histogram->buckets[i], 0);
+}
+
+void vc2_stats_histogram_add (vc2_stats_histogram *histogram, GstClockTime t) {
+  guint64 us = t/1000;
+  guint bucket = 0;
+
+  while (us > 0 && bucket < VC2_STATS_HISTOGRAM_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+
+  VC2_STATS_INC (histogram->count);
+  VC2_STATS_ADD (histogram->sum, t);
+  VC2_STATS_MAX (histogram->max, t);
+  VC2_STATS_INC (histogram->buckets[bucket]);
+}
+
+/* Adds <name>-count, <name>-mean and <name>-max in nanoseconds and
+ * <name>-histogram, an array of the bucket counts, to s */
+void vc2_stats_histogram_append (vc2_stats_histogram *histogram, GstStructure *s, const gchar *name) {
+  GValue buckets = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  guint64 count = VC2_STATS_GET (histogram->count);
+  guint64 sum   = VC2_STATS_GET (histogram->sum);
+  gchar *field;
+  guint i;
+
+  field = g_strdup_printf ("%s-count", name);
+  gst_structure_set (s, field, G_TYPE_UINT64, count, NULL);
+  g_free (field);
+
+  field = g_strdup_printf ("%s-mean", name);
+  gst_structure_set (s, field, G_TYPE_UINT64, (count > 0) ? sum/count : (guint64) 0, NULL);
+  g_free (field);
+
+  field = g_strdup_printf ("%s-max", name);
+  gst_structure_set (s, field, G_TYPE_UINT64, VC2_STATS_GET (histogram->max), NULL);
+  g_free (field);
+
+  g_value_init (&buckets, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+  for (i = 0; i < VC2_STATS_HISTOGRAM_BUCKETS; i++) {
+    g_value_set_uint64 (&v, VC2_STATS_GET (histogram->buckets[i]));
+    gst_value_array_append_value (&buckets, &v);
+  }
+  g_value_unset (&v);
+
+  field = g_strdup_printf ("%s-histogram", name);
+  gst_structure_take_value (s, field, &buckets);
+  g_free (field);
+}
+
+static gboolean vc2_stats_copy_field (GQuark field, const GValue *value, gpointer s) {
+  if (!gst_structure_id_has_field ((GstStructure *) s, field))
+    gst_structure_id_set_value ((GstStructure *) s, field, value);
+  return TRUE;
+}
+
+/* The RTP base classes have a stats property of their own (from 1.4), which
+ * the elements' stats property hides. This copies its fields into s, so
+ * nothing is lost. */
+void vc2_stats_merge_parent (GObject *object, gpointer parent_class, GstStructure *s) {
+  GParamSpec *pspec;
+  GValue v = G_VALUE_INIT;
+  const GstStructure *parent_stats;
+
+  pspec = g_object_class_find_property (G_OBJECT_CLASS (parent_class), "stats");
+  if (pspec == NULL || !(pspec->flags & G_PARAM_READABLE) ||
+      G_PARAM_SPEC_VALUE_TYPE (pspec) != GST_TYPE_STRUCTURE)
+    return;
+
+  g_value_init (&v, GST_TYPE_STRUCTURE);
+  G_OBJECT_CLASS (g_type_class_peek (pspec->owner_type))->get_property (object, pspec->param_id, &v, pspec);
+  parent_stats = gst_value_get_structure (&v);
+  if (parent_stats)
+    gst_structure_foreach (parent_stats, vc2_stats_copy_field, s);
+  g_value_unset (&v);
+}
@@ -0,0 +1,62 @@
+/* GStreamer VC2 RTP
+ *
+ * James Weaver <james.barrett@bbc.co.uk> (C) BBC <2015>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __VC2_STATS_H__
+#define __VC2_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Counters are written by the streaming thread and read by whoever asks for
+ * the stats property, so they are updated with relaxed atomics: no locks and
+ * no ordering, just no torn values. */
+#define VC2_STATS_ADD(counter, n) __atomic_fetch_add (&(counter), (n), __ATOMIC_RELAXED)
+#define VC2_STATS_INC(counter)    VC2_STATS_ADD (counter, 1)
+#define VC2_STATS_GET(counter)    __atomic_load_n (&(counter), __ATOMIC_RELAXED)
+#define VC2_STATS_SET(counter, n) __atomic_store_n (&(counter), (n), __ATOMIC_RELAXED)
+#define VC2_STATS_MAX(counter, n) \
+  G_STMT_START { \
+    if ((n) > VC2_STATS_GET (counter)) \
+      VC2_STATS_SET (counter, n); \
+  } G_STMT_END
+
+/* Bucket 0 counts times under 1us, bucket i times from 2^(i-1)us up to
+ * 2^i us, and the last bucket everything longer */
+#define VC2_STATS_HISTOGRAM_BUCKETS 24
+
+typedef struct _vc2_stats_histogram vc2_stats_histogram;
+
+struct _vc2_stats_histogram {
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint64 buckets[VC2_STATS_HISTOGRAM_BUCKETS];
+};
+
+void vc2_stats_histogram_reset  (vc2_stats_histogram *histogram);
+void vc2_stats_histogram_add    (vc2_stats_histogram *histogram, GstClockTime t);
+void vc2_stats_histogram_append (vc2_stats_histogram *histogram, GstStructure *s, const gchar *name);
+
+void vc2_stats_merge_parent (GObject *object, gpointer parent_class, GstStructure *s);
+
+G_END_DECLS
+
+#endif /* __VC2_STATS_H__ */
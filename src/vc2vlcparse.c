@@ -26,18 +26,27 @@
 #include "vc2vlcparse.h"
 #include <stdlib.h>
 
+void             vc2_vlc_decoder_init     (vc2_vlc_decoder *decoder, guint8 *data, gssize size) {
+  decoder->start   = data;
+  decoder->bit     = 7;
+  decoder->offset  = 0;
+  decoder->size    = size;
+  decoder->overrun = FALSE;
+}
+
 vc2_vlc_decoder* vc2_vlc_decoder_new      (guint8 *data, gssize size) {
   vc2_vlc_decoder* r = (vc2_vlc_decoder *)malloc(sizeof(vc2_vlc_decoder));
-  r->start  = data;
-  r->bit    = 7;
-  r->offset = 0;
-  r->size   = size;
+  vc2_vlc_decoder_init(r, data, size);
   return r;
 }
 
+/* Reading past the end returns 1, which ends any uint being read, and marks
+ * the decoder as overrun so that the caller can reject what it parsed */
 gint vc2_vlc_decoder_read_bit(vc2_vlc_decoder *decoder) {
-  if (decoder->offset >= decoder->size)
+  if (decoder->offset >= decoder->size) {
+    decoder->overrun = TRUE;
     return 1;
+  }
 
   gint d = ((decoder->start[decoder->offset]) >> decoder->bit)&0x1;
   decoder->bit--;
@@ -49,23 +58,32 @@ gint vc2_vlc_decoder_read_bit(vc2_vlc_decoder *decoder) {
 }
 
 gboolean         vc2_vlc_decoder_overrun  (vc2_vlc_decoder *decoder) {
-  if (decoder->offset >= decoder->size)
-    return TRUE;
-  return FALSE;
+  return decoder->overrun;
 }
 
 gboolean         vc2_vlc_decoder_read_bool(vc2_vlc_decoder *decoder) {
   return (gboolean)vc2_vlc_decoder_read_bit(decoder);
 }
 
+/* Values which do not fit in 32 bits are treated like an overrun */
 guint32          vc2_vlc_decoder_read_uint(vc2_vlc_decoder *decoder) {
-  guint32 d = 1;
+  guint64 d = 1;
+  int n = 0;
   while (vc2_vlc_decoder_read_bit(decoder) == 0) {
+    if (++n > 32) {
+      decoder->overrun = TRUE;
+      return 0;
+    }
     d <<= 1;
     d |= vc2_vlc_decoder_read_bit(decoder);
   }
 
-  return d - 1;
+  if (d - 1 > G_MAXUINT32) {
+    decoder->overrun = TRUE;
+    return 0;
+  }
+
+  return (guint32)(d - 1);
 }
 
 gssize           vc2_vlc_decoder_length   (vc2_vlc_decoder *decoder) {
@@ -79,166 +97,415 @@ void             vc2_vlc_decoder_free     (vc2_vlc_decoder *decoder) {
   free((void *)decoder);
 }
 
-struct _base_video_format_info {
+vc2_vlc_encoder* vc2_vlc_encoder_new       (guint8 *data, gssize size) {
+  vc2_vlc_encoder* r = (vc2_vlc_encoder *)malloc(sizeof(vc2_vlc_encoder));
+  r->start   = data;
+  r->bit     = 7;
+  r->offset  = 0;
+  r->size    = size;
+  r->overrun = FALSE;
+  return r;
+}
+
+static void vc2_vlc_encoder_write_bit(vc2_vlc_encoder *encoder, gint d) {
+  if (encoder->offset >= encoder->size) {
+    encoder->overrun = TRUE;
+    return;
+  }
+
+  if (d)
+    encoder->start[encoder->offset] |= (1 << encoder->bit);
+  else
+    encoder->start[encoder->offset] &= ~(1 << encoder->bit);
+  encoder->bit--;
+  if (encoder->bit < 0) {
+    encoder->offset++;
+    encoder->bit = 7;
+  }
+}
+
+gboolean         vc2_vlc_encoder_overrun   (vc2_vlc_encoder *encoder) {
+  return encoder->overrun;
+}
+
+void             vc2_vlc_encoder_write_bool(vc2_vlc_encoder *encoder, gboolean d) {
+  vc2_vlc_encoder_write_bit(encoder, (d)?(1):(0));
+}
+
+/* Interleaved exp-Golomb, the inverse of vc2_vlc_decoder_read_uint */
+void             vc2_vlc_encoder_write_uint(vc2_vlc_encoder *encoder, guint32 d) {
+  guint64 v = (guint64)d + 1;
+  int n = 0;
+
+  while ((v >> (n + 1)) != 0)
+    n++;
+
+  while (n > 0) {
+    n--;
+    vc2_vlc_encoder_write_bit(encoder, 0);
+    vc2_vlc_encoder_write_bit(encoder, (v >> n)&0x1);
+  }
+  vc2_vlc_encoder_write_bit(encoder, 1);
+}
+
+/* The length in bytes, including the partly written last byte. Any unwritten
+ * bits in that byte are left as zero, which byte aligns the data */
+gssize           vc2_vlc_encoder_length    (vc2_vlc_encoder *encoder) {
+  if (encoder->bit == 7)
+    return encoder->offset;
+
+  encoder->start[encoder->offset] &= ~((1 << (encoder->bit + 1)) - 1);
+  return encoder->offset + 1;
+}
+
+void             vc2_vlc_encoder_free      (vc2_vlc_encoder *encoder) {
+  free((void *)encoder);
+}
+
+static const struct _frame_rate_info {
+  guint32 numer;
+  guint32 denom;
+} FRAME_RATE_INFO[] = {
+  { 0, 1 },
+  { 24000, 1001 },
+  { 24, 1 },
+  { 25, 1 },
+  { 30000, 1001 },
+  { 30, 1 },
+  { 50, 1 },
+  { 60000, 1001 },
+  { 60, 1 },
+  { 15000, 1001 },
+  { 25, 2 },
+  { 48, 1 },
+  { 48000, 1001 },
+  { 96, 1 },
+  { 100, 1 },
+  { 120000, 1001 },
+  { 120, 1 },
+};
+
+#define N_FRAME_RATES (sizeof(FRAME_RATE_INFO)/sizeof(FRAME_RATE_INFO[0]))
+
+static const struct _base_video_format_info {
   guint32 frame_width;
   guint32 frame_height;
   gboolean interlaced;
+  guint32 frame_rate_index;
+  guint32 color_diff_format;
 } BASE_VIDEO_FORMAT_INFO[] = {
-  { 640, 480, FALSE },
-  { 176, 120, FALSE },
-  { 176, 144, FALSE },
-  { 352, 240, FALSE },
-  { 352, 288, FALSE },
-  { 704, 480, FALSE },
-  { 704, 576, FALSE },
-  { 720, 480, TRUE },
-  { 720, 576, TRUE },
-  { 1280, 720, FALSE },
-  { 1280, 720, FALSE },
-  { 1920, 1080, TRUE },
-  { 1920, 1080, TRUE },
-  { 1920, 1080, FALSE },
-  { 1920, 1080, FALSE },
-  { 2048, 1080, FALSE },
-  { 4096, 2160, FALSE },
-  { 3840, 2160, FALSE },
-  { 3840, 2160, FALSE },
-  { 7680, 4320, FALSE },
-  { 7680, 4320, FALSE },
-  { 1920, 1080, FALSE },
-  { 720, 486, TRUE },
+  { 640, 480, FALSE, 1, VC2_COLOR_DIFF_420 },
+  { 176, 120, FALSE, 9, VC2_COLOR_DIFF_420 },
+  { 176, 144, FALSE, 10, VC2_COLOR_DIFF_420 },
+  { 352, 240, FALSE, 9, VC2_COLOR_DIFF_420 },
+  { 352, 288, FALSE, 10, VC2_COLOR_DIFF_420 },
+  { 704, 480, FALSE, 9, VC2_COLOR_DIFF_420 },
+  { 704, 576, FALSE, 10, VC2_COLOR_DIFF_420 },
+  { 720, 480, TRUE, 4, VC2_COLOR_DIFF_422 },
+  { 720, 576, TRUE, 3, VC2_COLOR_DIFF_422 },
+  { 1280, 720, FALSE, 7, VC2_COLOR_DIFF_422 },
+  { 1280, 720, FALSE, 6, VC2_COLOR_DIFF_422 },
+  { 1920, 1080, TRUE, 4, VC2_COLOR_DIFF_422 },
+  { 1920, 1080, TRUE, 3, VC2_COLOR_DIFF_422 },
+  { 1920, 1080, FALSE, 7, VC2_COLOR_DIFF_422 },
+  { 1920, 1080, FALSE, 6, VC2_COLOR_DIFF_422 },
+  { 2048, 1080, FALSE, 2, VC2_COLOR_DIFF_444 },
+  { 4096, 2160, FALSE, 2, VC2_COLOR_DIFF_444 },
+  { 3840, 2160, FALSE, 7, VC2_COLOR_DIFF_422 },
+  { 3840, 2160, FALSE, 6, VC2_COLOR_DIFF_422 },
+  { 7680, 4320, FALSE, 7, VC2_COLOR_DIFF_422 },
+  { 7680, 4320, FALSE, 6, VC2_COLOR_DIFF_422 },
+  { 1920, 1080, FALSE, 1, VC2_COLOR_DIFF_422 },
+  { 720, 486, TRUE, 4, VC2_COLOR_DIFF_422 },
 };
 
-vc2_sequence_header* vc2_sequence_header_new (GstBuffer *buf) {
-  vc2_sequence_header* hdr = (vc2_sequence_header*)malloc(sizeof(vc2_sequence_header));
-  hdr->buf            = gst_buffer_ref(buf);
-  hdr->length         = 0;
-  hdr->picture_width  = 0;
-  hdr->picture_height = 0;
-  hdr->interlaced     = FALSE;
-
-  {
-    GstMapInfo info;
-    gst_buffer_map(hdr->buf, &info, GST_MAP_READ);
-    vc2_vlc_decoder* dec = vc2_vlc_decoder_new(info.data, info.size);
-
-    unsigned int major_version = vc2_vlc_decoder_read_uint(dec);
-    vc2_vlc_decoder_read_uint(dec);
-    unsigned int profile       = vc2_vlc_decoder_read_uint(dec);
-    vc2_vlc_decoder_read_uint(dec);
-
-    if (major_version != 2 || profile != 3) {
-      vc2_vlc_decoder_free(dec);
-      gst_buffer_unmap(hdr->buf, &info);
-      gst_buffer_unref(hdr->buf);
-      free(hdr);
-      return NULL;
-    }
+#define N_BASE_VIDEO_FORMATS (sizeof(BASE_VIDEO_FORMAT_INFO)/sizeof(BASE_VIDEO_FORMAT_INFO[0]))
 
-    unsigned int base_video_format = vc2_vlc_decoder_read_uint(dec);
-    unsigned int frame_width  = BASE_VIDEO_FORMAT_INFO[base_video_format].frame_width;
-    unsigned int frame_height = BASE_VIDEO_FORMAT_INFO[base_video_format].frame_height;
-    gboolean     interlaced   = BASE_VIDEO_FORMAT_INFO[base_video_format].interlaced;
+gboolean vc2_base_video_format_get (guint32 index,
+                                    guint32 *frame_width, guint32 *frame_height, gboolean *interlaced,
+                                    guint32 *frame_rate_numer, guint32 *frame_rate_denom) {
+  if (index >= N_BASE_VIDEO_FORMATS)
+    return FALSE;
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      frame_width  = vc2_vlc_decoder_read_uint(dec);
-      frame_height = vc2_vlc_decoder_read_uint(dec);
-    }
+  if (frame_width)
+    *frame_width      = BASE_VIDEO_FORMAT_INFO[index].frame_width;
+  if (frame_height)
+    *frame_height     = BASE_VIDEO_FORMAT_INFO[index].frame_height;
+  if (interlaced)
+    *interlaced       = BASE_VIDEO_FORMAT_INFO[index].interlaced;
+  if (frame_rate_numer)
+    *frame_rate_numer = FRAME_RATE_INFO[BASE_VIDEO_FORMAT_INFO[index].frame_rate_index].numer;
+  if (frame_rate_denom)
+    *frame_rate_denom = FRAME_RATE_INFO[BASE_VIDEO_FORMAT_INFO[index].frame_rate_index].denom;
+
+  return TRUE;
+}
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      vc2_vlc_decoder_read_uint(dec);
-    }
+void vc2_parse_info_write (guint8 *data, guint8 parse_code, guint32 next_parse_offset, guint32 prev_parse_offset) {
+  data[ 0] = 0x42;
+  data[ 1] = 0x42;
+  data[ 2] = 0x43;
+  data[ 3] = 0x44;
+  data[ 4] = parse_code;
+  data[ 5] = (next_parse_offset >> 24)&0xFF;
+  data[ 6] = (next_parse_offset >> 16)&0xFF;
+  data[ 7] = (next_parse_offset >>  8)&0xFF;
+  data[ 8] = (next_parse_offset >>  0)&0xFF;
+  data[ 9] = (prev_parse_offset >> 24)&0xFF;
+  data[10] = (prev_parse_offset >> 16)&0xFF;
+  data[11] = (prev_parse_offset >>  8)&0xFF;
+  data[12] = (prev_parse_offset >>  0)&0xFF;
+}
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      vc2_vlc_decoder_read_uint(dec);
-    }
+gboolean vc2_parse_info_read (const guint8 *data, gsize size, vc2_parse_info *info) {
+  if (size < 13)
+    return FALSE;
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      if (vc2_vlc_decoder_read_uint(dec) == 0) {
-        vc2_vlc_decoder_read_uint(dec);
-        vc2_vlc_decoder_read_uint(dec);
-      }
+  if (data[0] != 0x42 || data[1] != 0x42 || data[2] != 0x43 || data[3] != 0x44)
+    return FALSE;
+
+  info->parse_code        = data[4];
+  info->next_parse_offset = (((guint32)data[ 5] << 24) |
+                             ((guint32)data[ 6] << 16) |
+                             ((guint32)data[ 7] <<  8) |
+                             ((guint32)data[ 8] <<  0));
+  info->prev_parse_offset = (((guint32)data[ 9] << 24) |
+                             ((guint32)data[10] << 16) |
+                             ((guint32)data[11] <<  8) |
+                             ((guint32)data[12] <<  0));
+  return TRUE;
+}
+
+/* Reads the parse info header at offset in the first size bytes of adapter.
+ * A header is only accepted once the following header has been seen and
+ * points back to it, except for an end of sequence, which has nothing after
+ * it. When next_parse_offset is zero the length of the unit is found by
+ * scanning for a following header which points back. A unit longer than
+ * max_unit_size (0 for no limit) is invalid, so that a corrupt
+ * next_parse_offset cannot keep the caller waiting for data forever. */
+vc2_parse_info_result vc2_parse_info_extract (GstAdapter *adapter, gsize size, gsize offset, gsize max_unit_size,
+                                              vc2_parse_info *info) {
+  guint8 buf[13];
+  vc2_parse_info first, next;
+  gssize nextoffset;
+  gsize limit;
+
+  if (offset + 13 > size)
+    return VC2_PARSE_INFO_NEED_DATA;
+
+  gst_adapter_copy(adapter, buf, offset, 13);
+  if (!vc2_parse_info_read(buf, 13, &first))
+    return VC2_PARSE_INFO_INVALID;
+
+  if (first.parse_code == 0x10) {
+    *info = first;
+    return VC2_PARSE_INFO_OK;
+  }
+
+  if (first.next_parse_offset != 0) {
+    if (first.next_parse_offset < 13 ||
+        (max_unit_size != 0 && first.next_parse_offset > max_unit_size))
+      return VC2_PARSE_INFO_INVALID;
+
+    if (first.next_parse_offset > size - offset - 13)
+      return VC2_PARSE_INFO_NEED_DATA;
+
+    gst_adapter_copy(adapter, buf, offset + first.next_parse_offset, 13);
+    if (!vc2_parse_info_read(buf, 13, &next) || next.prev_parse_offset != first.next_parse_offset)
+      return VC2_PARSE_INFO_INVALID;
+
+    *info = first;
+    return VC2_PARSE_INFO_OK;
+  }
+
+  /* Only scan as far as the header after the longest unit allowed */
+  limit = size;
+  if (max_unit_size != 0 && size - offset - 13 > max_unit_size)
+    limit = offset + max_unit_size + 13;
+
+  nextoffset = offset + 13;
+  while (TRUE) {
+    if (nextoffset + 4 > limit)
+      return (limit < size) ? VC2_PARSE_INFO_INVALID : VC2_PARSE_INFO_NEED_DATA;
+
+    nextoffset = gst_adapter_masked_scan_uint32(adapter, 0xFFFFFFFF, 0x42424344, nextoffset, limit - nextoffset);
+    if (nextoffset < 0 || nextoffset + 13 > limit)
+      return (limit < size) ? VC2_PARSE_INFO_INVALID : VC2_PARSE_INFO_NEED_DATA;
+
+    gst_adapter_copy(adapter, buf, nextoffset, 13);
+    vc2_parse_info_read(buf, 13, &next);
+    if (nextoffset - offset == next.prev_parse_offset) {
+      first.next_parse_offset = nextoffset - offset;
+      *info = first;
+      return VC2_PARSE_INFO_OK;
     }
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      if (vc2_vlc_decoder_read_uint(dec) == 0) {
-        vc2_vlc_decoder_read_uint(dec);
-        vc2_vlc_decoder_read_uint(dec);
-      }
+    nextoffset += 4;
+  }
+}
+
+/* Finds the first parse info header at or after offset which
+ * vc2_parse_info_extract accepts, or returns -1 if there is none yet. A
+ * candidate which needs more data does not stop the search, as a header
+ * with a corrupt next_parse_offset could otherwise hold it up forever. */
+gssize vc2_parse_info_find (GstAdapter *adapter, gsize size, gsize offset, gsize max_unit_size) {
+  vc2_parse_info info;
+  gssize parse_info_offset;
+
+  while (offset + 4 <= size) {
+    parse_info_offset = gst_adapter_masked_scan_uint32(adapter, 0xFFFFFFFF, 0x42424344, offset, size - offset);
+    if (parse_info_offset < 0)
+      break;
+
+    if (vc2_parse_info_extract(adapter, size, parse_info_offset, max_unit_size, &info) == VC2_PARSE_INFO_OK)
+      return parse_info_offset;
+
+    offset = parse_info_offset + 1;
+  }
+
+  return -1;
+}
+
+vc2_sequence_header* vc2_sequence_header_new (GstBuffer *buf) {
+  vc2_sequence_header* hdr;
+  vc2_vlc_decoder dec;
+  GstMapInfo info;
+  guint32 major_version, profile, base_video_format;
+  guint32 frame_width, frame_height, picture_coding_mode, color_diff_format;
+  guint32 frame_rate_numer, frame_rate_denom, frame_rate_index;
+  gboolean interlaced;
+
+  if (!gst_buffer_map(buf, &info, GST_MAP_READ))
+    return NULL;
+  vc2_vlc_decoder_init(&dec, info.data, info.size);
+
+  major_version = vc2_vlc_decoder_read_uint(&dec);
+  vc2_vlc_decoder_read_uint(&dec);
+  profile       = vc2_vlc_decoder_read_uint(&dec);
+  vc2_vlc_decoder_read_uint(&dec);
+
+  if (major_version != 2 || (profile != VC2_PROFILE_LOW_DELAY && profile != VC2_PROFILE_HIGH_QUALITY))
+    goto invalid;
+
+  base_video_format = vc2_vlc_decoder_read_uint(&dec);
+  if (!vc2_base_video_format_get(base_video_format, &frame_width, &frame_height, &interlaced,
+                                 &frame_rate_numer, &frame_rate_denom))
+    goto invalid;
+  color_diff_format = BASE_VIDEO_FORMAT_INFO[base_video_format].color_diff_format;
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    frame_width  = vc2_vlc_decoder_read_uint(&dec);
+    frame_height = vc2_vlc_decoder_read_uint(&dec);
+  }
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    color_diff_format = vc2_vlc_decoder_read_uint(&dec);
+  }
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    vc2_vlc_decoder_read_uint(&dec);
+  }
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    frame_rate_index = vc2_vlc_decoder_read_uint(&dec);
+    if (frame_rate_index == 0) {
+      frame_rate_numer = vc2_vlc_decoder_read_uint(&dec);
+      frame_rate_denom = vc2_vlc_decoder_read_uint(&dec);
+    } else if (frame_rate_index < N_FRAME_RATES) {
+      frame_rate_numer = FRAME_RATE_INFO[frame_rate_index].numer;
+      frame_rate_denom = FRAME_RATE_INFO[frame_rate_index].denom;
+    } else {
+      goto invalid;
     }
+  }
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      vc2_vlc_decoder_read_uint(dec);
-      vc2_vlc_decoder_read_uint(dec);
-      vc2_vlc_decoder_read_uint(dec);
-      vc2_vlc_decoder_read_uint(dec);
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    if (vc2_vlc_decoder_read_uint(&dec) == 0) {
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
     }
+  }
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      if (vc2_vlc_decoder_read_uint(dec) == 0) {
-        vc2_vlc_decoder_read_uint(dec);
-        vc2_vlc_decoder_read_uint(dec);
-        vc2_vlc_decoder_read_uint(dec);
-        vc2_vlc_decoder_read_uint(dec);
-      }
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    vc2_vlc_decoder_read_uint(&dec);
+    vc2_vlc_decoder_read_uint(&dec);
+    vc2_vlc_decoder_read_uint(&dec);
+    vc2_vlc_decoder_read_uint(&dec);
+  }
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    if (vc2_vlc_decoder_read_uint(&dec) == 0) {
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
     }
+  }
 
-    if (vc2_vlc_decoder_read_bool(dec)) {
-      if (vc2_vlc_decoder_read_uint(dec) == 0) {
-        if (vc2_vlc_decoder_read_bool(dec)) {
-          vc2_vlc_decoder_read_uint(dec);
-        }
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    if (vc2_vlc_decoder_read_uint(&dec) == 0) {
+      if (vc2_vlc_decoder_read_bool(&dec)) {
+        vc2_vlc_decoder_read_uint(&dec);
+      }
 
-        if (vc2_vlc_decoder_read_bool(dec)) {
-          vc2_vlc_decoder_read_uint(dec);
-        }
+      if (vc2_vlc_decoder_read_bool(&dec)) {
+        vc2_vlc_decoder_read_uint(&dec);
+      }
 
-        if (vc2_vlc_decoder_read_bool(dec)) {
-          vc2_vlc_decoder_read_uint(dec);
-        }
+      if (vc2_vlc_decoder_read_bool(&dec)) {
+        vc2_vlc_decoder_read_uint(&dec);
       }
     }
+  }
 
-    int picture_coding_mode = vc2_vlc_decoder_read_uint(dec);
-    if (picture_coding_mode == 0) {
-      interlaced = FALSE;
-    } else {
-      interlaced = TRUE;
-    }
-    
-    hdr->picture_width = frame_width;
-    if (interlaced) {
-      hdr->picture_height = frame_height/2;
-      hdr->interlaced = TRUE;
-    } else {
-      hdr->picture_height = frame_height;
-      hdr->interlaced = FALSE;
-    }
+  picture_coding_mode = vc2_vlc_decoder_read_uint(&dec);
+  if (picture_coding_mode > 1)
+    goto invalid;
+  interlaced = (picture_coding_mode == 1);
 
-    vc2_vlc_decoder_free(dec);
-    gst_buffer_unmap(hdr->buf, &info);
-  }
+  /* A truncated header reads as a run of 1 bits, which can look valid, so
+   * anything which ran off the end is rejected here */
+  if (vc2_vlc_decoder_overrun(&dec) || frame_width == 0 || frame_height < ((interlaced)?(2):(1)) ||
+      color_diff_format > VC2_COLOR_DIFF_420 || frame_rate_numer == 0 || frame_rate_denom == 0)
+    goto invalid;
+
+  gst_buffer_unmap(buf, &info);
+
+  hdr = (vc2_sequence_header*)malloc(sizeof(vc2_sequence_header));
+  hdr->buf            = gst_buffer_ref(buf);
+  hdr->length         = gst_buffer_get_size(buf);
+  hdr->picture_width  = frame_width;
+  hdr->interlaced     = interlaced;
+  hdr->profile        = profile;
+  hdr->color_diff_format = color_diff_format;
+  hdr->frame_rate_numer  = frame_rate_numer;
+  hdr->frame_rate_denom  = frame_rate_denom;
+  if (interlaced)
+    hdr->picture_height = frame_height/2;
+  else
+    hdr->picture_height = frame_height;
 
   return hdr;
+
+invalid:
+  gst_buffer_unmap(buf, &info);
+  return NULL;
 }
 
 gboolean             vc2_sequence_header_cmp (vc2_sequence_header* hdr, GstBuffer *buf, gsize size) {
+  GstMapInfo info;
+  gboolean r;
+
   if (hdr == NULL)
     return FALSE;
 
-  if (hdr->length > size)
+  if (hdr->length != size)
     return FALSE;
 
-  gboolean r = TRUE;
-  {
-    char *data = malloc(hdr->length);
-    gst_buffer_extract(hdr->buf, 0, data, hdr->length);
-
-    if (gst_buffer_memcmp(buf, 0, data, hdr->length))
-      r = FALSE;
-
-    free(data);
-  }
+  if (!gst_buffer_map(hdr->buf, &info, GST_MAP_READ))
+    return FALSE;
+  r = (gst_buffer_memcmp(buf, 0, info.data, hdr->length) == 0);
+  gst_buffer_unmap(hdr->buf, &info);
 
   return r;
 }
@@ -250,36 +517,143 @@ void                 vc2_sequence_header_free(vc2_sequence_header* hdr) {
   }
 }
 
-vc2_hq_transform_parameters* vc2_hq_transform_parameters_new (guint8 *data, gssize data_size) {
-  vc2_hq_transform_parameters* params = (vc2_hq_transform_parameters *)malloc(sizeof(vc2_hq_transform_parameters));
-  vc2_vlc_decoder* dec = vc2_vlc_decoder_new(data, data_size);
+static guint32 vc2_vlc_copy_uint (vc2_vlc_decoder *dec, vc2_vlc_encoder *enc) {
+  guint32 d = vc2_vlc_decoder_read_uint(dec);
+  vc2_vlc_encoder_write_uint(enc, d);
+  return d;
+}
+
+static gboolean vc2_vlc_copy_bool (vc2_vlc_decoder *dec, vc2_vlc_encoder *enc) {
+  gboolean d = vc2_vlc_decoder_read_bool(dec);
+  vc2_vlc_encoder_write_bool(enc, d);
+  return d;
+}
+
+/* Writes a copy of hdr with custom frame dimensions and a clean area which
+ * covers the whole of the new frame. The level is set to 0, as the new
+ * dimensions are unlikely to meet the constraints of the original level.
+ * Returns the length written, or 0 if it did not fit in size bytes. */
+gsize vc2_sequence_header_write_dimensions (vc2_sequence_header *hdr, guint32 frame_width, guint32 frame_height,
+                                            guint8 *data, gsize size) {
+  vc2_vlc_decoder dec;
+  vc2_vlc_encoder *enc;
+  GstMapInfo info;
+  gsize length;
   int i;
 
-  params->wavelet_index      = vc2_vlc_decoder_read_uint(dec);
-  params->dwt_depth          = vc2_vlc_decoder_read_uint(dec);
-  params->slices_x           = vc2_vlc_decoder_read_uint(dec);
-  params->slices_y           = vc2_vlc_decoder_read_uint(dec);
-  params->slice_prefix_bytes = vc2_vlc_decoder_read_uint(dec);
-  params->slice_size_scalar  = vc2_vlc_decoder_read_uint(dec);
-
-  if (vc2_vlc_decoder_read_bool(dec)) {
-    vc2_vlc_decoder_read_uint(dec);
-    for (i = 1; i < params->dwt_depth; i++) {
-      vc2_vlc_decoder_read_uint(dec);
-      vc2_vlc_decoder_read_uint(dec);
-      vc2_vlc_decoder_read_uint(dec);
+  if (!gst_buffer_map(hdr->buf, &info, GST_MAP_READ))
+    return 0;
+  vc2_vlc_decoder_init(&dec, info.data, info.size);
+  enc = vc2_vlc_encoder_new(data, size);
+
+  vc2_vlc_copy_uint(&dec, enc);                 /* major version */
+  vc2_vlc_copy_uint(&dec, enc);                 /* minor version */
+  vc2_vlc_copy_uint(&dec, enc);                 /* profile */
+  vc2_vlc_decoder_read_uint(&dec);              /* level */
+  vc2_vlc_encoder_write_uint(enc, 0);
+  vc2_vlc_copy_uint(&dec, enc);                 /* base video format */
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    vc2_vlc_decoder_read_uint(&dec);
+    vc2_vlc_decoder_read_uint(&dec);
+  }
+  vc2_vlc_encoder_write_bool(enc, TRUE);
+  vc2_vlc_encoder_write_uint(enc, frame_width);
+  vc2_vlc_encoder_write_uint(enc, frame_height);
+
+  if (vc2_vlc_copy_bool(&dec, enc))             /* colour difference format */
+    vc2_vlc_copy_uint(&dec, enc);
+
+  if (vc2_vlc_copy_bool(&dec, enc))             /* scan format */
+    vc2_vlc_copy_uint(&dec, enc);
+
+  if (vc2_vlc_copy_bool(&dec, enc)) {           /* frame rate */
+    if (vc2_vlc_copy_uint(&dec, enc) == 0) {
+      vc2_vlc_copy_uint(&dec, enc);
+      vc2_vlc_copy_uint(&dec, enc);
+    }
+  }
+
+  if (vc2_vlc_copy_bool(&dec, enc)) {           /* pixel aspect ratio */
+    if (vc2_vlc_copy_uint(&dec, enc) == 0) {
+      vc2_vlc_copy_uint(&dec, enc);
+      vc2_vlc_copy_uint(&dec, enc);
+    }
+  }
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {        /* clean area */
+    for (i = 0; i < 4; i++)
+      vc2_vlc_decoder_read_uint(&dec);
+  }
+  vc2_vlc_encoder_write_bool(enc, TRUE);
+  vc2_vlc_encoder_write_uint(enc, frame_width);
+  vc2_vlc_encoder_write_uint(enc, frame_height);
+  vc2_vlc_encoder_write_uint(enc, 0);
+  vc2_vlc_encoder_write_uint(enc, 0);
+
+  if (vc2_vlc_copy_bool(&dec, enc)) {           /* signal range */
+    if (vc2_vlc_copy_uint(&dec, enc) == 0) {
+      for (i = 0; i < 4; i++)
+        vc2_vlc_copy_uint(&dec, enc);
+    }
+  }
+
+  if (vc2_vlc_copy_bool(&dec, enc)) {           /* colour spec */
+    if (vc2_vlc_copy_uint(&dec, enc) == 0) {
+      for (i = 0; i < 3; i++) {
+        if (vc2_vlc_copy_bool(&dec, enc))
+          vc2_vlc_copy_uint(&dec, enc);
+      }
+    }
+  }
+
+  vc2_vlc_copy_uint(&dec, enc);                 /* picture coding mode */
+
+  length = vc2_vlc_encoder_length(enc);
+  if (vc2_vlc_decoder_overrun(&dec) || vc2_vlc_encoder_overrun(enc))
+    length = 0;
+  vc2_vlc_encoder_free(enc);
+  gst_buffer_unmap(hdr->buf, &info);
+
+  return length;
+}
+
+vc2_hq_transform_parameters* vc2_hq_transform_parameters_new (guint8 *data, gssize data_size) {
+  vc2_hq_transform_parameters* params;
+  vc2_vlc_decoder dec;
+  guint32 i;
+
+  params = (vc2_hq_transform_parameters *)malloc(sizeof(vc2_hq_transform_parameters));
+  vc2_vlc_decoder_init(&dec, data, data_size);
+
+  params->wavelet_index      = vc2_vlc_decoder_read_uint(&dec);
+  params->dwt_depth          = vc2_vlc_decoder_read_uint(&dec);
+  params->slices_x           = vc2_vlc_decoder_read_uint(&dec);
+  params->slices_y           = vc2_vlc_decoder_read_uint(&dec);
+  params->slice_prefix_bytes = vc2_vlc_decoder_read_uint(&dec);
+  params->slice_size_scalar  = vc2_vlc_decoder_read_uint(&dec);
+
+  /* a custom quantisation matrix has one value for the DC band and three
+   * for each level of the transform */
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    vc2_vlc_decoder_read_uint(&dec);
+    for (i = 0; i < params->dwt_depth && !vc2_vlc_decoder_overrun(&dec); i++) {
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
     }
   }
 
-  params->coded_size = vc2_vlc_decoder_length(dec);
+  params->coded_size = vc2_vlc_decoder_length(&dec);
 
-  if (vc2_vlc_decoder_overrun(dec)) {
-    vc2_vlc_decoder_free(dec);
+  /* The slice count is used to size tables, so it has to be sane as well */
+  if (vc2_vlc_decoder_overrun(&dec) ||
+      params->slices_x == 0 || params->slices_y == 0 ||
+      (guint64)params->slices_x*params->slices_y > G_MAXUINT32) {
     free(params);
     return NULL;
   }
 
-  vc2_vlc_decoder_free(dec);
   return params;
 }
 
@@ -287,3 +661,115 @@ void vc2_hq_transform_parameters_free(vc2_hq_transform_parameters* params) {
   if (params)
     free(params);
 }
+
+/* The low delay transform parameters differ from the HQ ones only in giving
+ * the slice sizes as a fraction of bytes instead of a prefix and scalar */
+vc2_ld_transform_parameters* vc2_ld_transform_parameters_new (guint8 *data, gssize data_size) {
+  vc2_ld_transform_parameters* params;
+  vc2_vlc_decoder dec;
+  guint32 i;
+
+  params = (vc2_ld_transform_parameters *)malloc(sizeof(vc2_ld_transform_parameters));
+  vc2_vlc_decoder_init(&dec, data, data_size);
+
+  params->wavelet_index           = vc2_vlc_decoder_read_uint(&dec);
+  params->dwt_depth               = vc2_vlc_decoder_read_uint(&dec);
+  params->slices_x                = vc2_vlc_decoder_read_uint(&dec);
+  params->slices_y                = vc2_vlc_decoder_read_uint(&dec);
+  params->slice_bytes_numerator   = vc2_vlc_decoder_read_uint(&dec);
+  params->slice_bytes_denominator = vc2_vlc_decoder_read_uint(&dec);
+
+  if (vc2_vlc_decoder_read_bool(&dec)) {
+    vc2_vlc_decoder_read_uint(&dec);
+    for (i = 0; i < params->dwt_depth && !vc2_vlc_decoder_overrun(&dec); i++) {
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
+      vc2_vlc_decoder_read_uint(&dec);
+    }
+  }
+
+  params->coded_size = vc2_vlc_decoder_length(&dec);
+
+  /* Every slice has to hold at least its quantisation index, so a slice of
+   * less than a byte means the parameters are corrupt */
+  if (vc2_vlc_decoder_overrun(&dec) ||
+      params->slices_x == 0 || params->slices_y == 0 ||
+      (guint64)params->slices_x*params->slices_y > G_MAXUINT32 ||
+      params->slice_bytes_denominator == 0 ||
+      params->slice_bytes_numerator < params->slice_bytes_denominator) {
+    free(params);
+    return NULL;
+  }
+
+  return params;
+}
+
+void vc2_ld_transform_parameters_free(vc2_ld_transform_parameters* params) {
+  if (params)
+    free(params);
+}
+
+/* Returns the offset of low delay slice n from the first slice. Slice n is
+ * always the bytes between the offsets of slices n and n + 1, so where any
+ * run of slices starts and ends follows from the parameters alone. */
+guint64 vc2_ld_slice_offset (vc2_ld_transform_parameters *params, guint64 n) {
+  return gst_util_uint64_scale(n, params->slice_bytes_numerator, params->slice_bytes_denominator);
+}
+
+/* Writes a copy of the transform parameters at data with the slice counts
+ * replaced. Returns the length written, or 0 if the parameters could not be
+ * read or did not fit in size bytes. */
+gsize vc2_hq_transform_parameters_write_slices (const guint8 *data, gsize data_size, guint32 slices_x, guint32 slices_y,
+                                                guint8 *out, gsize size) {
+  vc2_vlc_decoder dec;
+  vc2_vlc_encoder *enc;
+  guint32 dwt_depth, i;
+  gsize length;
+
+  vc2_vlc_decoder_init(&dec, (guint8 *)data, data_size);
+  enc = vc2_vlc_encoder_new(out, size);
+
+  vc2_vlc_copy_uint(&dec, enc);                 /* wavelet index */
+  dwt_depth = vc2_vlc_copy_uint(&dec, enc);
+  vc2_vlc_decoder_read_uint(&dec);
+  vc2_vlc_decoder_read_uint(&dec);
+  vc2_vlc_encoder_write_uint(enc, slices_x);
+  vc2_vlc_encoder_write_uint(enc, slices_y);
+  vc2_vlc_copy_uint(&dec, enc);                 /* slice prefix bytes */
+  vc2_vlc_copy_uint(&dec, enc);                 /* slice size scalar */
+
+  if (vc2_vlc_copy_bool(&dec, enc)) {
+    vc2_vlc_copy_uint(&dec, enc);
+    for (i = 0; i < dwt_depth && !vc2_vlc_decoder_overrun(&dec); i++) {
+      vc2_vlc_copy_uint(&dec, enc);
+      vc2_vlc_copy_uint(&dec, enc);
+      vc2_vlc_copy_uint(&dec, enc);
+    }
+  }
+
+  length = vc2_vlc_encoder_length(enc);
+  if (vc2_vlc_decoder_overrun(&dec) || vc2_vlc_encoder_overrun(enc))
+    length = 0;
+  vc2_vlc_encoder_free(enc);
+
+  return length;
+}
+
+/* Returns the coded length of the HQ slice starting at data, or 0 if the slice
+ * does not fit in size bytes */
+gsize vc2_hq_slice_length (const guint8 *data, gsize size, guint32 slice_prefix_bytes, guint32 slice_size_scalar) {
+  guint64 length = (guint64) slice_prefix_bytes + 1;
+  int i;
+
+  /* prefix and qindex, followed by a length byte and data for each component */
+  for (i = 0; i < 3; i++) {
+    if (length >= size)
+      return 0;
+    length += data[length]*slice_size_scalar + 1;
+  }
+
+  if (length > size)
+    return 0;
+
+  return length;
+}
@@ -22,6 +22,7 @@
 #define __VC2_VLC_PARSE_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 
 G_BEGIN_DECLS
 
@@ -32,8 +33,10 @@ struct _vc2_vlc_decoder {
   int bit;
   int offset;
   int size;
+  gboolean overrun;
 };
 
+void             vc2_vlc_decoder_init     (vc2_vlc_decoder *decoder, guint8 *data, gssize size);
 vc2_vlc_decoder* vc2_vlc_decoder_new      (guint8 *data, gssize size);
 gboolean         vc2_vlc_decoder_overrun  (vc2_vlc_decoder *decoder);
 gboolean         vc2_vlc_decoder_read_bool(vc2_vlc_decoder *decoder);
@@ -41,6 +44,64 @@ guint32          vc2_vlc_decoder_read_uint(vc2_vlc_decoder *decoder);
 gssize           vc2_vlc_decoder_length   (vc2_vlc_decoder *decoder);
 void             vc2_vlc_decoder_free     (vc2_vlc_decoder *decoder);
 
+typedef struct _vc2_vlc_encoder vc2_vlc_encoder;
+
+struct _vc2_vlc_encoder {
+  guint8 *start;
+  int bit;
+  int offset;
+  int size;
+  gboolean overrun;
+};
+
+vc2_vlc_encoder* vc2_vlc_encoder_new       (guint8 *data, gssize size);
+gboolean         vc2_vlc_encoder_overrun   (vc2_vlc_encoder *encoder);
+void             vc2_vlc_encoder_write_bool(vc2_vlc_encoder *encoder, gboolean d);
+void             vc2_vlc_encoder_write_uint(vc2_vlc_encoder *encoder, guint32 d);
+gssize           vc2_vlc_encoder_length    (vc2_vlc_encoder *encoder);
+void             vc2_vlc_encoder_free      (vc2_vlc_encoder *encoder);
+
+/* colour difference formats, as coded in the sequence header */
+enum {
+  VC2_COLOR_DIFF_444 = 0,
+  VC2_COLOR_DIFF_422 = 1,
+  VC2_COLOR_DIFF_420 = 2,
+};
+
+/* profiles, as coded in the sequence header */
+enum {
+  VC2_PROFILE_LOW_DELAY    = 0,
+  VC2_PROFILE_HIGH_QUALITY = 3,
+};
+
+gboolean vc2_base_video_format_get (guint32 index,
+                                    guint32 *frame_width, guint32 *frame_height, gboolean *interlaced,
+                                    guint32 *frame_rate_numer, guint32 *frame_rate_denom);
+
+typedef struct _vc2_parse_info vc2_parse_info;
+
+struct _vc2_parse_info {
+  guint8  parse_code;
+  guint32 next_parse_offset;
+  guint32 prev_parse_offset;
+};
+
+/* Units longer than this, counting their parse info header, are taken to be
+ * a corrupt next_parse_offset rather than waited for */
+#define VC2_PARSE_INFO_DEFAULT_MAX_UNIT_SIZE (128*1024*1024)
+
+typedef enum {
+  VC2_PARSE_INFO_OK,
+  VC2_PARSE_INFO_NEED_DATA,
+  VC2_PARSE_INFO_INVALID,
+} vc2_parse_info_result;
+
+void                  vc2_parse_info_write   (guint8 *data, guint8 parse_code, guint32 next_parse_offset, guint32 prev_parse_offset);
+gboolean              vc2_parse_info_read    (const guint8 *data, gsize size, vc2_parse_info *info);
+vc2_parse_info_result vc2_parse_info_extract (GstAdapter *adapter, gsize size, gsize offset, gsize max_unit_size,
+                                              vc2_parse_info *info);
+gssize                vc2_parse_info_find    (GstAdapter *adapter, gsize size, gsize offset, gsize max_unit_size);
+
 typedef struct _vc2_sequence_header vc2_sequence_header;
 
 struct _vc2_sequence_header {
@@ -50,11 +111,17 @@ struct _vc2_sequence_header {
   guint32 picture_width;
   guint32 picture_height;
   gboolean interlaced;
+  guint32 profile;
+  guint32 color_diff_format;
+  guint32 frame_rate_numer;
+  guint32 frame_rate_denom;
 };
 
 vc2_sequence_header* vc2_sequence_header_new (GstBuffer *buf);
 gboolean             vc2_sequence_header_cmp (vc2_sequence_header* hdr, GstBuffer *buf, gsize size);
 void                 vc2_sequence_header_free(vc2_sequence_header* hdr);
+gsize                vc2_sequence_header_write_dimensions (vc2_sequence_header *hdr, guint32 frame_width, guint32 frame_height,
+                                                           guint8 *data, gsize size);
 
 typedef struct _vc2_hq_transform_parameters vc2_hq_transform_parameters;
 
@@ -71,6 +138,27 @@ struct _vc2_hq_transform_parameters {
 
 vc2_hq_transform_parameters* vc2_hq_transform_parameters_new (guint8 *data, gssize data_size);
 void vc2_hq_transform_parameters_free(vc2_hq_transform_parameters* params);
+gsize vc2_hq_transform_parameters_write_slices (const guint8 *data, gsize data_size, guint32 slices_x, guint32 slices_y,
+                                                guint8 *out, gsize size);
+
+typedef struct _vc2_ld_transform_parameters vc2_ld_transform_parameters;
+
+struct _vc2_ld_transform_parameters {
+  guint32 wavelet_index;
+  guint32 dwt_depth;
+  guint32 slices_x;
+  guint32 slices_y;
+  guint32 slice_bytes_numerator;
+  guint32 slice_bytes_denominator;
+
+  gsize   coded_size;
+};
+
+vc2_ld_transform_parameters* vc2_ld_transform_parameters_new (guint8 *data, gssize data_size);
+void vc2_ld_transform_parameters_free(vc2_ld_transform_parameters* params);
+guint64 vc2_ld_slice_offset (vc2_ld_transform_parameters *params, guint64 n);
+
+gsize vc2_hq_slice_length (const guint8 *data, gsize size, guint32 slice_prefix_bytes, guint32 slice_size_scalar);
 
 G_END_DECLS
 